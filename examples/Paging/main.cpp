@@ -104,6 +104,29 @@ public:
 	}
 };
 
+/**
+ * Prints the paging statistics gathered since they were last printed.
+ */
+void printPagingStatistics(PagedVolume<MaterialDensityPair44>& volData)
+{
+	PagingStatistics stats = volData.getPagingStatistics(true);
+	std::cout << "Paging statistics:" << std::endl;
+#ifdef POLYVOX_LOOKUP_STATISTICS_ENABLED
+	std::cout << "    Last chunk cache hit rate: " << stats.getLastChunkCacheHitRate() * 100.0f << "%" << std::endl;
+	std::cout << "    Chunk table lookups: " << stats.m_uNoOfChunkTableLookups << " (average probe length " << stats.getAverageProbeLength() << ")" << std::endl;
+#endif
+	std::cout << "    Page ins: " << stats.m_uNoOfPageIns << ", page outs: " << stats.m_uNoOfPageOuts << ", dirty write backs: " << stats.m_uNoOfDirtyWriteBacks << std::endl;
+	std::cout << "    Compressions: " << stats.m_uNoOfCompressions << ", evictions: " << stats.m_uNoOfEvictions << std::endl;
+	std::cout << "    Page in latency:" << std::endl;
+	for (uint32_t ct = 0; ct < PagingStatistics::uNoOfLatencyBuckets; ct++)
+	{
+		if (stats.m_arrayPageInLatency[ct] > 0)
+		{
+			std::cout << "        >= " << PagingStatistics::getLatencyBucketLowerBoundInMicroseconds(ct) << "us: " << stats.m_arrayPageInLatency[ct] << std::endl;
+		}
+	}
+}
+
 class PagingExample : public PolyVoxExample
 {
 public:
@@ -124,6 +147,7 @@ protected:
 		std::cout << "Prefetching region: " << reg.getLowerCorner() << " -> " << reg.getUpperCorner() << std::endl;
 		volData.prefetch(reg);
 		std::cout << "Memory usage: " << (volData.calculateSizeInBytes() / 1024.0 / 1024.0) << "MB" << std::endl;
+		printPagingStatistics(volData);
 		std::cout << "Flushing entire volume" << std::endl;
 		volData.flushAll();
 		std::cout << "Memory usage: " << (volData.calculateSizeInBytes() / 1024.0 / 1024.0) << "MB" << std::endl;
@@ -132,6 +156,7 @@ protected:
 		PolyVox::Region reg2(Vector3DInt32(0, 0, 0), Vector3DInt32(254, 254, 254));
 		auto mesh = extractCubicMesh(&volData, reg2);
 		std::cout << "#vertices: " << mesh.getNoOfVertices() << std::endl;
+		printPagingStatistics(volData);
 
 		auto decodedMesh = decodeMesh(mesh);
 
@@ -28,6 +28,7 @@
 #include "Region.h"
 #include "Vector.h"
 
+#include <functional>
 #include <limits>
 
 namespace PolyVox
@@ -43,6 +44,12 @@ namespace PolyVox
 	public:
 		typedef _VoxelType VoxelType;
 
+		/// Can be given to a volume to be told when its voxels are modified. The first region is the part of the volume which
+		/// changed, rounded out to the chunks (or tiles) in which the volume tracks changes. The second region also includes the
+		/// neighbouring voxels, which is what has to be re-extracted because surface extractors look one voxel beyond the region
+		/// they process (see the notes on region boundaries in the CubicSurfaceExtractor documentation).
+		typedef std::function<void(const Region& regChanged, const Region& regAffected)> ChangeListener;
+
 #ifndef SWIG
 		template <typename DerivedVolumeType>
 		class Sampler
@@ -118,6 +125,9 @@ namespace PolyVox
 		/// Sets the voxel at the position given by a 3D vector
 		void setVoxel(const Vector3DInt32& v3dPos, VoxelType tValue);
 
+		/// Gets bounds on the values of the voxels in the given Region, if the volume keeps track of them
+		bool getValueRange(const Region& regQuery, VoxelType& tMin, VoxelType& tMax) const;
+
 		/// Calculates approximatly how many bytes of memory the volume is currently using.
 		uint32_t calculateSizeInBytes(void);
 
@@ -118,6 +118,21 @@ namespace PolyVox
 		POLYVOX_THROW(not_implemented, "You should never call the base class version of this function.");
 	}
 
+	////////////////////////////////////////////////////////////////////////////////
+	/// Volumes which keep a summary of the values in each part of the volume (see PagedVolume::getValueRange()) provide their own
+	/// version of this function, which lets algorithms such as the surface extractors skip regions which cannot contain what they
+	/// are looking for. This version does not know anything about the voxels, and so always returns false.
+	/// \param regQuery The region to examine.
+	/// \param tMin Set to a value no greater than any voxel in the region, if the function returns true.
+	/// \param tMax Set to a value no smaller than any voxel in the region, if the function returns true.
+	/// \return Whether the bounds are known.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	bool BaseVolume<VoxelType>::getValueRange(const Region& /*regQuery*/, VoxelType& /*tMin*/, VoxelType& /*tMax*/) const
+	{
+		return false;
+	}
+
 	////////////////////////////////////////////////////////////////////////////////
 	/// 
 	////////////////////////////////////////////////////////////////////////////////
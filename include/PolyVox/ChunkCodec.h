@@ -0,0 +1,219 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_ChunkCodec_H__
+#define __PolyVox_ChunkCodec_H__
+
+#include "Impl/ErrorHandling.h"
+#include "Impl/LZEncoding.h"
+#include "Impl/PaletteEncoding.h"
+#include "Impl/RunLengthEncoding.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace PolyVox
+{
+	namespace ChunkCodecTags
+	{
+		/// Identifies the codec which compressed a chunk. User defined codecs should use tags from FirstUserTag onwards.
+		enum ChunkCodecTag
+		{
+			Raw = 0,
+			RunLength = 1,
+			Palette = 2,
+			LZ = 3,
+			FirstUserTag = 128
+		};
+	}
+
+	/**
+	 * A ChunkCodec compresses the voxel data of a chunk (which is in Morton order) so that a Pager can store it in less space. The
+	 * built in codecs are RawChunkCodec, RunLengthChunkCodec, PaletteChunkCodec and LZChunkCodec, and users can provide their own
+	 * by subclassing this.
+	 *
+	 * Pagers do not call the codec directly but use encodeChunkData() and decodeChunkData(), which store the codec's tag along with
+	 * the compressed data. This means that data written with one codec can still be read after the pager has switched to another.
+	 */
+	template <typename VoxelType>
+	class ChunkCodec
+	{
+	public:
+		virtual ~ChunkCodec() {};
+
+		/// Gets the tag which is stored with data compressed by this codec. It must be unique.
+		virtual uint8_t getTag(void) const = 0;
+
+		virtual void compress(const VoxelType* pData, uint32_t uNoOfVoxels, std::vector<uint8_t>& vecCompressedData) const = 0;
+		/// Must throw if the compressed data does not decode to exactly the given number of voxels.
+		virtual void decompress(const uint8_t* pCompressedData, size_t uCompressedSizeInBytes, VoxelType* pData, uint32_t uNoOfVoxels) const = 0;
+	};
+
+	/// Stores the data without compressing it.
+	template <typename VoxelType>
+	class RawChunkCodec : public ChunkCodec<VoxelType>
+	{
+	public:
+		uint8_t getTag(void) const { return ChunkCodecTags::Raw; }
+
+		void compress(const VoxelType* pData, uint32_t uNoOfVoxels, std::vector<uint8_t>& vecCompressedData) const
+		{
+			const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(pData);
+			vecCompressedData.assign(pBytes, pBytes + uNoOfVoxels * sizeof(VoxelType));
+		}
+
+		void decompress(const uint8_t* pCompressedData, size_t uCompressedSizeInBytes, VoxelType* pData, uint32_t uNoOfVoxels) const
+		{
+			POLYVOX_THROW_IF(uCompressedSizeInBytes != uNoOfVoxels * sizeof(VoxelType), std::runtime_error, "Raw chunk data has the wrong size.");
+			std::memcpy(pData, pCompressedData, uCompressedSizeInBytes);
+		}
+	};
+
+	/// Compresses the data with run length encoding, which suits smooth terrain with large areas of the same value.
+	template <typename VoxelType>
+	class RunLengthChunkCodec : public ChunkCodec<VoxelType>
+	{
+	public:
+		uint8_t getTag(void) const { return ChunkCodecTags::RunLength; }
+
+		void compress(const VoxelType* pData, uint32_t uNoOfVoxels, std::vector<uint8_t>& vecCompressedData) const
+		{
+			compressRunLength(pData, uNoOfVoxels, vecCompressedData);
+		}
+
+		void decompress(const uint8_t* pCompressedData, size_t uCompressedSizeInBytes, VoxelType* pData, uint32_t uNoOfVoxels) const
+		{
+			decompressRunLength(pCompressedData, uCompressedSizeInBytes, pData, uNoOfVoxels);
+		}
+	};
+
+	/// Compresses the data by storing each distinct value once and each voxel as a bit-packed index, which suits chunks with a few materials.
+	template <typename VoxelType>
+	class PaletteChunkCodec : public ChunkCodec<VoxelType>
+	{
+	public:
+		uint8_t getTag(void) const { return ChunkCodecTags::Palette; }
+
+		void compress(const VoxelType* pData, uint32_t uNoOfVoxels, std::vector<uint8_t>& vecCompressedData) const
+		{
+			compressPalette(pData, uNoOfVoxels, vecCompressedData);
+		}
+
+		void decompress(const uint8_t* pCompressedData, size_t uCompressedSizeInBytes, VoxelType* pData, uint32_t uNoOfVoxels) const
+		{
+			decompressPalette(pCompressedData, uCompressedSizeInBytes, pData, uNoOfVoxels);
+		}
+	};
+
+	/// Compresses the data with a fast LZ77 style compressor, which suits data with repeated patterns.
+	template <typename VoxelType>
+	class LZChunkCodec : public ChunkCodec<VoxelType>
+	{
+	public:
+		uint8_t getTag(void) const { return ChunkCodecTags::LZ; }
+
+		void compress(const VoxelType* pData, uint32_t uNoOfVoxels, std::vector<uint8_t>& vecCompressedData) const
+		{
+			compressLZ(reinterpret_cast<const uint8_t*>(pData), uNoOfVoxels * sizeof(VoxelType), vecCompressedData);
+		}
+
+		void decompress(const uint8_t* pCompressedData, size_t uCompressedSizeInBytes, VoxelType* pData, uint32_t uNoOfVoxels) const
+		{
+			decompressLZ(pCompressedData, uCompressedSizeInBytes, reinterpret_cast<uint8_t*>(pData), uNoOfVoxels * sizeof(VoxelType));
+		}
+	};
+
+	/**
+	 * Compresses the voxel data of a chunk with the given codec (or none if it is null), and writes the codec's tag followed by the
+	 * compressed data. If the codec does not make the data any smaller it is stored uncompressed instead, so the encoded data is never
+	 * more than one byte larger than the voxels.
+	 */
+	template <typename VoxelType>
+	void encodeChunkData(const ChunkCodec<VoxelType>* pCodec, const VoxelType* pData, uint32_t uNoOfVoxels, std::vector<uint8_t>& vecEncodedData)
+	{
+		const size_t uRawSizeInBytes = uNoOfVoxels * sizeof(VoxelType);
+
+		std::vector<uint8_t> vecCompressedData;
+		if (pCodec)
+		{
+			pCodec->compress(pData, uNoOfVoxels, vecCompressedData);
+		}
+
+		vecEncodedData.clear();
+		if (pCodec && (vecCompressedData.size() < uRawSizeInBytes))
+		{
+			vecEncodedData.reserve(vecCompressedData.size() + 1);
+			vecEncodedData.push_back(pCodec->getTag());
+			vecEncodedData.insert(vecEncodedData.end(), vecCompressedData.begin(), vecCompressedData.end());
+		}
+		else
+		{
+			const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(pData);
+			vecEncodedData.reserve(uRawSizeInBytes + 1);
+			vecEncodedData.push_back(ChunkCodecTags::Raw);
+			vecEncodedData.insert(vecEncodedData.end(), pBytes, pBytes + uRawSizeInBytes);
+		}
+	}
+
+	/**
+	 * Reverses encodeChunkData(). The data is decoded by the given codec if it has the right tag, and otherwise by the built in codec
+	 * with that tag. Throws if there is no codec with the tag, or if the data does not decode to exactly the given number of voxels.
+	 */
+	template <typename VoxelType>
+	void decodeChunkData(const ChunkCodec<VoxelType>* pCodec, const uint8_t* pEncodedData, size_t uEncodedSizeInBytes, VoxelType* pData, uint32_t uNoOfVoxels)
+	{
+		POLYVOX_THROW_IF(uEncodedSizeInBytes == 0, std::runtime_error, "Encoded chunk data is empty.");
+
+		const uint8_t uTag = pEncodedData[0];
+		const uint8_t* pCompressedData = pEncodedData + 1;
+		const size_t uCompressedSizeInBytes = uEncodedSizeInBytes - 1;
+
+		if (pCodec && (pCodec->getTag() == uTag))
+		{
+			pCodec->decompress(pCompressedData, uCompressedSizeInBytes, pData, uNoOfVoxels);
+			return;
+		}
+
+		switch (uTag)
+		{
+		case ChunkCodecTags::Raw:
+			RawChunkCodec<VoxelType>().decompress(pCompressedData, uCompressedSizeInBytes, pData, uNoOfVoxels);
+			break;
+		case ChunkCodecTags::RunLength:
+			RunLengthChunkCodec<VoxelType>().decompress(pCompressedData, uCompressedSizeInBytes, pData, uNoOfVoxels);
+			break;
+		case ChunkCodecTags::Palette:
+			PaletteChunkCodec<VoxelType>().decompress(pCompressedData, uCompressedSizeInBytes, pData, uNoOfVoxels);
+			break;
+		case ChunkCodecTags::LZ:
+			LZChunkCodec<VoxelType>().decompress(pCompressedData, uCompressedSizeInBytes, pData, uNoOfVoxels);
+			break;
+		default:
+			POLYVOX_THROW(std::runtime_error, "Chunk data was encoded with an unknown codec.");
+		}
+	}
+}
+
+#endif //__PolyVox_ChunkCodec_H__
@@ -35,4 +35,8 @@ SOFTWARE.
 //#define POLYVOX_ASSERTS_ENABLED
 #define POLYVOX_THROW_ENABLED
 
+// Counts hits on the last accessed chunk and chunk table lookups and probes for PagedVolume::getPagingStatistics(). This adds a little
+// work to every voxel access, so it is off by default and those counters are then always zero.
+//#define POLYVOX_LOOKUP_STATISTICS_ENABLED
+
 #endif
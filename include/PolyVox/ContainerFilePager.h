@@ -0,0 +1,752 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_ContainerFilePager_H__
+#define __PolyVox_ContainerFilePager_H__
+
+#include "Impl/PlatformDefinitions.h"
+
+#include "ChunkCodec.h"
+#include "PagedVolume.h"
+#include "Region.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_WIN32)
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#endif
+
+namespace PolyVox
+{
+	/**
+	 * An implementation of Pager which stores all the chunks of a volume in a single container file, which is kept open for the
+	 * lifetime of the pager. Unlike FilePager the file is not deleted when the pager is destroyed, so it can be used to save a
+	 * volume and load it again later. Paging a chunk in or out costs a seek and a read or write, rather than creating or opening
+	 * a file for every chunk.
+	 *
+	 * Each chunk is stored as a record (a small header followed by the voxel data) and the pager keeps an index of where each
+	 * record is in memory. When a chunk is paged out again a new record is written (reusing free space where possible), and only
+	 * then is the old one marked as free. Records are never overwritten while they are in use, so a crash while paging out leaves
+	 * the previous data of the chunk intact. The index is saved in the container by flush() and when the pager is destroyed, so
+	 * that opening the file does not have to read every record. If the index is missing (for example because the application
+	 * crashed) it is rebuilt by scanning the records instead, and the sequence numbers in the records show which is the latest
+	 * for each chunk. This relies on the writes reaching the disk in order, which the pager does not force.
+	 *
+	 * Space which is freed is only reused for records which fit in it, so compact() can be called from time to time to rewrite
+	 * the container without any gaps. The same container must always be used with the same voxel type and chunk side length.
+	 *
+	 * When the volume prefetches or writes back a number of chunks at once they are read and written in the order in which they
+	 * are stored in the container, and records which are close together are read with a single call.
+	 *
+	 * A ChunkCodec can be given to compress the chunks. Each record stores the tag of the codec which wrote it, so the codec can
+	 * be changed when the container is reopened and the chunks which were written with the old one can still be read.
+	 */
+	template <typename VoxelType>
+	class ContainerFilePager : public PagedVolume<VoxelType>::Pager
+	{
+	public:
+		/// Opens the given container file, creating it if it does not exist. The codec (if any) must outlive the pager.
+		ContainerFilePager(const std::string& strFilename, const ChunkCodec<VoxelType>* pCodec = nullptr)
+			:PagedVolume<VoxelType>::Pager()
+			, m_strFilename(strFilename)
+			, m_pCodec(pCodec)
+			, m_pFile(nullptr)
+			, m_uEndOfFile(sizeof(FileHeader))
+			, m_uNextSequenceNumber(1)
+			, m_bIndexSaved(false)
+		{
+			try
+			{
+				open();
+			}
+			catch (...)
+			{
+				// The destructor is not called if we throw, so the container must be closed here.
+				if (m_pFile)
+				{
+					fclose(m_pFile);
+				}
+				throw;
+			}
+		}
+
+		/// Destructor, saves the index and closes the container.
+		virtual ~ContainerFilePager()
+		{
+			// The container may not be open if compacting it failed.
+			if (!m_pFile)
+			{
+				return;
+			}
+
+			try
+			{
+				flush();
+			}
+			catch (const std::exception& e)
+			{
+				POLYVOX_LOG_ERROR("Failed to save the index of '", m_strFilename, "': ", e.what());
+			}
+
+			fclose(m_pFile);
+		}
+
+		virtual void pageIn(const Region& region, typename PagedVolume<VoxelType>::Chunk* pChunk)
+		{
+			POLYVOX_ASSERT(pChunk, "Attempting to page in NULL chunk");
+			POLYVOX_ASSERT(pChunk->getData(), "Chunk must have valid data");
+
+			std::vector<uint8_t> vecEncodedData;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				auto iterRecord = m_mapChunkRecords.find(packChunkPosition(region));
+				if (iterRecord != m_mapChunkRecords.end())
+				{
+					// The record header is in the index, so only the data needs to be read.
+					const RecordHeader& header = iterRecord->second.m_header;
+					POLYVOX_THROW_IF(header.m_uSideLength != static_cast<uint32_t>(region.getWidthInVoxels()), std::runtime_error,
+						"The chunk side length does not match the one used to write the container.");
+
+					vecEncodedData.resize(header.m_uSizeInBytes);
+					readAt(iterRecord->second.m_uOffset + sizeof(RecordHeader), vecEncodedData.data(), vecEncodedData.size());
+				}
+			}
+
+			// The data is decompressed after releasing the lock, so other threads can use the file meanwhile.
+			decodeChunk(region, pChunk, vecEncodedData);
+		}
+
+		/// Reads the chunks in the order in which their records are stored, and reads records which are close together with a
+		/// single call. This turns the page ins of a large area into mostly sequential reads.
+		virtual void pageInBatch(const std::vector<typename PagedVolume<VoxelType>::Pager::PageRequest>& vecRequests)
+		{
+			std::vector< std::vector<uint8_t> > vecEncodedData(vecRequests.size());
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				// The records to read, sorted by their offsets.
+				struct RecordToRead
+				{
+					const IndexEntry* m_pEntry;
+					size_t m_uRequest;
+
+					bool operator<(const RecordToRead& rhs) const
+					{
+						return m_pEntry->m_uOffset < rhs.m_pEntry->m_uOffset;
+					}
+				};
+				std::vector<RecordToRead> vecRecords;
+				vecRecords.reserve(vecRequests.size());
+				for (size_t ct = 0; ct < vecRequests.size(); ct++)
+				{
+					auto iterRecord = m_mapChunkRecords.find(packChunkPosition(vecRequests[ct].first));
+					if (iterRecord != m_mapChunkRecords.end())
+					{
+						POLYVOX_THROW_IF(iterRecord->second.m_header.m_uSideLength != static_cast<uint32_t>(vecRequests[ct].first.getWidthInVoxels()), std::runtime_error,
+							"The chunk side length does not match the one used to write the container.");
+						RecordToRead record = { &iterRecord->second, ct };
+						vecRecords.push_back(record);
+					}
+				}
+				std::sort(vecRecords.begin(), vecRecords.end());
+
+				std::vector<uint8_t> vecBuffer;
+				for (size_t uFirstRecord = 0; uFirstRecord < vecRecords.size();)
+				{
+					// Reading a small gap (such as a free record) is cheaper than seeking past it.
+					const uint64_t uStartOffset = vecRecords[uFirstRecord].m_pEntry->m_uOffset;
+					uint64_t uEndOffset = getDataEnd(*vecRecords[uFirstRecord].m_pEntry);
+					size_t uEndRecord = uFirstRecord + 1;
+					while ((uEndRecord < vecRecords.size()) && (vecRecords[uEndRecord].m_pEntry->m_uOffset <= uEndOffset + uMaxSkippedBytes))
+					{
+						uEndOffset = getDataEnd(*vecRecords[uEndRecord].m_pEntry);
+						uEndRecord++;
+					}
+
+					vecBuffer.resize(static_cast<size_t>(uEndOffset - uStartOffset));
+					readAt(uStartOffset, vecBuffer.data(), vecBuffer.size());
+
+					for (size_t ct = uFirstRecord; ct < uEndRecord; ct++)
+					{
+						const IndexEntry& entry = *vecRecords[ct].m_pEntry;
+						const uint8_t* pData = vecBuffer.data() + static_cast<size_t>(entry.m_uOffset - uStartOffset) + sizeof(RecordHeader);
+						vecEncodedData[vecRecords[ct].m_uRequest].assign(pData, pData + entry.m_header.m_uSizeInBytes);
+					}
+					uFirstRecord = uEndRecord;
+				}
+			}
+
+			for (size_t ct = 0; ct < vecRequests.size(); ct++)
+			{
+				decodeChunk(vecRequests[ct].first, vecRequests[ct].second, vecEncodedData[ct]);
+			}
+		}
+
+		virtual void pageOut(const Region& region, typename PagedVolume<VoxelType>::Chunk* pChunk)
+		{
+			POLYVOX_ASSERT(pChunk, "Attempting to page out NULL chunk");
+			POLYVOX_ASSERT(pChunk->getData(), "Chunk must have valid data");
+
+			POLYVOX_LOG_TRACE("Paging out data for ", region);
+
+			std::vector<uint8_t> vecEncodedData;
+			encodeChunkData(m_pCodec, pChunk->getData(), pChunk->getDataSizeInBytes() / sizeof(VoxelType), vecEncodedData);
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			writeRecord(region, vecEncodedData);
+		}
+
+		/// Encodes all the chunks before writing any of them, so that the lock is only held while they are written.
+		virtual void pageOutBatch(const std::vector<typename PagedVolume<VoxelType>::Pager::PageRequest>& vecRequests)
+		{
+			std::vector< std::vector<uint8_t> > vecEncodedData(vecRequests.size());
+			for (size_t ct = 0; ct < vecRequests.size(); ct++)
+			{
+				POLYVOX_ASSERT(vecRequests[ct].second, "Attempting to page out NULL chunk");
+				POLYVOX_ASSERT(vecRequests[ct].second->getData(), "Chunk must have valid data");
+
+				POLYVOX_LOG_TRACE("Paging out data for ", vecRequests[ct].first);
+				const typename PagedVolume<VoxelType>::Chunk* pChunk = vecRequests[ct].second;
+				encodeChunkData(m_pCodec, pChunk->getData(), pChunk->getDataSizeInBytes() / sizeof(VoxelType), vecEncodedData[ct]);
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (size_t ct = 0; ct < vecRequests.size(); ct++)
+			{
+				writeRecord(vecRequests[ct].first, vecEncodedData[ct]);
+			}
+		}
+
+		/// Saves the index in the container and flushes any buffered writes to the disk.
+		void flush(void)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_bIndexSaved)
+			{
+				saveIndex();
+			}
+			if (m_pFile)
+			{
+				fflush(m_pFile);
+			}
+		}
+
+		/**
+		 * Rewrites the container so that the records are packed together without any free space between them. This
+		 * reads and writes every record, so should only be done when getFreeSpaceInBytes() shows that it is worthwhile.
+		 * The records are written to a new file which then replaces the container. If this fails the old container is
+		 * kept and can still be used.
+		 */
+		void compact(void)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			const std::string strCompactedFilename = m_strFilename + ".compact";
+			FILE* pCompactedFile = fopen(strCompactedFilename.c_str(), "w+b");
+			POLYVOX_THROW_IF(!pCompactedFile, std::runtime_error, "Unable to create '" + strCompactedFilename + "' to compact the container.");
+			auto funcDiscardCompactedFile = [&]()
+			{
+				fclose(pCompactedFile);
+				std::remove(strCompactedFilename.c_str());
+			};
+
+			// Copy the records in the order they are in the file, so that the old container is read sequentially.
+			std::vector< std::pair<uint64_t, IndexEntry*> > vecRecords;
+			vecRecords.reserve(m_mapChunkRecords.size());
+			for (auto& keyAndRecord : m_mapChunkRecords)
+			{
+				vecRecords.push_back(std::make_pair(keyAndRecord.second.m_uOffset, &keyAndRecord.second));
+			}
+			std::sort(vecRecords.begin(), vecRecords.end());
+
+			FileHeader fileHeader = createFileHeader();
+			bool bError = fwrite(&fileHeader, sizeof(fileHeader), 1, pCompactedFile) != 1;
+
+			uint64_t uCompactedEndOfFile = sizeof(FileHeader);
+			std::vector<IndexEntry> vecCompactedRecords;
+			vecCompactedRecords.reserve(vecRecords.size());
+			try
+			{
+				std::vector<uint8_t> vecBuffer;
+				for (auto& offsetAndRecord : vecRecords)
+				{
+					IndexEntry entry = *offsetAndRecord.second;
+					vecBuffer.resize(entry.m_header.m_uSizeInBytes);
+					readAt(entry.m_uOffset + sizeof(RecordHeader), vecBuffer.data(), vecBuffer.size());
+
+					entry.m_uOffset = uCompactedEndOfFile;
+					entry.m_header.m_uCapacityInBytes = entry.m_header.m_uSizeInBytes;
+					bError |= fwrite(&entry.m_header, sizeof(RecordHeader), 1, pCompactedFile) != 1;
+					bError |= fwrite(vecBuffer.data(), sizeof(uint8_t), vecBuffer.size(), pCompactedFile) != vecBuffer.size();
+
+					vecCompactedRecords.push_back(entry);
+					uCompactedEndOfFile += sizeof(RecordHeader) + entry.m_header.m_uSizeInBytes;
+				}
+			}
+			catch (...)
+			{
+				funcDiscardCompactedFile();
+				throw;
+			}
+
+			bError |= fflush(pCompactedFile) != 0;
+			if (bError || ferror(pCompactedFile) || ferror(m_pFile))
+			{
+				funcDiscardCompactedFile();
+				POLYVOX_THROW(std::runtime_error, "Error compacting '" + m_strFilename + "'.");
+			}
+
+			// The index is not saved until the new container is in place, so if we crash it will be rebuilt on the next open.
+#if defined(_WIN32)
+			// Windows cannot replace a file which is open, so both are closed and the container is opened again afterwards. If
+			// the replacement fails then the old container is still there, and is opened again instead.
+			fclose(pCompactedFile);
+			fclose(m_pFile);
+			const bool bReplaced = MoveFileExA(strCompactedFilename.c_str(), m_strFilename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+			if (!bReplaced)
+			{
+				std::remove(strCompactedFilename.c_str());
+			}
+			m_pFile = fopen(m_strFilename.c_str(), "r+b");
+			POLYVOX_THROW_IF(!m_pFile, std::runtime_error, "Unable to reopen '" + m_strFilename + "' after compacting it.");
+			POLYVOX_THROW_IF(!bReplaced, std::runtime_error, "Unable to replace '" + m_strFilename + "' with the compacted container.");
+#else
+			// Renaming replaces the old container in one step, and the compacted file stays open under its new name.
+			if (std::rename(strCompactedFilename.c_str(), m_strFilename.c_str()) != 0)
+			{
+				funcDiscardCompactedFile();
+				POLYVOX_THROW(std::runtime_error, "Unable to replace '" + m_strFilename + "' with the compacted container.");
+			}
+			fclose(m_pFile);
+			m_pFile = pCompactedFile;
+#endif
+
+			// Only now that the new container is in use can the index be updated to point into it.
+			for (uint32_t ct = 0; ct < vecRecords.size(); ct++)
+			{
+				*vecRecords[ct].second = vecCompactedRecords[ct];
+			}
+			m_mapFreeSlots.clear();
+			m_uEndOfFile = uCompactedEndOfFile;
+			m_bIndexSaved = false;
+		}
+
+		/// Gets the number of bytes in the container which are not used by any record (and so would be reclaimed by compact()).
+		uint64_t getFreeSpaceInBytes(void)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			uint64_t uFreeSpaceInBytes = 0;
+			for (const auto& capacityAndOffset : m_mapFreeSlots)
+			{
+				uFreeSpaceInBytes += sizeof(RecordHeader) + capacityAndOffset.first;
+			}
+			return uFreeSpaceInBytes;
+		}
+
+	private:
+		// The version of the container format which is written, and the only one which can be read.
+		static const uint32_t uFileVersion = 1;
+
+		// The container starts with this. The index is only valid while the offset is non-zero.
+		struct FileHeader
+		{
+			char m_arrayMagic[8];
+			uint32_t m_uVersion;
+			uint32_t m_uVoxelSizeInBytes;
+			uint64_t m_uIndexOffset;
+		};
+
+		enum RecordState : uint32_t
+		{
+			FreeRecord = 0,
+			ChunkRecord = 1,
+			IndexRecord = 2
+		};
+
+		// Each record starts with this, and the data (for a chunk or the index) follows it. The capacity may be larger than the
+		// size of the data if the record has been reused.
+		struct RecordHeader
+		{
+			uint32_t m_uState;
+			int32_t m_iLowerX;
+			int32_t m_iLowerY;
+			int32_t m_iLowerZ;
+			uint32_t m_uSideLength;
+			uint32_t m_uCapacityInBytes;
+			uint32_t m_uSizeInBytes;
+			uint32_t m_uSequenceNumber;
+		};
+
+		// The index record holds one of these for every record in the container, including the free ones.
+		struct IndexEntry
+		{
+			uint64_t m_uOffset;
+			RecordHeader m_header;
+		};
+
+		// Where a record is, and how much data it can hold.
+		struct Slot
+		{
+			uint64_t m_uOffset;
+			uint32_t m_uCapacityInBytes;
+		};
+
+		void open(void)
+		{
+			m_pFile = fopen(m_strFilename.c_str(), "r+b");
+			if (!m_pFile)
+			{
+				m_pFile = fopen(m_strFilename.c_str(), "w+b");
+				POLYVOX_THROW_IF(!m_pFile, std::runtime_error, "Unable to create '" + m_strFilename + "'.");
+				FileHeader fileHeader = createFileHeader();
+				writeAt(0, &fileHeader, sizeof(fileHeader));
+				return;
+			}
+
+			FileHeader fileHeader;
+			POLYVOX_THROW_IF(fread(&fileHeader, sizeof(fileHeader), 1, m_pFile) != 1, std::runtime_error, "'" + m_strFilename + "' is too small to be a container.");
+			POLYVOX_THROW_IF(std::memcmp(fileHeader.m_arrayMagic, getMagic(), sizeof(fileHeader.m_arrayMagic)) != 0, std::runtime_error, "'" + m_strFilename + "' is not a container.");
+			POLYVOX_THROW_IF(fileHeader.m_uVersion != uFileVersion, std::runtime_error, "'" + m_strFilename + "' was written by an unsupported version of the container format.");
+			POLYVOX_THROW_IF(fileHeader.m_uVoxelSizeInBytes != sizeof(VoxelType), std::runtime_error, "'" + m_strFilename + "' was written with a different voxel type.");
+
+			seekTo(0, SEEK_END);
+			m_uEndOfFile = tell();
+
+			std::vector<IndexEntry> vecEntries;
+			if (fileHeader.m_uIndexOffset != 0)
+			{
+				RecordHeader indexHeader;
+				readAt(fileHeader.m_uIndexOffset, &indexHeader, sizeof(indexHeader));
+				POLYVOX_THROW_IF(indexHeader.m_uState != RecordState::IndexRecord, std::runtime_error, "The index of '" + m_strFilename + "' is corrupt.");
+				vecEntries.resize(indexHeader.m_uSizeInBytes / sizeof(IndexEntry));
+				POLYVOX_THROW_IF(fread(vecEntries.data(), sizeof(IndexEntry), vecEntries.size(), m_pFile) != vecEntries.size(), std::runtime_error,
+					"The index of '" + m_strFilename + "' is truncated.");
+
+				// The index record itself can be reused once the index changes.
+				IndexEntry indexEntry;
+				indexEntry.m_uOffset = fileHeader.m_uIndexOffset;
+				indexEntry.m_header = indexHeader;
+				indexEntry.m_header.m_uState = RecordState::FreeRecord;
+				vecEntries.push_back(indexEntry);
+				m_bIndexSaved = true;
+			}
+			else
+			{
+				POLYVOX_LOG_WARNING("The index of '", m_strFilename, "' was not saved, so it is being rebuilt.");
+				for (uint64_t uOffset = sizeof(FileHeader); uOffset + sizeof(RecordHeader) <= m_uEndOfFile;)
+				{
+					IndexEntry entry;
+					entry.m_uOffset = uOffset;
+					readAt(uOffset, &entry.m_header, sizeof(entry.m_header));
+					uOffset += sizeof(RecordHeader) + entry.m_header.m_uCapacityInBytes;
+
+					// A record which was cut short by a crash is simply dropped.
+					if (uOffset > m_uEndOfFile)
+					{
+						m_uEndOfFile = entry.m_uOffset;
+						break;
+					}
+					vecEntries.push_back(entry);
+				}
+			}
+			POLYVOX_THROW_IF(ferror(m_pFile), std::runtime_error, "Error reading the index of '" + m_strFilename + "'.");
+
+			// Only the most recent record for each chunk is used, the others are treated as free.
+			for (const IndexEntry& entry : vecEntries)
+			{
+				m_uNextSequenceNumber = (std::max)(m_uNextSequenceNumber, entry.m_header.m_uSequenceNumber + 1);
+
+				if (entry.m_header.m_uState != RecordState::ChunkRecord)
+				{
+					m_mapFreeSlots.insert(std::make_pair(entry.m_header.m_uCapacityInBytes, entry.m_uOffset));
+					continue;
+				}
+
+				const Region region(entry.m_header.m_iLowerX, entry.m_header.m_iLowerY, entry.m_header.m_iLowerZ,
+					entry.m_header.m_iLowerX + entry.m_header.m_uSideLength - 1, entry.m_header.m_iLowerY + entry.m_header.m_uSideLength - 1, entry.m_header.m_iLowerZ + entry.m_header.m_uSideLength - 1);
+				const uint64_t uKey = packChunkPosition(region);
+				auto iterRecord = m_mapChunkRecords.find(uKey);
+				if (iterRecord == m_mapChunkRecords.end())
+				{
+					m_mapChunkRecords[uKey] = entry;
+				}
+				else if (iterRecord->second.m_header.m_uSequenceNumber < entry.m_header.m_uSequenceNumber)
+				{
+					freeSlot(iterRecord->second);
+					iterRecord->second = entry;
+				}
+				else
+				{
+					freeSlot(entry);
+				}
+			}
+		}
+
+		// Writes the encoded data of a chunk to a new record, and then frees its old one. The lock must be held.
+		void writeRecord(const Region& region, const std::vector<uint8_t>& vecEncodedData)
+		{
+			invalidateIndex();
+
+			const uint32_t uSizeInBytes = static_cast<uint32_t>(vecEncodedData.size());
+			const uint64_t uKey = packChunkPosition(region);
+			const Slot slot = allocateSlot(uSizeInBytes);
+
+			// The record is marked as free until its data has been written, so that if we crash part way through the scan in
+			// open() skips it and finds the old record instead.
+			IndexEntry entry;
+			entry.m_uOffset = slot.m_uOffset;
+			RecordHeader& header = entry.m_header;
+			header.m_uState = RecordState::FreeRecord;
+			header.m_iLowerX = region.getLowerX();
+			header.m_iLowerY = region.getLowerY();
+			header.m_iLowerZ = region.getLowerZ();
+			header.m_uSideLength = static_cast<uint32_t>(region.getWidthInVoxels());
+			header.m_uCapacityInBytes = slot.m_uCapacityInBytes;
+			header.m_uSizeInBytes = uSizeInBytes;
+			header.m_uSequenceNumber = m_uNextSequenceNumber++;
+			try
+			{
+				writeAt(slot.m_uOffset, &header, sizeof(header));
+				fwrite(vecEncodedData.data(), sizeof(uint8_t), uSizeInBytes, m_pFile);
+				POLYVOX_THROW_IF(ferror(m_pFile), std::runtime_error, "Error writing out chunk data to '" + m_strFilename + "'.");
+
+				header.m_uState = RecordState::ChunkRecord;
+				writeAt(slot.m_uOffset, &header.m_uState, sizeof(header.m_uState));
+			}
+			catch (...)
+			{
+				m_mapFreeSlots.insert(std::make_pair(slot.m_uCapacityInBytes, slot.m_uOffset));
+				throw;
+			}
+
+			// If we crash before the old record is freed then the sequence number shows that the new one is the current one.
+			auto iterRecord = m_mapChunkRecords.find(uKey);
+			if (iterRecord != m_mapChunkRecords.end())
+			{
+				freeSlot(iterRecord->second);
+			}
+			m_mapChunkRecords[uKey] = entry;
+		}
+
+		// Decodes the data read from a chunk's record, or fills the chunk with zeros (as FilePager does) if it had no record.
+		void decodeChunk(const Region& region, typename PagedVolume<VoxelType>::Chunk* pChunk, const std::vector<uint8_t>& vecEncodedData)
+		{
+			if (!vecEncodedData.empty())
+			{
+				POLYVOX_LOG_TRACE("Paging in data for ", region);
+				decodeChunkData(m_pCodec, vecEncodedData.data(), vecEncodedData.size(), pChunk->getData(), pChunk->getDataSizeInBytes() / sizeof(VoxelType));
+			}
+			else
+			{
+				POLYVOX_LOG_TRACE("No data found for ", region, " during paging in.");
+				uint32_t noOfVoxels = region.getWidthInVoxels() * region.getHeightInVoxels() * region.getDepthInVoxels();
+				std::fill(pChunk->getData(), pChunk->getData() + noOfVoxels, VoxelType());
+			}
+		}
+
+		// Clears the index offset in the container before the first change to it, so that a crash causes the index to be rebuilt.
+		void invalidateIndex(void)
+		{
+			if (m_bIndexSaved)
+			{
+				const uint64_t uNoIndex = 0;
+				writeAt(offsetof(FileHeader, m_uIndexOffset), &uNoIndex, sizeof(uNoIndex));
+				m_bIndexSaved = false;
+			}
+		}
+
+		void saveIndex(void)
+		{
+			invalidateIndex();
+
+			std::vector<IndexEntry> vecEntries;
+			vecEntries.reserve(m_mapChunkRecords.size() + m_mapFreeSlots.size());
+			for (const auto& keyAndRecord : m_mapChunkRecords)
+			{
+				vecEntries.push_back(keyAndRecord.second);
+			}
+
+			// The index is written to a slot of its own, which then becomes free again as soon as the container is changed.
+			const uint32_t uSizeInBytes = static_cast<uint32_t>((vecEntries.size() + m_mapFreeSlots.size()) * sizeof(IndexEntry));
+			const Slot indexSlot = allocateSlot(uSizeInBytes);
+			for (const auto& capacityAndOffset : m_mapFreeSlots)
+			{
+				IndexEntry entry;
+				std::memset(&entry, 0, sizeof(entry));
+				entry.m_uOffset = capacityAndOffset.second;
+				entry.m_header.m_uState = RecordState::FreeRecord;
+				entry.m_header.m_uCapacityInBytes = capacityAndOffset.first;
+				vecEntries.push_back(entry);
+			}
+
+			RecordHeader indexHeader;
+			std::memset(&indexHeader, 0, sizeof(indexHeader));
+			indexHeader.m_uState = RecordState::IndexRecord;
+			indexHeader.m_uCapacityInBytes = indexSlot.m_uCapacityInBytes;
+			indexHeader.m_uSizeInBytes = static_cast<uint32_t>(vecEntries.size() * sizeof(IndexEntry));
+			writeAt(indexSlot.m_uOffset, &indexHeader, sizeof(indexHeader));
+			fwrite(vecEntries.data(), sizeof(IndexEntry), vecEntries.size(), m_pFile);
+			fflush(m_pFile);
+
+			// The header is only pointed at the index once it has been completely written.
+			writeAt(offsetof(FileHeader, m_uIndexOffset), &indexSlot.m_uOffset, sizeof(indexSlot.m_uOffset));
+			POLYVOX_THROW_IF(ferror(m_pFile), std::runtime_error, "Error writing the index of '" + m_strFilename + "'.");
+			m_mapFreeSlots.insert(std::make_pair(indexSlot.m_uCapacityInBytes, indexSlot.m_uOffset));
+			m_bIndexSaved = true;
+		}
+
+		// Finds the smallest free record which can hold the given amount of data, or adds a new one at the end of the container.
+		Slot allocateSlot(uint32_t uSizeInBytes)
+		{
+			Slot slot;
+			auto iterBestSlot = m_mapFreeSlots.lower_bound(uSizeInBytes);
+			if (iterBestSlot != m_mapFreeSlots.end())
+			{
+				slot.m_uCapacityInBytes = iterBestSlot->first;
+				slot.m_uOffset = iterBestSlot->second;
+				m_mapFreeSlots.erase(iterBestSlot);
+			}
+			else
+			{
+				slot.m_uOffset = m_uEndOfFile;
+				slot.m_uCapacityInBytes = uSizeInBytes;
+				m_uEndOfFile += sizeof(RecordHeader) + uSizeInBytes;
+			}
+			return slot;
+		}
+
+		void freeSlot(const IndexEntry& entry)
+		{
+			Slot slot;
+			slot.m_uOffset = entry.m_uOffset;
+			slot.m_uCapacityInBytes = entry.m_header.m_uCapacityInBytes;
+			freeSlot(slot);
+		}
+
+		void freeSlot(const Slot& slot)
+		{
+			const uint32_t uState = RecordState::FreeRecord;
+			writeAt(slot.m_uOffset, &uState, sizeof(uState));
+			m_mapFreeSlots.insert(std::make_pair(slot.m_uCapacityInBytes, slot.m_uOffset));
+		}
+
+		void seekTo(uint64_t uOffset, int iOrigin = SEEK_SET)
+		{
+			POLYVOX_THROW_IF(!m_pFile, std::runtime_error, "'" + m_strFilename + "' is not open.");
+#if defined(_WIN32)
+			const int iResult = _fseeki64(m_pFile, static_cast<int64_t>(uOffset), iOrigin);
+#else
+			const int iResult = fseeko(m_pFile, static_cast<off_t>(uOffset), iOrigin);
+#endif
+			POLYVOX_THROW_IF(iResult != 0, std::runtime_error, "Unable to seek in '" + m_strFilename + "'.");
+		}
+
+		uint64_t tell(void)
+		{
+#if defined(_WIN32)
+			return static_cast<uint64_t>(_ftelli64(m_pFile));
+#else
+			return static_cast<uint64_t>(ftello(m_pFile));
+#endif
+		}
+
+		void readAt(uint64_t uOffset, void* pDestination, size_t uSizeInBytes)
+		{
+			seekTo(uOffset);
+			POLYVOX_THROW_IF(fread(pDestination, 1, uSizeInBytes, m_pFile) != uSizeInBytes, std::runtime_error, "Unexpected end of '" + m_strFilename + "'.");
+		}
+
+		void writeAt(uint64_t uOffset, const void* pSource, size_t uSizeInBytes)
+		{
+			seekTo(uOffset);
+			POLYVOX_THROW_IF(fwrite(pSource, 1, uSizeInBytes, m_pFile) != uSizeInBytes, std::runtime_error, "Error writing to '" + m_strFilename + "'.");
+		}
+
+		static FileHeader createFileHeader(void)
+		{
+			FileHeader fileHeader;
+			std::memcpy(fileHeader.m_arrayMagic, getMagic(), sizeof(fileHeader.m_arrayMagic));
+			fileHeader.m_uVersion = uFileVersion;
+			fileHeader.m_uVoxelSizeInBytes = sizeof(VoxelType);
+			fileHeader.m_uIndexOffset = 0;
+			return fileHeader;
+		}
+
+		static const char* getMagic(void)
+		{
+			return "PVCHUNKS";
+		}
+
+		// Where the data of a record ends.
+		static uint64_t getDataEnd(const IndexEntry& entry)
+		{
+			return entry.m_uOffset + sizeof(RecordHeader) + entry.m_header.m_uSizeInBytes;
+		}
+
+		// Chunks are keyed by their position in chunk space, which is exact as they are aligned to their side length.
+		static uint64_t packChunkPosition(const Region& region)
+		{
+			const int32_t iSideLength = region.getWidthInVoxels();
+			return (static_cast<uint64_t>(static_cast<uint32_t>(region.getLowerX() / iSideLength) & 0x1FFFFF)) |
+				(static_cast<uint64_t>(static_cast<uint32_t>(region.getLowerY() / iSideLength) & 0x1FFFFF) << 21) |
+				(static_cast<uint64_t>(static_cast<uint32_t>(region.getLowerZ() / iSideLength) & 0x1FFFFF) << 42);
+		}
+
+		// When paging in a batch, records which are at most this far apart are read with a single call.
+		static const uint64_t uMaxSkippedBytes = 64 * 1024;
+
+		std::string m_strFilename;
+		const ChunkCodec<VoxelType>* m_pCodec;
+		FILE* m_pFile;
+
+		// The index, which also holds a copy of each chunk's record header so that it does not have to be read before the data.
+		std::unordered_map<uint64_t, IndexEntry> m_mapChunkRecords;
+		// The free records, keyed by their capacity so that the best fit can be found quickly.
+		std::multimap<uint32_t, uint64_t> m_mapFreeSlots;
+		uint64_t m_uEndOfFile;
+		uint32_t m_uNextSequenceNumber;
+
+		// Whether the index in the container is up to date.
+		bool m_bIndexSaved;
+
+		// The volume may page chunks in and out from several threads, and they all share the file.
+		std::mutex m_mutex;
+	};
+}
+
+#endif //__PolyVox_ContainerFilePager_H__
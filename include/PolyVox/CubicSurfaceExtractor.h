@@ -33,6 +33,8 @@
 #include "Mesh.h"
 #include "Vertex.h"
 
+#include <type_traits>
+
 namespace PolyVox
 {
 	/// A specialised vertex format which encodes the data from the cubic extraction algorithm in a very 
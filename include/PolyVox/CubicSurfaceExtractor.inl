@@ -199,6 +199,26 @@ namespace PolyVox
 		return -1; //Should never happen.
 	}
 
+	// With the default IsQuadNeeded a quad is only placed between a voxel which is greater than zero and one which is zero, so there
+	// are no quads if none of the voxels is greater than zero or if all of them are. The region has to include the voxels just below
+	// it, as the extractor compares each voxel with those behind it. Volumes which do not know the range of their values cannot skip
+	// anything, and neither can custom IsQuadNeeded functions (as we do not know what they are looking for). Only arithmetic voxel types
+	// can be checked, as only their ranges are known and other types may not support the comparisons.
+	template<typename VolumeType>
+	bool isRegionWithoutQuads(VolumeType* volData, const Region& region, std::true_type /*bCanSkipRegion*/)
+	{
+		typename VolumeType::VoxelType tMin;
+		typename VolumeType::VoxelType tMax;
+		const Region regRead(region.getLowerCorner() - Vector3DInt32(1, 1, 1), region.getUpperCorner());
+		return volData->getValueRange(regRead, tMin, tMax) && (!(tMax > 0) || (tMin > 0));
+	}
+
+	template<typename VolumeType>
+	bool isRegionWithoutQuads(VolumeType* /*volData*/, const Region& /*region*/, std::false_type /*bCanSkipRegion*/)
+	{
+		return false;
+	}
+
 	/// The CubicSurfaceExtractor creates a mesh in which each voxel appears to be rendered as a cube
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	/// Introduction
@@ -273,6 +293,16 @@ namespace PolyVox
 		Timer timer;
 		result->clear();
 
+		typedef std::integral_constant<bool, std::is_arithmetic<typename VolumeType::VoxelType>::value &&
+			std::is_same<IsQuadNeeded, DefaultIsQuadNeeded<typename VolumeType::VoxelType> >::value> CanSkipRegion;
+		if (isRegionWithoutQuads(volData, region, CanSkipRegion()))
+		{
+			result->setOffset(region.getLowerCorner());
+			POLYVOX_LOG_TRACE("Cubic surface extraction skipped a region without any quads (Region size = ", region.getWidthInVoxels(),
+				"x", region.getHeightInVoxels(), "x", region.getDepthInVoxels(), ")");
+			return;
+		}
+
 		//Used to avoid creating duplicate vertices.
 		Array<3, IndexAndMaterial<VolumeType> > m_previousSliceVertices(region.getUpperX() - region.getLowerX() + 2, region.getUpperY() - region.getLowerY() + 2, MaxVerticesPerPosition);
 		Array<3, IndexAndMaterial<VolumeType> > m_currentSliceVertices(region.getUpperX() - region.getLowerX() + 2, region.getUpperY() - region.getLowerY() + 2, MaxVerticesPerPosition);
@@ -27,12 +27,15 @@
 
 #include "Impl/PlatformDefinitions.h"
 
+#include "ChunkCodec.h"
 #include "PagedVolume.h"
 #include "Region.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <ctime>
 #include <fstream>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -43,18 +46,18 @@ namespace PolyVox
 	 * An implementation of Pager which stores voxels to files on disk. Each chunk is written
 	 * to a seperate file and you can specify the name of a folder where these will be stored.
 	 *
-	 * Note that no compression is performed (mostly to avoid dependancies) so for large
-	 * volumes you may want to consider this class as an example and create a custom version
-	 * with compression.
+	 * By default no compression is performed, but a ChunkCodec can be given to compress the
+	 * data of each chunk before it is written (see ChunkCodec.h for the built in codecs).
 	 */
 	template <typename VoxelType>
 	class FilePager : public PagedVolume<VoxelType>::Pager
 	{
 	public:
-		/// Constructor
-		FilePager(const std::string& strFolderName = ".")
+		/// Constructor. The codec (if any) must outlive the pager.
+		FilePager(const std::string& strFolderName = ".", const ChunkCodec<VoxelType>* pCodec = nullptr)
 			:PagedVolume<VoxelType>::Pager()
 			, m_strFolderName(strFolderName)
+			, m_pCodec(pCodec)
 		{
 				// Add the trailing slash, assuming the user dind't already do it.
 				if ((m_strFolderName.back() != '/') && (m_strFolderName.back() != '\\'))
@@ -102,23 +105,22 @@ namespace PolyVox
 			{
 				POLYVOX_LOG_TRACE("Paging in data for ", region);
 
-				/*fseek(pFile, 0L, SEEK_END);
+				fseek(pFile, 0L, SEEK_END);
 				size_t fileSizeInBytes = ftell(pFile);
 				fseek(pFile, 0L, SEEK_SET);
 
-				uint8_t* buffer = new uint8_t[fileSizeInBytes];
-				fread(buffer, sizeof(uint8_t), fileSizeInBytes, pFile);
-				pChunk->setData(buffer, fileSizeInBytes);
-				delete[] buffer;*/
-
-				fread(pChunk->getData(), sizeof(uint8_t), pChunk->getDataSizeInBytes(), pFile);
+				std::vector<uint8_t> vecEncodedData(fileSizeInBytes);
+				fread(vecEncodedData.data(), sizeof(uint8_t), fileSizeInBytes, pFile);
 
 				if (ferror(pFile))
 				{
+					fclose(pFile);
 					POLYVOX_THROW(std::runtime_error, "Error reading in chunk data, even though a file exists.");
 				}
 
 				fclose(pFile);
+
+				decodeChunkData(m_pCodec, vecEncodedData.data(), vecEncodedData.size(), pChunk->getData(), pChunk->getDataSizeInBytes() / sizeof(VoxelType));
 			}
 			else
 			{
@@ -138,6 +140,10 @@ namespace PolyVox
 
 			POLYVOX_LOG_TRACE("Paging out data for ", region);
 
+			// Compress the data before opening the file, so the file is open for as short a time as possible.
+			std::vector<uint8_t> vecEncodedData;
+			encodeChunkData(m_pCodec, pChunk->getData(), pChunk->getDataSizeInBytes() / sizeof(VoxelType), vecEncodedData);
+
 			std::stringstream ssFilename;
 			ssFilename << m_strFolderName << "/"
 				<< region.getLowerX() << "_" << region.getLowerY() << "_" << region.getLowerZ() << "_"
@@ -155,13 +161,21 @@ namespace PolyVox
 				POLYVOX_THROW(std::runtime_error, "Unable to open file to write out chunk data.");
 			}
 
-			//The file has been created, so add it to the list to delete on shutdown.
-			m_vecCreatedFiles.push_back(filename);
+			//The file has been created, so add it to the list to delete on shutdown (unless the chunk has been paged out
+			//before). The lock is needed in case the volume is paging chunks out from several threads.
+			{
+				std::lock_guard<std::mutex> lock(m_mutexCreatedFiles);
+				if (std::find(m_vecCreatedFiles.begin(), m_vecCreatedFiles.end(), filename) == m_vecCreatedFiles.end())
+				{
+					m_vecCreatedFiles.push_back(filename);
+				}
+			}
 
-			fwrite(pChunk->getData(), sizeof(uint8_t), pChunk->getDataSizeInBytes(), pFile);
+			fwrite(vecEncodedData.data(), sizeof(uint8_t), vecEncodedData.size(), pFile);
 
 			if (ferror(pFile))
 			{
+				fclose(pFile);
 				POLYVOX_THROW(std::runtime_error, "Error writing out chunk data.");
 			}
 
@@ -172,7 +186,10 @@ namespace PolyVox
 		std::string m_strFolderName;
 		std::string m_strPostfix;
 
+		const ChunkCodec<VoxelType>* m_pCodec;
+
 		std::vector<std::string> m_vecCreatedFiles;
+		std::mutex m_mutexCreatedFiles;
 	};
 }
 
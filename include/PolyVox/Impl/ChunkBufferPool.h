@@ -0,0 +1,218 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_ChunkBufferPool_H__
+#define __PolyVox_ChunkBufferPool_H__
+
+#include "ErrorHandling.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+namespace PolyVox
+{
+	// A pool of equally sized, aligned buffers for chunk data. Buffers which are released are kept and handed out again rather than
+	// being returned to the heap, so streaming chunks in and out does not churn the allocator or fragment memory. The total number of
+	// buffers (in use or free) is soft-limited: buffers released while more than the limit exist are freed straight away. Acquiring
+	// always succeeds, even above the limit, as pinned chunks may force the volume to exceed its memory budget.
+	class ChunkBufferPool
+	{
+	public:
+		ChunkBufferPool(size_t uBufferSizeInBytes, size_t uAlignment, uint32_t uMaxNoOfBuffers, bool bThreadSafe)
+			:m_uBufferSizeInBytes(uBufferSizeInBytes)
+			, m_uAlignment(uAlignment)
+			, m_uMaxNoOfBuffers(uMaxNoOfBuffers)
+			, m_bThreadSafe(bThreadSafe)
+		{
+			POLYVOX_THROW_IF((uAlignment == 0) || ((uAlignment & (uAlignment - 1)) != 0), std::invalid_argument, "Alignment must be a power of two.");
+		}
+
+		~ChunkBufferPool()
+		{
+			POLYVOX_ASSERT(m_uNoOfBuffers == m_vecFreeBuffers.size(), "Chunk buffers are still in use as the pool is destroyed.");
+			trim(0);
+		}
+
+		// Gets a buffer, reusing a free one if possible. The contents are undefined.
+		void* acquire(void)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+				if (m_bThreadSafe)
+				{
+					lock.lock();
+				}
+
+				if (!m_vecFreeBuffers.empty())
+				{
+					void* pBuffer = m_vecFreeBuffers.back();
+					m_vecFreeBuffers.pop_back();
+					return pBuffer;
+				}
+			}
+
+			// Allocating is slow, so do it outside the lock. The buffer is only counted once we have it, as allocating may throw.
+			void* pBuffer = allocateBuffer();
+			{
+				std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+				if (m_bThreadSafe)
+				{
+					lock.lock();
+				}
+
+				m_uNoOfBuffers++;
+			}
+			return pBuffer;
+		}
+
+		// Returns a buffer to the pool, or to the heap if the pool already holds as many buffers as it should.
+		void release(void* pBuffer)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+				if (m_bThreadSafe)
+				{
+					lock.lock();
+				}
+
+				if (m_uNoOfBuffers <= m_uMaxNoOfBuffers)
+				{
+					m_vecFreeBuffers.push_back(pBuffer);
+					return;
+				}
+
+				m_uNoOfBuffers--;
+			}
+
+			freeBuffer(pBuffer);
+		}
+
+		// Allocates free buffers until the pool holds the given number (or the maximum, if that is smaller).
+		void reserve(uint32_t uNoOfBuffers)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+			if (m_bThreadSafe)
+			{
+				lock.lock();
+			}
+
+			m_vecFreeBuffers.reserve(m_uMaxNoOfBuffers);
+			while ((m_uNoOfBuffers < uNoOfBuffers) && (m_uNoOfBuffers < m_uMaxNoOfBuffers))
+			{
+				m_vecFreeBuffers.push_back(allocateBuffer());
+				m_uNoOfBuffers++;
+			}
+		}
+
+		// Changes the soft limit on the number of buffers, freeing any free buffers which take the total above the new limit.
+		void setMaxNoOfBuffers(uint32_t uMaxNoOfBuffers)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+			if (m_bThreadSafe)
+			{
+				lock.lock();
+			}
+
+			m_uMaxNoOfBuffers = uMaxNoOfBuffers;
+			while ((m_uNoOfBuffers > m_uMaxNoOfBuffers) && !m_vecFreeBuffers.empty())
+			{
+				freeBuffer(m_vecFreeBuffers.back());
+				m_vecFreeBuffers.pop_back();
+				m_uNoOfBuffers--;
+			}
+		}
+
+		// Frees buffers which are not in use until at most the given number of free buffers remain.
+		void trim(uint32_t uMaxNoOfFreeBuffers)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+			if (m_bThreadSafe)
+			{
+				lock.lock();
+			}
+
+			while (m_vecFreeBuffers.size() > uMaxNoOfFreeBuffers)
+			{
+				freeBuffer(m_vecFreeBuffers.back());
+				m_vecFreeBuffers.pop_back();
+				m_uNoOfBuffers--;
+			}
+		}
+
+		size_t getBufferSizeInBytes(void) const
+		{
+			return m_uBufferSizeInBytes;
+		}
+
+		uint32_t getNoOfFreeBuffers(void) const
+		{
+			std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+			if (m_bThreadSafe)
+			{
+				lock.lock();
+			}
+
+			return static_cast<uint32_t>(m_vecFreeBuffers.size());
+		}
+
+	private:
+		// C++11 has no aligned allocation, so we over-allocate and store the original pointer just in front of the aligned buffer.
+		void* allocateBuffer(void) const
+		{
+			void* pAllocation = std::malloc(m_uBufferSizeInBytes + m_uAlignment + sizeof(void*));
+			if (!pAllocation)
+			{
+				throw std::bad_alloc();
+			}
+
+			uintptr_t uAddress = reinterpret_cast<uintptr_t>(pAllocation) + sizeof(void*);
+			uAddress = (uAddress + m_uAlignment - 1) & ~static_cast<uintptr_t>(m_uAlignment - 1);
+
+			void* pBuffer = reinterpret_cast<void*>(uAddress);
+			static_cast<void**>(pBuffer)[-1] = pAllocation;
+			return pBuffer;
+		}
+
+		void freeBuffer(void* pBuffer) const
+		{
+			std::free(static_cast<void**>(pBuffer)[-1]);
+		}
+
+		size_t m_uBufferSizeInBytes;
+		size_t m_uAlignment;
+		uint32_t m_uMaxNoOfBuffers;
+		bool m_bThreadSafe;
+
+		// The number of buffers which have been allocated, whether they are currently in use or in the free list.
+		uint32_t m_uNoOfBuffers = 0;
+		std::vector<void*> m_vecFreeBuffers;
+		mutable std::mutex m_mutex;
+	};
+}
+
+#endif //__PolyVox_ChunkBufferPool_H__
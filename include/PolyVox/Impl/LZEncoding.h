@@ -0,0 +1,191 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_LZEncoding_H__
+#define __PolyVox_LZEncoding_H__
+
+#include "ErrorHandling.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace PolyVox
+{
+	namespace Impl
+	{
+		// Lengths of 15 or more are continued in extra bytes, each of which adds up to 255.
+		inline void writeLZLength(size_t uLength, std::vector<uint8_t>& vecCompressedData)
+		{
+			for (uLength -= 15; uLength >= 255; uLength -= 255)
+			{
+				vecCompressedData.push_back(255);
+			}
+			vecCompressedData.push_back(static_cast<uint8_t>(uLength));
+		}
+
+		inline size_t readLZLength(const uint8_t*& pInput, const uint8_t* pInputEnd)
+		{
+			size_t uLength = 15;
+			uint8_t uByte;
+			do
+			{
+				POLYVOX_THROW_IF(pInput == pInputEnd, std::runtime_error, "LZ encoded data ends in the middle of a length.");
+				uByte = *pInput++;
+				uLength += uByte;
+			} while (uByte == 255);
+			return uLength;
+		}
+
+		// Writes a sequence of literal bytes followed by a match (which is omitted for the final sequence).
+		inline void writeLZSequence(const uint8_t* pLiterals, size_t uNoOfLiterals, size_t uMatchOffset, size_t uMatchLength, std::vector<uint8_t>& vecCompressedData)
+		{
+			const size_t uMinMatchLength = 4;
+			const size_t uMatchLengthCode = (uMatchLength > 0) ? uMatchLength - uMinMatchLength : 0;
+
+			vecCompressedData.push_back(static_cast<uint8_t>(((uNoOfLiterals < 15 ? uNoOfLiterals : 15) << 4) | (uMatchLengthCode < 15 ? uMatchLengthCode : 15)));
+			if (uNoOfLiterals >= 15)
+			{
+				writeLZLength(uNoOfLiterals, vecCompressedData);
+			}
+			vecCompressedData.insert(vecCompressedData.end(), pLiterals, pLiterals + uNoOfLiterals);
+
+			if (uMatchLength > 0)
+			{
+				vecCompressedData.push_back(static_cast<uint8_t>(uMatchOffset & 0xFF));
+				vecCompressedData.push_back(static_cast<uint8_t>(uMatchOffset >> 8));
+				if (uMatchLengthCode >= 15)
+				{
+					writeLZLength(uMatchLengthCode, vecCompressedData);
+				}
+			}
+		}
+	}
+
+	// A simple dictionary compressor in the style of LZ4, for data which has repeated patterns but not necessarily long runs or few distinct
+	// values. It works on bytes so it can be used for any voxel type. The output is a series of sequences, each of which is a token byte
+	// (holding the number of literal bytes and the match length), the literal bytes, and then the offset (as two bytes) and length of an
+	// earlier occurrence of the bytes which follow. The final sequence only holds literals. Matches are found through a small hash table,
+	// which favours speed over the best possible ratio.
+	inline void compressLZ(const uint8_t* pData, size_t uSizeInBytes, std::vector<uint8_t>& vecCompressedData)
+	{
+		const size_t uMinMatchLength = 4;
+		const size_t uMaxMatchOffset = 65535;
+		const uint32_t uHashBits = 12;
+		const uint32_t uNoPosition = 0xFFFFFFFF;
+
+		std::vector<uint32_t> vecHashTable(1 << uHashBits, uNoPosition);
+		vecCompressedData.clear();
+
+		size_t uAnchor = 0;
+		size_t uPos = 0;
+		while (uPos + uMinMatchLength <= uSizeInBytes)
+		{
+			uint32_t uSequence;
+			std::memcpy(&uSequence, pData + uPos, sizeof(uSequence));
+			const uint32_t uHash = (uSequence * 2654435761u) >> (32 - uHashBits);
+			const uint32_t uCandidate = vecHashTable[uHash];
+			vecHashTable[uHash] = static_cast<uint32_t>(uPos);
+
+			if ((uCandidate != uNoPosition) && (uPos - uCandidate <= uMaxMatchOffset) && (std::memcmp(pData + uCandidate, pData + uPos, uMinMatchLength) == 0))
+			{
+				size_t uMatchLength = uMinMatchLength;
+				while ((uPos + uMatchLength < uSizeInBytes) && (pData[uCandidate + uMatchLength] == pData[uPos + uMatchLength]))
+				{
+					uMatchLength++;
+				}
+
+				Impl::writeLZSequence(pData + uAnchor, uPos - uAnchor, uPos - uCandidate, uMatchLength, vecCompressedData);
+				uPos += uMatchLength;
+				uAnchor = uPos;
+			}
+			else
+			{
+				uPos++;
+			}
+		}
+
+		Impl::writeLZSequence(pData + uAnchor, uSizeInBytes - uAnchor, 0, 0, vecCompressedData);
+	}
+
+	// Reverses compressLZ(). Throws if the compressed data does not decode to exactly the expected number of bytes.
+	inline void decompressLZ(const uint8_t* pCompressedData, size_t uCompressedSizeInBytes, uint8_t* pData, size_t uSizeInBytes)
+	{
+		const size_t uMinMatchLength = 4;
+
+		const uint8_t* pInput = pCompressedData;
+		const uint8_t* pInputEnd = pCompressedData + uCompressedSizeInBytes;
+		size_t uWritten = 0;
+
+		while (true)
+		{
+			POLYVOX_THROW_IF(pInput == pInputEnd, std::runtime_error, "LZ encoded data is missing its final sequence.");
+			const uint8_t uToken = *pInput++;
+
+			size_t uNoOfLiterals = uToken >> 4;
+			if (uNoOfLiterals == 15)
+			{
+				uNoOfLiterals = Impl::readLZLength(pInput, pInputEnd);
+			}
+			POLYVOX_THROW_IF((uNoOfLiterals > static_cast<size_t>(pInputEnd - pInput)) || (uNoOfLiterals > uSizeInBytes - uWritten), std::runtime_error,
+				"LZ encoded data contains too many literals.");
+			std::memcpy(pData + uWritten, pInput, uNoOfLiterals);
+			pInput += uNoOfLiterals;
+			uWritten += uNoOfLiterals;
+
+			// Only the final sequence ends with the input.
+			if (pInput == pInputEnd)
+			{
+				break;
+			}
+
+			POLYVOX_THROW_IF(pInputEnd - pInput < 2, std::runtime_error, "LZ encoded data ends in the middle of an offset.");
+			const size_t uMatchOffset = pInput[0] | (static_cast<size_t>(pInput[1]) << 8);
+			pInput += 2;
+
+			size_t uMatchLength = uToken & 0x0F;
+			if (uMatchLength == 15)
+			{
+				uMatchLength = Impl::readLZLength(pInput, pInputEnd);
+			}
+			uMatchLength += uMinMatchLength;
+
+			POLYVOX_THROW_IF((uMatchOffset == 0) || (uMatchOffset > uWritten), std::runtime_error, "LZ encoded data contains an invalid offset.");
+			POLYVOX_THROW_IF(uMatchLength > uSizeInBytes - uWritten, std::runtime_error, "LZ encoded data contains too many bytes.");
+
+			// The match may overlap the bytes it is producing (which is how runs are encoded), so it must be copied forwards one byte at a time.
+			const uint8_t* pMatch = pData + uWritten - uMatchOffset;
+			uint8_t* pOutput = pData + uWritten;
+			for (size_t uByte = 0; uByte < uMatchLength; uByte++)
+			{
+				pOutput[uByte] = pMatch[uByte];
+			}
+			uWritten += uMatchLength;
+		}
+
+		POLYVOX_THROW_IF(uWritten != uSizeInBytes, std::runtime_error, "LZ encoded data contains too few bytes.");
+	}
+}
+
+#endif //__PolyVox_LZEncoding_H__
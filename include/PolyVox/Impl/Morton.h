@@ -25,6 +25,25 @@
 #ifndef __PolyVox_Morton_H__
 #define __PolyVox_Morton_H__
 
+#include <cstdint>
+#include <cstring> //For memcpy
+
+// The conversion of single byte voxels into Morton order has an SSSE3 version. Builds which do not enable SSSE3 everywhere (which is
+// the default for x86 compilers) still compile it for SSSE3 where the compiler allows this, and check for it when it is first used.
+#if defined(__SSSE3__)
+	#define POLYVOX_MORTON_SSSE3
+	#define POLYVOX_TARGET_SSSE3
+	#include <tmmintrin.h>
+#elif (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || (defined(__GNUC__) && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))))
+	#define POLYVOX_MORTON_SSSE3
+	#define POLYVOX_TARGET_SSSE3 __attribute__((target("ssse3")))
+	#include <tmmintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	#define POLYVOX_MORTON_SSSE3
+	#define POLYVOX_TARGET_SSSE3
+	#include <intrin.h>
+#endif
+
 namespace PolyVox
 {
 	// Based on: http://www.forceflow.be/2013/10/07/morton-encodingdecoding-through-bit-interleaving-implementations/
@@ -139,6 +158,202 @@ namespace PolyVox
 		0x00924804, 0x00924820, 0x00924824, 0x00924900, 0x00924904, 0x00924920, 0x00924924
 	};
 
+	// Computes the Morton index of a position within a chunk. Each coordinate must be less than 256.
+	inline uint32_t encodeMorton(uint32_t uXPos, uint32_t uYPos, uint32_t uZPos)
+	{
+		return morton256_x[uXPos] | morton256_y[uYPos] | morton256_z[uZPos];
+	}
+
+	// The functions below convert a cube of voxels between linear ordering (x varying fastest and z slowest) and Morton ordering. The
+	// cube is processed in blocks of 4x4x4 voxels, which are always stored in 64 consecutive elements of the Morton ordered data. This
+	// means the Morton side is accessed sequentially, the index only has to be computed once per block, and the linear side is accessed
+	// a few rows at a time. See https://fgiesen.wordpress.com/2011/01/17/texture-tiling-and-swizzling/ for background. Voxels are
+	// copied bytewise in places, so they must be trivially copyable (which the rest of PolyVox already assumes).
+	namespace Impl
+	{
+		// The position within a 4x4x4 block of each of the 64 voxels it contains, in Morton order.
+		inline uint32_t getBlockX(uint32_t uIndex) { return (uIndex & 1) | ((uIndex >> 2) & 2); }
+		inline uint32_t getBlockY(uint32_t uIndex) { return ((uIndex >> 1) & 1) | ((uIndex >> 3) & 2); }
+		inline uint32_t getBlockZ(uint32_t uIndex) { return ((uIndex >> 2) & 1) | ((uIndex >> 4) & 2); }
+
+		// Handles chunks which are too small to contain a whole block.
+		template <bool bLinearToMorton, typename VoxelType>
+		void convertOrderingSlow(const VoxelType* pSource, VoxelType* pDestination, uint32_t uSideLength)
+		{
+			for (uint32_t z = 0; z < uSideLength; z++)
+			{
+				for (uint32_t y = 0; y < uSideLength; y++)
+				{
+					for (uint32_t x = 0; x < uSideLength; x++)
+					{
+						const uint32_t uLinearIndex = x + (y + z * uSideLength) * uSideLength;
+						const uint32_t uMortonIndex = encodeMorton(x, y, z);
+						if (bLinearToMorton)
+						{
+							pDestination[uMortonIndex] = pSource[uLinearIndex];
+						}
+						else
+						{
+							pDestination[uLinearIndex] = pSource[uMortonIndex];
+						}
+					}
+				}
+			}
+		}
+
+		template <bool bLinearToMorton, typename VoxelType>
+		void convertOrderingBlocks(const VoxelType* pSource, VoxelType* pDestination, uint32_t uSideLength)
+		{
+			// Each block contains sixteen rows of four voxels. The lowest bit of a Morton index comes from x, so within a row the
+			// first two voxels are next to each other in the Morton data, as are the last two (which follow eight elements later).
+			uint32_t auLinearRowOffsets[16];
+			uint32_t auMortonRowOffsets[16];
+			for (uint32_t uRow = 0; uRow < 16; uRow++)
+			{
+				auLinearRowOffsets[uRow] = ((uRow & 3) + (uRow >> 2) * uSideLength) * uSideLength;
+				auMortonRowOffsets[uRow] = morton256_y[uRow & 3] | morton256_z[uRow >> 2];
+			}
+
+			for (uint32_t z = 0; z < uSideLength; z += 4)
+			{
+				for (uint32_t y = 0; y < uSideLength; y += 4)
+				{
+					for (uint32_t x = 0; x < uSideLength; x += 4)
+					{
+						const uint32_t uLinearBase = x + (y + z * uSideLength) * uSideLength;
+						const uint32_t uMortonBase = encodeMorton(x, y, z);
+						for (uint32_t uRow = 0; uRow < 16; uRow++)
+						{
+							const uint32_t uLinearRow = uLinearBase + auLinearRowOffsets[uRow];
+							const uint32_t uMortonRow = uMortonBase + auMortonRowOffsets[uRow];
+							if (bLinearToMorton)
+							{
+								std::memcpy(pDestination + uMortonRow, pSource + uLinearRow, 2 * sizeof(VoxelType));
+								std::memcpy(pDestination + uMortonRow + 8, pSource + uLinearRow + 2, 2 * sizeof(VoxelType));
+							}
+							else
+							{
+								std::memcpy(pDestination + uLinearRow, pSource + uMortonRow, 2 * sizeof(VoxelType));
+								std::memcpy(pDestination + uLinearRow + 2, pSource + uMortonRow + 8, 2 * sizeof(VoxelType));
+							}
+						}
+					}
+				}
+			}
+		}
+
+#if defined(POLYVOX_MORTON_SSSE3)
+		inline bool isSSSE3Supported(void)
+		{
+#if defined(__SSSE3__)
+			return true;
+#elif defined(_MSC_VER)
+			int aiInfo[4];
+			__cpuid(aiInfo, 1);
+			return (aiInfo[2] & (1 << 9)) != 0;
+#else
+			return __builtin_cpu_supports("ssse3") != 0;
+#endif
+		}
+
+		// For single byte voxels each quarter of a block (two rows of four voxels in each of two slices) fits in an SSE register,
+		// so it can be reordered with a single shuffle rather than moving the voxels one at a time.
+		template <bool bLinearToMorton>
+		POLYVOX_TARGET_SSSE3 void convertOrderingBlocksBytes(const uint8_t* pSource, uint8_t* pDestination, uint32_t uSideLength)
+		{
+			// The register holds the four rows one after the other, with the row at (y, z) in lane (y + 2 * z).
+			alignas(16) uint8_t auShuffle[16];
+			for (uint32_t uIndex = 0; uIndex < 16; uIndex++)
+			{
+				const uint32_t uRowOffset = getBlockX(uIndex) + 4 * (getBlockY(uIndex) + 2 * getBlockZ(uIndex));
+				if (bLinearToMorton)
+				{
+					auShuffle[uIndex] = static_cast<uint8_t>(uRowOffset);
+				}
+				else
+				{
+					auShuffle[uRowOffset] = static_cast<uint8_t>(uIndex);
+				}
+			}
+			const __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(auShuffle));
+
+			const uint32_t uSliceLength = uSideLength * uSideLength;
+			for (uint32_t z = 0; z < uSideLength; z += 4)
+			{
+				for (uint32_t y = 0; y < uSideLength; y += 4)
+				{
+					for (uint32_t x = 0; x < uSideLength; x += 4)
+					{
+						const uint32_t uMortonBase = encodeMorton(x, y, z);
+						for (uint32_t uQuarter = 0; uQuarter < 4; uQuarter++)
+						{
+							// The quarters are the four combinations of the upper bits of y and z.
+							const uint32_t uLinearBase = x + (y + (uQuarter & 1) * 2) * uSideLength + (z + (uQuarter >> 1) * 2) * uSliceLength;
+							const uint32_t auRowOffsets[4] = { uLinearBase, uLinearBase + uSideLength, uLinearBase + uSliceLength, uLinearBase + uSideLength + uSliceLength };
+
+							alignas(16) uint8_t auRows[16];
+							if (bLinearToMorton)
+							{
+								for (uint32_t uRow = 0; uRow < 4; uRow++)
+								{
+									std::memcpy(auRows + uRow * 4, pSource + auRowOffsets[uRow], 4);
+								}
+								const __m128i rows = _mm_load_si128(reinterpret_cast<const __m128i*>(auRows));
+								_mm_storeu_si128(reinterpret_cast<__m128i*>(pDestination + uMortonBase + uQuarter * 16), _mm_shuffle_epi8(rows, shuffle));
+							}
+							else
+							{
+								const __m128i morton = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource + uMortonBase + uQuarter * 16));
+								_mm_store_si128(reinterpret_cast<__m128i*>(auRows), _mm_shuffle_epi8(morton, shuffle));
+								for (uint32_t uRow = 0; uRow < 4; uRow++)
+								{
+									std::memcpy(pDestination + auRowOffsets[uRow], auRows + uRow * 4, 4);
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+#endif
+
+		template <bool bLinearToMorton, typename VoxelType>
+		void convertOrdering(const VoxelType* pSource, VoxelType* pDestination, uint32_t uSideLength)
+		{
+			if (uSideLength < 4)
+			{
+				convertOrderingSlow<bLinearToMorton>(pSource, pDestination, uSideLength);
+				return;
+			}
+
+#if defined(POLYVOX_MORTON_SSSE3)
+			// Going back to linear order the shuffles are no faster than the generic version, which writes whole rows at once.
+			static const bool bSSSE3Supported = isSSSE3Supported();
+			if (bLinearToMorton && (sizeof(VoxelType) == 1) && bSSSE3Supported)
+			{
+				convertOrderingBlocksBytes<bLinearToMorton>(reinterpret_cast<const uint8_t*>(pSource), reinterpret_cast<uint8_t*>(pDestination), uSideLength);
+				return;
+			}
+#endif
+
+			convertOrderingBlocks<bLinearToMorton>(pSource, pDestination, uSideLength);
+		}
+	}
+
+	/// Copies a cube of voxels with the given (power of two) side length from linear ordering into Morton ordering.
+	template <typename VoxelType>
+	void convertLinearOrderingToMorton(const VoxelType* pLinear, VoxelType* pMorton, uint32_t uSideLength)
+	{
+		Impl::convertOrdering<true>(pLinear, pMorton, uSideLength);
+	}
+
+	/// Copies a cube of voxels with the given (power of two) side length from Morton ordering into linear ordering.
+	template <typename VoxelType>
+	void convertMortonOrderingToLinear(const VoxelType* pMorton, VoxelType* pLinear, uint32_t uSideLength)
+	{
+		Impl::convertOrdering<false>(pMorton, pLinear, uSideLength);
+	}
+
 	/*inline uint32_t convertCoordinates(uint16_t uXPos, uint16_t uYPos, uint16_t uZPos)
 	{
 	uint64_t answer = 0;
@@ -0,0 +1,108 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_PagerCallCounters_H__
+#define __PolyVox_PagerCallCounters_H__
+
+#include "../PagingStatistics.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace PolyVox
+{
+	// Counts the calls which chunks make to their Pager and how long they take. Chunks are paged in and out by many threads at once
+	// (and outside of any lock) so the counters are atomic, but they are only updated with relaxed increments as nothing else is
+	// ordered by them. This is cheap compared to the calls to the Pager themselves, so it is always enabled.
+	class PagerCallCounters
+	{
+	public:
+		PagerCallCounters()
+		{
+			reset();
+		}
+
+		void recordPageIn(std::chrono::steady_clock::duration duration)
+		{
+			m_uNoOfPageIns.fetch_add(1, std::memory_order_relaxed);
+			m_arrayPageInLatency[getLatencyBucket(duration)].fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void recordPageOut(std::chrono::steady_clock::duration duration)
+		{
+			m_uNoOfPageOuts.fetch_add(1, std::memory_order_relaxed);
+			m_arrayPageOutLatency[getLatencyBucket(duration)].fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// Copies the counters into the statistics, optionally setting them back to zero. Calls which are being recorded at the same
+		// time end up in either this interval or the next one.
+		void getStatistics(PagingStatistics& statistics, bool bReset)
+		{
+			statistics.m_uNoOfPageIns = read(m_uNoOfPageIns, bReset);
+			statistics.m_uNoOfPageOuts = read(m_uNoOfPageOuts, bReset);
+			for (uint32_t ct = 0; ct < PagingStatistics::uNoOfLatencyBuckets; ct++)
+			{
+				statistics.m_arrayPageInLatency[ct] = read(m_arrayPageInLatency[ct], bReset);
+				statistics.m_arrayPageOutLatency[ct] = read(m_arrayPageOutLatency[ct], bReset);
+			}
+		}
+
+		void reset(void)
+		{
+			m_uNoOfPageIns = 0;
+			m_uNoOfPageOuts = 0;
+			for (uint32_t ct = 0; ct < PagingStatistics::uNoOfLatencyBuckets; ct++)
+			{
+				m_arrayPageInLatency[ct] = 0;
+				m_arrayPageOutLatency[ct] = 0;
+			}
+		}
+
+	private:
+		static uint32_t getLatencyBucket(std::chrono::steady_clock::duration duration)
+		{
+			uint64_t uMicroseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+			uint32_t uBucket = 0;
+			while ((uMicroseconds > 1) && (uBucket < PagingStatistics::uNoOfLatencyBuckets - 1))
+			{
+				uMicroseconds >>= 1;
+				uBucket++;
+			}
+			return uBucket;
+		}
+
+		static uint64_t read(std::atomic<uint64_t>& uCounter, bool bReset)
+		{
+			return bReset ? uCounter.exchange(0, std::memory_order_relaxed) : uCounter.load(std::memory_order_relaxed);
+		}
+
+		std::atomic<uint64_t> m_uNoOfPageIns;
+		std::atomic<uint64_t> m_uNoOfPageOuts;
+		std::atomic<uint64_t> m_arrayPageInLatency[PagingStatistics::uNoOfLatencyBuckets];
+		std::atomic<uint64_t> m_arrayPageOutLatency[PagingStatistics::uNoOfLatencyBuckets];
+	};
+}
+
+#endif //__PolyVox_PagerCallCounters_H__
@@ -0,0 +1,155 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_PaletteEncoding_H__
+#define __PolyVox_PaletteEncoding_H__
+
+#include "ErrorHandling.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <vector>
+
+namespace PolyVox
+{
+	// Gets the number of bits needed for an index into a palette of the given size, rounded up to a power of two (or zero if the palette
+	// has a single entry) so that no index ever straddles a byte boundary unless it is a whole number of bytes.
+	inline uint8_t getPaletteIndexBits(uint32_t uPaletteSize)
+	{
+		uint8_t uBits = 0;
+		while ((uBits < 32) && ((uint64_t(1) << uBits) < uPaletteSize))
+		{
+			uBits = (uBits == 0) ? 1 : uBits * 2;
+		}
+		return uBits;
+	}
+
+	// Palette encoding of voxel data, which works well for chunks containing only a few distinct values even when they do not form long
+	// runs (such as a mixture of materials). The distinct values are written once and each voxel is then written as a bit-packed index
+	// into them. The output is the palette size as a uint32_t, the palette, the number of bits per index as a uint8_t, and then the indices
+	// (least significant bits first). As with compressRunLength() the voxels are compared bytewise rather than with operator==.
+	template <typename VoxelType>
+	void compressPalette(const VoxelType* pData, uint32_t uNoOfVoxels, std::vector<uint8_t>& vecCompressedData)
+	{
+		auto funcBytewiseLess = [](const VoxelType* pLhs, const VoxelType* pRhs) { return std::memcmp(pLhs, pRhs, sizeof(VoxelType)) < 0; };
+		std::map<const VoxelType*, uint32_t, decltype(funcBytewiseLess)> mapPaletteIndices(funcBytewiseLess);
+
+		// Build the palette and the indices together. Neighbouring voxels are often the same, so the map is only searched when the value changes.
+		std::vector<uint32_t> vecIndices(uNoOfVoxels);
+		std::vector<const VoxelType*> vecPalette;
+		for (uint32_t uVoxel = 0; uVoxel < uNoOfVoxels; uVoxel++)
+		{
+			if ((uVoxel > 0) && (std::memcmp(pData + uVoxel, pData + uVoxel - 1, sizeof(VoxelType)) == 0))
+			{
+				vecIndices[uVoxel] = vecIndices[uVoxel - 1];
+				continue;
+			}
+
+			auto iterPaletteIndex = mapPaletteIndices.find(pData + uVoxel);
+			if (iterPaletteIndex == mapPaletteIndices.end())
+			{
+				iterPaletteIndex = mapPaletteIndices.insert(std::make_pair(pData + uVoxel, static_cast<uint32_t>(vecPalette.size()))).first;
+				vecPalette.push_back(pData + uVoxel);
+			}
+			vecIndices[uVoxel] = iterPaletteIndex->second;
+		}
+
+		const uint32_t uPaletteSize = static_cast<uint32_t>(vecPalette.size());
+		const uint8_t uIndexBits = getPaletteIndexBits(uPaletteSize);
+
+		vecCompressedData.clear();
+		vecCompressedData.reserve(sizeof(uint32_t) + uPaletteSize * sizeof(VoxelType) + 1 + (static_cast<size_t>(uNoOfVoxels) * uIndexBits + 7) / 8);
+		vecCompressedData.resize(sizeof(uint32_t) + uPaletteSize * sizeof(VoxelType) + 1);
+		std::memcpy(&vecCompressedData[0], &uPaletteSize, sizeof(uint32_t));
+		for (uint32_t uEntry = 0; uEntry < uPaletteSize; uEntry++)
+		{
+			std::memcpy(&vecCompressedData[sizeof(uint32_t) + uEntry * sizeof(VoxelType)], vecPalette[uEntry], sizeof(VoxelType));
+		}
+		vecCompressedData.back() = uIndexBits;
+
+		uint64_t uBuffer = 0;
+		uint32_t uBitsInBuffer = 0;
+		for (uint32_t uIndex : vecIndices)
+		{
+			uBuffer |= static_cast<uint64_t>(uIndex) << uBitsInBuffer;
+			uBitsInBuffer += uIndexBits;
+			while (uBitsInBuffer >= 8)
+			{
+				vecCompressedData.push_back(static_cast<uint8_t>(uBuffer));
+				uBuffer >>= 8;
+				uBitsInBuffer -= 8;
+			}
+		}
+		if (uBitsInBuffer > 0)
+		{
+			vecCompressedData.push_back(static_cast<uint8_t>(uBuffer));
+		}
+	}
+
+	// Reverses compressPalette(). Throws if the compressed data is not valid for the expected number of voxels.
+	template <typename VoxelType>
+	void decompressPalette(const uint8_t* pCompressedData, size_t uCompressedSizeInBytes, VoxelType* pData, uint32_t uNoOfVoxels)
+	{
+		POLYVOX_THROW_IF(uCompressedSizeInBytes < sizeof(uint32_t), std::runtime_error, "Palette encoded data is too small.");
+
+		uint32_t uPaletteSize;
+		std::memcpy(&uPaletteSize, pCompressedData, sizeof(uint32_t));
+		POLYVOX_THROW_IF((uPaletteSize == 0) || (uPaletteSize > uNoOfVoxels), std::runtime_error, "Palette encoded data has an invalid palette size.");
+
+		const size_t uIndicesOffset = sizeof(uint32_t) + static_cast<size_t>(uPaletteSize) * sizeof(VoxelType) + 1;
+		POLYVOX_THROW_IF(uCompressedSizeInBytes < uIndicesOffset, std::runtime_error, "Palette encoded data is too small.");
+
+		std::vector<VoxelType> vecPalette(uPaletteSize);
+		std::memcpy(vecPalette.data(), pCompressedData + sizeof(uint32_t), uPaletteSize * sizeof(VoxelType));
+
+		const uint8_t uIndexBits = pCompressedData[uIndicesOffset - 1];
+		POLYVOX_THROW_IF(uIndexBits != getPaletteIndexBits(uPaletteSize), std::runtime_error, "Palette encoded data has an invalid index size.");
+		POLYVOX_THROW_IF(uCompressedSizeInBytes != uIndicesOffset + (static_cast<size_t>(uNoOfVoxels) * uIndexBits + 7) / 8, std::runtime_error,
+			"Palette encoded data has an invalid size.");
+
+		const uint64_t uIndexMask = (uint64_t(1) << uIndexBits) - 1;
+		const uint8_t* pIndices = pCompressedData + uIndicesOffset;
+		uint64_t uBuffer = 0;
+		uint32_t uBitsInBuffer = 0;
+		for (uint32_t uVoxel = 0; uVoxel < uNoOfVoxels; uVoxel++)
+		{
+			while (uBitsInBuffer < uIndexBits)
+			{
+				uBuffer |= static_cast<uint64_t>(*pIndices++) << uBitsInBuffer;
+				uBitsInBuffer += 8;
+			}
+
+			const uint32_t uIndex = static_cast<uint32_t>(uBuffer & uIndexMask);
+			uBuffer >>= uIndexBits;
+			uBitsInBuffer -= uIndexBits;
+
+			POLYVOX_THROW_IF(uIndex >= uPaletteSize, std::runtime_error, "Palette encoded data contains an invalid index.");
+			pData[uVoxel] = vecPalette[uIndex];
+		}
+	}
+}
+
+#endif //__PolyVox_PaletteEncoding_H__
@@ -0,0 +1,94 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+
+#ifndef __PolyVox_RunLengthEncoding_H__
+#define __PolyVox_RunLengthEncoding_H__
+
+#include "ErrorHandling.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace PolyVox
+{
+	// Simple run length encoding of voxel data, which works well for the large uniform areas found in typical terrain (particularly
+	// when the data is in Morton order, as runs then cover whole blocks rather than single rows). Each run is written as a uint32_t
+	// length followed by the bytes of the voxel value, so the output can also be stored on disk. Voxels are compared bytewise rather
+	// than with operator== so that the encoding is lossless for all types (e.g. negative zero) and only requires trivially copyable data.
+	template <typename VoxelType>
+	void compressRunLength(const VoxelType* pData, uint32_t uNoOfVoxels, std::vector<uint8_t>& vecCompressedData)
+	{
+		const size_t uRunSizeInBytes = sizeof(uint32_t) + sizeof(VoxelType);
+
+		vecCompressedData.clear();
+
+		uint32_t uRunStart = 0;
+		while (uRunStart < uNoOfVoxels)
+		{
+			uint32_t uRunEnd = uRunStart + 1;
+			while ((uRunEnd < uNoOfVoxels) && (std::memcmp(pData + uRunEnd, pData + uRunStart, sizeof(VoxelType)) == 0))
+			{
+				uRunEnd++;
+			}
+
+			const uint32_t uRunLength = uRunEnd - uRunStart;
+			const size_t uOffset = vecCompressedData.size();
+			vecCompressedData.resize(uOffset + uRunSizeInBytes);
+			std::memcpy(&vecCompressedData[uOffset], &uRunLength, sizeof(uint32_t));
+			std::memcpy(&vecCompressedData[uOffset + sizeof(uint32_t)], pData + uRunStart, sizeof(VoxelType));
+
+			uRunStart = uRunEnd;
+		}
+	}
+
+	// Reverses compressRunLength(). Throws if the compressed data does not decode to exactly the expected number of voxels.
+	template <typename VoxelType>
+	void decompressRunLength(const uint8_t* pCompressedData, size_t uCompressedSizeInBytes, VoxelType* pData, uint32_t uNoOfVoxels)
+	{
+		const size_t uRunSizeInBytes = sizeof(uint32_t) + sizeof(VoxelType);
+
+		POLYVOX_THROW_IF(uCompressedSizeInBytes % uRunSizeInBytes != 0, std::runtime_error, "Run length encoded data has an invalid size.");
+
+		uint32_t uNoOfVoxelsWritten = 0;
+		for (size_t uOffset = 0; uOffset < uCompressedSizeInBytes; uOffset += uRunSizeInBytes)
+		{
+			uint32_t uRunLength;
+			VoxelType tValue;
+			std::memcpy(&uRunLength, pCompressedData + uOffset, sizeof(uint32_t));
+			std::memcpy(&tValue, pCompressedData + uOffset + sizeof(uint32_t), sizeof(VoxelType));
+
+			POLYVOX_THROW_IF(uRunLength > uNoOfVoxels - uNoOfVoxelsWritten, std::runtime_error, "Run length encoded data contains too many voxels.");
+
+			std::fill(pData + uNoOfVoxelsWritten, pData + uNoOfVoxelsWritten + uRunLength, tValue);
+			uNoOfVoxelsWritten += uRunLength;
+		}
+
+		POLYVOX_THROW_IF(uNoOfVoxelsWritten != uNoOfVoxels, std::runtime_error, "Run length encoded data contains too few voxels.");
+	}
+}
+
+#endif //__PolyVox_RunLengthEncoding_H__
@@ -0,0 +1,123 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_ValueRange_H__
+#define __PolyVox_ValueRange_H__
+
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+namespace PolyVox
+{
+	// The smallest and largest values in a set of voxels, which lets code looking for particular values (such as a surface extractor
+	// looking for voxels either side of its threshold) rule out a whole chunk without reading it. Voxels which cannot be ordered (NaNs,
+	// or voxel types which are not arithmetic) make the range unknown, and for non-arithmetic types it always is.
+	template <typename VoxelType, bool bArithmetic = std::is_arithmetic<VoxelType>::value>
+	class ValueRange
+	{
+	public:
+		ValueRange()
+			:m_tMin()
+			, m_tMax()
+			, m_bValid(false)
+		{
+		}
+
+		bool isValid(void) const
+		{
+			return m_bValid;
+		}
+
+		VoxelType getMin(void) const
+		{
+			return m_tMin;
+		}
+
+		VoxelType getMax(void) const
+		{
+			return m_tMax;
+		}
+
+		void set(VoxelType tValue)
+		{
+			m_tMin = tValue;
+			m_tMax = tValue;
+			m_bValid = isOrdered(tValue);
+		}
+
+		void set(const VoxelType* pData, uint32_t uNoOfVoxels)
+		{
+			set(pData[0]);
+			for (uint32_t uIndex = 1; (uIndex < uNoOfVoxels) && m_bValid; uIndex++)
+			{
+				include(pData[uIndex]);
+			}
+		}
+
+		// Widens the range to include another value. A range which is unknown stays unknown, as it may not include the existing ones.
+		void include(VoxelType tValue)
+		{
+			if (m_bValid)
+			{
+				if (tValue < m_tMin)
+				{
+					m_tMin = tValue;
+				}
+				else if (tValue > m_tMax)
+				{
+					m_tMax = tValue;
+				}
+				else if (!isOrdered(tValue))
+				{
+					m_bValid = false;
+				}
+			}
+		}
+
+	private:
+		static bool isOrdered(VoxelType tValue)
+		{
+			return !std::is_floating_point<VoxelType>::value || !std::isnan(static_cast<long double>(tValue));
+		}
+
+		VoxelType m_tMin;
+		VoxelType m_tMax;
+		bool m_bValid;
+	};
+
+	template <typename VoxelType>
+	class ValueRange<VoxelType, false>
+	{
+	public:
+		bool isValid(void) const { return false; }
+		VoxelType getMin(void) const { return VoxelType(); }
+		VoxelType getMax(void) const { return VoxelType(); }
+		void set(VoxelType /*tValue*/) {}
+		void set(const VoxelType* /*pData*/, uint32_t /*uNoOfVoxels*/) {}
+		void include(VoxelType /*tValue*/) {}
+	};
+}
+
+#endif //__PolyVox_ValueRange_H__
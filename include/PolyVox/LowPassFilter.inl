@@ -75,10 +75,14 @@ namespace PolyVox
 
 		typename SrcVolumeType::Sampler srcSampler(m_pVolSrc);
 
+		// The results are written through a sampler, which is much faster than setVoxel() for volumes made of chunks.
+		typename DstVolumeType::Sampler dstSampler(m_pVolDst);
+
 		for (int32_t iSrcZ = iSrcMinZ, iDstZ = iDstMinZ; iSrcZ <= iSrcMaxZ; iSrcZ++, iDstZ++)
 		{
 			for (int32_t iSrcY = iSrcMinY, iDstY = iDstMinY; iSrcY <= iSrcMaxY; iSrcY++, iDstY++)
 			{
+				dstSampler.setPosition(iSrcMinX, iSrcY, iSrcZ);
 				for (int32_t iSrcX = iSrcMinX, iDstX = iDstMinX; iSrcX <= iSrcMaxX; iSrcX++, iDstX++)
 				{
 					AccumulationType tSrcVoxel(0);
@@ -117,7 +121,11 @@ namespace PolyVox
 					tSrcVoxel /= 27;
 
 					//tSrcVoxel.setDensity(uDensity);
-					m_pVolDst->setVoxel(iSrcX, iSrcY, iSrcZ, static_cast<typename DstVolumeType::VoxelType>(tSrcVoxel));
+					if (!dstSampler.setVoxel(static_cast<typename DstVolumeType::VoxelType>(tSrcVoxel)))
+					{
+						POLYVOX_THROW(std::out_of_range, "Position is outside valid region");
+					}
+					dstSampler.movePositiveX();
 				}
 			}
 		}
@@ -136,18 +144,7 @@ namespace PolyVox
 		RawVolume<AccumulationType> satVolume(Region(satLowerCorner, satUpperCorner));
 
 		//Clear to zeros (necessary?)
-		//FIXME - use Volume::fill() method. Implemented in base class as below
-		//but with optimised implementations in subclasses?
-		for (int32_t z = satLowerCorner.getZ(); z <= satUpperCorner.getZ(); z++)
-		{
-			for (int32_t y = satLowerCorner.getY(); y <= satUpperCorner.getY(); y++)
-			{
-				for (int32_t x = satLowerCorner.getX(); x <= satUpperCorner.getX(); x++)
-				{
-					satVolume.setVoxel(x, y, z, 0);
-				}
-			}
-		}
+		satVolume.fill(Region(satLowerCorner, satUpperCorner), 0);
 
 		typename RawVolume<AccumulationType>::Sampler satVolumeIter(&satVolume);
 
@@ -223,10 +220,13 @@ namespace PolyVox
 
 		const Vector3DInt32& v3dSrcLowerCorner = m_regSrc.getLowerCorner();
 
+		typename DstVolumeType::Sampler dstSampler(m_pVolDst);
+
 		for (int32_t iDstZ = v3dDstLowerCorner.getZ(), iSrcZ = v3dSrcLowerCorner.getZ(); iDstZ <= v3dDstUpperCorner.getZ(); iDstZ++, iSrcZ++)
 		{
 			for (int32_t iDstY = v3dDstLowerCorner.getY(), iSrcY = v3dSrcLowerCorner.getY(); iDstY <= v3dDstUpperCorner.getY(); iDstY++, iSrcY++)
 			{
+				dstSampler.setPosition(v3dDstLowerCorner.getX(), iDstY, iDstZ);
 				for (int32_t iDstX = v3dDstLowerCorner.getX(), iSrcX = v3dSrcLowerCorner.getX(); iDstX <= v3dDstUpperCorner.getX(); iDstX++, iSrcX++)
 				{
 					int32_t satLowerX = iSrcX - border - 1;
@@ -250,7 +250,11 @@ namespace PolyVox
 					uint32_t sideLength = border * 2 + 1;
 					AccumulationType average = sum / (sideLength*sideLength*sideLength);
 
-					m_pVolDst->setVoxel(iDstX, iDstY, iDstZ, static_cast<typename DstVolumeType::VoxelType>(average));
+					if (!dstSampler.setVoxel(static_cast<typename DstVolumeType::VoxelType>(average)))
+					{
+						POLYVOX_THROW(std::out_of_range, "Position is outside valid region");
+					}
+					dstSampler.movePositiveX();
 				}
 			}
 		}
@@ -0,0 +1,400 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_MappedFilePager_H__
+#define __PolyVox_MappedFilePager_H__
+
+#include "Impl/PlatformDefinitions.h"
+
+#include "PagedVolume.h"
+#include "Region.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#if defined(_WIN32)
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace PolyVox
+{
+	/**
+	 * An implementation of Pager which reads voxels from a memory mapped volume file. The file contains a short header followed by
+	 * a fixed size record for each chunk in a box of chunks, and each record holds the voxels of the chunk in the same (Morton) order
+	 * as the PagedVolume uses. Chunks which are paged in therefore point straight into the mapping (see Chunk::setExternalData())
+	 * rather than having the data copied into them. This means paging in costs almost nothing, opening even a huge file is instant,
+	 * and the memory is the operating system's page cache, which is shared by all processes which map the same file.
+	 *
+	 * The file is mapped read-only and is never modified. Chunks which are modified are given their own copy of the data by the
+	 * volume, and when they are paged out this pager keeps the new data and pages it in again in preference to the file. By default
+	 * the data is kept in memory, a full uncompressed chunk for each chunk which has ever been modified, and this is not counted
+	 * by the volume's memory limit. getModifiedChunksSizeInBytes() reports how much it is using. If many chunks may be modified then
+	 * another pager (such as a FilePager or ContainerFilePager) can be given to the constructor, and the modified chunks are then
+	 * paged out to that instead. Either way the changes can be kept by using writeFile() to save a new file, or dropped with
+	 * discardModifiedChunks(). Chunks outside the box in the file are filled with the default value of the voxel type, like FilePager does.
+	 *
+	 * The chunk side length of the volume must match the one used to write the file.
+	 */
+	template <typename VoxelType>
+	class MappedFilePager : public PagedVolume<VoxelType>::Pager
+	{
+	public:
+		/// Maps the given volume file, which must have been created by writeFile() with the same voxel type. If a pager is given for
+		/// the modified chunks then they are paged out to it rather than being kept in memory. It must outlive this pager.
+		MappedFilePager(const std::string& strFilename, typename PagedVolume<VoxelType>::Pager* pModifiedChunkPager = nullptr)
+			:PagedVolume<VoxelType>::Pager()
+			, m_pModifiedChunkPager(pModifiedChunkPager)
+		{
+			m_pMapping = std::make_shared<Mapping>(strFilename);
+
+			POLYVOX_THROW_IF(m_pMapping->m_uSizeInBytes < sizeof(Header), std::runtime_error, "'" + strFilename + "' is too small to be a volume file.");
+			std::memcpy(&m_header, m_pMapping->m_pData, sizeof(Header));
+			POLYVOX_THROW_IF(std::memcmp(m_header.m_arrayMagic, getMagic(), sizeof(m_header.m_arrayMagic)) != 0, std::runtime_error, "'" + strFilename + "' is not a volume file.");
+			POLYVOX_THROW_IF(m_header.m_uVoxelSizeInBytes != sizeof(VoxelType), std::runtime_error, "'" + strFilename + "' was written with a different voxel type.");
+
+			const uint64_t uNoOfRecords = static_cast<uint64_t>(m_header.m_uWidthInChunks) * m_header.m_uHeightInChunks * m_header.m_uDepthInChunks;
+			POLYVOX_THROW_IF(uHeaderSizeInBytes + uNoOfRecords * getRecordSizeInBytes() > m_pMapping->m_uSizeInBytes, std::runtime_error, "'" + strFilename + "' has been truncated.");
+		}
+
+		/// Destructor
+		virtual ~MappedFilePager()
+		{
+		}
+
+		virtual void pageIn(const Region& region, typename PagedVolume<VoxelType>::Chunk* pChunk)
+		{
+			POLYVOX_ASSERT(pChunk, "Attempting to page in NULL chunk");
+			POLYVOX_THROW_IF(static_cast<uint32_t>(region.getWidthInVoxels()) != m_header.m_uChunkSideLength, std::invalid_argument, "The volume's chunk side length does not match the volume file.");
+
+			const Vector3DInt32 v3dChunkPos = chunkContaining(region.getLowerCorner(), static_cast<int32_t>(m_header.m_uChunkSideLength));
+
+			// Chunks which have been modified take priority over the file.
+			bool bPagedOutModifiedChunk = false;
+			{
+				std::lock_guard<std::mutex> lock(m_mutexModifiedChunks);
+				auto iterModifiedChunk = m_mapModifiedChunks.find(packChunkPosition(v3dChunkPos));
+				if (iterModifiedChunk != m_mapModifiedChunks.end())
+				{
+					pChunk->setExternalData(iterModifiedChunk->second);
+					return;
+				}
+				bPagedOutModifiedChunk = m_setPagedOutModifiedChunks.count(packChunkPosition(v3dChunkPos)) > 0;
+			}
+			if (bPagedOutModifiedChunk)
+			{
+				m_pModifiedChunkPager->pageIn(region, pChunk);
+				return;
+			}
+
+			uint64_t uRecordIndex = 0;
+			if (findRecord(v3dChunkPos, uRecordIndex))
+			{
+				POLYVOX_LOG_TRACE("Mapping data for ", region);
+
+				// The aliasing constructor means that the mapping stays open for as long as any chunk (or snapshot) is using it.
+				VoxelType* pRecord = reinterpret_cast<VoxelType*>(m_pMapping->m_pData + uHeaderSizeInBytes + uRecordIndex * getRecordSizeInBytes());
+				pChunk->setExternalData(std::shared_ptr<VoxelType>(m_pMapping, pRecord));
+			}
+			else
+			{
+				POLYVOX_LOG_TRACE("No data found for ", region, " during paging in.");
+				std::fill(pChunk->getData(), pChunk->getData() + getNoOfVoxelsPerChunk(), VoxelType());
+			}
+		}
+
+		virtual void pageOut(const Region& region, typename PagedVolume<VoxelType>::Chunk* pChunk)
+		{
+			POLYVOX_ASSERT(pChunk, "Attempting to page out NULL chunk");
+			POLYVOX_ASSERT(pChunk->getData(), "Chunk must have valid data");
+
+			const Vector3DInt32 v3dChunkPos = chunkContaining(region.getLowerCorner(), static_cast<int32_t>(m_header.m_uChunkSideLength));
+			if (m_pModifiedChunkPager)
+			{
+				// Only the position is remembered, once the data is safely with the other pager.
+				m_pModifiedChunkPager->pageOut(region, pChunk);
+				std::lock_guard<std::mutex> lock(m_mutexModifiedChunks);
+				m_setPagedOutModifiedChunks.insert(packChunkPosition(v3dChunkPos));
+				return;
+			}
+
+			POLYVOX_LOG_TRACE("Keeping modified data for ", region);
+
+			// A new buffer is used each time, as the previous one may still be in use by a chunk or snapshot.
+			const uint32_t uNoOfVoxels = getNoOfVoxelsPerChunk();
+			std::shared_ptr<VoxelType> pData(new VoxelType[uNoOfVoxels], std::default_delete<VoxelType[]>());
+			std::memcpy(pData.get(), pChunk->getData(), uNoOfVoxels * sizeof(VoxelType));
+
+			std::lock_guard<std::mutex> lock(m_mutexModifiedChunks);
+			m_mapModifiedChunks[packChunkPosition(v3dChunkPos)] = std::move(pData);
+		}
+
+		/// The memory used to keep the modified chunks which have been paged out (or just their positions, if they are paged out to
+		/// another pager). This is not included in the volume's memory usage.
+		uint64_t getModifiedChunksSizeInBytes(void) const
+		{
+			std::lock_guard<std::mutex> lock(m_mutexModifiedChunks);
+			return m_mapModifiedChunks.size() * (getRecordSizeInBytes() + sizeof(std::pair<const uint64_t, std::shared_ptr<VoxelType> >)) +
+				m_setPagedOutModifiedChunks.size() * sizeof(uint64_t);
+		}
+
+		/// Forgets the modified chunks which have been paged out, so that they are paged in from the file again. Chunks which are
+		/// still in a volume are not affected, so call PagedVolume::flushAll() first to drop all the changes. Any data which was paged
+		/// out to another pager is left there, but is no longer used.
+		void discardModifiedChunks(void)
+		{
+			std::lock_guard<std::mutex> lock(m_mutexModifiedChunks);
+			m_mapModifiedChunks.clear();
+			m_setPagedOutModifiedChunks.clear();
+		}
+
+		/// The Region (in voxels) which is covered by the chunk records in the file.
+		Region getEnclosingRegion(void) const
+		{
+			const int32_t iSideLength = static_cast<int32_t>(m_header.m_uChunkSideLength);
+			const Vector3DInt32 v3dLower(m_header.m_iLowerChunkX * iSideLength, m_header.m_iLowerChunkY * iSideLength, m_header.m_iLowerChunkZ * iSideLength);
+			const Vector3DInt32 v3dSize(m_header.m_uWidthInChunks * iSideLength, m_header.m_uHeightInChunks * iSideLength, m_header.m_uDepthInChunks * iSideLength);
+			return Region(v3dLower, v3dLower + v3dSize - Vector3DInt32(1, 1, 1));
+		}
+
+		/**
+		 * Writes the chunks of a volume which overlap the given Region to a new volume file, which can then be used with a MappedFilePager.
+		 * The chunks are paged into the volume if necessary.
+		 */
+		static void writeFile(const std::string& strFilename, PagedVolume<VoxelType>& volume, const Region& regVolume)
+		{
+			// Find the size of the chunks from one of them, as the volume does not otherwise expose it.
+			const uint32_t uNoOfVoxelsPerChunk = volume.pinChunk(regVolume.getLowerCorner())->getDataSizeInBytes() / sizeof(VoxelType);
+			int32_t iSideLength = 1;
+			while (static_cast<uint32_t>(iSideLength * iSideLength * iSideLength) < uNoOfVoxelsPerChunk)
+			{
+				iSideLength *= 2;
+			}
+
+			// Chunks are aligned to multiples of the side length, so round the lower corner down (towards negative infinity).
+			const Vector3DInt32 v3dLowerChunk = chunkContaining(regVolume.getLowerCorner(), iSideLength);
+			const Vector3DInt32 v3dUpperChunk = chunkContaining(regVolume.getUpperCorner(), iSideLength);
+
+			Header header;
+			std::memcpy(header.m_arrayMagic, getMagic(), sizeof(header.m_arrayMagic));
+			header.m_uVoxelSizeInBytes = sizeof(VoxelType);
+			header.m_uChunkSideLength = static_cast<uint32_t>(iSideLength);
+			header.m_iLowerChunkX = v3dLowerChunk.getX();
+			header.m_iLowerChunkY = v3dLowerChunk.getY();
+			header.m_iLowerChunkZ = v3dLowerChunk.getZ();
+			header.m_uWidthInChunks = static_cast<uint32_t>(v3dUpperChunk.getX() - v3dLowerChunk.getX() + 1);
+			header.m_uHeightInChunks = static_cast<uint32_t>(v3dUpperChunk.getY() - v3dLowerChunk.getY() + 1);
+			header.m_uDepthInChunks = static_cast<uint32_t>(v3dUpperChunk.getZ() - v3dLowerChunk.getZ() + 1);
+
+			FILE* pFile = fopen(strFilename.c_str(), "wb");
+			POLYVOX_THROW_IF(!pFile, std::runtime_error, "Unable to open '" + strFilename + "' to write the volume file.");
+			std::unique_ptr<FILE, int(*)(FILE*)> pFileCloser(pFile, &fclose);
+
+			// The header is padded to the size of a page, so that the chunk records are aligned.
+			std::vector<uint8_t> vecHeader(uHeaderSizeInBytes, 0);
+			std::memcpy(vecHeader.data(), &header, sizeof(Header));
+			fwrite(vecHeader.data(), 1, vecHeader.size(), pFile);
+
+			for (uint32_t z = 0; z < header.m_uDepthInChunks; z++)
+			{
+				for (uint32_t y = 0; y < header.m_uHeightInChunks; y++)
+				{
+					for (uint32_t x = 0; x < header.m_uWidthInChunks; x++)
+					{
+						const Vector3DInt32 v3dChunkLower((header.m_iLowerChunkX + x) * iSideLength, (header.m_iLowerChunkY + y) * iSideLength, (header.m_iLowerChunkZ + z) * iSideLength);
+						auto chunkHandle = volume.pinChunk(v3dChunkLower);
+						fwrite(chunkHandle->getData(), 1, chunkHandle->getDataSizeInBytes(), pFile);
+					}
+				}
+			}
+
+			POLYVOX_THROW_IF(ferror(pFile), std::runtime_error, "Error writing the volume file.");
+		}
+
+	private:
+		// The file starts with this, and the chunk records follow it in x, y, z order.
+		struct Header
+		{
+			char m_arrayMagic[8];
+			uint32_t m_uVoxelSizeInBytes;
+			uint32_t m_uChunkSideLength;
+			int32_t m_iLowerChunkX;
+			int32_t m_iLowerChunkY;
+			int32_t m_iLowerChunkZ;
+			uint32_t m_uWidthInChunks;
+			uint32_t m_uHeightInChunks;
+			uint32_t m_uDepthInChunks;
+		};
+		static const uint64_t uHeaderSizeInBytes = 4096;
+
+		// Owns the mapping of the file, which is closed once the pager and all the chunks using it have gone.
+		struct Mapping
+		{
+			Mapping(const std::string& strFilename)
+			{
+#if defined(_WIN32)
+				m_hFile = CreateFileA(strFilename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+				POLYVOX_THROW_IF(m_hFile == INVALID_HANDLE_VALUE, std::runtime_error, "Unable to open '" + strFilename + "'.");
+				LARGE_INTEGER iFileSize;
+				if (!GetFileSizeEx(m_hFile, &iFileSize))
+				{
+					close();
+					POLYVOX_THROW(std::runtime_error, "Unable to get the size of '" + strFilename + "'.");
+				}
+				m_uSizeInBytes = static_cast<uint64_t>(iFileSize.QuadPart);
+				m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				m_pData = m_hMapping ? static_cast<uint8_t*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+				if (!m_pData)
+				{
+					close();
+					POLYVOX_THROW(std::runtime_error, "Unable to map '" + strFilename + "'.");
+				}
+#else
+				m_iFile = open(strFilename.c_str(), O_RDONLY);
+				POLYVOX_THROW_IF(m_iFile < 0, std::runtime_error, "Unable to open '" + strFilename + "'.");
+				struct stat fileStatus;
+				if (fstat(m_iFile, &fileStatus) != 0)
+				{
+					close();
+					POLYVOX_THROW(std::runtime_error, "Unable to get the size of '" + strFilename + "'.");
+				}
+				m_uSizeInBytes = static_cast<uint64_t>(fileStatus.st_size);
+				void* pMapping = mmap(nullptr, m_uSizeInBytes, PROT_READ, MAP_SHARED, m_iFile, 0);
+				m_pData = (pMapping != MAP_FAILED) ? static_cast<uint8_t*>(pMapping) : nullptr;
+				if (!m_pData)
+				{
+					close();
+					POLYVOX_THROW(std::runtime_error, "Unable to map '" + strFilename + "'.");
+				}
+#endif
+			}
+
+			~Mapping()
+			{
+				close();
+			}
+
+			void close(void)
+			{
+#if defined(_WIN32)
+				if (m_pData)
+				{
+					UnmapViewOfFile(m_pData);
+				}
+				if (m_hMapping)
+				{
+					CloseHandle(m_hMapping);
+				}
+				CloseHandle(m_hFile);
+#else
+				if (m_pData)
+				{
+					munmap(m_pData, m_uSizeInBytes);
+				}
+				::close(m_iFile);
+#endif
+			}
+
+#if defined(_WIN32)
+			HANDLE m_hFile = INVALID_HANDLE_VALUE;
+			HANDLE m_hMapping = nullptr;
+#else
+			int m_iFile = -1;
+#endif
+			uint8_t* m_pData = nullptr;
+			uint64_t m_uSizeInBytes = 0;
+		};
+
+		static Vector3DInt32 chunkContaining(const Vector3DInt32& v3dPos, int32_t iSideLength)
+		{
+			auto floorDiv = [iSideLength](int32_t iValue) { return (iValue >= 0) ? (iValue / iSideLength) : -((-iValue + iSideLength - 1) / iSideLength); };
+			return Vector3DInt32(floorDiv(v3dPos.getX()), floorDiv(v3dPos.getY()), floorDiv(v3dPos.getZ()));
+		}
+
+		static const char* getMagic(void)
+		{
+			return "PVMAPPED";
+		}
+
+		uint32_t getNoOfVoxelsPerChunk(void) const
+		{
+			return m_header.m_uChunkSideLength * m_header.m_uChunkSideLength * m_header.m_uChunkSideLength;
+		}
+
+		uint64_t getRecordSizeInBytes(void) const
+		{
+			return static_cast<uint64_t>(getNoOfVoxelsPerChunk()) * sizeof(VoxelType);
+		}
+
+		bool findRecord(const Vector3DInt32& v3dChunkPos, uint64_t& uRecordIndex) const
+		{
+			const int64_t iX = static_cast<int64_t>(v3dChunkPos.getX()) - m_header.m_iLowerChunkX;
+			const int64_t iY = static_cast<int64_t>(v3dChunkPos.getY()) - m_header.m_iLowerChunkY;
+			const int64_t iZ = static_cast<int64_t>(v3dChunkPos.getZ()) - m_header.m_iLowerChunkZ;
+			if ((iX < 0) || (iY < 0) || (iZ < 0) || (iX >= m_header.m_uWidthInChunks) || (iY >= m_header.m_uHeightInChunks) || (iZ >= m_header.m_uDepthInChunks))
+			{
+				return false;
+			}
+
+			uRecordIndex = static_cast<uint64_t>(iX + iY * m_header.m_uWidthInChunks + iZ * static_cast<int64_t>(m_header.m_uWidthInChunks) * m_header.m_uHeightInChunks);
+			return true;
+		}
+
+		static uint64_t packChunkPosition(const Vector3DInt32& v3dChunkPos)
+		{
+			return (static_cast<uint64_t>(static_cast<uint32_t>(v3dChunkPos.getX()) & 0x1FFFFF)) |
+				(static_cast<uint64_t>(static_cast<uint32_t>(v3dChunkPos.getY()) & 0x1FFFFF) << 21) |
+				(static_cast<uint64_t>(static_cast<uint32_t>(v3dChunkPos.getZ()) & 0x1FFFFF) << 42);
+		}
+
+		std::shared_ptr<Mapping> m_pMapping;
+		Header m_header;
+
+		// The data of chunks which have been modified and paged out, keyed by their packed position. Each buffer is only
+		// replaced (never modified) so that chunks and snapshots which are still using the old one are not affected.
+		std::unordered_map< uint64_t, std::shared_ptr<VoxelType> > m_mapModifiedChunks;
+
+		// If the modified chunks are paged out to another pager then just their positions are kept.
+		typename PagedVolume<VoxelType>::Pager* m_pModifiedChunkPager;
+		std::unordered_set<uint64_t> m_setPagedOutModifiedChunks;
+		mutable std::mutex m_mutexModifiedChunks;
+	};
+}
+
+#endif //__PolyVox_MappedFilePager_H__
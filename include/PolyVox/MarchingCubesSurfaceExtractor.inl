@@ -288,6 +288,24 @@ namespace PolyVox
 
 		typename ControllerType::DensityType tThreshold = controller.getThreshold();
 
+		// Many regions are entirely empty or entirely solid, and some volumes can tell us this without us having to visit every voxel.
+		// The surface only passes through cells with corners on both sides of the threshold, and the gradients are only computed for
+		// those cells, so if all the voxels are on the same side of it then there is nothing to do. This relies on the density never
+		// decreasing as the voxel value increases, which is known to be true of the default controller for primitive types.
+		if (std::is_same<ControllerType, DefaultMarchingCubesController<typename VolumeType::VoxelType> >::value)
+		{
+			typename VolumeType::VoxelType tMin;
+			typename VolumeType::VoxelType tMax;
+			if (volData->getValueRange(region, tMin, tMax) &&
+				((controller.convertToDensity(tMax) < tThreshold) || !(controller.convertToDensity(tMin) < tThreshold)))
+			{
+				result->setOffset(region.getLowerCorner());
+				POLYVOX_LOG_TRACE("Marching cubes surface extraction skipped a region without any surface (Region size = ", region.getWidthInVoxels(),
+					"x", region.getHeightInVoxels(), "x", region.getDepthInVoxels(), ")");
+				return;
+			}
+		}
+
 		// A naive implemetation of Marching Cubes might sample the eight corner voxels of every cell to determine the cell index. 
 		// However, when processing the cells sequentially we cn observe that many of the voxels are shared with previous adjacent 
 		// cells, and so we can obtain these by careful bit-shifting. These variables keep track of previous cells for this purpose.
@@ -25,18 +25,33 @@
 #ifndef __PolyVox_PagedVolume_H__
 #define __PolyVox_PagedVolume_H__
 
+#include "Impl/ChunkBufferPool.h"
+#include "Impl/PagerCallCounters.h"
+#include "Impl/ValueRange.h"
+
 #include "BaseVolume.h"
+#include "PagingStatistics.h"
 #include "Region.h"
 #include "Vector.h"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <limits>
 #include <cstdlib> //For abort()
 #include <cstring> //For memcpy
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <thread>
 #include <unordered_map>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <stdexcept> //For invalid_argument
+#include <utility>
 #include <vector>
 
 namespace PolyVox
@@ -53,6 +68,32 @@ namespace PolyVox
 	///
 	/// A consequence of this paging approach is that (unlike the RawVolume) the PagedVolume does not need to have a predefined size. After
 	/// the volume has been created you can begin acessing voxels anywhere in space and the required data will be created automatically.
+	///
+	/// By default a PagedVolume may only be used from one thread at a time, because even reading a voxel can cause chunks to be paged in
+	/// and out. If you need to access the volume from several threads (e.g. to run surface extraction on worker threads) then enable
+	/// concurrent access when constructing it. The chunk table is then split into a number of independently locked shards, and each
+	/// Sampler keeps its current chunk pinned in memory so that it cannot be evicted by another thread. Any number of threads may read
+	/// at the same time, but writes must not overlap with other accesses to the same chunk, and the Pager must be able to cope with being
+	/// called from any of the threads.
+	///
+	/// The memory used by the volume is split into two tiers. Recently used chunks are held uncompressed, and use up to half of the target
+	/// memory usage. When this is full the least recently used chunks are run length encoded and kept in memory, where they can be
+	/// decompressed again very quickly if needed. Only once the total memory usage exceeds the target are chunks handed to the Pager.
+	/// Typical terrain compresses very well, so this allows a much larger part of the volume to be held in memory. Chunks in which every
+	/// voxel has the same value (e.g. those which are entirely air or solid rock) are handled specially. They share a single read-only copy
+	/// of the data with all other chunks containing the same value, and are only given their own copy when a different value is written.
+	///
+	/// Chunks which are pinned are never evicted, even if this means the target memory usage is exceeded. Samplers always pin the chunk
+	/// they are currently in (so they remain valid however small the memory budget), and you can pin chunks yourself by holding on to
+	/// the ChunkHandle returned by pinChunk().
+	///
+	/// When concurrent access is enabled you can also ask the PagedVolume to create a number of background paging threads. Prefetching
+	/// is then asynchronous (prefetch() returns immediately and the chunks are added to the volume as they become ready), and modified
+	/// chunks which are evicted are handed to these threads to be paged out rather than stalling the thread which caused the eviction.
+	///
+	/// Applications which stream the volume around a viewer can use setFocus() rather than prefetch(). This pages in the chunks within
+	/// a radius of one or more focus points nearest first, cancels whatever is left of the previous request when it is called again, and
+	/// reorders the resident chunks so that those furthest from the focus points are the first to be evicted.
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	template <typename VoxelType>
 	class PagedVolume : public BaseVolume<VoxelType>
@@ -62,18 +103,33 @@ namespace PolyVox
 		class Chunk;
 		/// The Pager class is responsible for the loading and unloading of Chunks, and can be subclassed by the user.
 		class Pager;
+		/// A ChunkHandle keeps a Chunk pinned in memory for as long as it exists.
+		class ChunkHandle;
+		/// A Snapshot is a read-only view of the volume as it was at a particular time.
+		class Snapshot;
+		/// A RegionWriter writes the voxels of a region one after another.
+		class RegionWriter;
 
 		class Chunk
 		{
 			friend class PagedVolume;
 
 		public:
-			Chunk(Vector3DInt32 v3dPosition, uint16_t uSideLength, Pager* pPager = nullptr);
+			/// The chunk is paged in straight away unless bPageIn is false, in which case its data is undefined until the volume has
+			/// passed it to Pager::pageInBatch().
+			Chunk(Vector3DInt32 v3dPosition, uint16_t uSideLength, Pager* pPager = nullptr, ChunkBufferPool* pBufferPool = nullptr, PagerCallCounters* pPagerCallCounters = nullptr, bool bPageIn = true);
 			~Chunk();
 
+			/// Gets the voxel data in Morton order. For homogeneous chunks and those using external data this is shared and must not be modified.
 			VoxelType* getData(void) const;
 			uint32_t getDataSizeInBytes(void) const;
 
+			/// Whether all voxels in the chunk have the same value. Such chunks do not need their own copy of the data.
+			bool isHomogeneous(void) const;
+
+			/// Makes the chunk use read-only data which belongs to the Pager (such as a memory mapped file) rather than its own copy.
+			void setExternalData(std::shared_ptr<VoxelType> pExternalData);
+
 			VoxelType getVoxel(uint32_t uXPos, uint32_t uYPos, uint32_t uZPos) const;
 			VoxelType getVoxel(const Vector3DUint16& v3dPos) const;
 
@@ -90,20 +146,97 @@ namespace PolyVox
 			/// Private assignment operator to prevent accisdental copying
 			Chunk& operator=(const Chunk& /*rhs*/) {};
 
-			// This is updated by the PagedVolume and used to discard the least recently used chunks.
-			uint32_t m_uChunkLastAccessed;
+			// These link the chunk into the PagedVolume's list of resident chunks, which is kept in order of
+			// use (most recent at the head) so that the least recently used chunk can be found in constant time.
+			Chunk* m_pPrevChunk;
+			Chunk* m_pNextChunk;
+
+			// The position of this chunk in the PagedVolume's chunk table, so it can be removed without a search. The slot
+			// may change when the shard grows or when other chunks are removed.
+			uint32_t m_uChunkTableShard;
+			uint32_t m_uChunkArrayIndex;
+
+			// When the volume is accessed concurrently the list above cannot be reordered on every access (as that would require a lock),
+			// so instead this flag is set and the chunk is given a second chance when it reaches the end of the list. The same is done
+			// for getVoxel() without concurrent access, where reordering the list would cost more than the read itself.
+			std::atomic<bool> m_bRecentlyUsed;
+
+			// Chunks which are pinned (e.g. because a Sampler is pointing into them) will not be evicted.
+			std::atomic<uint32_t> m_uPinCount;
 
 			// This is so we can tell whether a uncompressed chunk has to be recompressed and whether
 			// a compressed chunk has to be paged back to disk, or whether they can just be discarded.
-			bool m_bDataModified;
+			// It is cleared when the data is written back while the chunk stays resident (see PagedVolume::checkpoint()).
+			std::atomic<bool> m_bDataModified;
+
+			// The version of the volume when this chunk was last modified, or zero if it has never been (see PagedVolume::getMaxVersion()).
+			std::atomic<uint64_t> m_uVersion;
+
+			// Bounds on the values of the voxels (see PagedVolume::getValueRange()). Writes only set the flag, as several threads may be
+			// writing to the chunk, and the bounds are calculated again the next time they are asked for or the chunk is compressed. The
+			// bounds themselves are only touched while no-one can be writing, or with the shard lock held.
+			void calculateValueRange(void);
+			std::atomic<bool> m_bValueRangeStale;
+			ValueRange<VoxelType> m_valueRange;
+
+			// Passes the (uncompressed) data to the pager.
+			void writeToPager(void);
+
+			// The voxels covered by the chunk.
+			Region getRegion(void) const;
 
 			uint32_t calculateSizeInBytes(void);
 			static uint32_t calculateSizeInBytes(uint32_t uSideLength);
 
+			// Chunks which have not been used for a while are kept in memory in compressed form, rather than being paged out.
+			// While a chunk is compressed m_tData is null and the voxels cannot be accessed until it has been decompressed.
+			bool isCompressed(void) const;
+			bool compress(void);
+			void decompress(void);
+			// Writes the uncompressed voxels to the given buffer, without changing the chunk.
+			void copyData(VoxelType* pData) const;
+			std::vector<uint8_t> m_vecCompressedData;
+
+			// Chunks in which all voxels have the same value point m_tData at a buffer which is shared by all such chunks,
+			// so they use hardly any memory but can still be read in the normal way. The same applies to chunks which use
+			// external data provided by the Pager. A chunk must be given its own copy of the data (by calling expand())
+			// before it can be modified.
+			bool hasSingleValue(void) const;
+			void makeHomogeneous(std::shared_ptr<VoxelType> pSharedData);
+			void expand(void);
+			bool isShared(void) const;
+			std::shared_ptr<VoxelType> m_pSharedData;
+			bool m_bExternalData;
+
+			// Incremented whenever m_tData is replaced, so that Samplers which are pointing into the chunk can tell that they have to
+			// read the pointer again. In concurrent mode it only changes while the shard is locked.
+			std::atomic<uint32_t> m_uDataGeneration;
+
+			// Samplers which had the chunk pinned while its data was replaced (because it was expanded or handed to a snapshot) may
+			// still be pointing into the old buffers, so the chunk keeps them alive until it is next compressed or made homogeneous
+			// (which only happens once nothing has it pinned).
+			std::vector< std::shared_ptr<VoxelType> > m_vecRetiredData;
+
+			// Gives up the chunk's data (returning it as a shared buffer) and replaces it with a copy, so that whoever holds the old
+			// data does not see later modifications. This is how snapshots are given the data before a chunk is modified.
+			std::shared_ptr<VoxelType> detachData(void);
+
+			// The snapshot generation of the volume when the snapshots were last given this chunk's data (see PagedVolume::snapshot()).
+			uint32_t m_uSnapshotGeneration;
+
+			// Whether the chunk is compressed or shares its data, and so is in the PagedVolume's list of compact chunks.
+			bool isCompact(void) const;
+
+			// Voxel data comes from the volume's pool of buffers if there is one, otherwise from the heap.
+			VoxelType* allocateData(void) const;
+			void freeData(VoxelType* pData) const;
+
 			VoxelType* m_tData;
 			uint16_t m_uSideLength;
 			uint8_t m_uSideLengthPower;
 			Pager* m_pPager;
+			ChunkBufferPool* m_pBufferPool;
+			PagerCallCounters* m_pPagerCallCounters;
 
 			// Note: Do we really need to store this position here as well as in the block maps?
 			Vector3DInt32 m_v3dChunkSpacePosition;
@@ -122,8 +255,163 @@ namespace PolyVox
 			/// Destructor
 			virtual ~Pager() {};
 
+			/// A chunk to be paged in or out, along with the voxels which it covers.
+			typedef std::pair<Region, Chunk*> PageRequest;
+
 			virtual void pageIn(const Region& region, Chunk* pChunk) = 0;
 			virtual void pageOut(const Region& region, Chunk* pChunk) = 0;
+
+			/// Pages in several chunks at once. The volume uses this when prefetching, and pagers which can read a number of chunks
+			/// more efficiently than one at a time (for example in the order in which they are stored) should override it.
+			virtual void pageInBatch(const std::vector<PageRequest>& vecRequests)
+			{
+				for (const PageRequest& request : vecRequests)
+				{
+					pageIn(request.first, request.second);
+				}
+			}
+
+			/// Pages out several chunks at once. The volume uses this when writing back modified chunks with flushDirty() or checkpoint().
+			virtual void pageOutBatch(const std::vector<PageRequest>& vecRequests)
+			{
+				for (const PageRequest& request : vecRequests)
+				{
+					pageOut(request.first, request.second);
+				}
+			}
+		};
+
+		/**
+		* A reference-counted handle to a Chunk. While at least one handle to a chunk exists the chunk is pinned, which means the
+		* PagedVolume will not evict it (even if this means exceeding the target memory usage) and pointers into its data stay valid.
+		* Handles are obtained from PagedVolume::pinChunk() and may be freely copied. They must not outlive the volume.
+		*/
+		class ChunkHandle
+		{
+			friend class PagedVolume;
+
+		public:
+			/// Constructs an empty handle
+			ChunkHandle();
+			ChunkHandle(const ChunkHandle& rhs);
+			ChunkHandle(ChunkHandle&& rhs);
+			/// Destructor, unpins the chunk
+			~ChunkHandle();
+
+			ChunkHandle& operator=(ChunkHandle rhs);
+
+			/// Gets the chunk which is pinned, or null for an empty handle
+			Chunk* get(void) const;
+			Chunk* operator->(void) const;
+			explicit operator bool(void) const;
+
+			/// Unpins the chunk and makes the handle empty
+			void reset(void);
+
+		private:
+			/// Takes over a pin which has already been applied by the volume
+			ChunkHandle(const PagedVolume* pVolume, Chunk* pChunk);
+
+			const PagedVolume* m_pVolume;
+			Chunk* m_pChunk;
+		};
+
+		/**
+		* A read-only view of the volume as it was when PagedVolume::snapshot() was called, which is not affected by later modifications.
+		* Chunks are only copied when they are first modified after the snapshot was taken, at which point the snapshot is given the
+		* old data and the volume carries on with a copy. Until then the snapshot reads from the volume itself (paging chunks in if
+		* necessary), so taking a snapshot is cheap and it only uses memory for the chunks which have since been modified.
+		*
+		* This allows a thread to save or mesh a consistent version of the volume while other threads carry on editing it, without
+		* either having to wait for the other. Snapshots may be freely copied, but must not outlive the volume. Unless concurrent access
+		* is enabled they may only be used from the thread which uses the volume.
+		*/
+		class Snapshot
+		{
+			friend class PagedVolume;
+
+		public:
+			/// Constructs an empty snapshot
+			Snapshot();
+
+			/// Gets a voxel at the position given by <tt>x,y,z</tt> coordinates
+			VoxelType getVoxel(int32_t uXPos, int32_t uYPos, int32_t uZPos) const;
+			/// Gets a voxel at the position given by a 3D vector
+			VoxelType getVoxel(const Vector3DInt32& v3dPos) const;
+			/// Copies the voxels in the given Region into an array in which x varies fastest and z slowest
+			void readRegion(const Region& regRead, VoxelType* pDestination, int32_t iRowStride = 0, int32_t iSliceStride = 0) const;
+
+			/// Whether this snapshot was obtained from a volume, rather than being empty
+			explicit operator bool(void) const;
+
+		private:
+			// The data of the chunks which have been modified since the snapshot was taken, keyed by their packed position. This is
+			// shared between copies of the snapshot, and the volume keeps a weak reference to it so it can add to it.
+			struct Data
+			{
+				std::mutex m_mutex;
+				std::unordered_map< uint64_t, std::shared_ptr<VoxelType> > m_mapChunkData;
+			};
+
+			Snapshot(const PagedVolume* pVolume, std::shared_ptr<Data> pData);
+
+			const VoxelType* getChunkData(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ, ChunkHandle& handle) const;
+
+			const PagedVolume* m_pVolume;
+			std::shared_ptr<Data> m_pData;
+		};
+
+		/**
+		* Writes the voxels of a Region one at a time in raster order (x varies fastest and z slowest), which is the order in which
+		* nested loops over a region usually visit them. All the chunks which the current row of voxels passes through are kept pinned
+		* and writable, so moving between chunks along a row costs an array lookup rather than a chunk table lookup, and each chunk is
+		* only found again when the writer moves on to the next row of chunks. The chunks which were written to are marked as modified
+		* when they are released, which happens at the end of each row of chunks and when the writer is destroyed.
+		*/
+		class RegionWriter
+		{
+		public:
+			/// Constructs a writer which starts at the lower corner of the given region
+			RegionWriter(PagedVolume* pVolume, const Region& regWrite);
+			~RegionWriter();
+
+			/// Writes the voxel at the current position and moves on to the next one
+			void writeVoxel(VoxelType tValue);
+			/// Gets the position which the next call to writeVoxel() will write
+			Vector3DInt32 getPosition(void) const;
+			/// Whether every voxel in the region has been written
+			bool isFinished(void) const;
+
+		private:
+			RegionWriter(const RegionWriter&);
+			RegionWriter& operator=(const RegionWriter&);
+
+			void beginChunkRow(void);
+			void releaseChunkRow(void);
+
+			PagedVolume* m_pVolume;
+			Region m_regWrite;
+			int32_t m_iXPos;
+			int32_t m_iYPos;
+			int32_t m_iZPos;
+			bool m_bFinished;
+
+			// The chunks which the current row passes through, and their data. The chunks are made writable for the snapshot
+			// generation recorded here, and must be made writable again if a snapshot has been taken since.
+			std::vector<ChunkHandle> m_vecRowChunks;
+			std::vector<VoxelType*> m_vecRowChunkData;
+			uint32_t m_uSnapshotGeneration;
+
+			// Whether anything has been written to each of the chunks in the row. This is not a vector<bool>, so that the flag for the
+			// current chunk can be set through a pointer.
+			std::vector<uint8_t> m_vecRowChunkWritten;
+
+			Chunk* m_pCurrentChunk;
+			VoxelType* m_pCurrentChunkData;
+			uint8_t* m_pCurrentChunkWritten;
+			uint32_t m_uYZIndex;
+			uint8_t m_uChunkSideLengthPower;
+			int32_t m_iChunkMask;
 		};
 
 		//There seems to be some descrepency between Visual Studio and GCC about how the following class should be declared.
@@ -140,6 +428,8 @@ namespace PolyVox
 		class Sampler : public BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> > //This line works on GCC
 #endif
 		{
+			friend class PagedVolume;
+
 		public:
 			Sampler(PagedVolume<VoxelType>* volume);
 			~Sampler();
@@ -188,9 +478,62 @@ namespace PolyVox
 			inline VoxelType peekVoxel1px1py0pz(void) const;
 			inline VoxelType peekVoxel1px1py1pz(void) const;
 
+			Sampler(const Sampler& rhs);
+			Sampler& operator=(const Sampler& rhs);
+
 		private:
+			void prepareCurrentChunkForWrite(void);
+			inline const VoxelType* getCurrentVoxel(void) const;
+			void refreshCurrentChunkData(void) const;
+
+			void linkSampler(void);
+			void unlinkSampler(void);
+
+			static uint8_t getCacheSlot(int32_t iChunkPos);
+			Chunk* getCachedChunk(uint32_t uSlot, int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const;
+			void releaseCachedChunks(void);
+			const VoxelType* getNeighbourChunkData(int32_t iXOffset, int32_t iYOffset, int32_t iZOffset) const;
+			VoxelType peekVoxelInNeighbourhood(int32_t iXOffset, int32_t iYOffset, int32_t iZOffset) const;
+
 			//Other current position information
-			VoxelType* mCurrentVoxel;
+			mutable VoxelType* mCurrentVoxel;
+
+			// The sampler keeps its current chunk pinned so that mCurrentVoxel cannot be left dangling by the chunk being evicted. This
+			// also acts as the sampler's own cache of the last accessed chunk (the volume's cache cannot be shared between threads).
+			// The pin belongs to the chunk's slot in m_arrayCachedChunks.
+			Chunk* m_pCurrentChunk;
+
+			// The data of the current chunk, and the chunk's data generation when it was read. A write through the volume (or another
+			// sampler, or thread) may give a homogeneous chunk its own data at any time. Without concurrent access the volume then
+			// points the samplers at the new data (see PagedVolume::refreshSamplers()), but in concurrent mode that could happen in
+			// the middle of a read on another thread. Reads therefore compare the generations instead, and read the pointer again
+			// (under a lock) if they differ. Whether they do is copied from the volume, so reads do not have to look at it.
+			mutable VoxelType* m_pCurrentChunkData;
+			mutable uint32_t m_uCurrentChunkDataGeneration;
+			bool m_bCheckDataGeneration;
+
+			// The samplers of a volume without concurrent access form a list starting at PagedVolume::m_pFirstSampler.
+			Sampler* m_pPrevSampler;
+			Sampler* m_pNextSampler;
+
+			// Whether the sampler has made its current chunk writable (in which case m_pCurrentChunkData is the chunk's own data),
+			// and the snapshot generation at the time. Once another snapshot has been taken the chunk must be made writable again.
+			bool m_bCurrentChunkWritable;
+			uint32_t m_uWritableSnapshotGeneration;
+
+			// The current chunk and the chunks around it, so that peeks and moves across chunk boundaries do not need to go through
+			// the chunk table. Each chunk goes in the slot given by its position modulo three on each axis, so the 27 chunks around
+			// any chunk are in different slots and moving to a neighbour leaves the others where they are. A slot is only checked
+			// (and its chunk replaced) when it is used, so up to 27 chunks stay pinned even after the sampler has moved away from
+			// them. The data pointers (and their generations) are only used in concurrent mode, as for m_pCurrentChunkData.
+			mutable Chunk* m_arrayCachedChunks[27];
+			mutable VoxelType* m_arrayCachedChunkData[27];
+			mutable uint32_t m_arrayCachedChunkDataGeneration[27];
+
+			// The slot of the current chunk on each axis.
+			uint8_t m_uCurrentSlotX;
+			uint8_t m_uCurrentSlotY;
+			uint8_t m_uCurrentSlotZ;
 
 			uint16_t m_uXPosInChunk;
 			uint16_t m_uYPosInChunk;
@@ -206,7 +549,7 @@ namespace PolyVox
 
 	public:
 		/// Constructor for creating a fixed size volume.
-		PagedVolume(Pager* pPager, uint32_t uTargetMemoryUsageInBytes = 256 * 1024 * 1024, uint16_t uChunkSideLength = 32);
+		PagedVolume(Pager* pPager, uint64_t uTargetMemoryUsageInBytes = 256 * 1024 * 1024, uint16_t uChunkSideLength = 32, bool bConcurrentAccess = false, uint32_t uNoOfPagingThreads = 0);
 		/// Destructor
 		~PagedVolume();
 
@@ -220,13 +563,54 @@ namespace PolyVox
 		/// Sets the voxel at the position given by a 3D vector
 		void setVoxel(const Vector3DInt32& v3dPos, VoxelType tValue);
 
+		/// Sets every voxel in the given Region to the same value
+		void fill(const Region& regFill, VoxelType tValue);
+		/// Copies voxels into the given Region from an array in which x varies fastest and z slowest
+		void setVoxels(const Region& regWrite, const VoxelType* pLinearSource);
+		/// Sets each voxel in the given Region to the value returned by a function of its position
+		template <typename GeneratorFunction>
+		void generate(const Region& regWrite, GeneratorFunction funcGenerator);
+
+		/// Copies the voxels in the given Region into an array in which x varies fastest and z slowest
+		void readRegion(const Region& regRead, VoxelType* pDestination, int32_t iRowStride = 0, int32_t iSliceStride = 0) const;
+		/// Calls a function with the data of each chunk which overlaps the given Region, without copying it
+		template <typename ChunkSpanFunction>
+		void forEachChunkSpan(const Region& regRead, ChunkSpanFunction funcChunkSpan) const;
+
 		/// Tries to ensure that the voxels within the specified Region are loaded into memory.
-		void prefetch(Region regPrefetch);
+		std::future<void> prefetch(Region regPrefetch);
+		/// Pages in the chunks within a radius of the given points, nearest first, and makes those furthest away the first to be evicted.
+		std::future<void> setFocus(const std::vector<Vector3DInt32>& vecFocusPoints, uint32_t uRadius);
 		/// Removes all voxels from memory
 		void flushAll();
+		/// Writes modified chunks in the specified Region back to the pager, but keeps them in memory.
+		void flushDirty(const Region& regFlush);
+		/// Writes modified chunks back to the pager, but keeps them in memory. Returns false if the time budget ran out first.
+		bool checkpoint(uint32_t uTimeBudgetInMilliseconds = 0);
+		/// Allocates buffers for as many uncompressed chunks as the target memory usage allows, so that paging does not have to later.
+		void preallocateChunkBuffers(void);
+
+		/// Pages in the chunk containing the given voxel (if necessary) and pins it until the returned handle is destroyed.
+		ChunkHandle pinChunk(const Vector3DInt32& v3dPos);
+
+		/// Takes a read-only snapshot of the volume, which later modifications will not affect.
+		Snapshot snapshot(void) const;
+
+		/// Changes the amount of memory the volume aims to use, evicting chunks straight away if necessary.
+		void setTargetMemoryUsage(uint64_t uTargetMemoryUsageInBytes);
 
 		/// Calculates approximatly how many bytes of memory the volume is currently using.
-		uint32_t calculateSizeInBytes(void);
+		uint64_t calculateSizeInBytes(void);
+		/// Gets counters describing the paging activity since the volume was created or the counters were last reset.
+		PagingStatistics getPagingStatistics(bool bResetCounters = false);
+
+		/// Gets bounds on the values of the voxels in the given Region, from the summaries kept for each chunk.
+		bool getValueRange(const Region& regQuery, VoxelType& tMin, VoxelType& tMax) const;
+
+		/// Gets the version of the most recently modified chunk which overlaps the given Region.
+		uint64_t getMaxVersion(const Region& regQuery) const;
+		/// Sets a function to be called whenever a chunk is modified.
+		void setChangeListener(typename BaseVolume<VoxelType>::ChangeListener funcChangeListener);
 
 	protected:
 		/// Copy constructor
@@ -236,8 +620,98 @@ namespace PolyVox
 		PagedVolume& operator=(const PagedVolume& rhs);
 
 	private:
+		struct ChunkList;
+		struct ChunkTableShard;
+
 		bool canReuseLastAccessedChunk(int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const;
-		Chunk* getChunk(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ) const;
+		Chunk* getChunk(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ, bool bPinChunk = false, bool bForWrite = false, VoxelType** ppChunkData = nullptr) const;
+		Chunk* addPagedInChunk(std::unique_ptr<Chunk> pNewChunk, bool bPinChunk, bool bForWrite, VoxelType** ppChunkData, bool& bDecompressChunk) const;
+		void pageInChunks(const std::vector<Vector3DInt32>& vecChunkPositions) const;
+		void unpinChunk(Chunk* pChunk) const;
+		void updateChunkVersion(Chunk* pChunk);
+		VoxelType* getPinnedChunkData(Chunk* pChunk) const;
+
+		// Access to the chunk table.
+		static uint64_t packChunkPosition(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ);
+		static uint32_t hashChunkPosition(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ);
+		Chunk* findChunkInShard(const ChunkTableShard& shard, uint32_t uPositionHash, int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ) const;
+		void insertChunkInShard(ChunkTableShard& shard, uint32_t uPositionHash, Chunk* pChunk) const;
+		std::unique_ptr<Chunk> removeChunkFromShard(ChunkTableShard& shard, Chunk* pChunk) const;
+		void growShard(ChunkTableShard& shard) const;
+		static uint32_t getHomeSlot(const ChunkTableShard& shard, uint32_t uPositionHash);
+		void touchChunk(Chunk* pChunk) const;
+		static void markChunkRecentlyUsed(Chunk* pChunk);
+		void rememberPagedOutChunkVersion(ChunkTableShard& shard, const Vector3DInt32& v3dChunkPos, uint64_t uVersion) const;
+		uint64_t getPagedOutChunkVersion(ChunkTableShard& shard, int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ, bool bForget) const;
+
+		// Maintenance of the lists of chunks ordered by recency of use.
+		ChunkList& getChunkList(Chunk* pChunk) const;
+		void linkChunkAtHead(ChunkList& list, Chunk* pChunk) const;
+		void unlinkChunk(ChunkList& list, Chunk* pChunk) const;
+		std::unique_ptr<Chunk> removeChunk(Chunk* pChunk) const;
+		void removeAllChunks(ChunkList& list, std::vector< std::unique_ptr<Chunk> >& vecRemovedChunks) const;
+		bool releaseLeastRecentlyUsedChunk(ChunkList& list, std::vector< std::unique_ptr<Chunk> >& vecRemovedChunks) const;
+		bool releaseChunk(Chunk* pChunk, std::vector< std::unique_ptr<Chunk> >& vecRemovedChunks) const;
+		void enforceMemoryLimit(std::vector< std::unique_ptr<Chunk> >& vecRemovedChunks) const;
+		void applyTargetMemoryUsage(uint64_t uTargetMemoryUsageInBytes);
+		uint64_t calculateMemoryUsageInBytes(void) const;
+		void decompressChunk(Chunk* pChunk) const;
+		bool prepareChunkForWrite(Chunk* pChunk, const VoxelType& tValue) const;
+		bool tryMakeHomogeneous(Chunk* pChunk) const;
+		std::shared_ptr<VoxelType> getHomogeneousData(const VoxelType& tValue) const;
+		bool isHomogeneousWithValue(Chunk* pChunk, const VoxelType& tValue) const;
+
+		// Writing whole regions a chunk at a time.
+		Region getChunkRegion(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ) const;
+		template <typename VoxelFunction>
+		void writeVoxels(const Region& regWrite, VoxelFunction funcVoxel);
+		template <typename VoxelFunction>
+		void writeChunkVoxels(Chunk* pChunk, const Region& regWrite, VoxelFunction funcVoxel);
+		bool tryCreateFilledChunk(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ, const VoxelType& tValue, ChunkHandle& handle);
+		void fillWholeChunk(Chunk* pChunk, const VoxelType& tValue);
+		static void copyChunkSpan(const Region& regChunk, const Region& regSpan, const VoxelType* pChunkData, const Region& regRead, VoxelType* pDestination, int32_t iRowStride, int32_t iSliceStride);
+
+		// Copy-on-write support for snapshots.
+		bool isChunkWritable(Chunk* pChunk) const;
+		void makeChunkWritable(Chunk* pChunk) const;
+		bool captureChunkForSnapshots(Chunk* pChunk) const;
+#ifndef SWIG
+		void refreshSamplers(Chunk* pChunk) const;
+#endif
+
+		// Counts a write in for the current snapshot generation for as long as it exists (see m_arrayWritesInProgress).
+		class WriteScope
+		{
+		public:
+			explicit WriteScope(const PagedVolume* pVolume);
+			~WriteScope();
+
+		private:
+			WriteScope(const WriteScope&);
+			WriteScope& operator=(const WriteScope&);
+
+			std::atomic<uint32_t>* m_pWritesInProgress;
+		};
+
+		void deleteRemovedChunks(std::vector< std::unique_ptr<Chunk> >& vecRemovedChunks) const;
+		bool writeBackModifiedChunks(const Region* pChunkRegion, uint32_t uTimeBudgetInMilliseconds);
+
+		// Coordination of chunks which are being paged in and out by different threads.
+		std::unique_ptr<Chunk> beginPageIn(const Vector3DInt32& v3dChunkPos, bool& bRetryLookup) const;
+		bool tryBeginPageIn(const Vector3DInt32& v3dChunkPos) const;
+		bool isPageInStale(const Vector3DInt32& v3dChunkPos) const;
+		void endPageIn(const Vector3DInt32& v3dChunkPos) const;
+		void waitForPendingPageOuts(void) const;
+
+		// Background paging. Chunks are passed to the Pager in batches of up to this many.
+		static const uint32_t uMaxNoOfChunksPerPagingBatch = 16;
+		void pagingThreadMain(void);
+		void stopPagingThreads(void);
+
+		// Streaming around focus points.
+		std::vector<Vector3DInt32> findChunksInFocus(const std::vector<Vector3DInt32>& vecFocusPoints, uint32_t uRadius) const;
+		uint64_t calculateFocusDistanceSquared(const Vector3DInt32& v3dChunkPos, const std::vector<Vector3DInt32>& vecFocusPoints) const;
+		void orderChunksByFocusDistance(const std::vector<Vector3DInt32>& vecFocusPoints, uint32_t uRadius, uint32_t uFocusGeneration) const;
 
 		// Storing these properties individually has proved to be faster than keeping
 		// them in a Vector3DInt32 as it avoids constructions and comparison overheads.
@@ -248,19 +722,135 @@ namespace PolyVox
 		mutable int32_t m_v3dLastAccessedChunkZ = 0;
 		mutable Chunk* m_pLastAccessedChunk = nullptr;
 
-		mutable uint32_t m_uTimestamper = 0;
+		// The voxel data of uncompressed chunks is recycled through this pool rather than being allocated for every chunk. It must
+		// outlive all chunks, so it is declared before any of the members which own them.
+		std::unique_ptr<ChunkBufferPool> m_pChunkBufferPool;
 
-		uint32_t m_uChunkCountLimit = 0;
+		// The resident chunks form intrusive doubly-linked lists with the most recently used chunk at the head and the least
+		// recently used at the tail. Together with the chunk count this means eviction does not need to search the chunk array.
+		struct ChunkList
+		{
+			Chunk* m_pMostRecentlyUsedChunk = nullptr;
+			Chunk* m_pLeastRecentlyUsedChunk = nullptr;
+		};
 
-		// Chunks are stored in the following array which is used as a hash-table. Conventional wisdom is that such a hash-table
-		// should not be more than half full to avoid conflicts, and a practical chunk size seems to be 64^3. With this configuration
-		// there can be up to 32768*64^3 = 8 gigavoxels (with each voxel perhaps being many bytes). This should effectively make use 
-		// of even high end machines. Of course, the user can choose to limit the memory usage in which case much less of the chunk 
-		// array will actually be used. None-the-less, we have chosen to use a fixed size array (rather than a vector) as it appears to 
-		// be slightly faster (probably due to the extra pointer indirection in a vector?) and the actual size of this array should
-		// just be 1Mb or so.
-		static const uint32_t uChunkArraySize = 65536;
-		mutable std::unique_ptr< Chunk > m_arrayChunks[uChunkArraySize];
+		// Uncompressed chunks are compressed (or made homogeneous) when they reach the tail of the first list, and then move to the
+		// second list. Compact chunks are paged out when they reach the tail of that. Compressed chunks are moved back to the first
+		// list if they are used, as are homogeneous chunks which are written to.
+		mutable ChunkList m_listUncompressedChunks;
+		mutable ChunkList m_listCompactChunks;
+		mutable std::atomic<uint32_t> m_uChunkCount;
+		mutable uint32_t m_uNoOfUncompressedChunks = 0;
+		mutable uint64_t m_uCompactDataSizeInBytes = 0;
+
+		// Guards the lists above (and the counts) when concurrent access is enabled. If a shard lock is also
+		// needed then it must be taken after this one. A chunk only changes between being compact and
+		// uncompressed while both are held, so its state always matches the list it is in.
+		mutable std::mutex m_mutexChunkList;
+
+		// The buffers used by homogeneous chunks, one for each value. Only a few are kept so that the memory they use is negligible.
+		static const uint32_t uMaxNoOfHomogeneousValues = 16;
+		mutable std::vector< std::shared_ptr<VoxelType> > m_vecHomogeneousData;
+		mutable std::mutex m_mutexHomogeneousData;
+
+		// The memory limits. These can be changed while the volume is in use, but only while the list lock is held. The count
+		// limit is also read without the lock (e.g. to warn about prefetching too much), hence it is atomic.
+		std::atomic<uint32_t> m_uUncompressedChunkCountLimit;
+		uint64_t m_uTargetMemoryUsageInBytes = 0;
+
+		// Chunks are stored in a hash table which is split into a number of shards, each of which has its own lock. When concurrent
+		// access is enabled this means threads only contend with each other if they happen to be looking up chunks which fall into the
+		// same shard. The low bits of the hash pick the shard and the higher bits the starting slot within it.
+		//
+		// Each shard uses open addressing with linear probing. It is doubled in size whenever it would become more than half full, so
+		// probe sequences stay short and a lookup can stop as soon as it reaches an empty slot, however many chunks are resident.
+		// Removal shifts the following entries back to close the gap (rather than leaving a tombstone), so this stays true over time.
+		static const uint32_t uNoOfChunkTableShards = 64;
+		static const uint32_t uInitialChunkTableShardSize = 64;
+		static const uint32_t uMaxNoOfPagedOutChunkVersionsPerShard = 1024;
+		static const uint32_t uPagedOutChunkVersionSizeInBytes = sizeof(std::pair<const uint64_t, uint64_t>) + 2 * sizeof(void*); // Node and bucket.
+
+		struct ChunkTableShard
+		{
+			std::mutex m_mutex;
+			std::vector< std::unique_ptr< Chunk > > m_vecChunks; // Size is always a power of two.
+			uint32_t m_uNoOfChunks = 0;
+
+			// The versions of modified chunks which are not resident, so that they are not lost when chunks are paged out. They are
+			// keyed by the packed chunk position, and are kept in the shard which the chunk would be in so they share its lock. So that
+			// editing a large world does not make this grow without limit, once it holds too many versions they are replaced by a floor
+			// (their maximum) which applies to every chunk in the shard which is not resident. This can only make versions higher, so
+			// at worst regions which have not really changed are reported as changed once.
+			std::unordered_map<uint64_t, uint64_t> m_mapPagedOutChunkVersions;
+			uint64_t m_uPagedOutChunkVersionFloor = 0;
+
+			// Statistics about the lookups in this shard (see getPagingStatistics()), only gathered if POLYVOX_LOOKUP_STATISTICS_ENABLED
+			// is defined. They are guarded by the lock, so keeping them here rather than in shared counters avoids any contention.
+			mutable uint64_t m_uNoOfLookups = 0;
+			mutable uint64_t m_uNoOfProbes = 0;
+		};
+		mutable ChunkTableShard m_arrayChunkTableShards[uNoOfChunkTableShards];
+
+		// The total size of the shards (including the versions of paged out chunks), which can grow while only the shard lock is held.
+		mutable std::atomic<uint64_t> m_uChunkTableSizeInBytes;
+
+		// Modified chunks are given the current version, which moves on whenever getMaxVersion() has returned it. This means a
+		// write normally only has to compare the chunk's version with this one, rather than incrementing a shared counter.
+		mutable std::atomic<uint64_t> m_uCurrentVersion;
+		typename BaseVolume<VoxelType>::ChangeListener m_funcChangeListener;
+
+		// The snapshots which may still be in use. The generation is incremented whenever one is taken, and a chunk must give its data
+		// to any snapshots which do not have it yet before it is modified, unless it has done so since the generation last changed.
+		// If there have never been any snapshots all chunks are in generation zero, so writes only cost a comparison.
+		mutable std::vector< std::weak_ptr<typename Snapshot::Data> > m_vecSnapshots;
+		mutable std::mutex m_mutexSnapshots;
+		mutable std::atomic<uint32_t> m_uSnapshotGeneration;
+
+		// In concurrent mode a write which checked the generation just before a snapshot was taken could still be modifying data which
+		// the snapshot then reads. Writes therefore count themselves in for their generation (indexed by its lowest bit) and snapshot()
+		// waits for those of the previous generation to finish. Taking snapshots is serialised so the two counters cannot be mixed up.
+		mutable std::atomic<uint32_t> m_arrayWritesInProgress[2];
+		mutable std::mutex m_mutexSnapshotCreation;
+
+		// When concurrent access is enabled, modified chunks are paged out after they have been removed from the chunk table (so that
+		// other threads are not blocked). If background paging threads exist then they do this, and until they get round to it the
+		// chunks sit in the write-behind queue from where they can be reclaimed if needed again. Otherwise another thread which needs
+		// a chunk which is being paged out (or in) has to wait for this to complete. All of this is guarded by m_mutexPaging.
+		mutable std::mutex m_mutexPaging;
+		mutable std::condition_variable m_conditionPagingComplete;
+		mutable std::vector<Vector3DInt32> m_vecPendingPageOuts;
+		mutable std::vector<Vector3DInt32> m_vecPageInsInProgress;
+
+		// A page in which was started while another copy of the chunk was still resident becomes stale if that copy is modified and
+		// paged out before the new one is added to the chunk table, as the data may have been read before it was written.
+		mutable std::vector<Vector3DInt32> m_vecStalePageIns;
+		mutable std::deque< std::unique_ptr<Chunk> > m_dequeWriteBehindChunks;
+
+		// Prefetch requests waiting for a background paging thread.
+		mutable std::deque< std::function<void()> > m_dequePagingJobs;
+		mutable std::condition_variable m_conditionPagingWork;
+		bool m_bStopPagingThreads = false;
+		std::vector<std::thread> m_vecPagingThreads;
+
+		// Incremented by each call to setFocus(), so that the chunks queued by earlier calls can be skipped.
+		mutable std::atomic<uint32_t> m_uFocusGeneration;
+
+		// Statistics for getPagingStatistics(). Those which are not kept in the shards are guarded by the list lock, apart from the
+		// hits on the last accessed chunk (which is only used without concurrent access) and those about calls to the Pager.
+		mutable uint64_t m_uNoOfLastChunkCacheHits = 0;
+		mutable uint64_t m_uNoOfCompressions = 0;
+		mutable uint64_t m_uNoOfEvictions = 0;
+		std::atomic<uint64_t> m_uNoOfDirtyWriteBacks;
+		mutable PagerCallCounters m_pagerCallCounters;
+
+		// Whether the volume may be accessed from multiple threads at the same time.
+		bool m_bConcurrentAccess = false;
+
+#ifndef SWIG
+		// Without concurrent access all the samplers are kept in a list, so that those pointing into a chunk can be updated when the
+		// chunk's data is replaced. This means they do not have to check for it on every read.
+		mutable Sampler* m_pFirstSampler = nullptr;
+#endif
 
 		// The size of the chunks
 		uint16_t m_uChunkSideLength;
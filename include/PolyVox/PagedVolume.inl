@@ -23,6 +23,8 @@
 *******************************************************************************/
 
 #include "Impl/ErrorHandling.h"
+#include "Impl/Morton.h"
+#include "Impl/Timer.h"
 
 #include <algorithm>
 #include <limits>
@@ -34,10 +36,21 @@ namespace PolyVox
 	/// \param pPager Called by PolyVox to load and unload data on demand.
 	/// \param uTargetMemoryUsageInBytes The upper limit to how much memory this PagedVolume should aim to use.
 	/// \param uChunkSideLength The size of the chunks making up the volume. Small chunks will compress/decompress faster, but there will also be more of them meaning voxel access could be slower.
+	/// \param bConcurrentAccess Whether the volume can be accessed by multiple threads at the same time. This has a small overhead so it is disabled by default.
+	/// \param uNoOfPagingThreads The number of background threads used for asynchronous prefetching and page out. This requires concurrent access to be enabled.
 	////////////////////////////////////////////////////////////////////////////////
 	template <typename VoxelType>
-	PagedVolume<VoxelType>::PagedVolume(Pager* pPager, uint32_t uTargetMemoryUsageInBytes, uint16_t uChunkSideLength)
+	PagedVolume<VoxelType>::PagedVolume(Pager* pPager, uint64_t uTargetMemoryUsageInBytes, uint16_t uChunkSideLength, bool bConcurrentAccess, uint32_t uNoOfPagingThreads)
 		:BaseVolume<VoxelType>()
+		, m_uChunkCount(0)
+		, m_uUncompressedChunkCountLimit(0)
+		, m_uChunkTableSizeInBytes(0)
+		, m_uCurrentVersion(1)
+		, m_uSnapshotGeneration(0)
+		, m_arrayWritesInProgress()
+		, m_uFocusGeneration(0)
+		, m_uNoOfDirtyWriteBacks(0)
+		, m_bConcurrentAccess(bConcurrentAccess)
 		, m_uChunkSideLength(uChunkSideLength)
 		, m_pPager(pPager)
 	{
@@ -47,27 +60,32 @@ namespace PolyVox
 			POLYVOX_THROW_IF(m_uChunkSideLength == 0, std::invalid_argument, "Chunk side length cannot be zero.");
 			POLYVOX_THROW_IF(m_uChunkSideLength > 256, std::invalid_argument, "Chunk size is too large to be practical.");
 			POLYVOX_THROW_IF(!isPowerOf2(m_uChunkSideLength), std::invalid_argument, "Chunk side length must be a power of two.");
+			POLYVOX_THROW_IF(uNoOfPagingThreads > 0 && !bConcurrentAccess, std::invalid_argument, "Background paging threads require concurrent access to be enabled.");
 
 			// Used to perform multiplications and divisions by bit shifting.
 			m_uChunkSideLengthPower = logBase2(m_uChunkSideLength);
 			// Use to perform modulo by bit operations
 			m_iChunkMask = m_uChunkSideLength - 1;
 
-			// Calculate the number of chunks based on the memory limit and the size of each chunk.
-			uint32_t uChunkSizeInBytes = PagedVolume<VoxelType>::Chunk::calculateSizeInBytes(m_uChunkSideLength);
-			m_uChunkCountLimit = uTargetMemoryUsageInBytes / uChunkSizeInBytes;
+			for (uint32_t ct = 0; ct < uNoOfChunkTableShards; ct++)
+			{
+				m_arrayChunkTableShards[ct].m_vecChunks.resize(uInitialChunkTableShardSize);
+				m_uChunkTableSizeInBytes += uInitialChunkTableShardSize * sizeof(std::unique_ptr< Chunk >);
+			}
 
-			// Enforce sensible limits on the number of chunks.
-			const uint32_t uMinPracticalNoOfChunks = 32; // Enough to make sure a chunks and it's neighbours can be loaded, with a few to spare.
-			const uint32_t uMaxPracticalNoOfChunks = uChunkArraySize / 2; // A hash table should only become half-full to avoid too many clashes.
-			POLYVOX_LOG_WARNING_IF(m_uChunkCountLimit < uMinPracticalNoOfChunks, "Requested memory usage limit of ",
-				uTargetMemoryUsageInBytes / (1024 * 1024), "Mb is too low and cannot be adhered to.");
-			m_uChunkCountLimit = (std::max)(m_uChunkCountLimit, uMinPracticalNoOfChunks);
-			m_uChunkCountLimit = (std::min)(m_uChunkCountLimit, uMaxPracticalNoOfChunks);
+			applyTargetMemoryUsage(uTargetMemoryUsageInBytes);
 
-			// Inform the user about the chosen memory configuration.
-			POLYVOX_LOG_DEBUG("Memory usage limit for volume now set to ", (m_uChunkCountLimit * uChunkSizeInBytes) / (1024 * 1024),
-				"Mb (", m_uChunkCountLimit, " chunks of ", uChunkSizeInBytes / 1024, "Kb each).");
+			// The pool keeps hold of enough buffers for the uncompressed chunks, plus a few for those being paged in and reordered.
+			// Page alignment is used for larger chunks, as they may then be mapped or copied more efficiently.
+			const uint32_t uChunkSizeInBytes = PagedVolume<VoxelType>::Chunk::calculateSizeInBytes(m_uChunkSideLength);
+			const size_t uBufferAlignment = (uChunkSizeInBytes >= 4096) ? 4096 : 64;
+			m_pChunkBufferPool.reset(new ChunkBufferPool(uChunkSizeInBytes, uBufferAlignment, m_uUncompressedChunkCountLimit + uNoOfPagingThreads + 1, bConcurrentAccess));
+
+			// Start the background paging threads last, as they may start using the volume as soon as they exist.
+			for (uint32_t ct = 0; ct < uNoOfPagingThreads; ct++)
+			{
+				m_vecPagingThreads.push_back(std::thread(&PagedVolume<VoxelType>::pagingThreadMain, this));
+			}
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
@@ -85,10 +103,12 @@ namespace PolyVox
 
 	////////////////////////////////////////////////////////////////////////////////
 	/// Destroys the volume The destructor will call flushAll() to ensure that a paging volume has the chance to save it's data via the dataOverflowHandler() if desired.
+	/// Any prefetches which have not yet been started by the background paging threads are abandoned.
 	////////////////////////////////////////////////////////////////////////////////
 	template <typename VoxelType>
 	PagedVolume<VoxelType>::~PagedVolume()
 	{
+		stopPagingThreads();
 		flushAll();
 	}
 
@@ -124,8 +144,49 @@ namespace PolyVox
 		const uint16_t yOffset = static_cast<uint16_t>(uYPos & m_iChunkMask);
 		const uint16_t zOffset = static_cast<uint16_t>(uZPos & m_iChunkMask);
 
-		auto pChunk = canReuseLastAccessedChunk(chunkX, chunkY, chunkZ) ? m_pLastAccessedChunk : getChunk(chunkX, chunkY, chunkZ);
+		if (m_bConcurrentAccess)
+		{
+			// The last accessed chunk cannot be shared between threads, so we always go to the chunk table. If the chunk is resident
+			// we read from it while the shard is locked, as that prevents it being evicted. Otherwise we page it in and pin it while
+			// we read. Samplers should be preferred for bulk access as they keep their own chunk and so avoid this cost.
+			const uint32_t uPositionHash = hashChunkPosition(chunkX, chunkY, chunkZ);
+			ChunkTableShard& shard = m_arrayChunkTableShards[uPositionHash % uNoOfChunkTableShards];
+			{
+				std::lock_guard<std::mutex> shardLock(shard.m_mutex);
+				auto pChunk = findChunkInShard(shard, uPositionHash, chunkX, chunkY, chunkZ);
+				if (pChunk && !pChunk->isCompressed())
+				{
+					touchChunk(pChunk);
+					return pChunk->getVoxel(xOffset, yOffset, zOffset);
+				}
+			}
+
+			auto pChunk = getChunk(chunkX, chunkY, chunkZ, true);
+			VoxelType tValue = pChunk->getVoxel(xOffset, yOffset, zOffset);
+			unpinChunk(pChunk);
+			return tValue;
+		}
+
+		if (canReuseLastAccessedChunk(chunkX, chunkY, chunkZ))
+		{
+			return m_pLastAccessedChunk->getVoxel(xOffset, yOffset, zOffset);
+		}
 
+		// Without concurrent access there is nothing to lock or pin, so a resident chunk which is not compressed can be read straight
+		// from the chunk table. Only chunks which have to be decompressed or paged in need the full work of getChunk(). Random reads
+		// would spend much of their time moving chunks to the head of the list, so as in concurrent mode the chunk is only marked.
+		const uint32_t uPositionHash = hashChunkPosition(chunkX, chunkY, chunkZ);
+		Chunk* pChunk = findChunkInShard(m_arrayChunkTableShards[uPositionHash % uNoOfChunkTableShards], uPositionHash, chunkX, chunkY, chunkZ);
+		if (!pChunk || pChunk->isCompressed())
+		{
+			return getChunk(chunkX, chunkY, chunkZ)->getVoxel(xOffset, yOffset, zOffset);
+		}
+
+		markChunkRecentlyUsed(pChunk);
+		m_pLastAccessedChunk = pChunk;
+		m_v3dLastAccessedChunkX = chunkX;
+		m_v3dLastAccessedChunkY = chunkY;
+		m_v3dLastAccessedChunkZ = chunkZ;
 		return pChunk->getVoxel(xOffset, yOffset, zOffset);
 	}
 
@@ -157,9 +218,28 @@ namespace PolyVox
 		const uint16_t yOffset = static_cast<uint16_t>(uYPos - (chunkY << m_uChunkSideLengthPower));
 		const uint16_t zOffset = static_cast<uint16_t>(uZPos - (chunkZ << m_uChunkSideLengthPower));
 
+		if (m_bConcurrentAccess)
+		{
+			// See getVoxel() for why this is handled differently. Another thread could be expanding a homogeneous chunk at the same
+			// time as us, so rather than checking whether it needs expanding we always ask for a chunk which can be written to.
+			Chunk* pChunk = nullptr;
+			{
+				WriteScope writeScope(this);
+				pChunk = getChunk(chunkX, chunkY, chunkZ, true, true);
+				pChunk->setVoxel(xOffset, yOffset, zOffset, tValue);
+			}
+			updateChunkVersion(pChunk);
+			unpinChunk(pChunk);
+			return;
+		}
+
 		auto pChunk = canReuseLastAccessedChunk(chunkX, chunkY, chunkZ) ? m_pLastAccessedChunk : getChunk(chunkX, chunkY, chunkZ);
 
-		pChunk->setVoxel(xOffset, yOffset, zOffset, tValue);
+		if (isChunkWritable(pChunk) || prepareChunkForWrite(pChunk, tValue))
+		{
+			pChunk->setVoxel(xOffset, yOffset, zOffset, tValue);
+			updateChunkVersion(pChunk);
+		}
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
@@ -172,12 +252,196 @@ namespace PolyVox
 		setVoxel(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ(), tValue);
 	}
 
+	////////////////////////////////////////////////////////////////////////////////
+	/// This is much faster than calling setVoxel() for each voxel, as each chunk only has to be found once. Chunks which are entirely
+	/// inside the region are simply made homogeneous where possible, so filling large regions uses hardly any memory, and those which
+	/// are not resident are not paged in unless a Snapshot may still need their old data.
+	/// \param regFill The Region to fill.
+	/// \param tValue The value to which the voxels will be set.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::fill(const Region& regFill, VoxelType tValue)
+	{
+		if (!regFill.isValid())
+		{
+			return;
+		}
+
+		for (int32_t z = regFill.getLowerZ() >> m_uChunkSideLengthPower; z <= regFill.getUpperZ() >> m_uChunkSideLengthPower; z++)
+		{
+			for (int32_t y = regFill.getLowerY() >> m_uChunkSideLengthPower; y <= regFill.getUpperY() >> m_uChunkSideLengthPower; y++)
+			{
+				for (int32_t x = regFill.getLowerX() >> m_uChunkSideLengthPower; x <= regFill.getUpperX() >> m_uChunkSideLengthPower; x++)
+				{
+					const Region regChunk = getChunkRegion(x, y, z);
+
+					// A chunk which is completely overwritten does not need to be paged in first.
+					ChunkHandle handle;
+					if (regFill.containsRegion(regChunk) && tryCreateFilledChunk(x, y, z, tValue, handle))
+					{
+						updateChunkVersion(handle.get());
+						continue;
+					}
+					if (!handle)
+					{
+						handle = ChunkHandle(this, getChunk(x, y, z, true));
+					}
+
+					// Writing the value which a homogeneous chunk already contains would not change anything.
+					if (isHomogeneousWithValue(handle.get(), tValue))
+					{
+						continue;
+					}
+
+					if (regFill.containsRegion(regChunk))
+					{
+						fillWholeChunk(handle.get(), tValue);
+					}
+					else
+					{
+						Region regChunkFill(regChunk);
+						regChunkFill.cropTo(regFill);
+						writeChunkVoxels(handle.get(), regChunkFill, [&](int32_t, int32_t, int32_t) { return tValue; });
+					}
+
+					updateChunkVersion(handle.get());
+				}
+			}
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// The source data is laid out as in a RawVolume, with x varying fastest and z slowest. It is written a chunk at a time.
+	/// \param regWrite The Region to write.
+	/// \param pLinearSource The new voxel values. There must be one for each voxel in the region.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::setVoxels(const Region& regWrite, const VoxelType* pLinearSource)
+	{
+		const int32_t iWidth = regWrite.getWidthInVoxels();
+		const int32_t iHeight = regWrite.getHeightInVoxels();
+		writeVoxels(regWrite, [&](int32_t x, int32_t y, int32_t z)
+		{
+			return pLinearSource[(x - regWrite.getLowerX()) + ((y - regWrite.getLowerY()) + (z - regWrite.getLowerZ()) * iHeight) * iWidth];
+		});
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This is useful for procedurally generating the contents of a volume. The function is called once for each voxel and must
+	/// return the value of that voxel. The voxels are visited a chunk at a time, so the order of the calls is not specified.
+	/// \param regWrite The Region to write.
+	/// \param funcGenerator A function (or functor) with the signature <tt>VoxelType(int32_t x, int32_t y, int32_t z)</tt>.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	template <typename GeneratorFunction>
+	void PagedVolume<VoxelType>::generate(const Region& regWrite, GeneratorFunction funcGenerator)
+	{
+		writeVoxels(regWrite, funcGenerator);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This is much faster than calling getVoxel() for each voxel, as each chunk only has to be found once and its voxels are then
+	/// copied out of Morton order directly. The chunks are paged in if necessary, as with getVoxel().
+	/// \param regRead The Region to read.
+	/// \param pDestination The array to copy the voxels into.
+	/// \param iRowStride The distance (in voxels) between the starts of consecutive rows in the destination. Zero means the width of the region.
+	/// \param iSliceStride The distance (in voxels) between the starts of consecutive slices in the destination. Zero means the row stride multiplied by the height of the region.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::readRegion(const Region& regRead, VoxelType* pDestination, int32_t iRowStride, int32_t iSliceStride) const
+	{
+		iRowStride = (iRowStride > 0) ? iRowStride : regRead.getWidthInVoxels();
+		iSliceStride = (iSliceStride > 0) ? iSliceStride : iRowStride * regRead.getHeightInVoxels();
+
+		forEachChunkSpan(regRead, [&](const Region& regChunk, const Region& regSpan, const VoxelType* pChunkData)
+		{
+			copyChunkSpan(regChunk, regSpan, pChunkData, regRead, pDestination, iRowStride, iSliceStride);
+		});
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This gives direct access to the voxel data of the chunks (in Morton order, see Chunk::getData()), which avoids copying it when
+	/// the caller can work with that layout. The function is called once for each chunk which overlaps the region, and is given the
+	/// Region covered by the whole chunk, the part of that which lies inside the requested region, and the chunk's data. The chunk is
+	/// pinned while the function runs, but the data must not be modified or used after it has returned.
+	/// \param regRead The Region to read.
+	/// \param funcChunkSpan A function (or functor) with the signature <tt>void(const Region& regChunk, const Region& regSpan, const VoxelType* pChunkData)</tt>.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	template <typename ChunkSpanFunction>
+	void PagedVolume<VoxelType>::forEachChunkSpan(const Region& regRead, ChunkSpanFunction funcChunkSpan) const
+	{
+		if (!regRead.isValid())
+		{
+			return;
+		}
+
+		for (int32_t z = regRead.getLowerZ() >> m_uChunkSideLengthPower; z <= regRead.getUpperZ() >> m_uChunkSideLengthPower; z++)
+		{
+			for (int32_t y = regRead.getLowerY() >> m_uChunkSideLengthPower; y <= regRead.getUpperY() >> m_uChunkSideLengthPower; y++)
+			{
+				for (int32_t x = regRead.getLowerX() >> m_uChunkSideLengthPower; x <= regRead.getUpperX() >> m_uChunkSideLengthPower; x++)
+				{
+					const Region regChunk = getChunkRegion(x, y, z);
+					Region regSpan(regChunk);
+					regSpan.cropTo(regRead);
+
+					// In concurrent mode the data pointer must come from getChunk(), as another thread could be expanding a homogeneous
+					// chunk. The shared buffer stays alive until the chunk is unpinned, so the data we were given remains valid.
+					VoxelType* pChunkData = nullptr;
+					ChunkHandle handle(this, getChunk(x, y, z, true, false, &pChunkData));
+					funcChunkSpan(regChunk, regSpan, static_cast<const VoxelType*>(pChunkData));
+				}
+			}
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Taking a snapshot is cheap, as no data is copied until chunks are modified (see Snapshot for details). Each chunk which is
+	/// modified while a snapshot exists needs an extra copy of its data, which is not counted towards the volume's memory usage, so
+	/// snapshots should not be kept for longer than necessary. If other threads are writing to the volume then this waits for their
+	/// writes to the current chunks to finish, but a bulk write (such as fill()) which spans several chunks may be partly included.
+	/// \return A read-only view of the volume as it is now.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	typename PagedVolume<VoxelType>::Snapshot PagedVolume<VoxelType>::snapshot(void) const
+	{
+		std::lock_guard<std::mutex> creationLock(m_mutexSnapshotCreation);
+
+		std::shared_ptr<typename Snapshot::Data> pSnapshotData = std::make_shared<typename Snapshot::Data>();
+		uint32_t uPreviousGeneration = 0;
+		{
+			std::lock_guard<std::mutex> snapshotsLock(m_mutexSnapshots);
+			m_vecSnapshots.erase(std::remove_if(m_vecSnapshots.begin(), m_vecSnapshots.end(),
+				[](const std::weak_ptr<typename Snapshot::Data>& pData) { return pData.expired(); }), m_vecSnapshots.end());
+			m_vecSnapshots.push_back(pSnapshotData);
+
+			// Every chunk now has to give its data to the new snapshot before it is next modified.
+			uPreviousGeneration = m_uSnapshotGeneration++;
+		}
+
+		// Writes which started before this are not protected from the snapshot, so we wait for them. This is done without holding
+		// the lock above, as they may need it to give their chunk's data to an earlier snapshot.
+		while (m_arrayWritesInProgress[uPreviousGeneration & 1] > 0)
+		{
+			std::this_thread::yield();
+		}
+
+		return Snapshot(this, pSnapshotData);
+	}
+
 	////////////////////////////////////////////////////////////////////////////////
 	/// Note that if the memory usage limit is not large enough to support the region this function will only load part of the region. In this case it is undefined which parts will actually be loaded. If all the voxels in the given region are already loaded, this function will not do anything. Other voxels might be unloaded to make space for the new voxels.
+	///
+	/// If the volume has background paging threads then the chunks are paged in by them and this function returns immediately. Otherwise
+	/// they are paged in before it returns. In both cases the returned future becomes ready once the whole region has been processed,
+	/// and rethrows any exception which was thrown by the Pager. The chunks are passed to Pager::pageInBatch() several at a time, so
+	/// pagers which can read a number of chunks at once are able to do so.
 	/// \param regPrefetch The Region of voxels to prefetch into memory.
+	/// \return A future which can be used to wait for the prefetch to complete.
 	////////////////////////////////////////////////////////////////////////////////
 	template <typename VoxelType>
-	void PagedVolume<VoxelType>::prefetch(Region regPrefetch)
+	std::future<void> PagedVolume<VoxelType>::prefetch(Region regPrefetch)
 	{
 		// Convert the start and end positions into chunk space coordinates
 		Vector3DInt32 v3dStart;
@@ -195,168 +459,2794 @@ namespace PolyVox
 		// Ensure we don't page in more chunks than the volume can hold.
 		Region region(v3dStart, v3dEnd);
 		uint32_t uNoOfChunks = static_cast<uint32_t>(region.getWidthInVoxels() * region.getHeightInVoxels() * region.getDepthInVoxels());
-		POLYVOX_LOG_WARNING_IF(uNoOfChunks > m_uChunkCountLimit, "Attempting to prefetch more than the maximum number of chunks (this will cause thrashing).");
-		uNoOfChunks = (std::min)(uNoOfChunks, m_uChunkCountLimit);
+		POLYVOX_LOG_WARNING_IF(uNoOfChunks > m_uUncompressedChunkCountLimit, "Attempting to prefetch more than the maximum number of uncompressed chunks (this will cause thrashing).");
 
-		// Loops over the specified positions and touch the corresponding chunks.
+		// The chunks which are not yet resident are passed to Pager::pageInBatch() a batch at a time.
+		std::vector<Vector3DInt32> vecChunkPositions;
+		vecChunkPositions.reserve(uNoOfChunks);
 		for (int32_t x = v3dStart.getX(); x <= v3dEnd.getX(); x++)
 		{
 			for (int32_t y = v3dStart.getY(); y <= v3dEnd.getY(); y++)
 			{
 				for (int32_t z = v3dStart.getZ(); z <= v3dEnd.getZ(); z++)
 				{
-					getChunk(x, y, z);
+					vecChunkPositions.push_back(Vector3DInt32(x, y, z));
 				}
 			}
 		}
-	}
 
-	////////////////////////////////////////////////////////////////////////////////
-	/// Removes all voxels from memory, and calls dataOverflowHandler() to ensure the application has a chance to store the data.
-	////////////////////////////////////////////////////////////////////////////////
-	template <typename VoxelType>
-	void PagedVolume<VoxelType>::flushAll()
-	{
-		// Clear this pointer as all chunks are about to be removed.
-		m_pLastAccessedChunk = nullptr;
+		if (m_vecPagingThreads.empty())
+		{
+			for (size_t uBatchStart = 0; uBatchStart < vecChunkPositions.size(); uBatchStart += uMaxNoOfChunksPerPagingBatch)
+			{
+				const size_t uBatchEnd = (std::min)(uBatchStart + uMaxNoOfChunksPerPagingBatch, vecChunkPositions.size());
+				pageInChunks(std::vector<Vector3DInt32>(vecChunkPositions.begin() + uBatchStart, vecChunkPositions.begin() + uBatchEnd));
+			}
+
+			std::promise<void> promiseComplete;
+			promiseComplete.set_value();
+			return promiseComplete.get_future();
+		}
 
-		// Erase all the most recently used chunks.
-		for (uint32_t uIndex = 0; uIndex < uChunkArraySize; uIndex++)
+		// Otherwise queue up one job per batch, so that they are spread across the paging threads. The last job to
+		// finish fulfils the promise, unless one of them has already failed and stored its exception there instead.
+		struct PrefetchRequest
 		{
-			m_arrayChunks[uIndex] = nullptr;
+			std::promise<void> m_promiseComplete;
+			std::atomic<uint32_t> m_uNoOfBatchesRemaining;
+			std::atomic<bool> m_bFailed;
+		};
+
+		auto pRequest = std::make_shared<PrefetchRequest>();
+		pRequest->m_uNoOfBatchesRemaining = (uNoOfChunks + uMaxNoOfChunksPerPagingBatch - 1) / uMaxNoOfChunksPerPagingBatch;
+		pRequest->m_bFailed = false;
+		std::future<void> futureComplete = pRequest->m_promiseComplete.get_future();
+
+		{
+			std::lock_guard<std::mutex> pagingLock(m_mutexPaging);
+			for (size_t uBatchStart = 0; uBatchStart < vecChunkPositions.size(); uBatchStart += uMaxNoOfChunksPerPagingBatch)
+			{
+				const size_t uBatchEnd = (std::min)(uBatchStart + uMaxNoOfChunksPerPagingBatch, vecChunkPositions.size());
+				std::vector<Vector3DInt32> vecBatch(vecChunkPositions.begin() + uBatchStart, vecChunkPositions.begin() + uBatchEnd);
+				m_dequePagingJobs.push_back([this, pRequest, vecBatch]
+				{
+					try
+					{
+						pageInChunks(vecBatch);
+					}
+					catch (...)
+					{
+						if (!pRequest->m_bFailed.exchange(true))
+						{
+							pRequest->m_promiseComplete.set_exception(std::current_exception());
+						}
+					}
+
+					if ((--pRequest->m_uNoOfBatchesRemaining == 0) && (!pRequest->m_bFailed))
+					{
+						pRequest->m_promiseComplete.set_value();
+					}
+				});
+			}
 		}
-	}
+		m_conditionPagingWork.notify_all();
 
-	template <typename VoxelType>
-	bool PagedVolume<VoxelType>::canReuseLastAccessedChunk(int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const
-	{
-		return ((iChunkX == m_v3dLastAccessedChunkX) &&
-			(iChunkY == m_v3dLastAccessedChunkY) &&
-			(iChunkZ == m_v3dLastAccessedChunkZ) &&
-			(m_pLastAccessedChunk));
+		return futureComplete;
 	}
 
+	////////////////////////////////////////////////////////////////////////////////
+	/// This is intended to be called whenever the viewer moves. The chunks which overlap the spheres around the focus points are paged
+	/// in nearest first, but at most as many as can be held uncompressed, so that a large radius does not cause thrashing. Calling it again
+	/// cancels the chunks which have not been paged in yet (though the previous future still becomes ready).
+	///
+	/// The resident chunks are also put in order of distance from the focus points, so the furthest are evicted first and the chunks
+	/// which are paged in do not push out those near the focus points. Chunks used after this are treated as recently used as usual.
+	///
+	/// As with prefetch(), the chunks are paged in by the background paging threads if there are any and otherwise before this returns.
+	/// \param vecFocusPoints The positions (in voxels) around which the volume should be loaded.
+	/// \param uRadius The distance (in voxels) from the focus points within which chunks are needed.
+	/// \return A future which can be used to wait for the chunks to be paged in.
+	////////////////////////////////////////////////////////////////////////////////
 	template <typename VoxelType>
-	typename PagedVolume<VoxelType>::Chunk* PagedVolume<VoxelType>::getChunk(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ) const
+	std::future<void> PagedVolume<VoxelType>::setFocus(const std::vector<Vector3DInt32>& vecFocusPoints, uint32_t uRadius)
 	{
-		Chunk* pChunk = nullptr;
+		POLYVOX_THROW_IF(vecFocusPoints.empty(), std::invalid_argument, "At least one focus point must be given");
 
-		// We generate a 16-bit hash here and assume this matches the range available in the chunk
-		// array. The assert here is just to make sure we take care if change this in the future.
-		static_assert(uChunkArraySize == 65536, "Chunk array size has changed, check if the hash calculation needs updating.");
-		// Extract the lower five bits from each position component.
-		const uint32_t uChunkXLowerBits = static_cast<uint32_t>(uChunkX & 0x1F);
-		const uint32_t uChunkYLowerBits = static_cast<uint32_t>(uChunkY & 0x1F);
-		const uint32_t uChunkZLowerBits = static_cast<uint32_t>(uChunkZ & 0x1F);
-		// Combine then to form a 15-bit hash of the position. Also shift by one to spread the values out in the whole 16-bit space.
-		const uint32_t iPosisionHash = (((uChunkXLowerBits)) | ((uChunkYLowerBits) << 5) | ((uChunkZLowerBits) << 10) << 1);
-
-		// Starting at the position indicated by the hash, and then search through the whole array looking for a chunk with the correct
-		// position. In most cases we expect to find it in the first place we look. Note that this algorithm is slow in the case that
-		// the chunk is not found because the whole array has to be searched, but in this case we are going to have to page the data in
-		// from an external source which is likely to be slow anyway.
-		uint32_t iIndex = iPosisionHash;
-		do
-		{
-			if (m_arrayChunks[iIndex])
-			{
-				Vector3DInt32& entryPos = m_arrayChunks[iIndex]->m_v3dChunkSpacePosition;
-				if (entryPos.getX() == uChunkX && entryPos.getY() == uChunkY && entryPos.getZ() == uChunkZ)
-				{
-					pChunk = m_arrayChunks[iIndex].get();
-					pChunk->m_uChunkLastAccessed = ++m_uTimestamper;
-					break;
-				}
-			}
-
-			iIndex++;
-			iIndex %= uChunkArraySize;
-		} while (iIndex != iPosisionHash); // Keep searching until we get back to our start position.
+		const uint32_t uFocusGeneration = ++m_uFocusGeneration;
 
-		// If we still haven't found the chunk then it's time to create a new one and page it in from disk.
-		if (!pChunk)
+		std::vector<Vector3DInt32> vecChunks = findChunksInFocus(vecFocusPoints, uRadius);
+		if (vecChunks.size() > m_uUncompressedChunkCountLimit)
 		{
-			// The chunk was not found so we will create a new one.
-			Vector3DInt32 v3dChunkPos(uChunkX, uChunkY, uChunkZ);
-			pChunk = new PagedVolume<VoxelType>::Chunk(v3dChunkPos, m_uChunkSideLength, m_pPager);
-			pChunk->m_uChunkLastAccessed = ++m_uTimestamper; // Important, as we may soon delete the oldest chunk
+			POLYVOX_LOG_WARNING("The focus covers more than the maximum number of uncompressed chunks, so only the nearest ", m_uUncompressedChunkCountLimit.load(), " will be paged in.");
+			vecChunks.resize(m_uUncompressedChunkCountLimit);
+		}
+
+		// Ordering the chunks first means those which are paged in replace the ones furthest away.
+		orderChunksByFocusDistance(vecFocusPoints, uRadius, uFocusGeneration);
 
-			// Store the chunk at the appropriate place in out chunk array. Ideally this place is
-			// given by the hash, otherwise we do a linear search for the next available location
-			// We always expect to find a free place because we aim to keep the array only half full.
-			uint32_t iIndex = iPosisionHash;
-			bool bInsertedSucessfully = false;
-			do
+		if (m_vecPagingThreads.empty() || vecChunks.empty())
+		{
+			for (const Vector3DInt32& v3dChunkPos : vecChunks)
 			{
-				if (m_arrayChunks[iIndex] == nullptr)
+				// Another thread may have moved the focus on.
+				if (m_uFocusGeneration != uFocusGeneration)
 				{
-					m_arrayChunks[iIndex] = std::move(std::unique_ptr< Chunk >(pChunk));
-					bInsertedSucessfully = true;
 					break;
 				}
+				getChunk(v3dChunkPos.getX(), v3dChunkPos.getY(), v3dChunkPos.getZ());
+			}
+			orderChunksByFocusDistance(vecFocusPoints, uRadius, uFocusGeneration);
+
+			std::promise<void> promiseComplete;
+			promiseComplete.set_value();
+			return promiseComplete.get_future();
+		}
 
-				iIndex++;
-				iIndex %= uChunkArraySize;
-			} while (iIndex != iPosisionHash); // Keep searching until we get back to our start position.
+		// Otherwise queue up one job per chunk as prefetch() does. The paging threads take them from the front of the queue so the
+		// nearest are paged in first, and those which belong to an earlier request are skipped. Whichever job finishes last puts the
+		// new chunks in order.
+		struct FocusRequest
+		{
+			std::promise<void> m_promiseComplete;
+			std::atomic<uint32_t> m_uNoOfChunksRemaining;
+			std::atomic<bool> m_bFailed;
+			std::vector<Vector3DInt32> m_vecFocusPoints;
+		};
 
-			// This should never really happen unless we are failing to keep our number of active chunks
-			// significantly under the target amount. Perhaps if chunks are 'pinned' for threading purposes?
-			POLYVOX_THROW_IF(!bInsertedSucessfully, std::logic_error, "No space in chunk array for new chunk.");
+		auto pRequest = std::make_shared<FocusRequest>();
+		pRequest->m_uNoOfChunksRemaining = static_cast<uint32_t>(vecChunks.size());
+		pRequest->m_bFailed = false;
+		pRequest->m_vecFocusPoints = vecFocusPoints;
+		std::future<void> futureComplete = pRequest->m_promiseComplete.get_future();
 
-			// As we have added a chunk we may have exceeded our target chunk limit. Search through the array to
-			// determine how many chunks we have, as well as finding the oldest timestamp. Note that this is potentially
-			// wasteful and we may instead wish to track how many chunks we have and/or delete a chunk at random (or
-			// just check e.g. 10 and delete the oldest of those) but we'll see if this is a bottleneck first. Paging
-			// the data in is probably more expensive.
-			uint32_t uChunkCount = 0;
-			uint32_t uOldestChunkIndex = 0;
-			uint32_t uOldestChunkTimestamp = std::numeric_limits<uint32_t>::max();
-			for (uint32_t uIndex = 0; uIndex < uChunkArraySize; uIndex++)
+		{
+			std::lock_guard<std::mutex> pagingLock(m_mutexPaging);
+			for (const Vector3DInt32& v3dChunkPos : vecChunks)
 			{
-				if (m_arrayChunks[uIndex])
+				m_dequePagingJobs.push_back([this, pRequest, v3dChunkPos, uRadius, uFocusGeneration]
 				{
-					uChunkCount++;
-					if (m_arrayChunks[uIndex]->m_uChunkLastAccessed < uOldestChunkTimestamp)
+					try
 					{
-						uOldestChunkTimestamp = m_arrayChunks[uIndex]->m_uChunkLastAccessed;
-						uOldestChunkIndex = uIndex;
+						if (m_uFocusGeneration == uFocusGeneration)
+						{
+							getChunk(v3dChunkPos.getX(), v3dChunkPos.getY(), v3dChunkPos.getZ());
+						}
 					}
-				}
+					catch (...)
+					{
+						if (!pRequest->m_bFailed.exchange(true))
+						{
+							pRequest->m_promiseComplete.set_exception(std::current_exception());
+						}
+					}
+
+					if ((--pRequest->m_uNoOfChunksRemaining == 0) && (!pRequest->m_bFailed))
+					{
+						orderChunksByFocusDistance(pRequest->m_vecFocusPoints, uRadius, uFocusGeneration);
+						pRequest->m_promiseComplete.set_value();
+					}
+				});
+			}
+		}
+		m_conditionPagingWork.notify_all();
+
+		return futureComplete;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Removes all voxels from memory, and calls dataOverflowHandler() to ensure the application has a chance to store the data.
+	/// Chunks which are pinned (e.g. because a Sampler is currently using them) are left in memory.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::flushAll()
+	{
+		// The chunks are deleted (and hence paged out) after the lock has been released.
+		std::vector< std::unique_ptr<Chunk> > vecRemovedChunks;
+		{
+			std::unique_lock<std::mutex> listLock(m_mutexChunkList, std::defer_lock);
+			if (m_bConcurrentAccess)
+			{
+				listLock.lock();
 			}
 
-			// Check if we have too many chunks, and delete the oldest if so.
-			if (uChunkCount > m_uChunkCountLimit)
+			// Clear this pointer as all chunks are about to be removed.
+			m_pLastAccessedChunk = nullptr;
+
+			// Erase all the chunks. Walking the lists of resident chunks avoids visiting every slot of the array.
+			removeAllChunks(m_listCompactChunks, vecRemovedChunks);
+			removeAllChunks(m_listUncompressedChunks, vecRemovedChunks);
+
+			// Shrink any shards which were grown to hold many chunks, if they are now empty.
+			for (uint32_t ct = 0; ct < uNoOfChunkTableShards; ct++)
 			{
-				m_arrayChunks[uOldestChunkIndex] = nullptr;
+				ChunkTableShard& shard = m_arrayChunkTableShards[ct];
+				std::unique_lock<std::mutex> shardLock(shard.m_mutex, std::defer_lock);
+				if (m_bConcurrentAccess)
+				{
+					shardLock.lock();
+				}
+
+				if ((shard.m_uNoOfChunks == 0) && (shard.m_vecChunks.size() > uInitialChunkTableShardSize))
+				{
+					m_uChunkTableSizeInBytes -= (shard.m_vecChunks.size() - uInitialChunkTableShardSize) * sizeof(std::unique_ptr< Chunk >);
+					std::vector< std::unique_ptr< Chunk > >(uInitialChunkTableShardSize).swap(shard.m_vecChunks);
+				}
 			}
 		}
 
-		m_pLastAccessedChunk = pChunk;
-		m_v3dLastAccessedChunkX = uChunkX;
-		m_v3dLastAccessedChunkY = uChunkY;
-		m_v3dLastAccessedChunkZ = uChunkZ;
+		deleteRemovedChunks(vecRemovedChunks);
 
-		return pChunk;
+		// Make sure that all data has really been written before we return, as the user may be about to read it.
+		if (m_bConcurrentAccess)
+		{
+			waitForPendingPageOuts();
+		}
+
+		// Free the buffers of homogeneous chunks, unless they are still used by pinned chunks.
+		std::lock_guard<std::mutex> homogeneousDataLock(m_mutexHomogeneousData);
+		m_vecHomogeneousData.erase(std::remove_if(m_vecHomogeneousData.begin(), m_vecHomogeneousData.end(),
+			[](const std::shared_ptr<VoxelType>& pData) { return pData.use_count() == 1; }), m_vecHomogeneousData.end());
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
-	/// Calculate the memory usage of the volume.
+	/// Changes the amount of memory the volume aims to use. If the new target is lower than the current memory usage then chunks are
+	/// compressed or paged out straight away (before this function returns) until it is met, or until only pinned chunks remain.
+	/// \param uTargetMemoryUsageInBytes The upper limit to how much memory this PagedVolume should aim to use.
 	////////////////////////////////////////////////////////////////////////////////
 	template <typename VoxelType>
-	uint32_t PagedVolume<VoxelType>::calculateSizeInBytes(void)
+	void PagedVolume<VoxelType>::setTargetMemoryUsage(uint64_t uTargetMemoryUsageInBytes)
 	{
-		uint32_t uChunkCount = 0;
-		for (uint32_t uIndex = 0; uIndex < uChunkArraySize; uIndex++)
+		POLYVOX_THROW_IF(uTargetMemoryUsageInBytes < 1 * 1024 * 1024, std::invalid_argument, "Target memory usage is too small to be practical");
+
+		// The chunks are deleted (and hence paged out) after the lock has been released.
+		std::vector< std::unique_ptr<Chunk> > vecEvictedChunks;
 		{
-			if (m_arrayChunks[uIndex])
+			std::unique_lock<std::mutex> listLock(m_mutexChunkList, std::defer_lock);
+			if (m_bConcurrentAccess)
 			{
-				uChunkCount++;
+				listLock.lock();
 			}
+
+			applyTargetMemoryUsage(uTargetMemoryUsageInBytes);
+			m_pChunkBufferPool->setMaxNoOfBuffers(m_uUncompressedChunkCountLimit + static_cast<uint32_t>(m_vecPagingThreads.size()) + 1);
+			enforceMemoryLimit(vecEvictedChunks);
 		}
 
-		// Note: We disregard the size of the other class members as they are likely to be very small compared to the size of the
-		// allocated voxel data. This also keeps the reported size as a power of two, which makes other memory calculations easier.
-		return PagedVolume<VoxelType>::Chunk::calculateSizeInBytes(m_uChunkSideLength) * uChunkCount;
+		deleteRemovedChunks(vecEvictedChunks);
 	}
-}
 
+	////////////////////////////////////////////////////////////////////////////////
+	/// Unlike flushAll(), this keeps the chunks in memory so the working set is not lost. Their data is passed to Pager::pageOutBatch()
+	/// and they are marked as unmodified, so they will not be paged out again when evicted unless they are modified in the meantime.
+	/// If other threads write to a chunk while it is being written then the pager may see a mix of old and new values, but the chunk
+	/// stays marked as modified and so the new values will be written later. Compressed chunks are written from a temporary copy of
+	/// their data, so they stay compressed and keep their place in the list of least recently used chunks.
+	/// \param regFlush The voxels to write back. Whole chunks are written, so this may include voxels outside of the region.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::flushDirty(const Region& regFlush)
+	{
+		Vector3DInt32 v3dStart;
+		Vector3DInt32 v3dEnd;
+		for (int i = 0; i < 3; i++)
+		{
+			v3dStart.setElement(i, regFlush.getLowerCorner().getElement(i) >> m_uChunkSideLengthPower);
+			v3dEnd.setElement(i, regFlush.getUpperCorner().getElement(i) >> m_uChunkSideLengthPower);
+		}
+
+		const Region regChunks(v3dStart, v3dEnd);
+		writeBackModifiedChunks(&regChunks, 0);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Writes all modified chunks back to the pager while keeping them in memory (see flushDirty()). This is intended to be called
+	/// periodically to save the volume, and can be spread over several calls by giving it a time budget. In this case it returns
+	/// false if it stopped before everything had been written, and the next call carries on with the remaining chunks.
+	/// \param uTimeBudgetInMilliseconds Approximately how long to spend writing chunks, or zero to write them all.
+	/// \return Whether all modified chunks have been written.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::checkpoint(uint32_t uTimeBudgetInMilliseconds)
+	{
+		if (!writeBackModifiedChunks(nullptr, uTimeBudgetInMilliseconds))
+		{
+			return false;
+		}
+
+		// Chunks which were evicted before the checkpoint may still be waiting to be paged out in the background.
+		if (m_bConcurrentAccess)
+		{
+			waitForPendingPageOuts();
+		}
+		return true;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Chunk buffers are normally allocated as chunks are paged in, and then recycled as chunks are compressed or paged out. This
+	/// allocates them all up front instead, which avoids allocation during paging and means a failure to get the memory happens
+	/// straight away. The buffers are not included in calculateSizeInBytes() until they are used by chunks.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::preallocateChunkBuffers(void)
+	{
+		m_pChunkBufferPool->reserve(m_uUncompressedChunkCountLimit);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// The chunk stays in memory (and so any pointers into its data remain valid) until the last copy of the returned handle has been
+	/// destroyed or reset. Pinned chunks are not counted against the target memory usage, so pinning too many will cause it to be exceeded.
+	/// \param v3dPos The position of any voxel in the chunk.
+	/// \return A handle which keeps the chunk pinned.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	typename PagedVolume<VoxelType>::ChunkHandle PagedVolume<VoxelType>::pinChunk(const Vector3DInt32& v3dPos)
+	{
+		const int32_t chunkX = v3dPos.getX() >> m_uChunkSideLengthPower;
+		const int32_t chunkY = v3dPos.getY() >> m_uChunkSideLengthPower;
+		const int32_t chunkZ = v3dPos.getZ() >> m_uChunkSideLengthPower;
+
+		return ChunkHandle(this, getChunk(chunkX, chunkY, chunkZ, true));
+	}
+
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::canReuseLastAccessedChunk(int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const
+	{
+		if ((iChunkX == m_v3dLastAccessedChunkX) &&
+			(iChunkY == m_v3dLastAccessedChunkY) &&
+			(iChunkZ == m_v3dLastAccessedChunkZ) &&
+			(m_pLastAccessedChunk))
+		{
+#ifdef POLYVOX_LOOKUP_STATISTICS_ENABLED
+			m_uNoOfLastChunkCacheHits++;
+#endif
+			return true;
+		}
+		return false;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Finds the requested chunk, paging it in if it is not already in memory. If concurrent access is enabled the returned pointer is
+	/// only guaranteed to stay valid if the chunk was pinned, in which case it must be released with unpinChunk() when no longer needed.
+	/// If bForWrite is set then the chunk is made writable (see makeChunkWritable()), so that a pinned chunk can be modified. The
+	/// chunk's data pointer can also be returned through ppChunkData, as in concurrent mode it cannot otherwise be read safely.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	typename PagedVolume<VoxelType>::Chunk* PagedVolume<VoxelType>::getChunk(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ, bool bPinChunk, bool bForWrite, VoxelType** ppChunkData) const
+	{
+		const uint32_t uPositionHash = hashChunkPosition(uChunkX, uChunkY, uChunkZ);
+		ChunkTableShard& shard = m_arrayChunkTableShards[uPositionHash % uNoOfChunkTableShards];
+
+		Chunk* pChunk = nullptr;
+		bool bDecompressChunk = false;
+		while (!pChunk)
+		{
+			{
+				std::unique_lock<std::mutex> shardLock(shard.m_mutex, std::defer_lock);
+				if (m_bConcurrentAccess)
+				{
+					shardLock.lock();
+				}
+
+				pChunk = findChunkInShard(shard, uPositionHash, uChunkX, uChunkY, uChunkZ);
+				if (pChunk)
+				{
+					// A compressed chunk has to be decompressed before it can be used, and it is pinned
+					// while we do this so that it cannot be evicted once we have released the shard lock.
+					bDecompressChunk = bForWrite ? !isChunkWritable(pChunk) : pChunk->isCompressed();
+					if (bPinChunk || bDecompressChunk)
+					{
+						pChunk->m_uPinCount++;
+					}
+					if (ppChunkData)
+					{
+						*ppChunkData = pChunk->m_tData;
+					}
+					touchChunk(pChunk);
+					break;
+				}
+			}
+
+			// If we still haven't found the chunk then it's time to create a new one and page it in from disk. This is done
+			// without holding any locks because paging in the data may be slow, and there is no reason for other threads to wait
+			// for it. In concurrent mode we first check whether another thread is already paging it in (in which case we wait for
+			// it and then look again) or whether it is still waiting to be paged out (in which case we can just take it back).
+			Vector3DInt32 v3dChunkPos(uChunkX, uChunkY, uChunkZ);
+			std::unique_ptr<Chunk> pNewChunk;
+			if (m_bConcurrentAccess)
+			{
+				bool bRetryLookup = false;
+				pNewChunk = beginPageIn(v3dChunkPos, bRetryLookup);
+				if (bRetryLookup)
+				{
+					continue;
+				}
+			}
+
+			try
+			{
+				if (!pNewChunk)
+				{
+					pNewChunk.reset(new PagedVolume<VoxelType>::Chunk(v3dChunkPos, m_uChunkSideLength, m_pPager, m_pChunkBufferPool.get(), &m_pagerCallCounters));
+				}
+				else if (pNewChunk->isCompressed())
+				{
+					// We took it back from the write-behind queue, and new chunks always start off uncompressed.
+					pNewChunk->decompress();
+				}
+
+				// Chunks which are completely empty or solid are common, and there is no need for them to have their own data.
+				if (!pNewChunk->isCompact())
+				{
+					tryMakeHomogeneous(pNewChunk.get());
+				}
+			}
+			catch (...)
+			{
+				if (m_bConcurrentAccess)
+				{
+					endPageIn(v3dChunkPos);
+				}
+				throw;
+			}
+
+			// If another thread has paged in the same chunk meanwhile then we use theirs, and if the page in turned out to be
+			// stale then we start again.
+			pChunk = addPagedInChunk(std::move(pNewChunk), bPinChunk, bForWrite, ppChunkData, bDecompressChunk);
+		}
+
+		if (bDecompressChunk)
+		{
+			// Another thread may give a snapshot the data as soon as it has been decompressed, so it is read under the shard lock.
+			if (bForWrite)
+			{
+				makeChunkWritable(pChunk);
+			}
+			else
+			{
+				decompressChunk(pChunk);
+			}
+			if (ppChunkData)
+			{
+				*ppChunkData = getPinnedChunkData(pChunk);
+			}
+			if (!bPinChunk)
+			{
+				unpinChunk(pChunk);
+			}
+		}
+
+		if (!m_bConcurrentAccess)
+		{
+			m_pLastAccessedChunk = pChunk;
+			m_v3dLastAccessedChunkX = uChunkX;
+			m_v3dLastAccessedChunkY = uChunkY;
+			m_v3dLastAccessedChunkZ = uChunkZ;
+		}
+
+		return pChunk;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Adds a chunk which has just been paged in to the chunk table, and ends the page in (see beginPageIn()). If another thread
+	/// has added the same chunk meanwhile then theirs is returned and the new one is discarded, and if the page in turned out to
+	/// be stale then null is returned so that the caller can start again. The returned chunk is pinned (and bDecompressChunk is set)
+	/// as in getChunk(), which carries on from here.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	typename PagedVolume<VoxelType>::Chunk* PagedVolume<VoxelType>::addPagedInChunk(std::unique_ptr<Chunk> pNewChunk, bool bPinChunk, bool bForWrite, VoxelType** ppChunkData, bool& bDecompressChunk) const
+	{
+		const Vector3DInt32 v3dChunkPos = pNewChunk->m_v3dChunkSpacePosition;
+		const int32_t uChunkX = v3dChunkPos.getX();
+		const int32_t uChunkY = v3dChunkPos.getY();
+		const int32_t uChunkZ = v3dChunkPos.getZ();
+		const uint32_t uPositionHash = hashChunkPosition(uChunkX, uChunkY, uChunkZ);
+		ChunkTableShard& shard = m_arrayChunkTableShards[uPositionHash % uNoOfChunkTableShards];
+
+		Chunk* pChunk = nullptr;
+		bool bPageInIsStale = false;
+
+		// The chunks are deleted (and hence paged out) after the lock has been released.
+		std::vector< std::unique_ptr<Chunk> > vecEvictedChunks;
+		{
+			// The new chunk is linked into the lists at the same time as it is added to the chunk table, as otherwise another
+			// thread could find it and try to move it between the lists before it is in one.
+			std::unique_lock<std::mutex> listLock(m_mutexChunkList, std::defer_lock);
+			if (m_bConcurrentAccess)
+			{
+				listLock.lock();
+			}
+
+			{
+				std::unique_lock<std::mutex> shardLock(shard.m_mutex, std::defer_lock);
+				if (m_bConcurrentAccess)
+				{
+					shardLock.lock();
+
+					// Another thread may have paged in the same chunk between our lookup and the call to beginPageIn(). In this
+					// case we use theirs and discard ours, which has just been paged in and so has not been modified. If theirs
+					// has already been paged out again then ours may be out of date, so we discard it and start again.
+					pChunk = findChunkInShard(shard, uPositionHash, uChunkX, uChunkY, uChunkZ);
+					bPageInIsStale = !pChunk && isPageInStale(v3dChunkPos);
+				}
+
+				if (pChunk)
+				{
+					touchChunk(pChunk);
+				}
+				else if (!bPageInIsStale)
+				{
+					// The new chunk is the most recently used one. If it has been modified before then it takes back its version.
+					pChunk = pNewChunk.release();
+					insertChunkInShard(shard, uPositionHash, pChunk);
+					pChunk->m_uVersion = (std::max)(pChunk->m_uVersion.load(), getPagedOutChunkVersion(shard, uChunkX, uChunkY, uChunkZ, true));
+					linkChunkAtHead(getChunkList(pChunk), pChunk);
+					m_uChunkCount++;
+					if (pChunk->isCompact())
+					{
+						m_uCompactDataSizeInBytes += pChunk->calculateSizeInBytes();
+					}
+					else
+					{
+						m_uNoOfUncompressedChunks++;
+					}
+				}
+
+				// The chunk which another thread paged in may have been compressed since, and a new chunk may be homogeneous.
+				if (pChunk)
+				{
+					bDecompressChunk = bForWrite ? !isChunkWritable(pChunk) : pChunk->isCompressed();
+					if (bPinChunk || bDecompressChunk)
+					{
+						pChunk->m_uPinCount++;
+					}
+					if (ppChunkData)
+					{
+						*ppChunkData = pChunk->m_tData;
+					}
+				}
+			}
+
+			// Adding a chunk may take us over our memory limit, in which case the least recently used chunks are found at the
+			// tail of the lists and compressed or discarded. A homogeneous chunk goes straight on to the compact list, where it
+			// could be the first to be discarded.
+			if (pChunk && !pNewChunk)
+			{
+				pChunk->m_uPinCount++;
+				enforceMemoryLimit(vecEvictedChunks);
+				pChunk->m_uPinCount--;
+			}
+		}
+
+		if (m_bConcurrentAccess)
+		{
+			endPageIn(v3dChunkPos);
+		}
+
+		deleteRemovedChunks(vecEvictedChunks);
+
+		return pChunk;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Makes sure the given chunks are resident, passing those which need to be paged in to the Pager in a single call to
+	/// Pager::pageInBatch(). Chunks which are already resident, or which another thread is paging in or out, are instead
+	/// found with getChunk() afterwards. Waiting for the other thread while holding on to our own batch could deadlock.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::pageInChunks(const std::vector<Vector3DInt32>& vecChunkPositions) const
+	{
+		std::vector<Vector3DInt32> vecOtherChunkPositions;
+		std::vector< std::unique_ptr<Chunk> > vecNewChunks;
+		for (const Vector3DInt32& v3dChunkPos : vecChunkPositions)
+		{
+			const uint32_t uPositionHash = hashChunkPosition(v3dChunkPos.getX(), v3dChunkPos.getY(), v3dChunkPos.getZ());
+			ChunkTableShard& shard = m_arrayChunkTableShards[uPositionHash % uNoOfChunkTableShards];
+			{
+				std::unique_lock<std::mutex> shardLock(shard.m_mutex, std::defer_lock);
+				if (m_bConcurrentAccess)
+				{
+					shardLock.lock();
+				}
+
+				if (findChunkInShard(shard, uPositionHash, v3dChunkPos.getX(), v3dChunkPos.getY(), v3dChunkPos.getZ()))
+				{
+					vecOtherChunkPositions.push_back(v3dChunkPos);
+					continue;
+				}
+			}
+
+			// The chunk is created before the page in is started, so that nothing needs to be undone if that throws.
+			std::unique_ptr<Chunk> pNewChunk(new PagedVolume<VoxelType>::Chunk(v3dChunkPos, m_uChunkSideLength, m_pPager, m_pChunkBufferPool.get(), &m_pagerCallCounters, false));
+			if (m_bConcurrentAccess && !tryBeginPageIn(v3dChunkPos))
+			{
+				vecOtherChunkPositions.push_back(v3dChunkPos);
+				continue;
+			}
+			vecNewChunks.push_back(std::move(pNewChunk));
+		}
+
+		try
+		{
+			if (!vecNewChunks.empty())
+			{
+				std::vector<typename Pager::PageRequest> vecRequests;
+				vecRequests.reserve(vecNewChunks.size());
+				for (auto& pNewChunk : vecNewChunks)
+				{
+					vecRequests.push_back(std::make_pair(pNewChunk->getRegion(), pNewChunk.get()));
+				}
+
+				// The time taken is shared between the chunks, so the statistics are comparable with those of single page ins.
+				const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				m_pPager->pageInBatch(vecRequests);
+				const std::chrono::steady_clock::duration durationPerChunk = (std::chrono::steady_clock::now() - start) / static_cast<int32_t>(vecNewChunks.size());
+
+				for (auto& pNewChunk : vecNewChunks)
+				{
+					m_pagerCallCounters.recordPageIn(durationPerChunk);
+
+					// As in the Chunk constructor, the data which the Pager wrote does not count as a modification.
+					pNewChunk->m_bDataModified = false;
+					tryMakeHomogeneous(pNewChunk.get());
+				}
+			}
+
+			for (auto& pNewChunk : vecNewChunks)
+			{
+				// If the page in was stale the chunk is paged in again by getChunk(), which then waits for any page out.
+				const Vector3DInt32 v3dChunkPos = pNewChunk->m_v3dChunkSpacePosition;
+				bool bDecompressChunk = false;
+				Chunk* pChunk = addPagedInChunk(std::move(pNewChunk), false, false, nullptr, bDecompressChunk);
+				if (!pChunk)
+				{
+					vecOtherChunkPositions.push_back(v3dChunkPos);
+				}
+				else if (bDecompressChunk)
+				{
+					// Another thread's copy of the chunk was found and has been compressed since, so it is treated as getChunk() would.
+					decompressChunk(pChunk);
+					unpinChunk(pChunk);
+				}
+			}
+		}
+		catch (...)
+		{
+			// Chunks which have been passed to addPagedInChunk() have already ended their page ins, and left null pointers behind.
+			if (m_bConcurrentAccess)
+			{
+				for (auto& pNewChunk : vecNewChunks)
+				{
+					if (pNewChunk)
+					{
+						endPageIn(pNewChunk->m_v3dChunkSpacePosition);
+					}
+				}
+			}
+			throw;
+		}
+
+		for (const Vector3DInt32& v3dChunkPos : vecOtherChunkPositions)
+		{
+			getChunk(v3dChunkPos.getX(), v3dChunkPos.getY(), v3dChunkPos.getZ());
+		}
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::unpinChunk(Chunk* pChunk) const
+	{
+		POLYVOX_ASSERT(pChunk->m_uPinCount > 0, "Attempting to unpin a chunk which is not pinned");
+		pChunk->m_uPinCount--;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Gives a chunk the current version after it has been modified, and tells the change listener if this is a new version. This
+	/// must be called after the voxels have been written, so that anyone who sees the old version is sure to have missed the write.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::updateChunkVersion(Chunk* pChunk)
+	{
+		// Most writes are to chunks which already have the current version. Otherwise another thread may be updating the same
+		// chunk, and we must not wind the version back if it has already seen a later one.
+		const uint64_t uCurrentVersion = m_uCurrentVersion;
+		uint64_t uChunkVersion = pChunk->m_uVersion.load(std::memory_order_relaxed);
+		while (uChunkVersion < uCurrentVersion)
+		{
+			if (pChunk->m_uVersion.compare_exchange_weak(uChunkVersion, uCurrentVersion))
+			{
+				if (m_funcChangeListener)
+				{
+					// The next modification of this chunk must be reported too, so it has to be given a new version. This is done
+					// before calling the listener so that changes made while it runs are not missed. Another thread may get there first.
+					uint64_t uExpectedVersion = uCurrentVersion;
+					m_uCurrentVersion.compare_exchange_strong(uExpectedVersion, uCurrentVersion + 1);
+
+					Vector3DInt32 v3dLower = pChunk->m_v3dChunkSpacePosition * static_cast<int32_t>(m_uChunkSideLength);
+					Vector3DInt32 v3dUpper = v3dLower + Vector3DInt32(m_uChunkSideLength - 1, m_uChunkSideLength - 1, m_uChunkSideLength - 1);
+					Region regChanged(v3dLower, v3dUpper);
+					Region regAffected(regChanged);
+					regAffected.grow(1);
+					m_funcChangeListener(regChanged, regAffected);
+				}
+				return;
+			}
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Reads the data pointer of a pinned chunk. In concurrent mode another thread may be giving the chunk its own data, so the
+	/// shard must be locked while doing so.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	VoxelType* PagedVolume<VoxelType>::getPinnedChunkData(Chunk* pChunk) const
+	{
+		POLYVOX_ASSERT(pChunk->m_uPinCount > 0, "Chunk must be pinned to read its data pointer");
+
+		ChunkTableShard& shard = m_arrayChunkTableShards[pChunk->m_uChunkTableShard];
+		std::unique_lock<std::mutex> shardLock(shard.m_mutex, std::defer_lock);
+		if (m_bConcurrentAccess)
+		{
+			shardLock.lock();
+		}
+		return pChunk->m_tData;
+	}
+
+	template <typename VoxelType>
+	uint64_t PagedVolume<VoxelType>::packChunkPosition(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ)
+	{
+		// 21 bits for each coordinate is plenty for chunk positions.
+		return (static_cast<uint64_t>(static_cast<uint32_t>(uChunkX) & 0x1FFFFF)) |
+			(static_cast<uint64_t>(static_cast<uint32_t>(uChunkY) & 0x1FFFFF) << 21) |
+			(static_cast<uint64_t>(static_cast<uint32_t>(uChunkZ) & 0x1FFFFF) << 42);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Keeps the version of a chunk which is being removed from the shard (see ChunkTableShard::m_mapPagedOutChunkVersions). If the
+	/// shard then holds too many versions they are collapsed into its floor. The shard must be locked if concurrent access is enabled.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::rememberPagedOutChunkVersion(ChunkTableShard& shard, const Vector3DInt32& v3dChunkPos, uint64_t uVersion) const
+	{
+		// This includes unmodified chunks, whose version is zero.
+		if (uVersion <= shard.m_uPagedOutChunkVersionFloor)
+		{
+			return;
+		}
+
+		auto result = shard.m_mapPagedOutChunkVersions.emplace(packChunkPosition(v3dChunkPos.getX(), v3dChunkPos.getY(), v3dChunkPos.getZ()), uVersion);
+		if (!result.second)
+		{
+			result.first->second = uVersion;
+			return;
+		}
+		m_uChunkTableSizeInBytes += uPagedOutChunkVersionSizeInBytes;
+
+		if (shard.m_mapPagedOutChunkVersions.size() > uMaxNoOfPagedOutChunkVersionsPerShard)
+		{
+			for (const auto& version : shard.m_mapPagedOutChunkVersions)
+			{
+				shard.m_uPagedOutChunkVersionFloor = (std::max)(shard.m_uPagedOutChunkVersionFloor, version.second);
+			}
+			m_uChunkTableSizeInBytes -= shard.m_mapPagedOutChunkVersions.size() * uPagedOutChunkVersionSizeInBytes;
+			std::unordered_map<uint64_t, uint64_t>().swap(shard.m_mapPagedOutChunkVersions);
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Gets the version of a chunk which is not resident, which is its own version if it is still known and otherwise the floor of the
+	/// shard. If bForget is set (because the chunk is being paged in, and so takes the version back) its entry is removed. The shard
+	/// must be locked if concurrent access is enabled.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	uint64_t PagedVolume<VoxelType>::getPagedOutChunkVersion(ChunkTableShard& shard, int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ, bool bForget) const
+	{
+		auto iterVersion = shard.m_mapPagedOutChunkVersions.find(packChunkPosition(uChunkX, uChunkY, uChunkZ));
+		if (iterVersion == shard.m_mapPagedOutChunkVersions.end())
+		{
+			return shard.m_uPagedOutChunkVersionFloor;
+		}
+
+		const uint64_t uVersion = iterVersion->second;
+		if (bForget)
+		{
+			shard.m_mapPagedOutChunkVersions.erase(iterVersion);
+			m_uChunkTableSizeInBytes -= uPagedOutChunkVersionSizeInBytes;
+		}
+		return uVersion;
+	}
+
+	template <typename VoxelType>
+	uint32_t PagedVolume<VoxelType>::hashChunkPosition(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ)
+	{
+		// The packed coordinates are thoroughly mixed with the 64-bit finaliser from MurmurHash3. Every bit of the result depends on
+		// every input bit, so both the low bits (which pick the shard) and the higher bits (which pick the slot) are well distributed
+		// even for the regular patterns found in a volume.
+		uint64_t uKey = packChunkPosition(uChunkX, uChunkY, uChunkZ);
+		uKey ^= uKey >> 33;
+		uKey *= 0xff51afd7ed558ccdULL;
+		uKey ^= uKey >> 33;
+		uKey *= 0xc4ceb9fe1a85ec53ULL;
+		uKey ^= uKey >> 33;
+		return static_cast<uint32_t>(uKey);
+	}
+
+	template <typename VoxelType>
+	uint32_t PagedVolume<VoxelType>::getHomeSlot(const ChunkTableShard& shard, uint32_t uPositionHash)
+	{
+		return (uPositionHash / uNoOfChunkTableShards) & (static_cast<uint32_t>(shard.m_vecChunks.size()) - 1);
+	}
+
+	template <typename VoxelType>
+	typename PagedVolume<VoxelType>::Chunk* PagedVolume<VoxelType>::findChunkInShard(const ChunkTableShard& shard, uint32_t uPositionHash, int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ) const
+	{
+		// Start at the position indicated by the hash and search forwards. The shard is never more than half full and
+		// entries are never separated from their home slot by a gap, so if we reach an empty slot the chunk is not present.
+		const uint32_t uMask = static_cast<uint32_t>(shard.m_vecChunks.size()) - 1;
+#ifdef POLYVOX_LOOKUP_STATISTICS_ENABLED
+		shard.m_uNoOfLookups++;
+#endif
+		for (uint32_t uIndex = getHomeSlot(shard, uPositionHash); shard.m_vecChunks[uIndex]; uIndex = (uIndex + 1) & uMask)
+		{
+#ifdef POLYVOX_LOOKUP_STATISTICS_ENABLED
+			shard.m_uNoOfProbes++;
+#endif
+			const Vector3DInt32& entryPos = shard.m_vecChunks[uIndex]->m_v3dChunkSpacePosition;
+			if (entryPos.getX() == uChunkX && entryPos.getY() == uChunkY && entryPos.getZ() == uChunkZ)
+			{
+				return shard.m_vecChunks[uIndex].get();
+			}
+		}
+
+#ifdef POLYVOX_LOOKUP_STATISTICS_ENABLED
+		// Reaching the empty slot counts as a probe too.
+		shard.m_uNoOfProbes++;
+#endif
+		return nullptr;
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::insertChunkInShard(ChunkTableShard& shard, uint32_t uPositionHash, Chunk* pChunk) const
+	{
+		// Take ownership straight away, so the chunk is not leaked if growing the shard fails.
+		std::unique_ptr< Chunk > pOwnedChunk(pChunk);
+
+		if ((shard.m_uNoOfChunks + 1) * 2 > shard.m_vecChunks.size())
+		{
+			growShard(shard);
+		}
+
+		// Store the chunk in the first free slot at or after the one given by the hash.
+		const uint32_t uMask = static_cast<uint32_t>(shard.m_vecChunks.size()) - 1;
+		uint32_t uIndex = getHomeSlot(shard, uPositionHash);
+		while (shard.m_vecChunks[uIndex])
+		{
+			uIndex = (uIndex + 1) & uMask;
+		}
+
+		shard.m_vecChunks[uIndex] = std::move(pOwnedChunk);
+		shard.m_uNoOfChunks++;
+		pChunk->m_uChunkTableShard = uPositionHash % uNoOfChunkTableShards;
+		pChunk->m_uChunkArrayIndex = uIndex;
+	}
+
+	template <typename VoxelType>
+	std::unique_ptr<typename PagedVolume<VoxelType>::Chunk> PagedVolume<VoxelType>::removeChunkFromShard(ChunkTableShard& shard, Chunk* pChunk) const
+	{
+		const uint32_t uMask = static_cast<uint32_t>(shard.m_vecChunks.size()) - 1;
+		uint32_t uGap = pChunk->m_uChunkArrayIndex;
+		std::unique_ptr< Chunk > pRemovedChunk = std::move(shard.m_vecChunks[uGap]);
+		shard.m_uNoOfChunks--;
+
+		// Move later entries in the same run back to fill the gap, as otherwise a search could stop there before reaching them. An entry
+		// can be moved as long as this does not take it before its home slot, i.e. it is at least as far from home as from the gap.
+		for (uint32_t uIndex = (uGap + 1) & uMask; shard.m_vecChunks[uIndex]; uIndex = (uIndex + 1) & uMask)
+		{
+			const Vector3DInt32& entryPos = shard.m_vecChunks[uIndex]->m_v3dChunkSpacePosition;
+			const uint32_t uHomeSlot = getHomeSlot(shard, hashChunkPosition(entryPos.getX(), entryPos.getY(), entryPos.getZ()));
+			if (((uIndex - uHomeSlot) & uMask) >= ((uIndex - uGap) & uMask))
+			{
+				shard.m_vecChunks[uGap] = std::move(shard.m_vecChunks[uIndex]);
+				shard.m_vecChunks[uGap]->m_uChunkArrayIndex = uGap;
+				uGap = uIndex;
+			}
+		}
+
+		return pRemovedChunk;
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::growShard(ChunkTableShard& shard) const
+	{
+		std::vector< std::unique_ptr< Chunk > > vecOldChunks(shard.m_vecChunks.size() * 2);
+		vecOldChunks.swap(shard.m_vecChunks);
+		m_uChunkTableSizeInBytes += vecOldChunks.size() * sizeof(std::unique_ptr< Chunk >);
+
+		const uint32_t uMask = static_cast<uint32_t>(shard.m_vecChunks.size()) - 1;
+		for (auto& pChunk : vecOldChunks)
+		{
+			if (pChunk)
+			{
+				const Vector3DInt32& pos = pChunk->m_v3dChunkSpacePosition;
+				uint32_t uIndex = getHomeSlot(shard, hashChunkPosition(pos.getX(), pos.getY(), pos.getZ()));
+				while (shard.m_vecChunks[uIndex])
+				{
+					uIndex = (uIndex + 1) & uMask;
+				}
+
+				pChunk->m_uChunkArrayIndex = uIndex;
+				shard.m_vecChunks[uIndex] = std::move(pChunk);
+			}
+		}
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::markChunkRecentlyUsed(Chunk* pChunk)
+	{
+		// Checking first avoids writing to a cache line which other threads are probably reading.
+		if (!pChunk->m_bRecentlyUsed.load(std::memory_order_relaxed))
+		{
+			pChunk->m_bRecentlyUsed.store(true, std::memory_order_relaxed);
+		}
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::touchChunk(Chunk* pChunk) const
+	{
+		if (m_bConcurrentAccess)
+		{
+			// Reordering the list would need a lock, so just mark the chunk and let releaseLeastRecentlyUsedChunk() take care of it.
+			markChunkRecentlyUsed(pChunk);
+		}
+		else
+		{
+			// Move the chunk to the head of its list as it is now the most recently used.
+			ChunkList& list = getChunkList(pChunk);
+			if (pChunk != list.m_pMostRecentlyUsedChunk)
+			{
+				unlinkChunk(list, pChunk);
+				linkChunkAtHead(list, pChunk);
+			}
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Calculate the memory usage of the volume. This includes the chunk objects and the chunk table as well as the voxel data. Free
+	/// buffers held for reuse by future chunks (see preallocateChunkBuffers()) are not included.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	uint64_t PagedVolume<VoxelType>::calculateSizeInBytes(void)
+	{
+		std::unique_lock<std::mutex> listLock(m_mutexChunkList, std::defer_lock);
+		if (m_bConcurrentAccess)
+		{
+			listLock.lock();
+		}
+
+		return calculateMemoryUsageInBytes();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// The counters are always enabled, as keeping them up to date costs very little. Most are only updated while a lock which is needed
+	/// anyway is held, and the rest use relaxed atomic increments. Calling this with bResetCounters set allows the statistics to be
+	/// gathered over fixed intervals (e.g. once per second, or once per frame). See PagingStatistics for what each counter means.
+	/// \param bResetCounters Whether to set the counters back to zero after reading them.
+	/// \return The counters.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	PagingStatistics PagedVolume<VoxelType>::getPagingStatistics(bool bResetCounters)
+	{
+		PagingStatistics statistics;
+		m_pagerCallCounters.getStatistics(statistics, bResetCounters);
+		statistics.m_uNoOfDirtyWriteBacks = bResetCounters ? m_uNoOfDirtyWriteBacks.exchange(0, std::memory_order_relaxed) : m_uNoOfDirtyWriteBacks.load(std::memory_order_relaxed);
+
+		std::unique_lock<std::mutex> listLock(m_mutexChunkList, std::defer_lock);
+		if (m_bConcurrentAccess)
+		{
+			listLock.lock();
+		}
+
+		statistics.m_uNoOfLastChunkCacheHits = m_uNoOfLastChunkCacheHits;
+		statistics.m_uNoOfCompressions = m_uNoOfCompressions;
+		statistics.m_uNoOfEvictions = m_uNoOfEvictions;
+		if (bResetCounters)
+		{
+			m_uNoOfLastChunkCacheHits = 0;
+			m_uNoOfCompressions = 0;
+			m_uNoOfEvictions = 0;
+		}
+
+		for (ChunkTableShard& shard : m_arrayChunkTableShards)
+		{
+			std::unique_lock<std::mutex> shardLock(shard.m_mutex, std::defer_lock);
+			if (m_bConcurrentAccess)
+			{
+				shardLock.lock();
+			}
+
+			statistics.m_uNoOfChunkTableLookups += shard.m_uNoOfLookups;
+			statistics.m_uNoOfChunkTableProbes += shard.m_uNoOfProbes;
+			if (bResetCounters)
+			{
+				shard.m_uNoOfLookups = 0;
+				shard.m_uNoOfProbes = 0;
+			}
+		}
+
+		return statistics;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Each chunk keeps track of the smallest and largest values of its voxels, which lets algorithms skip parts of the volume that
+	/// cannot contain what they are looking for without reading any voxels. For example, the surface extractors use this to return
+	/// straight away if every voxel in the region is on the same side of the threshold (such as in empty or completely solid regions).
+	/// The bounds cover the whole of each chunk which overlaps the region, so they can be wider than the values which are actually in
+	/// the region. The bounds of a chunk are calculated (by reading it) the first time they are asked for after it has been paged in
+	/// or modified, unless it has been compressed since. Chunks which are not resident are paged in, as a caller who needs the bounds
+	/// is usually about to read the voxels anyway.
+	/// Only arithmetic voxel types are summarised like this, and the bounds are also unknown if the region contains a NaN.
+	/// \param regQuery The region to examine. As with the voxels, this can extend beyond the chunks which are resident.
+	/// \param tMin Set to a value no greater than any voxel in the region, if the function returns true.
+	/// \param tMax Set to a value no smaller than any voxel in the region, if the function returns true.
+	/// \return Whether the bounds are known.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::getValueRange(const Region& regQuery, VoxelType& tMin, VoxelType& tMax) const
+	{
+		if (!std::is_arithmetic<VoxelType>::value || !regQuery.isValid())
+		{
+			return false;
+		}
+
+		ValueRange<VoxelType> valueRange;
+		for (int32_t z = regQuery.getLowerZ() >> m_uChunkSideLengthPower; z <= regQuery.getUpperZ() >> m_uChunkSideLengthPower; z++)
+		{
+			for (int32_t y = regQuery.getLowerY() >> m_uChunkSideLengthPower; y <= regQuery.getUpperY() >> m_uChunkSideLengthPower; y++)
+			{
+				for (int32_t x = regQuery.getLowerX() >> m_uChunkSideLengthPower; x <= regQuery.getUpperX() >> m_uChunkSideLengthPower; x++)
+				{
+					const uint32_t uPositionHash = hashChunkPosition(x, y, z);
+					ChunkTableShard& shard = m_arrayChunkTableShards[uPositionHash % uNoOfChunkTableShards];
+
+					// Resident chunks are not touched, as looking at their summary does not count as using them. Other chunks are paged
+					// in and then looked up again, so that the summary is always read (and recalculated) while holding the shard lock.
+					ValueRange<VoxelType> chunkValueRange;
+					ChunkHandle handle;
+					bool bFound = false;
+					while (!bFound)
+					{
+						{
+							std::unique_lock<std::mutex> shardLock(shard.m_mutex, std::defer_lock);
+							if (m_bConcurrentAccess)
+							{
+								shardLock.lock();
+							}
+
+							if (Chunk* pChunk = findChunkInShard(shard, uPositionHash, x, y, z))
+							{
+								// Compressed chunks are never stale, as their range is calculated when they are compressed.
+								if (pChunk->m_bValueRangeStale.load(std::memory_order_relaxed))
+								{
+									pChunk->calculateValueRange();
+								}
+								chunkValueRange = pChunk->m_valueRange;
+								bFound = true;
+							}
+						}
+
+						if (!bFound)
+						{
+							handle = ChunkHandle(this, getChunk(x, y, z, true));
+						}
+					}
+
+					if (!chunkValueRange.isValid())
+					{
+						return false;
+					}
+
+					if (valueRange.isValid())
+					{
+						valueRange.include(chunkValueRange.getMin());
+						valueRange.include(chunkValueRange.getMax());
+					}
+					else
+					{
+						valueRange = chunkValueRange;
+					}
+				}
+			}
+		}
+
+		tMin = valueRange.getMin();
+		tMax = valueRange.getMax();
+		return true;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Versions allow a cache of data derived from the volume (such as extracted meshes) to be brought up to date without having
+	/// to track the edits separately. Each chunk records the version at which it was last modified, and this function returns the
+	/// highest version of the chunks which overlap the given region, or zero if none of them have ever been modified. Any
+	/// modification made after this function returns will give the chunk a higher version, so a region whose maximum version
+	/// has not increased since it was last processed has not changed. Versions are remembered while chunks are paged out, but
+	/// not across different instances of the volume. Only a limited number of them are kept for paged out chunks, and beyond this
+	/// they are replaced by the highest of them, so regions which have not changed can occasionally be reported as changed.
+	/// \param regQuery The region to examine. As with the voxels, this can extend beyond the chunks which are resident.
+	/// \return The highest version of any chunk overlapping the region.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	uint64_t PagedVolume<VoxelType>::getMaxVersion(const Region& regQuery) const
+	{
+		uint64_t uMaxVersion = 0;
+		for (int32_t z = regQuery.getLowerZ() >> m_uChunkSideLengthPower; z <= regQuery.getUpperZ() >> m_uChunkSideLengthPower; z++)
+		{
+			for (int32_t y = regQuery.getLowerY() >> m_uChunkSideLengthPower; y <= regQuery.getUpperY() >> m_uChunkSideLengthPower; y++)
+			{
+				for (int32_t x = regQuery.getLowerX() >> m_uChunkSideLengthPower; x <= regQuery.getUpperX() >> m_uChunkSideLengthPower; x++)
+				{
+					const uint32_t uPositionHash = hashChunkPosition(x, y, z);
+					ChunkTableShard& shard = m_arrayChunkTableShards[uPositionHash % uNoOfChunkTableShards];
+
+					std::unique_lock<std::mutex> shardLock(shard.m_mutex, std::defer_lock);
+					if (m_bConcurrentAccess)
+					{
+						shardLock.lock();
+					}
+
+					uint64_t uVersion = 0;
+					if (Chunk* pChunk = findChunkInShard(shard, uPositionHash, x, y, z))
+					{
+						uVersion = pChunk->m_uVersion;
+					}
+					else
+					{
+						uVersion = getPagedOutChunkVersion(shard, x, y, z, false);
+					}
+					uMaxVersion = (std::max)(uMaxVersion, uVersion);
+				}
+			}
+		}
+
+		// The caller has now seen this version, so later modifications must be given a new one. Another thread may get there first.
+		uint64_t uExpectedVersion = uMaxVersion;
+		m_uCurrentVersion.compare_exchange_strong(uExpectedVersion, uMaxVersion + 1);
+		return uMaxVersion;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// The listener is called each time a chunk is modified, so calls to setVoxel() are each reported. Operations which write many
+	/// voxels at once (such as fill(), writeVoxels() and a RegionWriter) report each chunk they modify once, rather than once per
+	/// voxel. In concurrent mode it is called by whichever thread made the modification, without any locks
+	/// held, and so may be called by several threads at once. The listener should be set before the volume is used.
+	/// \param funcChangeListener The function to call, or an empty function to stop receiving notifications.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::setChangeListener(typename BaseVolume<VoxelType>::ChangeListener funcChangeListener)
+	{
+		m_funcChangeListener = std::move(funcChangeListener);
+	}
+
+	template <typename VoxelType>
+	typename PagedVolume<VoxelType>::ChunkList& PagedVolume<VoxelType>::getChunkList(Chunk* pChunk) const
+	{
+		return pChunk->isCompact() ? m_listCompactChunks : m_listUncompressedChunks;
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::linkChunkAtHead(ChunkList& list, Chunk* pChunk) const
+	{
+		POLYVOX_ASSERT(pChunk->m_pPrevChunk == nullptr && pChunk->m_pNextChunk == nullptr, "Chunk is already linked");
+
+		pChunk->m_pNextChunk = list.m_pMostRecentlyUsedChunk;
+		if (list.m_pMostRecentlyUsedChunk)
+		{
+			list.m_pMostRecentlyUsedChunk->m_pPrevChunk = pChunk;
+		}
+		list.m_pMostRecentlyUsedChunk = pChunk;
+
+		if (!list.m_pLeastRecentlyUsedChunk)
+		{
+			list.m_pLeastRecentlyUsedChunk = pChunk;
+		}
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::unlinkChunk(ChunkList& list, Chunk* pChunk) const
+	{
+		if (pChunk->m_pPrevChunk)
+		{
+			pChunk->m_pPrevChunk->m_pNextChunk = pChunk->m_pNextChunk;
+		}
+		else
+		{
+			list.m_pMostRecentlyUsedChunk = pChunk->m_pNextChunk;
+		}
+
+		if (pChunk->m_pNextChunk)
+		{
+			pChunk->m_pNextChunk->m_pPrevChunk = pChunk->m_pPrevChunk;
+		}
+		else
+		{
+			list.m_pLeastRecentlyUsedChunk = pChunk->m_pPrevChunk;
+		}
+
+		pChunk->m_pPrevChunk = nullptr;
+		pChunk->m_pNextChunk = nullptr;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Removes the chunk from the chunk table and the lists of resident chunks, and hands ownership of it to the caller. If the chunk is
+	/// pinned then it is left in place and a null pointer is returned. If concurrent access is enabled the list lock must be held.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	std::unique_ptr<typename PagedVolume<VoxelType>::Chunk> PagedVolume<VoxelType>::removeChunk(Chunk* pChunk) const
+	{
+		ChunkTableShard& shard = m_arrayChunkTableShards[pChunk->m_uChunkTableShard];
+
+		std::unique_lock<std::mutex> shardLock(shard.m_mutex, std::defer_lock);
+		if (m_bConcurrentAccess)
+		{
+			shardLock.lock();
+		}
+
+		// Chunks can only be pinned while the shard is locked, so once we have checked this no other thread can start using it.
+		if (pChunk->m_uPinCount > 0)
+		{
+			return nullptr;
+		}
+
+		// Don't leave a dangling pointer to the chunk we are about to remove.
+		if (pChunk == m_pLastAccessedChunk)
+		{
+			m_pLastAccessedChunk = nullptr;
+		}
+
+		unlinkChunk(getChunkList(pChunk), pChunk);
+		m_uChunkCount--;
+		if (pChunk->isCompact())
+		{
+			m_uCompactDataSizeInBytes -= pChunk->calculateSizeInBytes();
+		}
+		else
+		{
+			m_uNoOfUncompressedChunks--;
+		}
+
+		// The chunk's version must outlive it, as the data it was derived from may still be cached.
+		rememberPagedOutChunkVersion(shard, pChunk->m_v3dChunkSpacePosition, pChunk->m_uVersion);
+
+		// Registering the pending page out while the shard is still locked means any thread which fails to find
+		// the chunk in the table is guaranteed to see it, and hence to wait until the data has been written.
+		if (m_bConcurrentAccess && pChunk->m_bDataModified && pChunk->m_pPager)
+		{
+			std::lock_guard<std::mutex> pagingLock(m_mutexPaging);
+			m_vecPendingPageOuts.push_back(pChunk->m_v3dChunkSpacePosition);
+
+			// A thread which failed to find the chunk just before it was added to the table may already be paging in the old data.
+			if (std::find(m_vecPageInsInProgress.begin(), m_vecPageInsInProgress.end(), pChunk->m_v3dChunkSpacePosition) != m_vecPageInsInProgress.end())
+			{
+				m_vecStalePageIns.push_back(pChunk->m_v3dChunkSpacePosition);
+			}
+		}
+
+		return removeChunkFromShard(shard, pChunk);
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::removeAllChunks(ChunkList& list, std::vector< std::unique_ptr<Chunk> >& vecRemovedChunks) const
+	{
+		Chunk* pChunk = list.m_pLeastRecentlyUsedChunk;
+		while (pChunk)
+		{
+			Chunk* pPrevChunk = pChunk->m_pPrevChunk;
+			std::unique_ptr<Chunk> pRemovedChunk = removeChunk(pChunk);
+			if (pRemovedChunk)
+			{
+				vecRemovedChunks.push_back(std::move(pRemovedChunk));
+			}
+			pChunk = pPrevChunk;
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Releases the least recently used chunk in the given list which is not pinned (see releaseChunk()), and returns false if there is
+	/// no such chunk. Chunks which have been marked as recently used are given a second chance by moving them back to the head of the list.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::releaseLeastRecentlyUsedChunk(ChunkList& list, std::vector< std::unique_ptr<Chunk> >& vecRemovedChunks) const
+	{
+		// Each chunk can be given at most one second chance, so if we have visited every chunk twice then they must all be pinned.
+		uint32_t uNoOfChunksToVisit = m_uChunkCount * 2;
+
+		Chunk* pChunk = list.m_pLeastRecentlyUsedChunk;
+		while (pChunk && (uNoOfChunksToVisit-- > 0))
+		{
+			Chunk* pPrevChunk = pChunk->m_pPrevChunk;
+
+			if (pChunk->m_bRecentlyUsed.exchange(false, std::memory_order_relaxed))
+			{
+				unlinkChunk(list, pChunk);
+				linkChunkAtHead(list, pChunk);
+			}
+			else if (releaseChunk(pChunk, vecRemovedChunks))
+			{
+				return true;
+			}
+
+			// Wrap around as the chunks we just gave a second chance are now at the head.
+			pChunk = pPrevChunk ? pPrevChunk : list.m_pLeastRecentlyUsedChunk;
+		}
+
+		return false;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Reduces the memory used by an unpinned chunk. Uncompressed chunks are made homogeneous or compressed and moved to the list of
+	/// compact chunks, unless compression would not save any memory. Other chunks are removed from the volume and added to
+	/// vecRemovedChunks so that they can be paged out once the locks have been released. Returns false if the chunk is pinned. The
+	/// list lock must be held.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::releaseChunk(Chunk* pChunk, std::vector< std::unique_ptr<Chunk> >& vecRemovedChunks) const
+	{
+		if (!pChunk->isCompact())
+		{
+			ChunkTableShard& shard = m_arrayChunkTableShards[pChunk->m_uChunkTableShard];
+
+			// Other threads may be reading the chunk while holding the shard lock, so we must hold it while compressing.
+			std::unique_lock<std::mutex> shardLock(shard.m_mutex, std::defer_lock);
+			if (m_bConcurrentAccess)
+			{
+				shardLock.lock();
+			}
+
+			if (pChunk->m_uPinCount > 0)
+			{
+				return false;
+			}
+
+			if (tryMakeHomogeneous(pChunk) || pChunk->compress())
+			{
+				// The voxel data may have gone, so the cached pointer must not be used.
+				if (pChunk == m_pLastAccessedChunk)
+				{
+					m_pLastAccessedChunk = nullptr;
+				}
+
+				unlinkChunk(m_listUncompressedChunks, pChunk);
+				linkChunkAtHead(m_listCompactChunks, pChunk);
+				m_uNoOfUncompressedChunks--;
+				m_uCompactDataSizeInBytes += pChunk->calculateSizeInBytes();
+				m_uNoOfCompressions++;
+				return true;
+			}
+		}
+
+		std::unique_ptr<Chunk> pRemovedChunk = removeChunk(pChunk);
+		if (!pRemovedChunk)
+		{
+			return false;
+		}
+
+		vecRemovedChunks.push_back(std::move(pRemovedChunk));
+		m_uNoOfEvictions++;
+		return true;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Writes resident chunks which have been modified back to the pager, keeping them in memory. If a region is given (in chunk
+	/// coordinates) only chunks inside it are written. Returns false if the time budget (if any) ran out before all were written.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::writeBackModifiedChunks(const Region* pChunkRegion, uint32_t uTimeBudgetInMilliseconds)
+	{
+		// The chunks are pinned while we hold the list lock (which prevents them being removed) so that they stay
+		// resident, and so cannot be compressed or paged out by another thread while they are being written.
+		std::vector<Chunk*> vecModifiedChunks;
+		{
+			std::unique_lock<std::mutex> listLock(m_mutexChunkList, std::defer_lock);
+			if (m_bConcurrentAccess)
+			{
+				listLock.lock();
+			}
+
+			for (ChunkList* pList : { &m_listUncompressedChunks, &m_listCompactChunks })
+			{
+				for (Chunk* pChunk = pList->m_pMostRecentlyUsedChunk; pChunk; pChunk = pChunk->m_pNextChunk)
+				{
+					if (pChunk->m_bDataModified && (!pChunkRegion || pChunkRegion->containsPoint(pChunk->m_v3dChunkSpacePosition)))
+					{
+						pChunk->m_uPinCount++;
+						vecModifiedChunks.push_back(pChunk);
+					}
+				}
+			}
+		}
+
+		Timer timer;
+		size_t uNoOfChunksWritten = 0;
+		try
+		{
+			while (uNoOfChunksWritten < vecModifiedChunks.size())
+			{
+				// We always make some progress, however small the budget.
+				if ((uTimeBudgetInMilliseconds > 0) && (uNoOfChunksWritten > 0) && (timer.elapsedTimeInMilliSeconds() > uTimeBudgetInMilliseconds))
+				{
+					break;
+				}
+
+				// The chunks are passed to Pager::pageOutBatch() a batch at a time.
+				const size_t uBatchEnd = (std::min)(uNoOfChunksWritten + uMaxNoOfChunksPerPagingBatch, vecModifiedChunks.size());
+				std::vector<typename Pager::PageRequest> vecRequests;
+				std::vector< std::unique_ptr<Chunk> > vecChunkCopies;
+				vecRequests.reserve(uBatchEnd - uNoOfChunksWritten);
+				try
+				{
+					for (size_t ct = uNoOfChunksWritten; ct < uBatchEnd; ct++)
+					{
+						Chunk* pChunk = vecModifiedChunks[ct];
+
+						// The pager expects to see the raw voxel data, so compressed chunks are written from a temporary uncompressed copy.
+						// Decompressing them in place would move these (often cold) chunks to the head of the list, and so push the chunks
+						// which are really in use out of memory. In concurrent mode homogeneous chunks are copied as well, because another
+						// thread could expand them while we are reading them, whereas the data of an uncompressed pinned chunk cannot change.
+						Chunk* pChunkToWrite = pChunk;
+						{
+							ChunkTableShard& shard = m_arrayChunkTableShards[pChunk->m_uChunkTableShard];
+							std::unique_lock<std::mutex> shardLock(shard.m_mutex, std::defer_lock);
+							if (m_bConcurrentAccess)
+							{
+								shardLock.lock();
+							}
+
+							if (m_bConcurrentAccess ? pChunk->isCompact() : pChunk->isCompressed())
+							{
+								std::unique_ptr<Chunk> pChunkCopy(new Chunk(pChunk->m_v3dChunkSpacePosition, m_uChunkSideLength, m_pPager, m_pChunkBufferPool.get(), nullptr, false));
+								pChunk->copyData(pChunkCopy->m_tData);
+								pChunkToWrite = pChunkCopy.get();
+								vecChunkCopies.push_back(std::move(pChunkCopy));
+							}
+						}
+
+						// The flag is cleared first, so that if the chunk is modified while it is being written it will be written again.
+						pChunk->m_bDataModified = false;
+						vecRequests.push_back(std::make_pair(pChunk->getRegion(), pChunkToWrite));
+					}
+
+					// As when paging in, the time taken is shared between the chunks.
+					const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+					m_pPager->pageOutBatch(vecRequests);
+					const std::chrono::steady_clock::duration durationPerChunk = (std::chrono::steady_clock::now() - start) / static_cast<int32_t>(vecRequests.size());
+					for (size_t ct = 0; ct < vecRequests.size(); ct++)
+					{
+						m_pagerCallCounters.recordPageOut(durationPerChunk);
+					}
+				}
+				catch (...)
+				{
+					for (size_t ct = 0; ct < vecRequests.size(); ct++)
+					{
+						vecModifiedChunks[uNoOfChunksWritten + ct]->m_bDataModified = true;
+					}
+					throw;
+				}
+
+				m_uNoOfDirtyWriteBacks.fetch_add(vecRequests.size(), std::memory_order_relaxed);
+				for (; uNoOfChunksWritten < uBatchEnd; uNoOfChunksWritten++)
+				{
+					unpinChunk(vecModifiedChunks[uNoOfChunksWritten]);
+				}
+			}
+		}
+		catch (...)
+		{
+			for (size_t ct = uNoOfChunksWritten; ct < vecModifiedChunks.size(); ct++)
+			{
+				unpinChunk(vecModifiedChunks[ct]);
+			}
+			throw;
+		}
+
+		for (size_t ct = uNoOfChunksWritten; ct < vecModifiedChunks.size(); ct++)
+		{
+			unpinChunk(vecModifiedChunks[ct]);
+		}
+		return uNoOfChunksWritten == vecModifiedChunks.size();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Works out how many uncompressed chunks the given memory target allows, and stores the limits used by enforceMemoryLimit(). If
+	/// concurrent access is enabled the list lock must be held (except during construction).
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::applyTargetMemoryUsage(uint64_t uTargetMemoryUsageInBytes)
+	{
+		// Calculate the number of uncompressed chunks based on the memory limit and the size of each chunk. Half
+		// of the memory is reserved for uncompressed chunks and the rest is available for compressed chunks.
+		const uint64_t uChunkSizeInBytes = PagedVolume<VoxelType>::Chunk::calculateSizeInBytes(m_uChunkSideLength) + sizeof(Chunk);
+		uint64_t uUncompressedChunkCountLimit = (uTargetMemoryUsageInBytes / 2) / uChunkSizeInBytes;
+
+		// Enforce a sensible minimum number of chunks. There is no maximum, as the chunk table grows as needed.
+		const uint64_t uMinPracticalNoOfChunks = 32; // Enough to make sure a chunks and it's neighbours can be loaded, with a few to spare.
+		POLYVOX_LOG_WARNING_IF(uUncompressedChunkCountLimit < uMinPracticalNoOfChunks, "Requested memory usage limit of ",
+			uTargetMemoryUsageInBytes / (1024 * 1024), "Mb is too low and cannot be adhered to.");
+		uUncompressedChunkCountLimit = (std::max)(uUncompressedChunkCountLimit, uMinPracticalNoOfChunks);
+		uUncompressedChunkCountLimit = (std::min)(uUncompressedChunkCountLimit, static_cast<uint64_t>((std::numeric_limits<uint32_t>::max)()));
+
+		m_uUncompressedChunkCountLimit = static_cast<uint32_t>(uUncompressedChunkCountLimit);
+		m_uTargetMemoryUsageInBytes = (std::max)(uTargetMemoryUsageInBytes, uUncompressedChunkCountLimit * uChunkSizeInBytes);
+
+		// Inform the user about the chosen memory configuration.
+		POLYVOX_LOG_DEBUG("Memory usage limit for volume now set to ", m_uTargetMemoryUsageInBytes / (1024 * 1024),
+			"Mb (up to ", m_uUncompressedChunkCountLimit.load(), " uncompressed chunks of ", uChunkSizeInBytes / 1024, "Kb each).");
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// The memory used by the resident chunks (including the chunk objects themselves), the shared buffers of homogeneous chunks and
+	/// the chunk table. If concurrent access is enabled the list lock must be held.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	uint64_t PagedVolume<VoxelType>::calculateMemoryUsageInBytes(void) const
+	{
+		const uint64_t uChunkDataSizeInBytes = PagedVolume<VoxelType>::Chunk::calculateSizeInBytes(m_uChunkSideLength);
+
+		uint64_t uNoOfHomogeneousDataBuffers = 0;
+		{
+			std::lock_guard<std::mutex> homogeneousDataLock(m_mutexHomogeneousData);
+			uNoOfHomogeneousDataBuffers = m_vecHomogeneousData.size();
+		}
+
+		// Note: We disregard the size of the PagedVolume itself as it is small and fixed.
+		return (uChunkDataSizeInBytes + sizeof(Chunk)) * m_uNoOfUncompressedChunks + m_uCompactDataSizeInBytes +
+			uChunkDataSizeInBytes * uNoOfHomogeneousDataBuffers + m_uChunkTableSizeInBytes;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Compresses the least recently used chunks until the uncompressed chunks are within their limit, and then removes the least
+	/// recently used compressed chunks until the total memory usage is within the target. The list lock must be held.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::enforceMemoryLimit(std::vector< std::unique_ptr<Chunk> >& vecRemovedChunks) const
+	{
+		while (m_uNoOfUncompressedChunks > m_uUncompressedChunkCountLimit)
+		{
+			if (!releaseLeastRecentlyUsedChunk(m_listUncompressedChunks, vecRemovedChunks))
+			{
+				// Everything else is pinned, so we have to go over the limit for now.
+				POLYVOX_LOG_WARNING("All chunks are pinned, so the target memory usage is being exceeded (", m_uChunkCount.load(), " chunks resident).");
+				break;
+			}
+		}
+
+		// Then the compact chunks are paged out until the total memory usage is within the target.
+		while (calculateMemoryUsageInBytes() > m_uTargetMemoryUsageInBytes)
+		{
+			if (!releaseLeastRecentlyUsedChunk(m_listCompactChunks, vecRemovedChunks))
+			{
+				break;
+			}
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Gives a compact chunk its own uncompressed copy of the data (by decompressing or expanding it), and moves it to the head of the
+	/// list of uncompressed chunks. The chunk must be pinned by the caller.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::decompressChunk(Chunk* pChunk) const
+	{
+		POLYVOX_ASSERT(pChunk->m_uPinCount > 0, "Chunk must be pinned while it is decompressed");
+
+		// The chunks are deleted (and hence paged out) after the lock has been released.
+		std::vector< std::unique_ptr<Chunk> > vecEvictedChunks;
+		{
+			std::unique_lock<std::mutex> listLock(m_mutexChunkList, std::defer_lock);
+			if (m_bConcurrentAccess)
+			{
+				listLock.lock();
+			}
+
+			// Another thread may have needed the same chunk and decompressed it already.
+			if (!pChunk->isCompact())
+			{
+				return;
+			}
+
+			{
+				ChunkTableShard& shard = m_arrayChunkTableShards[pChunk->m_uChunkTableShard];
+				std::unique_lock<std::mutex> shardLock(shard.m_mutex, std::defer_lock);
+				if (m_bConcurrentAccess)
+				{
+					shardLock.lock();
+				}
+
+				const uint64_t uCompactSizeInBytes = pChunk->calculateSizeInBytes();
+				if (pChunk->isCompressed())
+				{
+					pChunk->decompress();
+				}
+				else
+				{
+					pChunk->expand();
+				}
+				m_uCompactDataSizeInBytes -= uCompactSizeInBytes;
+				refreshSamplers(pChunk);
+			}
+
+			unlinkChunk(m_listCompactChunks, pChunk);
+			linkChunkAtHead(m_listUncompressedChunks, pChunk);
+			m_uNoOfUncompressedChunks++;
+			enforceMemoryLimit(vecEvictedChunks);
+		}
+
+		deleteRemovedChunks(vecEvictedChunks);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Called before writing to a chunk which is homogeneous or has not yet given its data to the snapshots. If the chunk is homogeneous
+	/// and the value being written is the one it already contains then there is nothing to do and false is returned. Otherwise the
+	/// chunk is made writable (see makeChunkWritable()).
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::prepareChunkForWrite(Chunk* pChunk, const VoxelType& tValue) const
+	{
+		if (pChunk->isHomogeneous() && (std::memcmp(&tValue, pChunk->m_tData, sizeof(VoxelType)) == 0))
+		{
+			return false;
+		}
+
+		// The caller guarantees the chunk exists, but it must also stay pinned while it is expanded.
+		pChunk->m_uPinCount++;
+		makeChunkWritable(pChunk);
+		unpinChunk(pChunk);
+		return true;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Whether a chunk can be written to straight away, which requires it to have its own uncompressed data and to have given its
+	/// previous data to any snapshots taken since it was last written. If concurrent access is enabled the shard must be locked.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::isChunkWritable(Chunk* pChunk) const
+	{
+		return !pChunk->isCompact() && (pChunk->m_uSnapshotGeneration == m_uSnapshotGeneration.load(std::memory_order_relaxed));
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Prepares a (pinned) chunk to be modified. Any snapshots which do not yet have the chunk's data are given it, and the chunk then
+	/// gets its own uncompressed copy. Snapshots only accept uncompressed data, so a compressed chunk is decompressed first.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::makeChunkWritable(Chunk* pChunk) const
+	{
+		POLYVOX_ASSERT(pChunk->m_uPinCount > 0, "Chunk must be pinned while it is made writable");
+
+		ChunkTableShard& shard = m_arrayChunkTableShards[pChunk->m_uChunkTableShard];
+		bool bCaptured = false;
+		{
+			std::unique_lock<std::mutex> listLock(m_mutexChunkList, std::defer_lock);
+			std::unique_lock<std::mutex> shardLock(shard.m_mutex, std::defer_lock);
+			if (m_bConcurrentAccess)
+			{
+				listLock.lock();
+				shardLock.lock();
+			}
+			bCaptured = captureChunkForSnapshots(pChunk);
+		}
+
+		decompressChunk(pChunk);
+
+		if (!bCaptured)
+		{
+			std::unique_lock<std::mutex> listLock(m_mutexChunkList, std::defer_lock);
+			std::unique_lock<std::mutex> shardLock(shard.m_mutex, std::defer_lock);
+			if (m_bConcurrentAccess)
+			{
+				listLock.lock();
+				shardLock.lock();
+			}
+			captureChunkForSnapshots(pChunk);
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Gives the chunk's current data to any snapshots which do not have it yet, so that it can then be modified. A homogeneous chunk
+	/// simply shares its buffer, while one with its own data hands it over and carries on with a copy (any Samplers which were pointing
+	/// into the old data keep it alive until they are pointed at the copy). This fails for a compressed chunk, which must be decompressed first. If concurrent access is
+	/// enabled the chunk list and shard must be locked, as the chunk's data is checked under these locks by decompressChunk() and by
+	/// readers of the snapshots.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::captureChunkForSnapshots(Chunk* pChunk) const
+	{
+		if (pChunk->m_uSnapshotGeneration == m_uSnapshotGeneration.load(std::memory_order_relaxed))
+		{
+			return true;
+		}
+
+		if (pChunk->isCompressed())
+		{
+			return false;
+		}
+
+		std::lock_guard<std::mutex> snapshotsLock(m_mutexSnapshots);
+
+		// Older copies of the data can only still be in use by whoever has the chunk pinned, and the caller is not using them.
+		if (pChunk->m_uPinCount == 1)
+		{
+			pChunk->m_vecRetiredData.clear();
+		}
+
+		const uint64_t uChunkKey = packChunkPosition(pChunk->m_v3dChunkSpacePosition.getX(), pChunk->m_v3dChunkSpacePosition.getY(), pChunk->m_v3dChunkSpacePosition.getZ());
+		std::shared_ptr<VoxelType> pCapturedData;
+		for (auto iter = m_vecSnapshots.begin(); iter != m_vecSnapshots.end();)
+		{
+			auto pSnapshotData = iter->lock();
+			if (!pSnapshotData)
+			{
+				iter = m_vecSnapshots.erase(iter);
+				continue;
+			}
+
+			std::lock_guard<std::mutex> snapshotLock(pSnapshotData->m_mutex);
+			if (pSnapshotData->m_mapChunkData.find(uChunkKey) == pSnapshotData->m_mapChunkData.end())
+			{
+				if (!pCapturedData)
+				{
+					pCapturedData = pChunk->isShared() ? pChunk->m_pSharedData : pChunk->detachData();
+				}
+				pSnapshotData->m_mapChunkData[uChunkKey] = pCapturedData;
+			}
+			++iter;
+		}
+
+		pChunk->m_uSnapshotGeneration = m_uSnapshotGeneration.load(std::memory_order_relaxed);
+		if (pCapturedData && !pChunk->isShared())
+		{
+			refreshSamplers(pChunk);
+		}
+		return true;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Points any Samplers whose current chunk is the given one at its data, after the chunk has been given new data. This is only
+	/// done without concurrent access, as otherwise the Samplers could be in the middle of a read on another thread. They check the
+	/// chunk's data generation instead.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::refreshSamplers(Chunk* pChunk) const
+	{
+		for (Sampler* pSampler = m_pFirstSampler; pSampler; pSampler = pSampler->m_pNextSampler)
+		{
+			if (pSampler->m_pCurrentChunk == pChunk)
+			{
+				pSampler->refreshCurrentChunkData();
+			}
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// If all voxels in the given uncompressed chunk have the same value then its data is replaced by a shared buffer containing that
+	/// value. This is only done for a small number of different values, so it can fail even if the chunk is homogeneous.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::tryMakeHomogeneous(Chunk* pChunk) const
+	{
+		if (!pChunk->hasSingleValue())
+		{
+			return false;
+		}
+
+		std::shared_ptr<VoxelType> pData = getHomogeneousData(pChunk->m_tData[0]);
+		if (!pData)
+		{
+			return false;
+		}
+
+		pChunk->makeHomogeneous(std::move(pData));
+		pChunk->calculateValueRange();
+		return true;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Gets the shared buffer in which every voxel has the given value, creating it if necessary. Returns null if there are already
+	/// buffers for too many other values.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	std::shared_ptr<VoxelType> PagedVolume<VoxelType>::getHomogeneousData(const VoxelType& tValue) const
+	{
+		std::lock_guard<std::mutex> homogeneousDataLock(m_mutexHomogeneousData);
+
+		auto iterData = std::find_if(m_vecHomogeneousData.begin(), m_vecHomogeneousData.end(), [&](const std::shared_ptr<VoxelType>& pData)
+		{
+			return std::memcmp(pData.get(), &tValue, sizeof(VoxelType)) == 0;
+		});
+
+		if (iterData == m_vecHomogeneousData.end())
+		{
+			// Make room by discarding any buffers which are no longer used by any chunks.
+			if (m_vecHomogeneousData.size() >= uMaxNoOfHomogeneousValues)
+			{
+				m_vecHomogeneousData.erase(std::remove_if(m_vecHomogeneousData.begin(), m_vecHomogeneousData.end(),
+					[](const std::shared_ptr<VoxelType>& pData) { return pData.use_count() == 1; }), m_vecHomogeneousData.end());
+
+				if (m_vecHomogeneousData.size() >= uMaxNoOfHomogeneousValues)
+				{
+					return nullptr;
+				}
+			}
+
+			const uint32_t uNoOfVoxels = m_uChunkSideLength * m_uChunkSideLength * m_uChunkSideLength;
+			std::shared_ptr<VoxelType> pData(new VoxelType[uNoOfVoxels], std::default_delete<VoxelType[]>());
+			std::fill(pData.get(), pData.get() + uNoOfVoxels, tValue);
+			iterData = m_vecHomogeneousData.insert(m_vecHomogeneousData.end(), pData);
+		}
+
+		return *iterData;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Checks whether a chunk is homogeneous and contains the given value, in which case writing that value would not change it.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::isHomogeneousWithValue(Chunk* pChunk, const VoxelType& tValue) const
+	{
+		// Another thread may be decompressing the chunk, so the data pointer must be read under the shard lock.
+		std::unique_lock<std::mutex> shardLock(m_arrayChunkTableShards[pChunk->m_uChunkTableShard].m_mutex, std::defer_lock);
+		if (m_bConcurrentAccess)
+		{
+			shardLock.lock();
+		}
+
+		return pChunk->isHomogeneous() && (std::memcmp(pChunk->m_tData, &tValue, sizeof(VoxelType)) == 0);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Gets the Region covered by the chunk at the given position.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	Region PagedVolume<VoxelType>::getChunkRegion(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ) const
+	{
+		const Vector3DInt32 v3dLower(uChunkX << m_uChunkSideLengthPower, uChunkY << m_uChunkSideLengthPower, uChunkZ << m_uChunkSideLengthPower);
+		const int32_t iOffsetToUpper = m_uChunkSideLength - 1;
+		return Region(v3dLower, v3dLower + Vector3DInt32(iOffsetToUpper, iOffsetToUpper, iOffsetToUpper));
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Sets every voxel in the region to the value returned by the given function, a chunk at a time.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	template <typename VoxelFunction>
+	void PagedVolume<VoxelType>::writeVoxels(const Region& regWrite, VoxelFunction funcVoxel)
+	{
+		if (!regWrite.isValid())
+		{
+			return;
+		}
+
+		for (int32_t z = regWrite.getLowerZ() >> m_uChunkSideLengthPower; z <= regWrite.getUpperZ() >> m_uChunkSideLengthPower; z++)
+		{
+			for (int32_t y = regWrite.getLowerY() >> m_uChunkSideLengthPower; y <= regWrite.getUpperY() >> m_uChunkSideLengthPower; y++)
+			{
+				for (int32_t x = regWrite.getLowerX() >> m_uChunkSideLengthPower; x <= regWrite.getUpperX() >> m_uChunkSideLengthPower; x++)
+				{
+					Region regChunkWrite = getChunkRegion(x, y, z);
+					regChunkWrite.cropTo(regWrite);
+
+					// The handle unpins the chunk even if the function throws.
+					ChunkHandle handle(this, getChunk(x, y, z, true));
+					writeChunkVoxels(handle.get(), regChunkWrite, funcVoxel);
+					updateChunkVersion(handle.get());
+				}
+			}
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Sets the voxels of a single (pinned) chunk which lie in the given region. The Morton index is built up one axis at a time, so
+	/// the inner loop only needs a single table lookup per voxel.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	template <typename VoxelFunction>
+	void PagedVolume<VoxelType>::writeChunkVoxels(Chunk* pChunk, const Region& regWrite, VoxelFunction funcVoxel)
+	{
+		// This does nothing if the chunk already has its own uncompressed data and no snapshot needs the old data.
+		WriteScope writeScope(this);
+		makeChunkWritable(pChunk);
+
+		const Vector3DInt32 v3dChunkLower = pChunk->m_v3dChunkSpacePosition * static_cast<int32_t>(m_uChunkSideLength);
+		const Vector3DInt32 v3dLower = regWrite.getLowerCorner() - v3dChunkLower;
+		const Vector3DInt32 v3dUpper = regWrite.getUpperCorner() - v3dChunkLower;
+
+		VoxelType* pData = pChunk->m_tData;
+		for (int32_t z = v3dLower.getZ(); z <= v3dUpper.getZ(); z++)
+		{
+			const uint32_t uZIndex = morton256_z[z];
+			for (int32_t y = v3dLower.getY(); y <= v3dUpper.getY(); y++)
+			{
+				const uint32_t uYZIndex = uZIndex | morton256_y[y];
+				for (int32_t x = v3dLower.getX(); x <= v3dUpper.getX(); x++)
+				{
+					pData[uYZIndex | morton256_x[x]] = funcVoxel(v3dChunkLower.getX() + x, v3dChunkLower.getY() + y, v3dChunkLower.getZ() + z);
+				}
+			}
+		}
+
+		pChunk->m_bValueRangeStale.store(true, std::memory_order_release);
+		pChunk->m_bDataModified.store(true, std::memory_order_relaxed);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Used by fill() for a chunk which is about to be completely overwritten. If it is not resident then it is created with every voxel
+	/// set to the given value, without being paged in, and true is returned. Otherwise false is returned and the chunk should be found
+	/// and filled as usual. This is also the case if another thread is paging it in or out, or if a Snapshot may still need to read its
+	/// old data through the Pager. The handle is given the chunk if there is one, which may have been paged in by another thread.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::tryCreateFilledChunk(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ, const VoxelType& tValue, ChunkHandle& handle)
+	{
+		const Vector3DInt32 v3dChunkPos(uChunkX, uChunkY, uChunkZ);
+		const uint32_t uPositionHash = hashChunkPosition(uChunkX, uChunkY, uChunkZ);
+		ChunkTableShard& shard = m_arrayChunkTableShards[uPositionHash % uNoOfChunkTableShards];
+		{
+			std::unique_lock<std::mutex> shardLock(shard.m_mutex, std::defer_lock);
+			if (m_bConcurrentAccess)
+			{
+				shardLock.lock();
+			}
+
+			if (findChunkInShard(shard, uPositionHash, uChunkX, uChunkY, uChunkZ))
+			{
+				return false;
+			}
+		}
+
+		// A snapshot which is taken from now on waits for the new chunk to be added, and so sees the new value.
+		WriteScope writeScope(this);
+		{
+			std::lock_guard<std::mutex> snapshotsLock(m_mutexSnapshots);
+			for (const std::weak_ptr<typename Snapshot::Data>& pSnapshotData : m_vecSnapshots)
+			{
+				if (!pSnapshotData.expired())
+				{
+					return false;
+				}
+			}
+		}
+
+		std::unique_ptr<Chunk> pNewChunk(new PagedVolume<VoxelType>::Chunk(v3dChunkPos, m_uChunkSideLength, m_pPager, m_pChunkBufferPool.get(), &m_pagerCallCounters, false));
+		if (m_bConcurrentAccess && !tryBeginPageIn(v3dChunkPos))
+		{
+			return false;
+		}
+
+		try
+		{
+			std::shared_ptr<VoxelType> pSharedData = getHomogeneousData(tValue);
+			if (pSharedData)
+			{
+				pNewChunk->makeHomogeneous(std::move(pSharedData));
+			}
+			else
+			{
+				std::fill(pNewChunk->m_tData, pNewChunk->m_tData + m_uChunkSideLength * m_uChunkSideLength * m_uChunkSideLength, tValue);
+			}
+		}
+		catch (...)
+		{
+			if (m_bConcurrentAccess)
+			{
+				endPageIn(v3dChunkPos);
+			}
+			throw;
+		}
+
+		// If another thread has paged in the chunk meanwhile then that is used instead, and it still has to be filled. Ours is only
+		// marked as modified once it has been added, as otherwise it would be paged out when it is discarded.
+		const Chunk* pFilledChunk = pNewChunk.get();
+		bool bDecompressChunk = false;
+		Chunk* pChunk = addPagedInChunk(std::move(pNewChunk), true, false, nullptr, bDecompressChunk);
+		if (!pChunk)
+		{
+			return false;
+		}
+
+		handle = ChunkHandle(this, pChunk);
+		if (pChunk != pFilledChunk)
+		{
+			return false;
+		}
+		pChunk->m_bDataModified.store(true, std::memory_order_relaxed);
+		return true;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Overwrites every voxel in a (pinned) chunk with the same value. If nothing else has the chunk pinned then its data is simply
+	/// replaced by the shared buffer for that value, without decompressing anything. Otherwise the chunk's own data is filled, as
+	/// other threads or Samplers may be pointing into it. Chunks which are not resident are instead created by tryCreateFilledChunk().
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::fillWholeChunk(Chunk* pChunk, const VoxelType& tValue)
+	{
+		WriteScope writeScope(this);
+		{
+			std::unique_lock<std::mutex> listLock(m_mutexChunkList, std::defer_lock);
+			if (m_bConcurrentAccess)
+			{
+				listLock.lock();
+			}
+
+			ChunkTableShard& shard = m_arrayChunkTableShards[pChunk->m_uChunkTableShard];
+			std::unique_lock<std::mutex> shardLock(shard.m_mutex, std::defer_lock);
+			if (m_bConcurrentAccess)
+			{
+				shardLock.lock();
+			}
+
+			// Any snapshots must be given the old data first, which is not possible while it is compressed.
+			std::shared_ptr<VoxelType> pSharedData;
+			if ((pChunk->m_uPinCount == 1) && captureChunkForSnapshots(pChunk))
+			{
+				pSharedData = getHomogeneousData(tValue);
+			}
+
+			if (pSharedData)
+			{
+				const bool bWasCompact = pChunk->isCompact();
+				const uint64_t uOldCompactSizeInBytes = bWasCompact ? pChunk->calculateSizeInBytes() : 0;
+				pChunk->makeHomogeneous(std::move(pSharedData));
+				pChunk->m_bValueRangeStale.store(true, std::memory_order_release);
+				pChunk->m_bDataModified = true;
+
+				if (!bWasCompact)
+				{
+					unlinkChunk(m_listUncompressedChunks, pChunk);
+					linkChunkAtHead(m_listCompactChunks, pChunk);
+					m_uNoOfUncompressedChunks--;
+				}
+				m_uCompactDataSizeInBytes -= uOldCompactSizeInBytes;
+				m_uCompactDataSizeInBytes += pChunk->calculateSizeInBytes();
+				return;
+			}
+		}
+
+		makeChunkWritable(pChunk);
+		std::fill(pChunk->m_tData, pChunk->m_tData + m_uChunkSideLength * m_uChunkSideLength * m_uChunkSideLength, tValue);
+		pChunk->m_bValueRangeStale.store(true, std::memory_order_release);
+		pChunk->m_bDataModified.store(true, std::memory_order_relaxed);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Copies the part of a chunk's (Morton ordered) data which lies in regSpan into the destination array of a region read.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::copyChunkSpan(const Region& regChunk, const Region& regSpan, const VoxelType* pChunkData, const Region& regRead, VoxelType* pDestination, int32_t iRowStride, int32_t iSliceStride)
+	{
+		const Vector3DInt32 v3dLower = regSpan.getLowerCorner() - regChunk.getLowerCorner();
+		const Vector3DInt32 v3dUpper = regSpan.getUpperCorner() - regChunk.getLowerCorner();
+		VoxelType* pDestinationSpan = pDestination + (regSpan.getLowerX() - regRead.getLowerX()) +
+			(regSpan.getLowerY() - regRead.getLowerY()) * iRowStride + (regSpan.getLowerZ() - regRead.getLowerZ()) * iSliceStride;
+
+		for (int32_t z = v3dLower.getZ(); z <= v3dUpper.getZ(); z++)
+		{
+			const uint32_t uZIndex = morton256_z[z];
+			for (int32_t y = v3dLower.getY(); y <= v3dUpper.getY(); y++)
+			{
+				const uint32_t uYZIndex = uZIndex | morton256_y[y];
+				VoxelType* pDestinationVoxel = pDestinationSpan + (y - v3dLower.getY()) * iRowStride + (z - v3dLower.getZ()) * iSliceStride;
+				for (int32_t x = v3dLower.getX(); x <= v3dUpper.getX(); x++)
+				{
+					*pDestinationVoxel++ = pChunkData[uYZIndex | morton256_x[x]];
+				}
+			}
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Deletes chunks which have been removed from the volume, which gives them the chance to page out their data. This should
+	/// be called without holding any locks so that other threads are not held up by a slow Pager. If there are background paging
+	/// threads then modified chunks are instead handed over to them, and this function returns without waiting for the Pager.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::deleteRemovedChunks(std::vector< std::unique_ptr<Chunk> >& vecRemovedChunks) const
+	{
+		for (auto& pChunk : vecRemovedChunks)
+		{
+			const bool bPageOutPending = m_bConcurrentAccess && pChunk->m_bDataModified && pChunk->m_pPager;
+			const Vector3DInt32 v3dChunkPos = pChunk->m_v3dChunkSpacePosition;
+
+			if (bPageOutPending)
+			{
+				std::lock_guard<std::mutex> pagingLock(m_mutexPaging);
+				if (!m_vecPagingThreads.empty() && !m_bStopPagingThreads)
+				{
+					m_dequeWriteBehindChunks.push_back(std::move(pChunk));
+					m_conditionPagingWork.notify_one();
+
+					// Anyone waiting for this chunk can now take it back from the write-behind queue.
+					m_conditionPagingComplete.notify_all();
+					continue;
+				}
+			}
+
+			pChunk = nullptr;
+
+			if (bPageOutPending)
+			{
+				std::lock_guard<std::mutex> pagingLock(m_mutexPaging);
+				m_vecPendingPageOuts.erase(std::find(m_vecPendingPageOuts.begin(), m_vecPendingPageOuts.end(), v3dChunkPos));
+				m_conditionPagingComplete.notify_all();
+			}
+		}
+
+		vecRemovedChunks.clear();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Called when a chunk was not found in the chunk table. If another thread is already paging in the same chunk then this waits
+	/// for it to finish and sets bRetryLookup, so that the caller can find the chunk in the table. If the chunk is waiting to be paged
+	/// out then it is taken back and returned. Otherwise the chunk is marked as being paged in by the caller, who must construct it and
+	/// then call endPageIn(). Only used when concurrent access is enabled.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	std::unique_ptr<typename PagedVolume<VoxelType>::Chunk> PagedVolume<VoxelType>::beginPageIn(const Vector3DInt32& v3dChunkPos, bool& bRetryLookup) const
+	{
+		std::unique_lock<std::mutex> pagingLock(m_mutexPaging);
+		while (true)
+		{
+			if (std::find(m_vecPageInsInProgress.begin(), m_vecPageInsInProgress.end(), v3dChunkPos) != m_vecPageInsInProgress.end())
+			{
+				m_conditionPagingComplete.wait(pagingLock, [&]
+				{
+					return std::find(m_vecPageInsInProgress.begin(), m_vecPageInsInProgress.end(), v3dChunkPos) == m_vecPageInsInProgress.end();
+				});
+				bRetryLookup = true;
+				return nullptr;
+			}
+
+			auto iterPendingPageOut = std::find(m_vecPendingPageOuts.begin(), m_vecPendingPageOuts.end(), v3dChunkPos);
+			if (iterPendingPageOut == m_vecPendingPageOuts.end())
+			{
+				break;
+			}
+
+			// The chunk has been evicted but not yet written. If it is still in the write-behind queue then we can simply take it
+			// back, as it still holds the most recent data. Otherwise its data is being written and we have to wait for that.
+			for (auto iterChunk = m_dequeWriteBehindChunks.begin(); iterChunk != m_dequeWriteBehindChunks.end(); iterChunk++)
+			{
+				if ((*iterChunk)->m_v3dChunkSpacePosition == v3dChunkPos)
+				{
+					std::unique_ptr<Chunk> pChunk = std::move(*iterChunk);
+					m_dequeWriteBehindChunks.erase(iterChunk);
+					m_vecPendingPageOuts.erase(iterPendingPageOut);
+					m_vecPageInsInProgress.push_back(v3dChunkPos);
+					return pChunk;
+				}
+			}
+
+			m_conditionPagingComplete.wait(pagingLock);
+		}
+
+		m_vecPageInsInProgress.push_back(v3dChunkPos);
+		return nullptr;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// As beginPageIn(), but instead of waiting for another thread which is paging the chunk in or out this returns false.
+	/// If it returns true then the caller must call endPageIn() once it has added the chunk.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::tryBeginPageIn(const Vector3DInt32& v3dChunkPos) const
+	{
+		std::lock_guard<std::mutex> pagingLock(m_mutexPaging);
+		if ((std::find(m_vecPageInsInProgress.begin(), m_vecPageInsInProgress.end(), v3dChunkPos) != m_vecPageInsInProgress.end()) ||
+			(std::find(m_vecPendingPageOuts.begin(), m_vecPendingPageOuts.end(), v3dChunkPos) != m_vecPendingPageOuts.end()))
+		{
+			return false;
+		}
+
+		m_vecPageInsInProgress.push_back(v3dChunkPos);
+		return true;
+	}
+
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::isPageInStale(const Vector3DInt32& v3dChunkPos) const
+	{
+		std::lock_guard<std::mutex> pagingLock(m_mutexPaging);
+		return std::find(m_vecStalePageIns.begin(), m_vecStalePageIns.end(), v3dChunkPos) != m_vecStalePageIns.end();
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::endPageIn(const Vector3DInt32& v3dChunkPos) const
+	{
+		std::lock_guard<std::mutex> pagingLock(m_mutexPaging);
+		m_vecPageInsInProgress.erase(std::find(m_vecPageInsInProgress.begin(), m_vecPageInsInProgress.end(), v3dChunkPos));
+		m_vecStalePageIns.erase(std::remove(m_vecStalePageIns.begin(), m_vecStalePageIns.end(), v3dChunkPos), m_vecStalePageIns.end());
+		m_conditionPagingComplete.notify_all();
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::waitForPendingPageOuts(void) const
+	{
+		std::unique_lock<std::mutex> pagingLock(m_mutexPaging);
+		m_conditionPagingComplete.wait(pagingLock, [&] { return m_vecPendingPageOuts.empty(); });
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::pagingThreadMain(void)
+	{
+		std::unique_lock<std::mutex> pagingLock(m_mutexPaging);
+		while (true)
+		{
+			m_conditionPagingWork.wait(pagingLock, [&]
+			{
+				return m_bStopPagingThreads || !m_dequeWriteBehindChunks.empty() || !m_dequePagingJobs.empty();
+			});
+
+			// Page outs take priority over prefetching, as they free up memory and may be holding up other threads.
+			if (!m_dequeWriteBehindChunks.empty())
+			{
+				std::unique_ptr<Chunk> pChunk = std::move(m_dequeWriteBehindChunks.front());
+				m_dequeWriteBehindChunks.pop_front();
+				const Vector3DInt32 v3dChunkPos = pChunk->m_v3dChunkSpacePosition;
+
+				pagingLock.unlock();
+				pChunk = nullptr;
+				pagingLock.lock();
+
+				m_vecPendingPageOuts.erase(std::find(m_vecPendingPageOuts.begin(), m_vecPendingPageOuts.end(), v3dChunkPos));
+				m_conditionPagingComplete.notify_all();
+			}
+			else if (!m_dequePagingJobs.empty())
+			{
+				std::function<void()> job = std::move(m_dequePagingJobs.front());
+				m_dequePagingJobs.pop_front();
+
+				pagingLock.unlock();
+				job();
+				job = nullptr;
+				pagingLock.lock();
+			}
+			else
+			{
+				// We only get here once we have been asked to stop and there is nothing left to page out.
+				break;
+			}
+		}
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::stopPagingThreads(void)
+	{
+		{
+			std::lock_guard<std::mutex> pagingLock(m_mutexPaging);
+			m_dequePagingJobs.clear();
+			m_bStopPagingThreads = true;
+		}
+		m_conditionPagingWork.notify_all();
+
+		for (auto& pagingThread : m_vecPagingThreads)
+		{
+			pagingThread.join();
+		}
+		m_vecPagingThreads.clear();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Finds the chunks which overlap a sphere around any of the focus points, in order of their distance from the nearest one.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	std::vector<Vector3DInt32> PagedVolume<VoxelType>::findChunksInFocus(const std::vector<Vector3DInt32>& vecFocusPoints, uint32_t uRadius) const
+	{
+		// The bounding boxes of the spheres may overlap, so the candidates are keyed by their packed position to remove duplicates.
+		const int32_t iRadius = static_cast<int32_t>(uRadius);
+		std::vector< std::pair<uint64_t, Vector3DInt32> > vecCandidates;
+		for (const Vector3DInt32& v3dFocusPoint : vecFocusPoints)
+		{
+			const Vector3DInt32 v3dLower((v3dFocusPoint.getX() - iRadius) >> m_uChunkSideLengthPower,
+				(v3dFocusPoint.getY() - iRadius) >> m_uChunkSideLengthPower, (v3dFocusPoint.getZ() - iRadius) >> m_uChunkSideLengthPower);
+			const Vector3DInt32 v3dUpper((v3dFocusPoint.getX() + iRadius) >> m_uChunkSideLengthPower,
+				(v3dFocusPoint.getY() + iRadius) >> m_uChunkSideLengthPower, (v3dFocusPoint.getZ() + iRadius) >> m_uChunkSideLengthPower);
+			for (int32_t z = v3dLower.getZ(); z <= v3dUpper.getZ(); z++)
+			{
+				for (int32_t y = v3dLower.getY(); y <= v3dUpper.getY(); y++)
+				{
+					for (int32_t x = v3dLower.getX(); x <= v3dUpper.getX(); x++)
+					{
+						vecCandidates.push_back(std::make_pair(packChunkPosition(x, y, z), Vector3DInt32(x, y, z)));
+					}
+				}
+			}
+		}
+
+		auto funcComparePositions = [](const std::pair<uint64_t, Vector3DInt32>& lhs, const std::pair<uint64_t, Vector3DInt32>& rhs) { return lhs.first < rhs.first; };
+		auto funcEqualPositions = [](const std::pair<uint64_t, Vector3DInt32>& lhs, const std::pair<uint64_t, Vector3DInt32>& rhs) { return lhs.first == rhs.first; };
+		std::sort(vecCandidates.begin(), vecCandidates.end(), funcComparePositions);
+		vecCandidates.erase(std::unique(vecCandidates.begin(), vecCandidates.end(), funcEqualPositions), vecCandidates.end());
+
+		// The corners of the bounding boxes are outside the spheres. Sorting is stable, so chunks at the same distance stay in the
+		// order of their packed positions and the result does not depend on the order of the focus points.
+		const uint64_t uRadiusSquared = static_cast<uint64_t>(uRadius) * uRadius;
+		std::vector< std::pair<uint64_t, Vector3DInt32> > vecChunksInFocus;
+		for (const auto& candidate : vecCandidates)
+		{
+			const uint64_t uDistanceSquared = calculateFocusDistanceSquared(candidate.second, vecFocusPoints);
+			if (uDistanceSquared <= uRadiusSquared)
+			{
+				vecChunksInFocus.push_back(std::make_pair(uDistanceSquared, candidate.second));
+			}
+		}
+		std::stable_sort(vecChunksInFocus.begin(), vecChunksInFocus.end(), funcComparePositions);
+
+		std::vector<Vector3DInt32> vecChunks;
+		vecChunks.reserve(vecChunksInFocus.size());
+		for (const auto& chunkInFocus : vecChunksInFocus)
+		{
+			vecChunks.push_back(chunkInFocus.second);
+		}
+		return vecChunks;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Calculates the square of the distance (in voxels) from the nearest focus point to the nearest voxel in the chunk.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	uint64_t PagedVolume<VoxelType>::calculateFocusDistanceSquared(const Vector3DInt32& v3dChunkPos, const std::vector<Vector3DInt32>& vecFocusPoints) const
+	{
+		uint64_t uMinDistanceSquared = (std::numeric_limits<uint64_t>::max)();
+		for (const Vector3DInt32& v3dFocusPoint : vecFocusPoints)
+		{
+			uint64_t uDistanceSquared = 0;
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				const int64_t iLower = static_cast<int64_t>(v3dChunkPos.getElement(i)) << m_uChunkSideLengthPower;
+				const int64_t iUpper = iLower + m_iChunkMask;
+				const int64_t iPoint = v3dFocusPoint.getElement(i);
+				const int64_t iDistance = (iPoint < iLower) ? (iLower - iPoint) : ((iPoint > iUpper) ? (iPoint - iUpper) : 0);
+				uDistanceSquared += static_cast<uint64_t>(iDistance * iDistance);
+			}
+			uMinDistanceSquared = (std::min)(uMinDistanceSquared, uDistanceSquared);
+		}
+		return uMinDistanceSquared;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Reorders both lists of resident chunks so that the nearest to the focus points are at the head and the furthest at the tail, and
+	/// takes away the second chance of chunks outside the radius. Nothing is done if a later call to setFocus() has been made, as it
+	/// will put the chunks in its own order.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::orderChunksByFocusDistance(const std::vector<Vector3DInt32>& vecFocusPoints, uint32_t uRadius, uint32_t uFocusGeneration) const
+	{
+		std::unique_lock<std::mutex> listLock(m_mutexChunkList, std::defer_lock);
+		if (m_bConcurrentAccess)
+		{
+			listLock.lock();
+		}
+
+		if (m_uFocusGeneration != uFocusGeneration)
+		{
+			return;
+		}
+
+		const uint64_t uRadiusSquared = static_cast<uint64_t>(uRadius) * uRadius;
+		ChunkList* arrayLists[2] = { &m_listUncompressedChunks, &m_listCompactChunks };
+		for (ChunkList* pList : arrayLists)
+		{
+			std::vector< std::pair<uint64_t, Chunk*> > vecChunks;
+			for (Chunk* pChunk = pList->m_pMostRecentlyUsedChunk; pChunk; pChunk = pChunk->m_pNextChunk)
+			{
+				vecChunks.push_back(std::make_pair(calculateFocusDistanceSquared(pChunk->m_v3dChunkSpacePosition, vecFocusPoints), pChunk));
+			}
+
+			// Chunks at the same distance keep their order of use.
+			std::stable_sort(vecChunks.begin(), vecChunks.end(),
+				[](const std::pair<uint64_t, Chunk*>& lhs, const std::pair<uint64_t, Chunk*>& rhs) { return lhs.first < rhs.first; });
+
+			// Relinking from the furthest leaves the nearest at the head.
+			for (auto iter = vecChunks.rbegin(); iter != vecChunks.rend(); iter++)
+			{
+				Chunk* pChunk = iter->second;
+				unlinkChunk(*pList, pChunk);
+				linkChunkAtHead(*pList, pChunk);
+				if (iter->first > uRadiusSquared)
+				{
+					pChunk->m_bRecentlyUsed.store(false, std::memory_order_relaxed);
+				}
+			}
+		}
+	}
+
+	template <typename VoxelType>
+	PagedVolume<VoxelType>::ChunkHandle::ChunkHandle()
+		:m_pVolume(nullptr)
+		, m_pChunk(nullptr)
+	{
+	}
+
+	template <typename VoxelType>
+	PagedVolume<VoxelType>::ChunkHandle::ChunkHandle(const PagedVolume<VoxelType>* pVolume, Chunk* pChunk)
+		:m_pVolume(pVolume)
+		, m_pChunk(pChunk)
+	{
+	}
+
+	template <typename VoxelType>
+	PagedVolume<VoxelType>::ChunkHandle::ChunkHandle(const ChunkHandle& rhs)
+		:m_pVolume(rhs.m_pVolume)
+		, m_pChunk(rhs.m_pChunk)
+	{
+		// Each handle holds its own pin, so the chunk stays pinned until all copies have gone.
+		if (m_pChunk)
+		{
+			m_pChunk->m_uPinCount++;
+		}
+	}
+
+	template <typename VoxelType>
+	PagedVolume<VoxelType>::ChunkHandle::ChunkHandle(ChunkHandle&& rhs)
+		:m_pVolume(rhs.m_pVolume)
+		, m_pChunk(rhs.m_pChunk)
+	{
+		rhs.m_pVolume = nullptr;
+		rhs.m_pChunk = nullptr;
+	}
+
+	template <typename VoxelType>
+	PagedVolume<VoxelType>::ChunkHandle::~ChunkHandle()
+	{
+		reset();
+	}
+
+	template <typename VoxelType>
+	typename PagedVolume<VoxelType>::ChunkHandle& PagedVolume<VoxelType>::ChunkHandle::operator=(ChunkHandle rhs)
+	{
+		std::swap(m_pVolume, rhs.m_pVolume);
+		std::swap(m_pChunk, rhs.m_pChunk);
+		return *this;
+	}
+
+	template <typename VoxelType>
+	typename PagedVolume<VoxelType>::Chunk* PagedVolume<VoxelType>::ChunkHandle::get(void) const
+	{
+		return m_pChunk;
+	}
+
+	template <typename VoxelType>
+	typename PagedVolume<VoxelType>::Chunk* PagedVolume<VoxelType>::ChunkHandle::operator->(void) const
+	{
+		POLYVOX_ASSERT(m_pChunk, "Attempting to dereference an empty chunk handle");
+		return m_pChunk;
+	}
+
+	template <typename VoxelType>
+	PagedVolume<VoxelType>::ChunkHandle::operator bool(void) const
+	{
+		return m_pChunk != nullptr;
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::ChunkHandle::reset(void)
+	{
+		if (m_pChunk)
+		{
+			m_pVolume->unpinChunk(m_pChunk);
+		}
+		m_pVolume = nullptr;
+		m_pChunk = nullptr;
+	}
+
+	template <typename VoxelType>
+	PagedVolume<VoxelType>::Snapshot::Snapshot()
+		:m_pVolume(nullptr)
+	{
+	}
+
+	template <typename VoxelType>
+	PagedVolume<VoxelType>::Snapshot::Snapshot(const PagedVolume<VoxelType>* pVolume, std::shared_ptr<Data> pData)
+		:m_pVolume(pVolume)
+		, m_pData(std::move(pData))
+	{
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \param uXPos The \c x position of the voxel
+	/// \param uYPos The \c y position of the voxel
+	/// \param uZPos The \c z position of the voxel
+	/// \return The voxel value when the snapshot was taken
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	VoxelType PagedVolume<VoxelType>::Snapshot::getVoxel(int32_t uXPos, int32_t uYPos, int32_t uZPos) const
+	{
+		POLYVOX_ASSERT(m_pVolume, "Attempting to read from an empty snapshot");
+
+		const uint8_t uChunkSideLengthPower = m_pVolume->m_uChunkSideLengthPower;
+		const int32_t iChunkMask = m_pVolume->m_iChunkMask;
+
+		ChunkHandle handle;
+		const VoxelType* pChunkData = getChunkData(uXPos >> uChunkSideLengthPower, uYPos >> uChunkSideLengthPower, uZPos >> uChunkSideLengthPower, handle);
+		return pChunkData[morton256_x[uXPos & iChunkMask] | morton256_y[uYPos & iChunkMask] | morton256_z[uZPos & iChunkMask]];
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \param v3dPos The 3D position of the voxel
+	/// \return The voxel value when the snapshot was taken
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	VoxelType PagedVolume<VoxelType>::Snapshot::getVoxel(const Vector3DInt32& v3dPos) const
+	{
+		return getVoxel(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ());
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This behaves like PagedVolume::readRegion(), but gives the voxel values as they were when the snapshot was taken.
+	/// \param regRead The Region to read.
+	/// \param pDestination The array to copy the voxels into.
+	/// \param iRowStride The distance (in voxels) between the starts of consecutive rows in the destination. Zero means the width of the region.
+	/// \param iSliceStride The distance (in voxels) between the starts of consecutive slices in the destination. Zero means the row stride multiplied by the height of the region.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Snapshot::readRegion(const Region& regRead, VoxelType* pDestination, int32_t iRowStride, int32_t iSliceStride) const
+	{
+		POLYVOX_ASSERT(m_pVolume, "Attempting to read from an empty snapshot");
+
+		if (!regRead.isValid())
+		{
+			return;
+		}
+
+		iRowStride = (iRowStride > 0) ? iRowStride : regRead.getWidthInVoxels();
+		iSliceStride = (iSliceStride > 0) ? iSliceStride : iRowStride * regRead.getHeightInVoxels();
+
+		const uint8_t uChunkSideLengthPower = m_pVolume->m_uChunkSideLengthPower;
+		for (int32_t z = regRead.getLowerZ() >> uChunkSideLengthPower; z <= regRead.getUpperZ() >> uChunkSideLengthPower; z++)
+		{
+			for (int32_t y = regRead.getLowerY() >> uChunkSideLengthPower; y <= regRead.getUpperY() >> uChunkSideLengthPower; y++)
+			{
+				for (int32_t x = regRead.getLowerX() >> uChunkSideLengthPower; x <= regRead.getUpperX() >> uChunkSideLengthPower; x++)
+				{
+					const Region regChunk = m_pVolume->getChunkRegion(x, y, z);
+					Region regSpan(regChunk);
+					regSpan.cropTo(regRead);
+
+					ChunkHandle handle;
+					const VoxelType* pChunkData = getChunkData(x, y, z, handle);
+					PagedVolume<VoxelType>::copyChunkSpan(regChunk, regSpan, pChunkData, regRead, pDestination, iRowStride, iSliceStride);
+				}
+			}
+		}
+	}
+
+	template <typename VoxelType>
+	PagedVolume<VoxelType>::Snapshot::operator bool(void) const
+	{
+		return m_pVolume != nullptr;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Finds the data a chunk had when the snapshot was taken. If it has not been modified since then the snapshot does not have a copy,
+	/// and the chunk's current data is used instead. In that case the chunk is pinned through the given handle, which the caller must
+	/// keep until it has finished with the data. A chunk can be modified as soon as the shard is unlocked, but it first gives the data
+	/// we are reading to the snapshot and carries on with a copy, so that data stays valid.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	const VoxelType* PagedVolume<VoxelType>::Snapshot::getChunkData(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ, ChunkHandle& handle) const
+	{
+		const uint64_t uChunkKey = packChunkPosition(uChunkX, uChunkY, uChunkZ);
+		{
+			std::lock_guard<std::mutex> snapshotLock(m_pData->m_mutex);
+			auto iterChunkData = m_pData->m_mapChunkData.find(uChunkKey);
+			if (iterChunkData != m_pData->m_mapChunkData.end())
+			{
+				return iterChunkData->second.get();
+			}
+		}
+
+		handle = ChunkHandle(m_pVolume, m_pVolume->getChunk(uChunkX, uChunkY, uChunkZ, true));
+
+		// The chunk may have been modified between our first check and being pinned, so we look again while it cannot be.
+		ChunkTableShard& shard = m_pVolume->m_arrayChunkTableShards[handle->m_uChunkTableShard];
+		std::unique_lock<std::mutex> shardLock(shard.m_mutex, std::defer_lock);
+		if (m_pVolume->m_bConcurrentAccess)
+		{
+			shardLock.lock();
+		}
+
+		std::lock_guard<std::mutex> snapshotLock(m_pData->m_mutex);
+		auto iterChunkData = m_pData->m_mapChunkData.find(uChunkKey);
+		if (iterChunkData != m_pData->m_mapChunkData.end())
+		{
+			return iterChunkData->second.get();
+		}
+		return handle->m_tData;
+	}
+
+	template <typename VoxelType>
+	PagedVolume<VoxelType>::WriteScope::WriteScope(const PagedVolume<VoxelType>* pVolume)
+		:m_pWritesInProgress(nullptr)
+	{
+		// Snapshots are only taken on the same thread as writes unless concurrent access is enabled.
+		if (!pVolume->m_bConcurrentAccess)
+		{
+			return;
+		}
+
+		// If a snapshot is taken between reading the generation and counting ourselves in then it may not wait for us, so we try again.
+		for (;;)
+		{
+			const uint32_t uGeneration = pVolume->m_uSnapshotGeneration;
+			m_pWritesInProgress = &(pVolume->m_arrayWritesInProgress[uGeneration & 1]);
+			(*m_pWritesInProgress)++;
+			if (pVolume->m_uSnapshotGeneration == uGeneration)
+			{
+				break;
+			}
+			(*m_pWritesInProgress)--;
+		}
+	}
+
+	template <typename VoxelType>
+	PagedVolume<VoxelType>::WriteScope::~WriteScope()
+	{
+		if (m_pWritesInProgress)
+		{
+			(*m_pWritesInProgress)--;
+		}
+	}
+
+	template <typename VoxelType>
+	PagedVolume<VoxelType>::RegionWriter::RegionWriter(PagedVolume<VoxelType>* pVolume, const Region& regWrite)
+		:m_pVolume(pVolume)
+		, m_regWrite(regWrite)
+		, m_iXPos(regWrite.getLowerX())
+		, m_iYPos(regWrite.getLowerY())
+		, m_iZPos(regWrite.getLowerZ())
+		, m_bFinished(!regWrite.isValid())
+		, m_uSnapshotGeneration(0)
+		, m_pCurrentChunk(nullptr)
+		, m_pCurrentChunkData(nullptr)
+		, m_pCurrentChunkWritten(nullptr)
+		, m_uYZIndex(0)
+		, m_uChunkSideLengthPower(pVolume->m_uChunkSideLengthPower)
+		, m_iChunkMask(pVolume->m_iChunkMask)
+	{
+		if (!m_bFinished)
+		{
+			beginChunkRow();
+		}
+	}
+
+	template <typename VoxelType>
+	PagedVolume<VoxelType>::RegionWriter::~RegionWriter()
+	{
+		releaseChunkRow();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// \param tValue The value to which the voxel at the current position will be set.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::RegionWriter::writeVoxel(VoxelType tValue)
+	{
+		POLYVOX_ASSERT(!m_bFinished, "Attempting to write past the end of the region");
+
+		// In concurrent mode this makes a snapshot which is being taken wait for the write (see PagedVolume::snapshot()).
+		WriteScope writeScope(m_pVolume);
+		if (m_uSnapshotGeneration != m_pVolume->m_uSnapshotGeneration.load(std::memory_order_relaxed))
+		{
+			beginChunkRow();
+		}
+
+		m_pCurrentChunkData[m_uYZIndex | morton256_x[m_iXPos & m_iChunkMask]] = tValue;
+		m_pCurrentChunk->m_bValueRangeStale.store(true, std::memory_order_release);
+		*m_pCurrentChunkWritten = 1;
+
+		// Moving along a row only needs a new chunk when we cross into it.
+		if (m_iXPos < m_regWrite.getUpperX())
+		{
+			m_iXPos++;
+			if ((m_iXPos & m_iChunkMask) == 0)
+			{
+				const size_t uRowChunk = (m_iXPos >> m_uChunkSideLengthPower) - (m_regWrite.getLowerX() >> m_uChunkSideLengthPower);
+				m_pCurrentChunk = m_vecRowChunks[uRowChunk].get();
+				m_pCurrentChunkData = m_vecRowChunkData[uRowChunk];
+				m_pCurrentChunkWritten = &m_vecRowChunkWritten[uRowChunk];
+			}
+			return;
+		}
+
+		const int32_t iOldYChunk = m_iYPos >> m_uChunkSideLengthPower;
+		const int32_t iOldZChunk = m_iZPos >> m_uChunkSideLengthPower;
+		m_iXPos = m_regWrite.getLowerX();
+		if (m_iYPos < m_regWrite.getUpperY())
+		{
+			m_iYPos++;
+		}
+		else if (m_iZPos < m_regWrite.getUpperZ())
+		{
+			m_iYPos = m_regWrite.getLowerY();
+			m_iZPos++;
+		}
+		else
+		{
+			m_bFinished = true;
+			releaseChunkRow();
+			return;
+		}
+
+		if (((m_iYPos >> m_uChunkSideLengthPower) != iOldYChunk) || ((m_iZPos >> m_uChunkSideLengthPower) != iOldZChunk))
+		{
+			beginChunkRow();
+		}
+		else
+		{
+			m_uYZIndex = morton256_y[m_iYPos & m_iChunkMask] | morton256_z[m_iZPos & m_iChunkMask];
+			m_pCurrentChunk = m_vecRowChunks[0].get();
+			m_pCurrentChunkData = m_vecRowChunkData[0];
+			m_pCurrentChunkWritten = &m_vecRowChunkWritten[0];
+		}
+	}
+
+	template <typename VoxelType>
+	Vector3DInt32 PagedVolume<VoxelType>::RegionWriter::getPosition(void) const
+	{
+		return Vector3DInt32(m_iXPos, m_iYPos, m_iZPos);
+	}
+
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::RegionWriter::isFinished(void) const
+	{
+		return m_bFinished;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Pins and makes writable all the chunks which the current row passes through. This is also used to make them writable again
+	/// after a snapshot has been taken.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::RegionWriter::beginChunkRow(void)
+	{
+		releaseChunkRow();
+
+		// If a snapshot is taken while we do this then the generation will not match on the next write, and we will come back here.
+		m_uSnapshotGeneration = m_pVolume->m_uSnapshotGeneration.load(std::memory_order_relaxed);
+
+		const int32_t iYChunk = m_iYPos >> m_uChunkSideLengthPower;
+		const int32_t iZChunk = m_iZPos >> m_uChunkSideLengthPower;
+		for (int32_t iXChunk = m_regWrite.getLowerX() >> m_uChunkSideLengthPower; iXChunk <= m_regWrite.getUpperX() >> m_uChunkSideLengthPower; iXChunk++)
+		{
+			VoxelType* pChunkData = nullptr;
+			m_vecRowChunks.push_back(ChunkHandle(m_pVolume, m_pVolume->getChunk(iXChunk, iYChunk, iZChunk, true, true, &pChunkData)));
+			m_vecRowChunkData.push_back(pChunkData);
+			m_vecRowChunkWritten.push_back(0);
+		}
+
+		m_uYZIndex = morton256_y[m_iYPos & m_iChunkMask] | morton256_z[m_iZPos & m_iChunkMask];
+		const size_t uRowChunk = (m_iXPos >> m_uChunkSideLengthPower) - (m_regWrite.getLowerX() >> m_uChunkSideLengthPower);
+		m_pCurrentChunk = m_vecRowChunks[uRowChunk].get();
+		m_pCurrentChunkData = m_vecRowChunkData[uRowChunk];
+		m_pCurrentChunkWritten = &m_vecRowChunkWritten[uRowChunk];
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Unpins the chunks of the current row, marking those which were written to as modified.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::RegionWriter::releaseChunkRow(void)
+	{
+		for (size_t uRowChunk = 0; uRowChunk < m_vecRowChunks.size(); uRowChunk++)
+		{
+			if (m_vecRowChunkWritten[uRowChunk])
+			{
+				m_vecRowChunks[uRowChunk]->m_bDataModified.store(true, std::memory_order_relaxed);
+				m_pVolume->updateChunkVersion(m_vecRowChunks[uRowChunk].get());
+			}
+		}
+
+		m_vecRowChunks.clear();
+		m_vecRowChunkData.clear();
+		m_vecRowChunkWritten.clear();
+		m_pCurrentChunk = nullptr;
+		m_pCurrentChunkData = nullptr;
+		m_pCurrentChunkWritten = nullptr;
+	}
+}
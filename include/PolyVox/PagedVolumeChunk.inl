@@ -23,18 +23,31 @@
 *******************************************************************************/
 
 #include "Impl/Morton.h"
+#include "Impl/RunLengthEncoding.h"
 #include "Impl/Utility.h"
 
 namespace PolyVox
 {
 	template <typename VoxelType>
-	PagedVolume<VoxelType>::Chunk::Chunk(Vector3DInt32 v3dPosition, uint16_t uSideLength, Pager* pPager)
-		:m_uChunkLastAccessed(0)
+	PagedVolume<VoxelType>::Chunk::Chunk(Vector3DInt32 v3dPosition, uint16_t uSideLength, Pager* pPager, ChunkBufferPool* pBufferPool, PagerCallCounters* pPagerCallCounters, bool bPageIn)
+		:m_pPrevChunk(nullptr)
+		, m_pNextChunk(nullptr)
+		, m_uChunkTableShard(0)
+		, m_uChunkArrayIndex(0)
+		, m_bRecentlyUsed(false)
+		, m_uPinCount(0)
 		, m_bDataModified(true)
+		, m_uVersion(0)
+		, m_bValueRangeStale(true)
+		, m_bExternalData(false)
+		, m_uDataGeneration(0)
+		, m_uSnapshotGeneration(0)
 		, m_tData(0)
 		, m_uSideLength(0)
 		, m_uSideLengthPower(0)
 		, m_pPager(pPager)
+		, m_pBufferPool(pBufferPool)
+		, m_pPagerCallCounters(pPagerCallCounters)
 		, m_v3dChunkSpacePosition(v3dPosition)
 	{
 		POLYVOX_ASSERT(m_pPager, "No valid pager supplied to chunk constructor.");
@@ -45,20 +58,19 @@ namespace PolyVox
 		m_uSideLengthPower = logBase2(uSideLength);
 
 		// Allocate the data
-		const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
-		m_tData = new VoxelType[uNoOfVoxels];
-
-		// Pass the chunk to the Pager to give it a chance to initialise it with any data
-		// From the coordinates of the chunk we deduce the coordinates of the contained voxels.
-		Vector3DInt32 v3dLower = m_v3dChunkSpacePosition * static_cast<int32_t>(m_uSideLength);
-		Vector3DInt32 v3dUpper = v3dLower + Vector3DInt32(m_uSideLength - 1, m_uSideLength - 1, m_uSideLength - 1);
-		Region reg(v3dLower, v3dUpper);
+		m_tData = allocateData();
 
-		// A valid pager is normally present - this check is mostly to ease unit testing.
-		if (m_pPager)
+		// Pass the chunk to the Pager to give it a chance to initialise it with any data. A valid pager is normally
+		// present - this check is mostly to ease unit testing.
+		if (m_pPager && bPageIn)
 		{
 			// Page the data in
-			m_pPager->pageIn(reg, this);
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			m_pPager->pageIn(getRegion(), this);
+			if (m_pPagerCallCounters)
+			{
+				m_pPagerCallCounters->recordPageIn(std::chrono::steady_clock::now() - start);
+			}
 		}
 
 		// We'll use this later to decide if data needs to be paged out again.
@@ -70,18 +82,46 @@ namespace PolyVox
 	{
 		if (m_bDataModified && m_pPager)
 		{
-			// From the coordinates of the chunk we deduce the coordinates of the contained voxels.
-			Vector3DInt32 v3dLower = m_v3dChunkSpacePosition * static_cast<int32_t>(m_uSideLength);
-			Vector3DInt32 v3dUpper = v3dLower + Vector3DInt32(m_uSideLength - 1, m_uSideLength - 1, m_uSideLength - 1);
+			// The Pager expects to see the raw voxel data.
+			if (isCompressed())
+			{
+				decompress();
+			}
 
-			// Page the data out
-			m_pPager->pageOut(Region(v3dLower, v3dUpper), this);
+			writeToPager();
 		}
 
-		delete[] m_tData;
+		// Homogeneous chunks and those using external data do not own it.
+		if (!isShared())
+		{
+			freeData(m_tData);
+		}
 		m_tData = 0;
 	}
 
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Chunk::writeToPager(void)
+	{
+		POLYVOX_ASSERT(!isCompressed(), "Compressed chunks must be decompressed before they are written to the pager");
+
+		// Page the data out
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		m_pPager->pageOut(getRegion(), this);
+		if (m_pPagerCallCounters)
+		{
+			m_pPagerCallCounters->recordPageOut(std::chrono::steady_clock::now() - start);
+		}
+	}
+
+	template <typename VoxelType>
+	Region PagedVolume<VoxelType>::Chunk::getRegion(void) const
+	{
+		// From the coordinates of the chunk we deduce the coordinates of the contained voxels.
+		Vector3DInt32 v3dLower = m_v3dChunkSpacePosition * static_cast<int32_t>(m_uSideLength);
+		Vector3DInt32 v3dUpper = v3dLower + Vector3DInt32(m_uSideLength - 1, m_uSideLength - 1, m_uSideLength - 1);
+		return Region(v3dLower, v3dUpper);
+	}
+
 	template <typename VoxelType>
 	VoxelType* PagedVolume<VoxelType>::Chunk::getData(void) const
 	{
@@ -124,12 +164,15 @@ namespace PolyVox
 		POLYVOX_ASSERT(uYPos < m_uSideLength, "Supplied position is outside of the chunk");
 		POLYVOX_ASSERT(uZPos < m_uSideLength, "Supplied position is outside of the chunk");
 		POLYVOX_ASSERT(m_tData, "No uncompressed data - chunk must be decompressed before accessing voxels.");
+		POLYVOX_ASSERT(!isShared(), "Data is shared - homogeneous or external chunk must be expanded before modifying voxels.");
 
 		uint32_t index = morton256_x[uXPos] | morton256_y[uYPos] | morton256_z[uZPos];
 
 		m_tData[index] = tValue;
+		m_bValueRangeStale.store(true, std::memory_order_release);
 
-		this->m_bDataModified = true;
+		// Relaxed ordering is enough as the flag is only read once the writing thread has given up the chunk, and it keeps this cheap.
+		this->m_bDataModified.store(true, std::memory_order_relaxed);
 	}
 
 	template <typename VoxelType>
@@ -141,6 +184,19 @@ namespace PolyVox
 	template <typename VoxelType>
 	uint32_t PagedVolume<VoxelType>::Chunk::calculateSizeInBytes(void)
 	{
+		// Compressed chunks are small enough that the chunk object itself is a significant part of their size.
+		if (isCompressed())
+		{
+			return static_cast<uint32_t>(m_vecCompressedData.capacity() + sizeof(Chunk));
+		}
+
+		// Homogeneous chunks share their data, so the chunk object is all they use. External data is not counted either, as it
+		// belongs to the Pager.
+		if (isShared())
+		{
+			return sizeof(Chunk);
+		}
+
 		// Call through to the static version
 		return calculateSizeInBytes(m_uSideLength);
 	}
@@ -154,6 +210,246 @@ namespace PolyVox
 		return  uSizeInBytes;
 	}
 
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Chunk::calculateValueRange(void)
+	{
+		POLYVOX_ASSERT(!isCompressed(), "Chunk must be decompressed before calculating the range of its values");
+
+		// The flag is cleared before reading the voxels, so that any write we miss sets it again.
+		m_bValueRangeStale.exchange(false, std::memory_order_acquire);
+
+		// Shared data has the same value throughout if the chunk is homogeneous, but not if it is external.
+		m_valueRange.set(m_tData, isHomogeneous() ? 1 : m_uSideLength * m_uSideLength * m_uSideLength);
+	}
+
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::Chunk::isHomogeneous(void) const
+	{
+		return isShared() && !m_bExternalData;
+	}
+
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::Chunk::isShared(void) const
+	{
+		return m_pSharedData != nullptr;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This is intended to be called from Pager::pageIn(), and allows data which is already in memory in the right form (such as chunk
+	/// records in a memory mapped file, see MappedFilePager) to be used without copying it. The data must be in Morton order and must
+	/// not change while the chunk (or any snapshot of the volume) is using it. The volume makes a copy of it before the chunk is
+	/// modified, so the Pager will be asked to page out the copy rather than its own data.
+	/// \param pExternalData The voxel data, which is released when it is no longer needed.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Chunk::setExternalData(std::shared_ptr<VoxelType> pExternalData)
+	{
+		POLYVOX_THROW_IF(!pExternalData, std::invalid_argument, "External data must not be null");
+
+		makeHomogeneous(std::move(pExternalData));
+		m_bExternalData = true;
+	}
+
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::Chunk::isCompressed(void) const
+	{
+		return m_tData == nullptr;
+	}
+
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::Chunk::isCompact(void) const
+	{
+		return isCompressed() || isShared();
+	}
+
+	template <typename VoxelType>
+	VoxelType* PagedVolume<VoxelType>::Chunk::allocateData(void) const
+	{
+		const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
+		if (!m_pBufferPool)
+		{
+			return new VoxelType[uNoOfVoxels];
+		}
+
+		POLYVOX_ASSERT(m_pBufferPool->getBufferSizeInBytes() == getDataSizeInBytes(), "Chunk buffer pool has the wrong buffer size");
+
+		// Voxels are copied around with memcpy() so they must be trivially copyable, and hence do not need destroying. The
+		// constructors are still run to match new[], though for most voxel types they do nothing and are optimised away.
+		VoxelType* pData = static_cast<VoxelType*>(m_pBufferPool->acquire());
+		for (uint32_t ct = 0; ct < uNoOfVoxels; ct++)
+		{
+			new (pData + ct) VoxelType;
+		}
+		return pData;
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Chunk::freeData(VoxelType* pData) const
+	{
+		// Compressed chunks have no data to free.
+		if (pData && m_pBufferPool)
+		{
+			m_pBufferPool->release(pData);
+		}
+		else
+		{
+			delete[] pData;
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Checks whether all voxels in the chunk have the same value. As with the run length encoding, voxels are compared bytewise.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::Chunk::hasSingleValue(void) const
+	{
+		POLYVOX_ASSERT(!isCompressed(), "Chunk must be decompressed before checking its values");
+
+		const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
+		for (uint32_t uIndex = 1; uIndex < uNoOfVoxels; uIndex++)
+		{
+			if (std::memcmp(m_tData + uIndex, m_tData, sizeof(VoxelType)) != 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Frees the chunk's current data (whether uncompressed, compressed or another shared buffer) and uses the shared buffer instead.
+	/// Unless the whole chunk is being overwritten the shared buffer must contain the same data.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Chunk::makeHomogeneous(std::shared_ptr<VoxelType> pSharedData)
+	{
+		if (isCompressed())
+		{
+			std::vector<uint8_t>().swap(m_vecCompressedData);
+		}
+		else if (!isShared())
+		{
+			freeData(m_tData);
+		}
+
+		m_tData = pSharedData.get();
+		m_uDataGeneration.fetch_add(1, std::memory_order_relaxed);
+		m_pSharedData = std::move(pSharedData);
+		m_bExternalData = false;
+		m_vecRetiredData.clear();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Gives a homogeneous chunk (or one using external data) its own copy of the data, so that it can be modified.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Chunk::expand(void)
+	{
+		POLYVOX_ASSERT(isShared(), "Chunk does not share its data");
+
+		VoxelType* pData = allocateData();
+		std::memcpy(pData, m_tData, getDataSizeInBytes());
+
+		m_tData = pData;
+		m_uDataGeneration.fetch_add(1, std::memory_order_relaxed);
+		m_bExternalData = false;
+		m_vecRetiredData.push_back(std::move(m_pSharedData));
+	}
+
+	template <typename VoxelType>
+	std::shared_ptr<VoxelType> PagedVolume<VoxelType>::Chunk::detachData(void)
+	{
+		POLYVOX_ASSERT(!isCompact(), "Chunk must have its own uncompressed data to detach it");
+
+		// The buffer may have come from the volume's pool, in which case it must go back there.
+		ChunkBufferPool* pBufferPool = m_pBufferPool;
+		std::shared_ptr<VoxelType> pOldData(m_tData, [pBufferPool](VoxelType* pData)
+		{
+			if (pBufferPool)
+			{
+				pBufferPool->release(pData);
+			}
+			else
+			{
+				delete[] pData;
+			}
+		});
+
+		VoxelType* pData = allocateData();
+		std::memcpy(pData, m_tData, getDataSizeInBytes());
+
+		m_tData = pData;
+		m_uDataGeneration.fetch_add(1, std::memory_order_relaxed);
+		m_vecRetiredData.push_back(pOldData);
+		return pOldData;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Compresses the voxel data and frees the uncompressed copy. If compressing would not save any memory then the chunk is left as
+	/// it is and false is returned.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::Chunk::compress(void)
+	{
+		POLYVOX_ASSERT(!isCompact(), "Chunk is already compressed or homogeneous");
+
+		// Compressed chunks cannot be written to, so this gives them a range which stays valid until they are decompressed.
+		if (m_bValueRangeStale.load(std::memory_order_relaxed))
+		{
+			calculateValueRange();
+		}
+
+		compressRunLength(m_tData, m_uSideLength * m_uSideLength * m_uSideLength, m_vecCompressedData);
+		if (m_vecCompressedData.size() + sizeof(Chunk) >= getDataSizeInBytes())
+		{
+			std::vector<uint8_t>().swap(m_vecCompressedData);
+			return false;
+		}
+
+		m_vecCompressedData.shrink_to_fit();
+
+		freeData(m_tData);
+		m_tData = nullptr;
+		m_uDataGeneration.fetch_add(1, std::memory_order_relaxed);
+		m_vecRetiredData.clear();
+		return true;
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Chunk::decompress(void)
+	{
+		POLYVOX_ASSERT(isCompressed(), "Chunk is not compressed");
+
+		VoxelType* pData = allocateData();
+		try
+		{
+			copyData(pData);
+		}
+		catch (...)
+		{
+			freeData(pData);
+			throw;
+		}
+
+		// Swapping with an empty vector is the only way to be sure the memory is released.
+		std::vector<uint8_t>().swap(m_vecCompressedData);
+		m_tData = pData;
+		m_uDataGeneration.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Chunk::copyData(VoxelType* pData) const
+	{
+		if (!isCompressed())
+		{
+			std::memcpy(pData, m_tData, getDataSizeInBytes());
+			return;
+		}
+
+		const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
+		decompressRunLength(m_vecCompressedData.data(), m_vecCompressedData.size(), pData, uNoOfVoxels);
+	}
+
 	// This convienience function exists for historical reasons. Chunks used to store their data in 'linear' order but now we
 	// use Morton encoding. Users who still have data in linear order (on disk, in databases, etc) will need to call this function
 	// if they load the data in by memcpy()ing it via the raw pointer. On the other hand, if they set the data using setVoxel()
@@ -161,34 +457,20 @@ namespace PolyVox
 	template <typename VoxelType>
 	void PagedVolume<VoxelType>::Chunk::changeLinearOrderingToMorton(void)
 	{
-		VoxelType* pTempBuffer = new VoxelType[m_uSideLength * m_uSideLength * m_uSideLength];
-
-		// We should prehaps restructure this loop. From: https://fgiesen.wordpress.com/2011/01/17/texture-tiling-and-swizzling/
-		//
-		// "There's two basic ways to structure the actual swizzling: either you go through the (linear) source image in linear order, 
-		// writing in (somewhat) random order, or you iterate over the output data, picking the right source pixel for each target
-		// location. The former is more natural, especially when updating subrects of the destination texture (the source pixels still
-		// consist of one linear sequence of bytes per line; the pattern of destination addresses written is considerably more
-		// complicated), but the latter is usually much faster, especially if the source image data is in cached memory while the output
-		// data resides in non-cached write-combined memory where non-sequential writes are expensive."
-		//
-		// This is something to consider if profiling identifies it as a hotspot.
-		for (uint16_t z = 0; z < m_uSideLength; z++)
-		{
-			for (uint16_t y = 0; y < m_uSideLength; y++)
-			{
-				for (uint16_t x = 0; x < m_uSideLength; x++)
-				{
-					uint32_t uLinearIndex = x + y * m_uSideLength + z * m_uSideLength * m_uSideLength;
-					uint32_t uMortonIndex = morton256_x[x] | morton256_y[y] | morton256_z[z];
-					pTempBuffer[uMortonIndex] = m_tData[uLinearIndex];
-				}
-			}
+		// The ordering makes no difference if all the voxels are the same (and the data is shared so must not be written).
+		if (isHomogeneous())
+		{
+			return;
 		}
+		POLYVOX_THROW_IF(isShared(), invalid_operation, "External data must already be in Morton order");
 
-		std::memcpy(m_tData, pTempBuffer, getDataSizeInBytes());
+		VoxelType* pTempBuffer = allocateData();
+		convertLinearOrderingToMorton(m_tData, pTempBuffer, m_uSideLength);
 
-		delete[] pTempBuffer;
+		// The reordered data simply replaces the old buffer, rather than being copied back into it.
+		freeData(m_tData);
+		m_tData = pTempBuffer;
+		m_uDataGeneration.fetch_add(1, std::memory_order_relaxed);
 	}
 
 	// Like the above function, this is provided fot easing backwards compatibility. In Cubiquity we have some
@@ -196,22 +478,19 @@ namespace PolyVox
 	template <typename VoxelType>
 	void PagedVolume<VoxelType>::Chunk::changeMortonOrderingToLinear(void)
 	{
-		VoxelType* pTempBuffer = new VoxelType[m_uSideLength * m_uSideLength * m_uSideLength];
-		for (uint16_t z = 0; z < m_uSideLength; z++)
+		// The ordering makes no difference if all the voxels are the same (and the data is shared so must not be written).
+		if (isHomogeneous())
 		{
-			for (uint16_t y = 0; y < m_uSideLength; y++)
-			{
-				for (uint16_t x = 0; x < m_uSideLength; x++)
-				{
-					uint32_t uLinearIndex = x + y * m_uSideLength + z * m_uSideLength * m_uSideLength;
-					uint32_t uMortonIndex = morton256_x[x] | morton256_y[y] | morton256_z[z];
-					pTempBuffer[uLinearIndex] = m_tData[uMortonIndex];
-				}
-			}
+			return;
 		}
+		POLYVOX_THROW_IF(isShared(), invalid_operation, "External data must already be in Morton order");
 
-		std::memcpy(m_tData, pTempBuffer, getDataSizeInBytes());
+		VoxelType* pTempBuffer = allocateData();
+		convertMortonOrderingToLinear(m_tData, pTempBuffer, m_uSideLength);
 
-		delete[] pTempBuffer;
+		// The reordered data simply replaces the old buffer, rather than being copied back into it.
+		freeData(m_tData);
+		m_tData = pTempBuffer;
+		m_uDataGeneration.fetch_add(1, std::memory_order_relaxed);
 	}
 }
@@ -48,19 +48,155 @@ namespace PolyVox
 
 	template <typename VoxelType>
 	PagedVolume<VoxelType>::Sampler::Sampler(PagedVolume<VoxelType>* volume)
-		:BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >(volume), m_uChunkSideLengthMinusOne(volume->m_uChunkSideLength - 1)
-	{
+		:BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >(volume)
+		, mCurrentVoxel(nullptr)
+		, m_pCurrentChunk(nullptr)
+		, m_pCurrentChunkData(nullptr)
+		, m_uCurrentChunkDataGeneration(0)
+		, m_bCheckDataGeneration(volume->m_bConcurrentAccess)
+		, m_pPrevSampler(nullptr)
+		, m_pNextSampler(nullptr)
+		, m_bCurrentChunkWritable(false)
+		, m_uWritableSnapshotGeneration(0)
+		, m_uCurrentSlotX(0)
+		, m_uCurrentSlotY(0)
+		, m_uCurrentSlotZ(0)
+		, m_uChunkSideLengthMinusOne(volume->m_uChunkSideLength - 1)
+	{
+		std::fill(m_arrayCachedChunks, m_arrayCachedChunks + 27, nullptr);
+		std::fill(m_arrayCachedChunkData, m_arrayCachedChunkData + 27, nullptr);
+		std::fill(m_arrayCachedChunkDataGeneration, m_arrayCachedChunkDataGeneration + 27, 0);
+		linkSampler();
+	}
+
+	template <typename VoxelType>
+	PagedVolume<VoxelType>::Sampler::Sampler(const Sampler& rhs)
+		:BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >(rhs)
+		, mCurrentVoxel(rhs.mCurrentVoxel)
+		, m_pCurrentChunk(rhs.m_pCurrentChunk)
+		, m_pCurrentChunkData(rhs.m_pCurrentChunkData)
+		, m_uCurrentChunkDataGeneration(rhs.m_uCurrentChunkDataGeneration)
+		, m_bCheckDataGeneration(rhs.m_bCheckDataGeneration)
+		, m_pPrevSampler(nullptr)
+		, m_pNextSampler(nullptr)
+		, m_bCurrentChunkWritable(rhs.m_bCurrentChunkWritable)
+		, m_uWritableSnapshotGeneration(rhs.m_uWritableSnapshotGeneration)
+		, m_uCurrentSlotX(rhs.m_uCurrentSlotX)
+		, m_uCurrentSlotY(rhs.m_uCurrentSlotY)
+		, m_uCurrentSlotZ(rhs.m_uCurrentSlotZ)
+		, m_uXPosInChunk(rhs.m_uXPosInChunk)
+		, m_uYPosInChunk(rhs.m_uYPosInChunk)
+		, m_uZPosInChunk(rhs.m_uZPosInChunk)
+		, m_uChunkSideLengthMinusOne(rhs.m_uChunkSideLengthMinusOne)
+	{
+		// The copy needs its own pins on the chunks, as each sampler releases its pins when it is destroyed.
+		for (uint32_t ct = 0; ct < 27; ct++)
+		{
+			m_arrayCachedChunks[ct] = rhs.m_arrayCachedChunks[ct];
+			m_arrayCachedChunkData[ct] = rhs.m_arrayCachedChunkData[ct];
+			m_arrayCachedChunkDataGeneration[ct] = rhs.m_arrayCachedChunkDataGeneration[ct];
+			if (m_arrayCachedChunks[ct])
+			{
+				m_arrayCachedChunks[ct]->m_uPinCount++;
+			}
+		}
+		linkSampler();
 	}
 
 	template <typename VoxelType>
 	PagedVolume<VoxelType>::Sampler::~Sampler()
 	{
+		releaseCachedChunks();
+		unlinkSampler();
+	}
+
+	template <typename VoxelType>
+	typename PagedVolume<VoxelType>::Sampler& PagedVolume<VoxelType>::Sampler::operator=(const Sampler& rhs)
+	{
+		// Pin first, in case both samplers are using the same chunks.
+		for (uint32_t ct = 0; ct < 27; ct++)
+		{
+			if (rhs.m_arrayCachedChunks[ct])
+			{
+				rhs.m_arrayCachedChunks[ct]->m_uPinCount++;
+			}
+		}
+		releaseCachedChunks();
+		unlinkSampler();
+		for (uint32_t ct = 0; ct < 27; ct++)
+		{
+			m_arrayCachedChunks[ct] = rhs.m_arrayCachedChunks[ct];
+			m_arrayCachedChunkData[ct] = rhs.m_arrayCachedChunkData[ct];
+			m_arrayCachedChunkDataGeneration[ct] = rhs.m_arrayCachedChunkDataGeneration[ct];
+		}
+
+		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >::operator=(rhs);
+		mCurrentVoxel = rhs.mCurrentVoxel;
+		m_pCurrentChunk = rhs.m_pCurrentChunk;
+		m_pCurrentChunkData = rhs.m_pCurrentChunkData;
+		m_uCurrentChunkDataGeneration = rhs.m_uCurrentChunkDataGeneration;
+		m_bCheckDataGeneration = rhs.m_bCheckDataGeneration;
+		m_bCurrentChunkWritable = rhs.m_bCurrentChunkWritable;
+		m_uWritableSnapshotGeneration = rhs.m_uWritableSnapshotGeneration;
+		m_uCurrentSlotX = rhs.m_uCurrentSlotX;
+		m_uCurrentSlotY = rhs.m_uCurrentSlotY;
+		m_uCurrentSlotZ = rhs.m_uCurrentSlotZ;
+		m_uXPosInChunk = rhs.m_uXPosInChunk;
+		m_uYPosInChunk = rhs.m_uYPosInChunk;
+		m_uZPosInChunk = rhs.m_uZPosInChunk;
+		m_uChunkSideLengthMinusOne = rhs.m_uChunkSideLengthMinusOne;
+		linkSampler();
+		return *this;
 	}
 
 	template <typename VoxelType>
 	VoxelType PagedVolume<VoxelType>::Sampler::getVoxel(void) const
 	{
-		return *mCurrentVoxel;
+		return *getCurrentVoxel();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Adds the sampler to its volume's list, unless the volume allows concurrent access.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Sampler::linkSampler(void)
+	{
+		if (this->mVolume->m_bConcurrentAccess)
+		{
+			return;
+		}
+
+		m_pPrevSampler = nullptr;
+		m_pNextSampler = this->mVolume->m_pFirstSampler;
+		if (m_pNextSampler)
+		{
+			m_pNextSampler->m_pPrevSampler = this;
+		}
+		this->mVolume->m_pFirstSampler = this;
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Sampler::unlinkSampler(void)
+	{
+		if (this->mVolume->m_bConcurrentAccess)
+		{
+			return;
+		}
+
+		if (m_pPrevSampler)
+		{
+			m_pPrevSampler->m_pNextSampler = m_pNextSampler;
+		}
+		else
+		{
+			this->mVolume->m_pFirstSampler = m_pNextSampler;
+		}
+		if (m_pNextSampler)
+		{
+			m_pNextSampler->m_pPrevSampler = m_pPrevSampler;
+		}
+		m_pPrevSampler = nullptr;
+		m_pNextSampler = nullptr;
 	}
 
 	template <typename VoxelType>
@@ -86,18 +222,192 @@ namespace PolyVox
 
 		uint32_t uVoxelIndexInChunk = morton256_x[m_uXPosInChunk] | morton256_y[m_uYPosInChunk] | morton256_z[m_uZPosInChunk];
 
-		auto pCurrentChunk = this->mVolume->canReuseLastAccessedChunk(uXChunk, uYChunk, uZChunk) ?
-			this->mVolume->m_pLastAccessedChunk : this->mVolume->getChunk(uXChunk, uYChunk, uZChunk);
-
-		mCurrentVoxel = pCurrentChunk->m_tData + uVoxelIndexInChunk;
+		// The sampler keeps its chunk pinned so it cannot be evicted (by this or another thread) while we are pointing into it.
+		// Moving to another chunk (which is what happens when the move functions cross a chunk boundary) usually finds it already
+		// pinned in its slot, and otherwise replaces whichever chunk was in that slot.
+		if (!m_pCurrentChunk || (uXChunk != m_pCurrentChunk->m_v3dChunkSpacePosition.getX()) ||
+			(uYChunk != m_pCurrentChunk->m_v3dChunkSpacePosition.getY()) || (uZChunk != m_pCurrentChunk->m_v3dChunkSpacePosition.getZ()))
+		{
+			m_uCurrentSlotX = getCacheSlot(uXChunk);
+			m_uCurrentSlotY = getCacheSlot(uYChunk);
+			m_uCurrentSlotZ = getCacheSlot(uZChunk);
+			m_pCurrentChunk = getCachedChunk(m_uCurrentSlotX + m_uCurrentSlotY * 3 + m_uCurrentSlotZ * 9, uXChunk, uYChunk, uZChunk);
+			m_bCurrentChunkWritable = false;
+			refreshCurrentChunkData();
+		}
+		else
+		{
+			// Staying in the same chunk, whose data is checked when it is next read (in concurrent mode).
+			mCurrentVoxel = m_pCurrentChunkData + uVoxelIndexInChunk;
+		}
 	}
 
+	////////////////////////////////////////////////////////////////////////////////
+	/// Writes through the sampler's pointer into the current chunk, so after the first write to a chunk this is much cheaper than
+	/// PagedVolume::setVoxel().
+	/// \param tValue The value to which the voxel at the current position will be set.
+	/// \return Always true, as every position in a PagedVolume can be written.
+	////////////////////////////////////////////////////////////////////////////////
 	template <typename VoxelType>
 	bool PagedVolume<VoxelType>::Sampler::setVoxel(VoxelType tValue)
 	{
-		//Need to think what effect this has on any existing iterators.
-		POLYVOX_THROW(not_implemented, "This function cannot be used on PagedVolume samplers.");
-		return false;
+		// In concurrent mode this makes a snapshot which is being taken wait for the write (see PagedVolume::snapshot()).
+		typename PagedVolume<VoxelType>::WriteScope writeScope(this->mVolume);
+
+		if (!m_bCurrentChunkWritable || (m_uWritableSnapshotGeneration != this->mVolume->m_uSnapshotGeneration.load(std::memory_order_relaxed)) ||
+			(m_uCurrentChunkDataGeneration != m_pCurrentChunk->m_uDataGeneration.load(std::memory_order_relaxed)))
+		{
+			prepareCurrentChunkForWrite();
+		}
+
+		*mCurrentVoxel = tValue;
+		m_pCurrentChunk->m_bValueRangeStale.store(true, std::memory_order_release);
+		m_pCurrentChunk->m_bDataModified.store(true, std::memory_order_relaxed);
+		this->mVolume->updateChunkVersion(m_pCurrentChunk);
+		return true;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Makes the current chunk writable (expanding it, or giving its data to any snapshots), and points the sampler at its data.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Sampler::prepareCurrentChunkForWrite(void)
+	{
+		// If a snapshot is taken while we do this then the generation will not match on the next write, and we will come back here.
+		const uint32_t uSnapshotGeneration = this->mVolume->m_uSnapshotGeneration.load(std::memory_order_relaxed);
+
+		// The chunk is already pinned, so this gives the same chunk. The extra pin is then released, and the sampler points into
+		// the chunk's data again as making it writable may have replaced it.
+		const Vector3DInt32& v3dChunkPos = m_pCurrentChunk->m_v3dChunkSpacePosition;
+		this->mVolume->getChunk(v3dChunkPos.getX(), v3dChunkPos.getY(), v3dChunkPos.getZ(), true, true);
+		this->mVolume->unpinChunk(m_pCurrentChunk);
+
+		refreshCurrentChunkData();
+		m_bCurrentChunkWritable = true;
+		m_uWritableSnapshotGeneration = uSnapshotGeneration;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Gets the sampler's pointer to the current voxel. In concurrent mode it is first pointed into the current chunk's new data if
+	/// the chunk has been given some since the pointer was set (such as when a homogeneous chunk is expanded by a write through the
+	/// volume). Otherwise the volume has already done this.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	const VoxelType* PagedVolume<VoxelType>::Sampler::getCurrentVoxel(void) const
+	{
+		if (m_bCheckDataGeneration && (m_pCurrentChunk->m_uDataGeneration.load(std::memory_order_relaxed) != m_uCurrentChunkDataGeneration))
+		{
+			refreshCurrentChunkData();
+		}
+		return mCurrentVoxel;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Reads the current chunk's data pointer (and its generation) again, and points mCurrentVoxel at the current position in it.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Sampler::refreshCurrentChunkData(void) const
+	{
+		// The generation is read first, so if the data is replaced in between we will simply read it again next time.
+		m_uCurrentChunkDataGeneration = m_pCurrentChunk->m_uDataGeneration.load(std::memory_order_relaxed);
+		m_pCurrentChunkData = this->mVolume->getPinnedChunkData(m_pCurrentChunk);
+		mCurrentVoxel = m_pCurrentChunkData + (morton256_x[m_uXPosInChunk] | morton256_y[m_uYPosInChunk] | morton256_z[m_uZPosInChunk]);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Gets the slot (on one axis) for chunks at the given position, which is the position modulo three.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	uint8_t PagedVolume<VoxelType>::Sampler::getCacheSlot(int32_t iChunkPos)
+	{
+		const int32_t iSlot = iChunkPos % 3;
+		return static_cast<uint8_t>((iSlot < 0) ? iSlot + 3 : iSlot);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Gets the chunk at the given position from the given slot. If the slot holds a different chunk (or none) then the one we
+	/// want is found and pinned, and takes its place.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	typename PagedVolume<VoxelType>::Chunk* PagedVolume<VoxelType>::Sampler::getCachedChunk(uint32_t uSlot, int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const
+	{
+		Chunk* pChunk = m_arrayCachedChunks[uSlot];
+		if (pChunk && (pChunk->m_v3dChunkSpacePosition.getX() == iChunkX) && (pChunk->m_v3dChunkSpacePosition.getY() == iChunkY) &&
+			(pChunk->m_v3dChunkSpacePosition.getZ() == iChunkZ))
+		{
+			return pChunk;
+		}
+
+		Chunk* pNewChunk = this->mVolume->getChunk(iChunkX, iChunkY, iChunkZ, true);
+		if (pChunk)
+		{
+			this->mVolume->unpinChunk(pChunk);
+		}
+		m_arrayCachedChunks[uSlot] = pNewChunk;
+		m_arrayCachedChunkData[uSlot] = nullptr;
+		return pNewChunk;
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Sampler::releaseCachedChunks(void)
+	{
+		for (uint32_t ct = 0; ct < 27; ct++)
+		{
+			if (m_arrayCachedChunks[ct])
+			{
+				this->mVolume->unpinChunk(m_arrayCachedChunks[ct]);
+				m_arrayCachedChunks[ct] = nullptr;
+				m_arrayCachedChunkData[ct] = nullptr;
+			}
+		}
+		m_pCurrentChunk = nullptr;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Gets the data of the chunk at the given offset (in chunks) from the current one, finding and pinning the chunk if it is not
+	/// already in its slot.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	const VoxelType* PagedVolume<VoxelType>::Sampler::getNeighbourChunkData(int32_t iXOffset, int32_t iYOffset, int32_t iZOffset) const
+	{
+		const uint32_t uSlot = (m_uCurrentSlotX + 3 + iXOffset) % 3 + ((m_uCurrentSlotY + 3 + iYOffset) % 3) * 3 + ((m_uCurrentSlotZ + 3 + iZOffset) % 3) * 9;
+		const Vector3DInt32& v3dCurrentChunkPos = m_pCurrentChunk->m_v3dChunkSpacePosition;
+		Chunk* pChunk = getCachedChunk(uSlot, v3dCurrentChunkPos.getX() + iXOffset, v3dCurrentChunkPos.getY() + iYOffset, v3dCurrentChunkPos.getZ() + iZOffset);
+
+		// Without concurrent access the chunk's data can be read directly, which means writes through the volume are always seen.
+		if (!this->mVolume->m_bConcurrentAccess)
+		{
+			return pChunk->m_tData;
+		}
+
+		// Otherwise the pointer is only read (under the lock) when the chunk has been given new data, as for the current chunk.
+		const uint32_t uDataGeneration = pChunk->m_uDataGeneration.load(std::memory_order_relaxed);
+		if (!m_arrayCachedChunkData[uSlot] || (m_arrayCachedChunkDataGeneration[uSlot] != uDataGeneration))
+		{
+			m_arrayCachedChunkDataGeneration[uSlot] = uDataGeneration;
+			m_arrayCachedChunkData[uSlot] = this->mVolume->getPinnedChunkData(pChunk);
+		}
+		return m_arrayCachedChunkData[uSlot];
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Used by the peek functions when the voxel they need is in one of the neighbouring chunks.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxelInNeighbourhood(int32_t iXOffset, int32_t iYOffset, int32_t iZOffset) const
+	{
+		const int32_t iXPosInChunk = this->m_uXPosInChunk + iXOffset;
+		const int32_t iYPosInChunk = this->m_uYPosInChunk + iYOffset;
+		const int32_t iZPosInChunk = this->m_uZPosInChunk + iZOffset;
+
+		// Work out which chunk the voxel is in, and then wrap its position into that chunk.
+		const VoxelType* pChunkData = getNeighbourChunkData(
+			(iXPosInChunk < 0) ? -1 : ((iXPosInChunk > this->m_uChunkSideLengthMinusOne) ? 1 : 0),
+			(iYPosInChunk < 0) ? -1 : ((iYPosInChunk > this->m_uChunkSideLengthMinusOne) ? 1 : 0),
+			(iZPosInChunk < 0) ? -1 : ((iZPosInChunk > this->m_uChunkSideLengthMinusOne) ? 1 : 0));
+		return pChunkData[morton256_x[iXPosInChunk & this->m_uChunkSideLengthMinusOne] |
+			morton256_y[iYPosInChunk & this->m_uChunkSideLengthMinusOne] |
+			morton256_z[iZPosInChunk & this->m_uChunkSideLengthMinusOne]];
 	}
 
 	template <typename VoxelType>
@@ -225,9 +535,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_NEG_Y(this->m_uYPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_X_DELTA + NEG_Y_DELTA + NEG_Z_DELTA);
+			return *(getCurrentVoxel() + NEG_X_DELTA + NEG_Y_DELTA + NEG_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume - 1, this->mZPosInVolume - 1);
+		return peekVoxelInNeighbourhood(-1, -1, -1);
 	}
 
 	template <typename VoxelType>
@@ -235,9 +545,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_NEG_Y(this->m_uYPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_X_DELTA + NEG_Y_DELTA);
+			return *(getCurrentVoxel() + NEG_X_DELTA + NEG_Y_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume - 1, this->mZPosInVolume);
+		return peekVoxelInNeighbourhood(-1, -1, 0);
 	}
 
 	template <typename VoxelType>
@@ -245,9 +555,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_NEG_Y(this->m_uYPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_X_DELTA + NEG_Y_DELTA + POS_Z_DELTA);
+			return *(getCurrentVoxel() + NEG_X_DELTA + NEG_Y_DELTA + POS_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume - 1, this->mZPosInVolume + 1);
+		return peekVoxelInNeighbourhood(-1, -1, 1);
 	}
 
 	template <typename VoxelType>
@@ -255,9 +565,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_X_DELTA + NEG_Z_DELTA);
+			return *(getCurrentVoxel() + NEG_X_DELTA + NEG_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume, this->mZPosInVolume - 1);
+		return peekVoxelInNeighbourhood(-1, 0, -1);
 	}
 
 	template <typename VoxelType>
@@ -265,9 +575,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_X_DELTA);
+			return *(getCurrentVoxel() + NEG_X_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume, this->mZPosInVolume);
+		return peekVoxelInNeighbourhood(-1, 0, 0);
 	}
 
 	template <typename VoxelType>
@@ -275,9 +585,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_X_DELTA + POS_Z_DELTA);
+			return *(getCurrentVoxel() + NEG_X_DELTA + POS_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume, this->mZPosInVolume + 1);
+		return peekVoxelInNeighbourhood(-1, 0, 1);
 	}
 
 	template <typename VoxelType>
@@ -285,9 +595,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_POS_Y(this->m_uYPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_X_DELTA + POS_Y_DELTA + NEG_Z_DELTA);
+			return *(getCurrentVoxel() + NEG_X_DELTA + POS_Y_DELTA + NEG_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume + 1, this->mZPosInVolume - 1);
+		return peekVoxelInNeighbourhood(-1, 1, -1);
 	}
 
 	template <typename VoxelType>
@@ -295,9 +605,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_POS_Y(this->m_uYPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_X_DELTA + POS_Y_DELTA);
+			return *(getCurrentVoxel() + NEG_X_DELTA + POS_Y_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume + 1, this->mZPosInVolume);
+		return peekVoxelInNeighbourhood(-1, 1, 0);
 	}
 
 	template <typename VoxelType>
@@ -305,9 +615,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_POS_Y(this->m_uYPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_X_DELTA + POS_Y_DELTA + POS_Z_DELTA);
+			return *(getCurrentVoxel() + NEG_X_DELTA + POS_Y_DELTA + POS_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume + 1, this->mZPosInVolume + 1);
+		return peekVoxelInNeighbourhood(-1, 1, 1);
 	}
 
 	//////////////////////////////////////////////////////////////////////////
@@ -317,9 +627,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_Y(this->m_uYPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_Y_DELTA + NEG_Z_DELTA);
+			return *(getCurrentVoxel() + NEG_Y_DELTA + NEG_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume - 1, this->mZPosInVolume - 1);
+		return peekVoxelInNeighbourhood(0, -1, -1);
 	}
 
 	template <typename VoxelType>
@@ -327,9 +637,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_Y(this->m_uYPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_Y_DELTA);
+			return *(getCurrentVoxel() + NEG_Y_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume - 1, this->mZPosInVolume);
+		return peekVoxelInNeighbourhood(0, -1, 0);
 	}
 
 	template <typename VoxelType>
@@ -337,9 +647,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_Y(this->m_uYPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_Y_DELTA + POS_Z_DELTA);
+			return *(getCurrentVoxel() + NEG_Y_DELTA + POS_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume - 1, this->mZPosInVolume + 1);
+		return peekVoxelInNeighbourhood(0, -1, 1);
 	}
 
 	template <typename VoxelType>
@@ -347,15 +657,15 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_Z_DELTA);
+			return *(getCurrentVoxel() + NEG_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume, this->mZPosInVolume - 1);
+		return peekVoxelInNeighbourhood(0, 0, -1);
 	}
 
 	template <typename VoxelType>
 	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel0px0py0pz(void) const
 	{
-		return *mCurrentVoxel;
+		return *getCurrentVoxel();
 	}
 
 	template <typename VoxelType>
@@ -363,9 +673,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_Z_DELTA);
+			return *(getCurrentVoxel() + POS_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume, this->mZPosInVolume + 1);
+		return peekVoxelInNeighbourhood(0, 0, 1);
 	}
 
 	template <typename VoxelType>
@@ -373,9 +683,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_Y(this->m_uYPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_Y_DELTA + NEG_Z_DELTA);
+			return *(getCurrentVoxel() + POS_Y_DELTA + NEG_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume + 1, this->mZPosInVolume - 1);
+		return peekVoxelInNeighbourhood(0, 1, -1);
 	}
 
 	template <typename VoxelType>
@@ -383,9 +693,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_Y(this->m_uYPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_Y_DELTA);
+			return *(getCurrentVoxel() + POS_Y_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume + 1, this->mZPosInVolume);
+		return peekVoxelInNeighbourhood(0, 1, 0);
 	}
 
 	template <typename VoxelType>
@@ -393,9 +703,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_Y(this->m_uYPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_Y_DELTA + POS_Z_DELTA);
+			return *(getCurrentVoxel() + POS_Y_DELTA + POS_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume + 1, this->mZPosInVolume + 1);
+		return peekVoxelInNeighbourhood(0, 1, 1);
 	}
 
 	//////////////////////////////////////////////////////////////////////////
@@ -405,9 +715,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_NEG_Y(this->m_uYPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_X_DELTA + NEG_Y_DELTA + NEG_Z_DELTA);
+			return *(getCurrentVoxel() + POS_X_DELTA + NEG_Y_DELTA + NEG_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume - 1, this->mZPosInVolume - 1);
+		return peekVoxelInNeighbourhood(1, -1, -1);
 	}
 
 	template <typename VoxelType>
@@ -415,9 +725,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_NEG_Y(this->m_uYPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_X_DELTA + NEG_Y_DELTA);
+			return *(getCurrentVoxel() + POS_X_DELTA + NEG_Y_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume - 1, this->mZPosInVolume);
+		return peekVoxelInNeighbourhood(1, -1, 0);
 	}
 
 	template <typename VoxelType>
@@ -425,9 +735,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_NEG_Y(this->m_uYPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_X_DELTA + NEG_Y_DELTA + POS_Z_DELTA);
+			return *(getCurrentVoxel() + POS_X_DELTA + NEG_Y_DELTA + POS_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume - 1, this->mZPosInVolume + 1);
+		return peekVoxelInNeighbourhood(1, -1, 1);
 	}
 
 	template <typename VoxelType>
@@ -435,9 +745,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_X_DELTA + NEG_Z_DELTA);
+			return *(getCurrentVoxel() + POS_X_DELTA + NEG_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume, this->mZPosInVolume - 1);
+		return peekVoxelInNeighbourhood(1, 0, -1);
 	}
 
 	template <typename VoxelType>
@@ -445,9 +755,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_X_DELTA);
+			return *(getCurrentVoxel() + POS_X_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume, this->mZPosInVolume);
+		return peekVoxelInNeighbourhood(1, 0, 0);
 	}
 
 	template <typename VoxelType>
@@ -455,9 +765,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_X_DELTA + POS_Z_DELTA);
+			return *(getCurrentVoxel() + POS_X_DELTA + POS_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume, this->mZPosInVolume + 1);
+		return peekVoxelInNeighbourhood(1, 0, 1);
 	}
 
 	template <typename VoxelType>
@@ -465,9 +775,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_POS_Y(this->m_uYPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_X_DELTA + POS_Y_DELTA + NEG_Z_DELTA);
+			return *(getCurrentVoxel() + POS_X_DELTA + POS_Y_DELTA + NEG_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume + 1, this->mZPosInVolume - 1);
+		return peekVoxelInNeighbourhood(1, 1, -1);
 	}
 
 	template <typename VoxelType>
@@ -475,9 +785,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_POS_Y(this->m_uYPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_X_DELTA + POS_Y_DELTA);
+			return *(getCurrentVoxel() + POS_X_DELTA + POS_Y_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume + 1, this->mZPosInVolume);
+		return peekVoxelInNeighbourhood(1, 1, 0);
 	}
 
 	template <typename VoxelType>
@@ -485,9 +795,9 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_POS_Y(this->m_uYPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_X_DELTA + POS_Y_DELTA + POS_Z_DELTA);
+			return *(getCurrentVoxel() + POS_X_DELTA + POS_Y_DELTA + POS_Z_DELTA);
 		}
-		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume + 1, this->mZPosInVolume + 1);
+		return peekVoxelInNeighbourhood(1, 1, 1);
 	}
 }
 
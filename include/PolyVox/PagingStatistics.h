@@ -0,0 +1,107 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_PagingStatistics_H__
+#define __PolyVox_PagingStatistics_H__
+
+#include "Config.h"
+
+#include <cstdint>
+
+namespace PolyVox
+{
+	////////////////////////////////////////////////////////////////////////////////
+	/// The counters returned by PagedVolume::getPagingStatistics(), which show how well the volume's memory budget suits the way it is
+	/// being used. For example a low hit rate on the last accessed chunk suggests using Samplers, while a large number of evictions
+	/// compared to page ins suggests the budget is too small for the working set.
+	///
+	/// The counters of hits on the last accessed chunk and of chunk table lookups and probes are only gathered if
+	/// POLYVOX_LOOKUP_STATISTICS_ENABLED is defined in Config.h, as they would otherwise slow down every access. The others are only
+	/// updated when chunks are paged, compressed or evicted, and so are always gathered.
+	///
+	/// The latency histograms have one bucket for each power of two microseconds, so bucket i counts calls to the Pager which took at
+	/// least 2^i microseconds but less than 2^(i+1). The first bucket also counts calls which took less than a microsecond and the last
+	/// counts all calls which took longer.
+	////////////////////////////////////////////////////////////////////////////////
+	struct PagingStatistics
+	{
+		static const uint32_t uNoOfLatencyBuckets = 20;
+
+		PagingStatistics()
+			:m_uNoOfLastChunkCacheHits(0)
+			, m_uNoOfChunkTableLookups(0)
+			, m_uNoOfChunkTableProbes(0)
+			, m_uNoOfPageIns(0)
+			, m_uNoOfPageOuts(0)
+			, m_uNoOfCompressions(0)
+			, m_uNoOfEvictions(0)
+			, m_uNoOfDirtyWriteBacks(0)
+		{
+			for (uint32_t ct = 0; ct < uNoOfLatencyBuckets; ct++)
+			{
+				m_arrayPageInLatency[ct] = 0;
+				m_arrayPageOutLatency[ct] = 0;
+			}
+		}
+
+		/// The fraction of chunk accesses which could reuse the last accessed chunk rather than looking it up in the chunk table.
+		float getLastChunkCacheHitRate(void) const
+		{
+			const uint64_t uNoOfAccesses = m_uNoOfLastChunkCacheHits + m_uNoOfChunkTableLookups;
+			return (uNoOfAccesses > 0) ? static_cast<float>(m_uNoOfLastChunkCacheHits) / uNoOfAccesses : 0.0f;
+		}
+
+		/// The average number of chunk table slots which were examined by each lookup.
+		float getAverageProbeLength(void) const
+		{
+			return (m_uNoOfChunkTableLookups > 0) ? static_cast<float>(m_uNoOfChunkTableProbes) / m_uNoOfChunkTableLookups : 0.0f;
+		}
+
+		/// The shortest call (in microseconds) which is counted by the given bucket of the latency histograms.
+		static uint32_t getLatencyBucketLowerBoundInMicroseconds(uint32_t uBucket)
+		{
+			return (uBucket == 0) ? 0 : (1u << uBucket);
+		}
+
+		/// Accesses which reused the last accessed chunk. This is only done when concurrent access is disabled.
+		uint64_t m_uNoOfLastChunkCacheHits;
+		/// Searches of the chunk table, and the total number of slots which they examined.
+		uint64_t m_uNoOfChunkTableLookups;
+		uint64_t m_uNoOfChunkTableProbes;
+		/// Calls to Pager::pageIn() and Pager::pageOut().
+		uint64_t m_uNoOfPageIns;
+		uint64_t m_uNoOfPageOuts;
+		/// Chunks which were compressed (or made homogeneous), and chunks which were removed from memory, to stay within the budget.
+		uint64_t m_uNoOfCompressions;
+		uint64_t m_uNoOfEvictions;
+		/// Modified chunks which were written to the Pager but kept in memory (by PagedVolume::flushDirty() and checkpoint()). These
+		/// are also counted as page outs.
+		uint64_t m_uNoOfDirtyWriteBacks;
+		/// How long the calls to the Pager took.
+		uint64_t m_arrayPageInLatency[uNoOfLatencyBuckets];
+		uint64_t m_arrayPageOutLatency[uNoOfLatencyBuckets];
+	};
+}
+
+#endif //__PolyVox_PagingStatistics_H__
@@ -29,10 +29,12 @@
 #include "Region.h"
 #include "Vector.h"
 
+#include <algorithm>
 #include <cstdlib> //For abort()
 #include <limits>
 #include <memory>
 #include <stdexcept> //For invalid_argument
+#include <vector>
 
 namespace PolyVox
 {
@@ -154,9 +156,25 @@ namespace PolyVox
 		/// Sets the voxel at the position given by a 3D vector
 		void setVoxel(const Vector3DInt32& v3dPos, VoxelType tValue);
 
+		/// Sets every voxel in the given Region to the same value
+		void fill(const Region& regFill, VoxelType tValue);
+		/// Copies voxels into the given Region from an array in which x varies fastest and z slowest
+		void setVoxels(const Region& regWrite, const VoxelType* pLinearSource);
+		/// Sets each voxel in the given Region to the value returned by a function of its position
+		template <typename GeneratorFunction>
+		void generate(const Region& regWrite, GeneratorFunction funcGenerator);
+
+		/// Copies the voxels in the given Region into an array in which x varies fastest and z slowest
+		void readRegion(const Region& regRead, VoxelType* pDestination, int32_t iRowStride = 0, int32_t iSliceStride = 0) const;
+
 		/// Calculates approximatly how many bytes of memory the volume is currently using.
 		uint32_t calculateSizeInBytes(void);
 
+		/// Gets the version of the most recently modified tile which overlaps the given Region.
+		uint64_t getMaxVersion(const Region& regQuery) const;
+		/// Sets a function to be called whenever a tile is modified.
+		void setChangeListener(typename BaseVolume<VoxelType>::ChangeListener funcChangeListener);
+
 	protected:
 		/// Copy constructor
 		RawVolume(const RawVolume& rhs);
@@ -166,6 +184,10 @@ namespace PolyVox
 
 	private:
 		void initialise(const Region& regValidRegion);
+		void updateTileVersion(int32_t iXPos, int32_t iYPos, int32_t iZPos);
+		void updateTileVersions(const Region& regChanged);
+		template <typename RowFunction>
+		void writeRows(const Region& regWrite, RowFunction funcRow);
 
 		//The size of the volume
 		Region m_regValidRegion;
@@ -175,6 +197,14 @@ namespace PolyVox
 
 		//The voxel data
 		VoxelType* m_pData;
+
+		// The data is stored as a single array, but changes are tracked for each tile (a cube of voxels) so that only the parts
+		// of the volume which were modified are reported. Tiles are positioned relative to the lower corner of the volume.
+		static const uint32_t uTileSideLengthPower = 4;
+		Vector3DInt32 m_v3dNoOfTiles;
+		std::vector<uint64_t> m_vecTileVersions;
+		mutable uint64_t m_uCurrentVersion;
+		typename BaseVolume<VoxelType>::ChangeListener m_funcChangeListener;
 	};
 }
 
@@ -33,6 +33,7 @@ namespace PolyVox
 		:BaseVolume<VoxelType>()
 		, m_regValidRegion(regValid)
 		, m_tBorderValue()
+		, m_uCurrentVersion(1)
 	{
 			this->setBorderValue(VoxelType());
 
@@ -203,6 +204,8 @@ namespace PolyVox
 				iLocalYPos * this->getWidth() +
 				iLocalZPos * this->getWidth() * this->getHeight()
 			] = tValue;
+
+		updateTileVersion(uXPos, uYPos, uZPos);
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
@@ -215,6 +218,133 @@ namespace PolyVox
 		setVoxel(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ(), tValue);
 	}
 
+	////////////////////////////////////////////////////////////////////////////////
+	/// This is much faster than calling setVoxel() for each voxel, as the voxels are written a row at a time.
+	/// \param regFill The Region to fill, which must lie inside the volume.
+	/// \param tValue The value to which the voxels will be set.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void RawVolume<VoxelType>::fill(const Region& regFill, VoxelType tValue)
+	{
+		writeRows(regFill, [&](VoxelType* pRow, int32_t /*iXPos*/, int32_t /*iYPos*/, int32_t /*iZPos*/, int32_t iLength)
+		{
+			std::fill(pRow, pRow + iLength, tValue);
+		});
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// The source data is laid out as in the RawVolume itself, with x varying fastest and z slowest, so the rows can simply be copied.
+	/// \param regWrite The Region to write, which must lie inside the volume.
+	/// \param pLinearSource The new voxel values. There must be one for each voxel in the region.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void RawVolume<VoxelType>::setVoxels(const Region& regWrite, const VoxelType* pLinearSource)
+	{
+		const VoxelType* pSourceRow = pLinearSource;
+		writeRows(regWrite, [&](VoxelType* pRow, int32_t /*iXPos*/, int32_t /*iYPos*/, int32_t /*iZPos*/, int32_t iLength)
+		{
+			std::copy(pSourceRow, pSourceRow + iLength, pRow);
+			pSourceRow += iLength;
+		});
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This is useful for procedurally generating the contents of a volume. The function is called once for each voxel, with x
+	/// varying fastest and z slowest, and must return the value of that voxel.
+	/// \param regWrite The Region to write, which must lie inside the volume.
+	/// \param funcGenerator A function (or functor) with the signature <tt>VoxelType(int32_t x, int32_t y, int32_t z)</tt>.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	template <typename GeneratorFunction>
+	void RawVolume<VoxelType>::generate(const Region& regWrite, GeneratorFunction funcGenerator)
+	{
+		writeRows(regWrite, [&](VoxelType* pRow, int32_t iXPos, int32_t iYPos, int32_t iZPos, int32_t iLength)
+		{
+			for (int32_t x = 0; x < iLength; x++)
+			{
+				pRow[x] = funcGenerator(iXPos + x, iYPos, iZPos);
+			}
+		});
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// The destination is laid out in the same way as the volume itself, so each row which lies inside the volume is simply copied.
+	/// Parts of the region which are outside the volume are given the border value, as with getVoxel().
+	/// \param regRead The Region to read.
+	/// \param pDestination The array to copy the voxels into.
+	/// \param iRowStride The distance (in voxels) between the starts of consecutive rows in the destination. Zero means the width of the region.
+	/// \param iSliceStride The distance (in voxels) between the starts of consecutive slices in the destination. Zero means the row stride multiplied by the height of the region.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void RawVolume<VoxelType>::readRegion(const Region& regRead, VoxelType* pDestination, int32_t iRowStride, int32_t iSliceStride) const
+	{
+		if (!regRead.isValid())
+		{
+			return;
+		}
+
+		iRowStride = (iRowStride > 0) ? iRowStride : regRead.getWidthInVoxels();
+		iSliceStride = (iSliceStride > 0) ? iSliceStride : iRowStride * regRead.getHeightInVoxels();
+
+		// The part of each row which is inside the volume. This may be empty.
+		const int32_t iInsideLowerX = (std::max)(regRead.getLowerX(), m_regValidRegion.getLowerX());
+		const int32_t iInsideUpperX = (std::min)(regRead.getUpperX(), m_regValidRegion.getUpperX());
+
+		for (int32_t z = regRead.getLowerZ(); z <= regRead.getUpperZ(); z++)
+		{
+			for (int32_t y = regRead.getLowerY(); y <= regRead.getUpperY(); y++)
+			{
+				VoxelType* pDestinationRow = pDestination + (y - regRead.getLowerY()) * iRowStride + (z - regRead.getLowerZ()) * iSliceStride;
+				VoxelType* pDestinationRowEnd = pDestinationRow + regRead.getWidthInVoxels();
+				if ((iInsideLowerX > iInsideUpperX) || !m_regValidRegion.containsPointInY(y) || !m_regValidRegion.containsPointInZ(z))
+				{
+					std::fill(pDestinationRow, pDestinationRowEnd, m_tBorderValue);
+					continue;
+				}
+
+				const VoxelType* pSourceRow = m_pData + (iInsideLowerX - m_regValidRegion.getLowerX()) +
+					(y - m_regValidRegion.getLowerY()) * this->getWidth() +
+					(z - m_regValidRegion.getLowerZ()) * this->getWidth() * this->getHeight();
+				VoxelType* pDestinationInside = pDestinationRow + (iInsideLowerX - regRead.getLowerX());
+				const int32_t iInsideLength = iInsideUpperX - iInsideLowerX + 1;
+
+				std::fill(pDestinationRow, pDestinationInside, m_tBorderValue);
+				std::copy(pSourceRow, pSourceRow + iInsideLength, pDestinationInside);
+				std::fill(pDestinationInside + iInsideLength, pDestinationRowEnd, m_tBorderValue);
+			}
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Calls the given function for each row of voxels (along the x axis) in the region, and then updates the tile versions.
+	/// The function is passed a pointer to the start of the row, the position of its first voxel and its length.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	template <typename RowFunction>
+	void RawVolume<VoxelType>::writeRows(const Region& regWrite, RowFunction funcRow)
+	{
+		if (!regWrite.isValid())
+		{
+			return;
+		}
+
+		POLYVOX_THROW_IF(!m_regValidRegion.containsRegion(regWrite), std::out_of_range, "Region is outside valid region");
+
+		const int32_t iRowLength = regWrite.getWidthInVoxels();
+		for (int32_t z = regWrite.getLowerZ(); z <= regWrite.getUpperZ(); z++)
+		{
+			for (int32_t y = regWrite.getLowerY(); y <= regWrite.getUpperY(); y++)
+			{
+				VoxelType* pRow = m_pData + (regWrite.getLowerX() - m_regValidRegion.getLowerX()) +
+					(y - m_regValidRegion.getLowerY()) * this->getWidth() +
+					(z - m_regValidRegion.getLowerZ()) * this->getWidth() * this->getHeight();
+				funcRow(pRow, regWrite.getLowerX(), y, z, iRowLength);
+			}
+		}
+
+		updateTileVersions(regWrite);
+	}
+
 	////////////////////////////////////////////////////////////////////////////////
 	/// This function should probably be made internal...
 	////////////////////////////////////////////////////////////////////////////////
@@ -241,6 +371,67 @@ namespace PolyVox
 
 		// Clear to zeros
 		std::fill(m_pData, m_pData + this->getWidth() * this->getHeight()* this->getDepth(), VoxelType());
+
+		// No tile has been modified yet.
+		const int32_t iTileSideLength = 1 << uTileSideLengthPower;
+		m_v3dNoOfTiles = Vector3DInt32((this->getWidth() + iTileSideLength - 1) >> uTileSideLengthPower,
+			(this->getHeight() + iTileSideLength - 1) >> uTileSideLengthPower, (this->getDepth() + iTileSideLength - 1) >> uTileSideLengthPower);
+		m_vecTileVersions.assign(m_v3dNoOfTiles.getX() * m_v3dNoOfTiles.getY() * m_v3dNoOfTiles.getZ(), 0);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Gives the tile containing the given voxel the current version, and tells the change listener if this is a new version.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void RawVolume<VoxelType>::updateTileVersion(int32_t iXPos, int32_t iYPos, int32_t iZPos)
+	{
+		const Vector3DInt32 v3dTile((iXPos - m_regValidRegion.getLowerX()) >> uTileSideLengthPower,
+			(iYPos - m_regValidRegion.getLowerY()) >> uTileSideLengthPower, (iZPos - m_regValidRegion.getLowerZ()) >> uTileSideLengthPower);
+		uint64_t& uTileVersion = m_vecTileVersions[v3dTile.getX() + (v3dTile.getY() + v3dTile.getZ() * m_v3dNoOfTiles.getY()) * m_v3dNoOfTiles.getX()];
+		if (uTileVersion == m_uCurrentVersion)
+		{
+			return;
+		}
+
+		uTileVersion = m_uCurrentVersion;
+		if (m_funcChangeListener)
+		{
+			// The next modification of this tile must be reported too, so it has to be given a new version.
+			m_uCurrentVersion++;
+
+			const int32_t iTileSideLength = 1 << uTileSideLengthPower;
+			Vector3DInt32 v3dLower = m_regValidRegion.getLowerCorner() + v3dTile * iTileSideLength;
+			Vector3DInt32 v3dUpper = v3dLower + Vector3DInt32(iTileSideLength - 1, iTileSideLength - 1, iTileSideLength - 1);
+			Region regChanged(v3dLower, v3dUpper);
+			regChanged.cropTo(m_regValidRegion);
+			Region regAffected(regChanged);
+			regAffected.grow(1);
+			m_funcChangeListener(regChanged, regAffected);
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Updates the version of every tile which overlaps the given region, which must lie inside the volume.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void RawVolume<VoxelType>::updateTileVersions(const Region& regChanged)
+	{
+		const int32_t iTileSideLength = 1 << uTileSideLengthPower;
+		const Vector3DInt32 v3dLowerTile = (regChanged.getLowerCorner() - m_regValidRegion.getLowerCorner()) / iTileSideLength;
+		const Vector3DInt32 v3dUpperTile = (regChanged.getUpperCorner() - m_regValidRegion.getLowerCorner()) / iTileSideLength;
+
+		for (int32_t z = v3dLowerTile.getZ(); z <= v3dUpperTile.getZ(); z++)
+		{
+			for (int32_t y = v3dLowerTile.getY(); y <= v3dUpperTile.getY(); y++)
+			{
+				for (int32_t x = v3dLowerTile.getX(); x <= v3dUpperTile.getX(); x++)
+				{
+					// The first voxel of each tile is always inside the volume.
+					const Vector3DInt32 v3dTileStart = m_regValidRegion.getLowerCorner() + Vector3DInt32(x, y, z) * iTileSideLength;
+					updateTileVersion(v3dTileStart.getX(), v3dTileStart.getY(), v3dTileStart.getZ());
+				}
+			}
+		}
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
@@ -251,5 +442,57 @@ namespace PolyVox
 	{
 		return this->getWidth() * this->getHeight() * this->getDepth() * sizeof(VoxelType);
 	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Returns the highest version of the tiles which overlap the given region, or zero if none of them have been modified. Any
+	/// modification made after this function returns will give the tile a higher version, so a region whose maximum version has
+	/// not increased since it was last processed has not changed. See PagedVolume::getMaxVersion() for more details.
+	/// \param regQuery The region to examine. Parts of it which lie outside the volume are ignored.
+	/// \return The highest version of any tile overlapping the region.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	uint64_t RawVolume<VoxelType>::getMaxVersion(const Region& regQuery) const
+	{
+		Region regCropped(regQuery);
+		regCropped.cropTo(m_regValidRegion);
+		if (!regCropped.isValid())
+		{
+			return 0;
+		}
+
+		const int32_t iTileSideLength = 1 << uTileSideLengthPower;
+		const Vector3DInt32 v3dLowerTile = (regCropped.getLowerCorner() - m_regValidRegion.getLowerCorner()) / iTileSideLength;
+		const Vector3DInt32 v3dUpperTile = (regCropped.getUpperCorner() - m_regValidRegion.getLowerCorner()) / iTileSideLength;
+
+		uint64_t uMaxVersion = 0;
+		for (int32_t z = v3dLowerTile.getZ(); z <= v3dUpperTile.getZ(); z++)
+		{
+			for (int32_t y = v3dLowerTile.getY(); y <= v3dUpperTile.getY(); y++)
+			{
+				for (int32_t x = v3dLowerTile.getX(); x <= v3dUpperTile.getX(); x++)
+				{
+					uMaxVersion = (std::max)(uMaxVersion, m_vecTileVersions[x + (y + z * m_v3dNoOfTiles.getY()) * m_v3dNoOfTiles.getX()]);
+				}
+			}
+		}
+
+		// The caller has now seen this version, so later modifications must be given a new one.
+		if (uMaxVersion == m_uCurrentVersion)
+		{
+			m_uCurrentVersion++;
+		}
+		return uMaxVersion;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// The listener is called each time a tile is modified, so calls to setVoxel() are each reported. Operations which write many
+	/// voxels at once report each tile they modify once, rather than once per voxel.
+	/// \param funcChangeListener The function to call, or an empty function to stop receiving notifications.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void RawVolume<VoxelType>::setChangeListener(typename BaseVolume<VoxelType>::ChangeListener funcChangeListener)
+	{
+		m_funcChangeListener = std::move(funcChangeListener);
+	}
 }
 
@@ -108,6 +108,7 @@ namespace PolyVox
 		if (this->m_bIsCurrentPositionValidInX && this->m_bIsCurrentPositionValidInY && this->m_bIsCurrentPositionValidInZ)
 		{
 			*mCurrentVoxel = tValue;
+			this->mVolume->updateTileVersion(this->mXPosInVolume, this->mYPosInVolume, this->mZPosInVolume);
 			return true;
 		}
 		else
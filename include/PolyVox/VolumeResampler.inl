@@ -22,6 +22,7 @@
 * SOFTWARE.
 *******************************************************************************/
 
+#include "Impl/ErrorHandling.h"
 #include "Impl/Interpolation.h"
 
 #include <cmath>
@@ -67,15 +68,26 @@ namespace PolyVox
 	template< typename SrcVolumeType, typename DstVolumeType>
 	void VolumeResampler<SrcVolumeType, DstVolumeType>::resampleSameSize()
 	{
+		// Both volumes are accessed through samplers, which step along each row much faster than getVoxel() and setVoxel().
+		typename SrcVolumeType::Sampler srcSampler(m_pVolSrc);
+		typename DstVolumeType::Sampler dstSampler(m_pVolDst);
+
 		for (int32_t sz = m_regSrc.getLowerZ(), dz = m_regDst.getLowerZ(); dz <= m_regDst.getUpperZ(); sz++, dz++)
 		{
 			for (int32_t sy = m_regSrc.getLowerY(), dy = m_regDst.getLowerY(); dy <= m_regDst.getUpperY(); sy++, dy++)
 			{
+				srcSampler.setPosition(m_regSrc.getLowerX(), sy, sz);
+				dstSampler.setPosition(m_regDst.getLowerX(), dy, dz);
 				for (int32_t sx = m_regSrc.getLowerX(), dx = m_regDst.getLowerX(); dx <= m_regDst.getUpperX(); sx++, dx++)
 				{
-					const typename SrcVolumeType::VoxelType& tSrcVoxel = m_pVolSrc->getVoxel(sx, sy, sz);
+					const typename SrcVolumeType::VoxelType& tSrcVoxel = srcSampler.getVoxel();
 					const typename DstVolumeType::VoxelType& tDstVoxel = static_cast<typename DstVolumeType::VoxelType>(tSrcVoxel);
-					m_pVolDst->setVoxel(dx, dy, dz, tDstVoxel);
+					if (!dstSampler.setVoxel(tDstVoxel))
+					{
+						POLYVOX_THROW(std::out_of_range, "Position is outside valid region");
+					}
+					srcSampler.movePositiveX();
+					dstSampler.movePositiveX();
 				}
 			}
 		}
@@ -97,11 +109,13 @@ namespace PolyVox
 		float fScaleZ = srcDepth / dstDepth;
 
 		typename SrcVolumeType::Sampler sampler(m_pVolSrc);
+		typename DstVolumeType::Sampler dstSampler(m_pVolDst);
 
 		for (int32_t dz = m_regDst.getLowerZ(); dz <= m_regDst.getUpperZ(); dz++)
 		{
 			for (int32_t dy = m_regDst.getLowerY(); dy <= m_regDst.getUpperY(); dy++)
 			{
+				dstSampler.setPosition(m_regDst.getLowerX(), dy, dz);
 				for (int32_t dx = m_regDst.getLowerX(); dx <= m_regDst.getUpperX(); dx++)
 				{
 					float sx = (dx - m_regDst.getLowerX()) * fScaleX;
@@ -131,7 +145,11 @@ namespace PolyVox
 					typename SrcVolumeType::VoxelType tInterpolatedValue = trilerp<float>(voxel000, voxel100, voxel010, voxel110, voxel001, voxel101, voxel011, voxel111, sx, sy, sz);
 
 					typename DstVolumeType::VoxelType result = static_cast<typename DstVolumeType::VoxelType>(tInterpolatedValue);
-					m_pVolDst->setVoxel(dx, dy, dz, result);
+					if (!dstSampler.setVoxel(result))
+					{
+						POLYVOX_THROW(std::out_of_range, "Position is outside valid region");
+					}
+					dstSampler.movePositiveX();
 				}
 			}
 		}
@@ -0,0 +1,361 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#include "TestChunkCodecs.h"
+
+#include "PolyVox/ChunkCodec.h"
+#include "PolyVox/ContainerFilePager.h"
+#include "PolyVox/FilePager.h"
+#include "PolyVox/MaterialDensityPair.h"
+#include "PolyVox/PagedVolume.h"
+
+#include <QtTest>
+
+#include <cstdio>
+#include <random>
+
+using namespace PolyVox;
+
+const int32_t g_iChunkSideLength = 32;
+const uint32_t g_uNoOfVoxelsPerChunk = g_iChunkSideLength * g_iChunkSideLength * g_iChunkSideLength;
+
+// Rolling hills, with the ground and the surface made of different materials.
+int32_t terrainHeight(int32_t x, int32_t z)
+{
+	return 12 + ((x / 4 + z / 6) % 5) + ((x * z) / 97) % 3;
+}
+
+template <typename VoxelType>
+VoxelType createTerrainVoxel(int32_t x, int32_t y, int32_t z);
+
+template <>
+uint8_t createTerrainVoxel<uint8_t>(int32_t x, int32_t y, int32_t z)
+{
+	const int32_t iHeight = terrainHeight(x, z);
+	return (y < iHeight) ? 255 : ((y == iHeight) ? 128 : 0);
+}
+
+template <>
+MaterialDensityPair44 createTerrainVoxel<MaterialDensityPair44>(int32_t x, int32_t y, int32_t z)
+{
+	const int32_t iHeight = terrainHeight(x, z);
+	const uint8_t uMaterial = (y < iHeight - 3) ? 2 : ((y < iHeight) ? 1 : 0);
+	return MaterialDensityPair44(uMaterial, (y < iHeight) ? MaterialDensityPair44::getMaxDensity() : 0);
+}
+
+template <>
+int32_t createTerrainVoxel<int32_t>(int32_t x, int32_t y, int32_t z)
+{
+	return (y < terrainHeight(x, z)) ? (y / 8) + 1000 : -1;
+}
+
+// Gets the data of a chunk in Morton order, just as a pager would be given it.
+template <typename VoxelType>
+std::vector<VoxelType> createTerrainChunk(void)
+{
+	FilePager<VoxelType> pager;
+	PagedVolume<VoxelType> volume(&pager, 16 * 1024 * 1024, g_iChunkSideLength);
+	volume.generate(Region(0, 0, 0, g_iChunkSideLength - 1, g_iChunkSideLength - 1, g_iChunkSideLength - 1), &createTerrainVoxel<VoxelType>);
+
+	auto handle = volume.pinChunk(Vector3DInt32(0, 0, 0));
+	return std::vector<VoxelType>(handle->getData(), handle->getData() + g_uNoOfVoxelsPerChunk);
+}
+
+template <typename VoxelType>
+std::vector<VoxelType> createNoiseChunk(void)
+{
+	std::mt19937 rng;
+	std::vector<VoxelType> vecData(g_uNoOfVoxelsPerChunk);
+	uint8_t* pBytes = reinterpret_cast<uint8_t*>(vecData.data());
+	for (size_t uByte = 0; uByte < vecData.size() * sizeof(VoxelType); uByte++)
+	{
+		pBytes[uByte] = static_cast<uint8_t>(rng());
+	}
+	return vecData;
+}
+
+// Encodes and decodes the data, and checks the result is the same and the encoded data is no more than a byte larger.
+template <typename VoxelType>
+bool checkRoundTrip(const ChunkCodec<VoxelType>* pCodec, const std::vector<VoxelType>& vecData, size_t& uEncodedSizeInBytes)
+{
+	std::vector<uint8_t> vecEncodedData;
+	encodeChunkData(pCodec, vecData.data(), static_cast<uint32_t>(vecData.size()), vecEncodedData);
+	uEncodedSizeInBytes = vecEncodedData.size();
+
+	std::vector<VoxelType> vecDecodedData(vecData.size());
+	decodeChunkData(pCodec, vecEncodedData.data(), vecEncodedData.size(), vecDecodedData.data(), static_cast<uint32_t>(vecDecodedData.size()));
+
+	return (uEncodedSizeInBytes <= vecData.size() * sizeof(VoxelType) + 1) &&
+		(std::memcmp(vecData.data(), vecDecodedData.data(), vecData.size() * sizeof(VoxelType)) == 0);
+}
+
+template <typename VoxelType>
+bool checkRoundTrips(void)
+{
+	RawChunkCodec<VoxelType> rawCodec;
+	RunLengthChunkCodec<VoxelType> runLengthCodec;
+	PaletteChunkCodec<VoxelType> paletteCodec;
+	LZChunkCodec<VoxelType> lzCodec;
+	const ChunkCodec<VoxelType>* arrayCodecs[] = { nullptr, &rawCodec, &runLengthCodec, &paletteCodec, &lzCodec };
+
+	const std::vector<VoxelType> vecHomogeneous(g_uNoOfVoxelsPerChunk, createTerrainVoxel<VoxelType>(0, 0, 0));
+	const std::vector<VoxelType> vecTerrain = createTerrainChunk<VoxelType>();
+	const std::vector<VoxelType> vecNoise = createNoiseChunk<VoxelType>();
+	const size_t uRawSizeInBytes = g_uNoOfVoxelsPerChunk * sizeof(VoxelType);
+
+	for (const ChunkCodec<VoxelType>* pCodec : arrayCodecs)
+	{
+		size_t uEncodedSizeInBytes;
+		if (!checkRoundTrip(pCodec, vecHomogeneous, uEncodedSizeInBytes) || !checkRoundTrip(pCodec, vecNoise, uEncodedSizeInBytes) || !checkRoundTrip(pCodec, vecTerrain, uEncodedSizeInBytes))
+		{
+			return false;
+		}
+
+		// All of the real codecs should do a good job of the terrain.
+		const bool bCompresses = pCodec && (pCodec->getTag() != ChunkCodecTags::Raw);
+		if (bCompresses != (uEncodedSizeInBytes * 2 < uRawSizeInBytes))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void TestChunkCodecs::testRoundTrip()
+{
+	QVERIFY(checkRoundTrips<uint8_t>());
+	QVERIFY(checkRoundTrips<MaterialDensityPair44>());
+	QVERIFY(checkRoundTrips<int32_t>());
+}
+
+template <typename VoxelType>
+bool checkCorruptDataThrows(const ChunkCodec<VoxelType>* pCodec, const std::vector<uint8_t>& vecEncodedData)
+{
+	std::vector<VoxelType> vecDecodedData(g_uNoOfVoxelsPerChunk);
+	try
+	{
+		decodeChunkData(pCodec, vecEncodedData.data(), vecEncodedData.size(), vecDecodedData.data(), g_uNoOfVoxelsPerChunk);
+	}
+	catch (const std::runtime_error&)
+	{
+		return true;
+	}
+	return false;
+}
+
+void TestChunkCodecs::testCorruptData()
+{
+	RunLengthChunkCodec<int32_t> runLengthCodec;
+	PaletteChunkCodec<int32_t> paletteCodec;
+	LZChunkCodec<int32_t> lzCodec;
+	const ChunkCodec<int32_t>* arrayCodecs[] = { nullptr, &runLengthCodec, &paletteCodec, &lzCodec };
+
+	const std::vector<int32_t> vecTerrain = createTerrainChunk<int32_t>();
+	for (const ChunkCodec<int32_t>* pCodec : arrayCodecs)
+	{
+		std::vector<uint8_t> vecEncodedData;
+		encodeChunkData(pCodec, vecTerrain.data(), g_uNoOfVoxelsPerChunk, vecEncodedData);
+
+		std::vector<uint8_t> vecTruncatedData(vecEncodedData.begin(), vecEncodedData.end() - 1);
+		QVERIFY(checkCorruptDataThrows<int32_t>(pCodec, vecTruncatedData));
+
+		std::vector<uint8_t> vecExtendedData(vecEncodedData);
+		vecExtendedData.push_back(0);
+		QVERIFY(checkCorruptDataThrows<int32_t>(pCodec, vecExtendedData));
+	}
+
+	// Data which was written by a codec the pager does not know about cannot be read.
+	std::vector<uint8_t> vecUnknownCodecData(1, ChunkCodecTags::FirstUserTag);
+	QVERIFY(checkCorruptDataThrows<int32_t>(nullptr, vecUnknownCodecData));
+}
+
+void TestChunkCodecs::testPagersWithCodecs()
+{
+	const Region regVolume(0, 0, 0, 127, 31, 63);
+	auto funcCheckVolume = [&regVolume](PagedVolume<uint8_t>& volume)
+	{
+		int32_t iErrors = 0;
+		for (int32_t z = regVolume.getLowerZ(); z <= regVolume.getUpperZ(); z++)
+		{
+			for (int32_t y = regVolume.getLowerY(); y <= regVolume.getUpperY(); y++)
+			{
+				for (int32_t x = regVolume.getLowerX(); x <= regVolume.getUpperX(); x++)
+				{
+					iErrors += (volume.getVoxel(x, y, z) != createTerrainVoxel<uint8_t>(x, y, z)) ? 1 : 0;
+				}
+			}
+		}
+		return iErrors;
+	};
+
+	// Flushing the volume means the chunks have to go through the pager.
+	LZChunkCodec<uint8_t> lzCodec;
+	{
+		FilePager<uint8_t> pager(".", &lzCodec);
+		PagedVolume<uint8_t> volume(&pager, 1 * 1024 * 1024, 16);
+		volume.generate(regVolume, &createTerrainVoxel<uint8_t>);
+		volume.flushAll();
+		QCOMPARE(funcCheckVolume(volume), 0);
+	}
+
+	// Chunks written with one codec can be read after switching to another.
+	const std::string strFilename = "testPagersWithCodecs.pvc";
+	std::remove(strFilename.c_str());
+	RunLengthChunkCodec<uint8_t> runLengthCodec;
+	{
+		ContainerFilePager<uint8_t> pager(strFilename, &runLengthCodec);
+		PagedVolume<uint8_t> volume(&pager, 1 * 1024 * 1024, 16);
+		volume.generate(regVolume, &createTerrainVoxel<uint8_t>);
+	}
+
+	PaletteChunkCodec<uint8_t> paletteCodec;
+	{
+		ContainerFilePager<uint8_t> pager(strFilename, &paletteCodec);
+		PagedVolume<uint8_t> volume(&pager, 1 * 1024 * 1024, 16);
+		volume.setVoxel(0, 0, 0, 0);
+		volume.setVoxel(0, 0, 0, createTerrainVoxel<uint8_t>(0, 0, 0));
+	}
+
+	{
+		ContainerFilePager<uint8_t> pager(strFilename);
+		PagedVolume<uint8_t> volume(&pager, 1 * 1024 * 1024, 16);
+		QCOMPARE(funcCheckVolume(volume), 0);
+	}
+
+	QVERIFY(std::remove(strFilename.c_str()) == 0);
+}
+
+// Reports how much the codec compresses a realistic chunk, and measures how long it takes to decompress it (which is most of the cost of paging it in).
+template <typename VoxelType>
+void benchmarkCodec(const ChunkCodec<VoxelType>& codec, const char* szName)
+{
+	const std::vector<VoxelType> vecTerrain = createTerrainChunk<VoxelType>();
+	std::vector<uint8_t> vecEncodedData;
+	encodeChunkData(&codec, vecTerrain.data(), g_uNoOfVoxelsPerChunk, vecEncodedData);
+	qDebug() << szName << "compression ratio:" << static_cast<float>(g_uNoOfVoxelsPerChunk * sizeof(VoxelType)) / vecEncodedData.size();
+
+	std::vector<VoxelType> vecDecodedData(g_uNoOfVoxelsPerChunk);
+	QBENCHMARK
+	{
+		decodeChunkData(&codec, vecEncodedData.data(), vecEncodedData.size(), vecDecodedData.data(), g_uNoOfVoxelsPerChunk);
+	}
+	QVERIFY(std::memcmp(vecTerrain.data(), vecDecodedData.data(), g_uNoOfVoxelsPerChunk * sizeof(VoxelType)) == 0);
+}
+
+// Reports how much the codec shrinks a container of terrain, and measures how long it takes to page the whole volume back in from
+// it. Unlike benchmarkCodec() this includes reading the records, so a codec which decodes more slowly can still page in faster.
+template <typename VoxelType>
+void benchmarkPageIn(const ChunkCodec<VoxelType>& codec, const char* szName)
+{
+	const Region regVolume(0, 0, 0, 8 * g_iChunkSideLength - 1, g_iChunkSideLength - 1, 8 * g_iChunkSideLength - 1);
+	const std::string strFilename = "benchmarkPageIn.pvc";
+	std::remove(strFilename.c_str());
+	{
+		ContainerFilePager<VoxelType> pager(strFilename, &codec);
+		{
+			PagedVolume<VoxelType> volume(&pager, 64 * 1024 * 1024, g_iChunkSideLength);
+			volume.generate(regVolume, &createTerrainVoxel<VoxelType>);
+		}
+		pager.flush();
+
+		FILE* pFile = fopen(strFilename.c_str(), "rb");
+		fseek(pFile, 0, SEEK_END);
+		const long iFileSizeInBytes = ftell(pFile);
+		fclose(pFile);
+		qDebug() << szName << "container compression ratio:" << static_cast<float>(regVolume.getWidthInVoxels() * regVolume.getHeightInVoxels() * regVolume.getDepthInVoxels() * sizeof(VoxelType)) / iFileSizeInBytes;
+
+		QBENCHMARK
+		{
+			PagedVolume<VoxelType> volume(&pager, 64 * 1024 * 1024, g_iChunkSideLength);
+			volume.prefetch(regVolume).get();
+		}
+
+		PagedVolume<VoxelType> volume(&pager, 64 * 1024 * 1024, g_iChunkSideLength);
+		QVERIFY(volume.getVoxel(100, 14, 200) == createTerrainVoxel<VoxelType>(100, 14, 200));
+	}
+	QVERIFY(std::remove(strFilename.c_str()) == 0);
+}
+
+void TestChunkCodecs::testUInt8RawSpeed()
+{
+	benchmarkCodec(RawChunkCodec<uint8_t>(), "uint8_t raw");
+}
+
+void TestChunkCodecs::testUInt8RunLengthSpeed()
+{
+	benchmarkCodec(RunLengthChunkCodec<uint8_t>(), "uint8_t run length");
+}
+
+void TestChunkCodecs::testUInt8PaletteSpeed()
+{
+	benchmarkCodec(PaletteChunkCodec<uint8_t>(), "uint8_t palette");
+}
+
+void TestChunkCodecs::testUInt8LZSpeed()
+{
+	benchmarkCodec(LZChunkCodec<uint8_t>(), "uint8_t LZ");
+}
+
+void TestChunkCodecs::testUInt8RawPageInSpeed()
+{
+	benchmarkPageIn(RawChunkCodec<uint8_t>(), "uint8_t raw");
+}
+
+void TestChunkCodecs::testUInt8RunLengthPageInSpeed()
+{
+	benchmarkPageIn(RunLengthChunkCodec<uint8_t>(), "uint8_t run length");
+}
+
+void TestChunkCodecs::testUInt8PalettePageInSpeed()
+{
+	benchmarkPageIn(PaletteChunkCodec<uint8_t>(), "uint8_t palette");
+}
+
+void TestChunkCodecs::testUInt8LZPageInSpeed()
+{
+	benchmarkPageIn(LZChunkCodec<uint8_t>(), "uint8_t LZ");
+}
+
+void TestChunkCodecs::testMaterialDensityPair44RawSpeed()
+{
+	benchmarkCodec(RawChunkCodec<MaterialDensityPair44>(), "MaterialDensityPair44 raw");
+}
+
+void TestChunkCodecs::testMaterialDensityPair44RunLengthSpeed()
+{
+	benchmarkCodec(RunLengthChunkCodec<MaterialDensityPair44>(), "MaterialDensityPair44 run length");
+}
+
+void TestChunkCodecs::testMaterialDensityPair44PaletteSpeed()
+{
+	benchmarkCodec(PaletteChunkCodec<MaterialDensityPair44>(), "MaterialDensityPair44 palette");
+}
+
+void TestChunkCodecs::testMaterialDensityPair44LZSpeed()
+{
+	benchmarkCodec(LZChunkCodec<MaterialDensityPair44>(), "MaterialDensityPair44 LZ");
+}
+
+QTEST_MAIN(TestChunkCodecs)
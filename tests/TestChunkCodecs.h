@@ -0,0 +1,53 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_TestChunkCodecs_H__
+#define __PolyVox_TestChunkCodecs_H__
+
+#include <QObject>
+
+class TestChunkCodecs: public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void testRoundTrip();
+	void testCorruptData();
+	void testPagersWithCodecs();
+
+	void testUInt8RawSpeed();
+	void testUInt8RunLengthSpeed();
+	void testUInt8PaletteSpeed();
+	void testUInt8LZSpeed();
+	void testUInt8RawPageInSpeed();
+	void testUInt8RunLengthPageInSpeed();
+	void testUInt8PalettePageInSpeed();
+	void testUInt8LZPageInSpeed();
+	void testMaterialDensityPair44RawSpeed();
+	void testMaterialDensityPair44RunLengthSpeed();
+	void testMaterialDensityPair44PaletteSpeed();
+	void testMaterialDensityPair44LZSpeed();
+};
+
+#endif
@@ -24,7 +24,9 @@
 
 #include "testvolume.h"
 
+#include "PolyVox/ContainerFilePager.h"
 #include "PolyVox/FilePager.h"
+#include "PolyVox/MappedFilePager.h"
 #include "PolyVox/PagedVolume.h"
 #include "PolyVox/RawVolume.h"
 
@@ -32,9 +34,60 @@
 #include <QtTest>
 
 #include <random>
+#include <thread>
 
 using namespace PolyVox;
 
+// Generates simple layered terrain (which compresses well) and counts how often chunks are paged in and out.
+class CountingTerrainPager : public PagedVolume<int32_t>::Pager
+{
+public:
+	virtual void pageIn(const Region& region, PagedVolume<int32_t>::Chunk* pChunk)
+	{
+		for (int32_t z = 0; z < region.getDepthInVoxels(); z++)
+		{
+			for (int32_t y = 0; y < region.getHeightInVoxels(); y++)
+			{
+				for (int32_t x = 0; x < region.getWidthInVoxels(); x++)
+				{
+					pChunk->setVoxel(x, y, z, (region.getLowerY() + y < 20) ? 1 : 0);
+				}
+			}
+		}
+		m_uNoOfPageIns++;
+		m_vecPageInPositions.push_back(region.getLowerCorner());
+	}
+
+	virtual void pageOut(const Region& /*region*/, PagedVolume<int32_t>::Chunk* /*pChunk*/)
+	{
+		m_uNoOfPageOuts++;
+	}
+
+	uint32_t m_uNoOfPageIns = 0;
+	uint32_t m_uNoOfPageOuts = 0;
+	std::vector<Vector3DInt32> m_vecPageInPositions;
+};
+
+// Also records the size of each batch of chunks which the volume passes to the pager.
+class BatchCountingPager : public CountingTerrainPager
+{
+public:
+	virtual void pageInBatch(const std::vector<PagedVolume<int32_t>::Pager::PageRequest>& vecRequests)
+	{
+		m_vecPageInBatchSizes.push_back(static_cast<uint32_t>(vecRequests.size()));
+		CountingTerrainPager::pageInBatch(vecRequests);
+	}
+
+	virtual void pageOutBatch(const std::vector<PagedVolume<int32_t>::Pager::PageRequest>& vecRequests)
+	{
+		m_vecPageOutBatchSizes.push_back(static_cast<uint32_t>(vecRequests.size()));
+		CountingTerrainPager::pageOutBatch(vecRequests);
+	}
+
+	std::vector<uint32_t> m_vecPageInBatchSizes;
+	std::vector<uint32_t> m_vecPageOutBatchSizes;
+};
+
 // This is used to compute a value from a list of integers. We use it to 
 // make sure we get the expected result from a series of volume accesses.
 inline int32_t cantorTupleFunction(int32_t previousResult, int32_t value)
@@ -42,6 +95,44 @@ inline int32_t cantorTupleFunction(int32_t previousResult, int32_t value)
 	return ((previousResult + value) * (previousResult + value + 1) + value) / 2;
 }
 
+// The original conversion from linear to Morton ordering, which computes the index of every voxel. It is used
+// to check the optimised conversion functions, and as a baseline for measuring their performance.
+template <typename VoxelType>
+void convertLinearOrderingToMortonReference(const VoxelType* pLinear, VoxelType* pMorton, uint32_t uSideLength)
+{
+	for (uint32_t z = 0; z < uSideLength; z++)
+	{
+		for (uint32_t y = 0; y < uSideLength; y++)
+		{
+			for (uint32_t x = 0; x < uSideLength; x++)
+			{
+				uint32_t uLinearIndex = x + y * uSideLength + z * uSideLength * uSideLength;
+				uint32_t uMortonIndex = morton256_x[x] | morton256_y[y] | morton256_z[z];
+				pMorton[uMortonIndex] = pLinear[uLinearIndex];
+			}
+		}
+	}
+}
+
+template <typename VoxelType>
+bool checkMortonConversion(uint32_t uSideLength)
+{
+	const uint32_t uNoOfVoxels = uSideLength * uSideLength * uSideLength;
+	std::vector<VoxelType> vecLinear(uNoOfVoxels);
+	for (uint32_t uIndex = 0; uIndex < uNoOfVoxels; uIndex++)
+	{
+		vecLinear[uIndex] = static_cast<VoxelType>(uIndex * 7 + 3);
+	}
+
+	std::vector<VoxelType> vecExpected(uNoOfVoxels);
+	std::vector<VoxelType> vecMorton(uNoOfVoxels);
+	std::vector<VoxelType> vecRoundTrip(uNoOfVoxels);
+	convertLinearOrderingToMortonReference(vecLinear.data(), vecExpected.data(), uSideLength);
+	convertLinearOrderingToMorton(vecLinear.data(), vecMorton.data(), uSideLength);
+	convertMortonOrderingToLinear(vecMorton.data(), vecRoundTrip.data(), uSideLength);
+	return (vecMorton == vecExpected) && (vecRoundTrip == vecLinear);
+}
+
 /*
  * Funtions for testing iteration in a forwards direction
  */
@@ -220,6 +311,31 @@ int32_t testSamplersWithWrappingBackwards(VolumeType* volume, Region region)
 	return result;
 }
 
+// Reads every voxel once with getVoxel(), so that the cost of moving the sampler (within and between chunks) is not hidden behind
+// the peeks and the hashing.
+template <typename VolumeType>
+int32_t testSamplerRowSweep(VolumeType* volume, Region region)
+{
+	int32_t result = 0;
+
+	typename VolumeType::Sampler sampler(volume);
+
+	for (int z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+	{
+		for (int y = region.getLowerY(); y <= region.getUpperY(); y++)
+		{
+			sampler.setPosition(region.getLowerX(), y, z);
+			for (int x = region.getLowerX(); x <= region.getUpperX(); x++)
+			{
+				result += sampler.getVoxel();
+				sampler.movePositiveX();
+			}
+		}
+	}
+
+	return result;
+}
+
 template <typename VolumeType>
 int32_t testDirectRandomAccess(const VolumeType* volume)
 {
@@ -481,6 +597,29 @@ void TestVolume::testPagedVolumeSamplersWithExternalBackwards()
 	QCOMPARE(result, static_cast<int32_t>(-993539594));
 }
 
+/*
+ * Sampler sweep tests
+ */
+void TestVolume::testRawVolumeSamplerRowSweep()
+{
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplerRowSweep(m_pRawVolume, m_regInternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(180923750));
+}
+
+void TestVolume::testPagedVolumeSamplerRowSweep()
+{
+	int32_t result = 0;
+	QBENCHMARK
+	{
+		result = testSamplerRowSweep(m_pPagedVolumeHighMem, m_regInternal);
+	}
+	QCOMPARE(result, static_cast<int32_t>(180923750));
+}
+
 /*
  * Random access tests
  */
@@ -600,4 +739,1546 @@ void TestVolume::testPagedVolumeChunkRandomAccess()
 	QCOMPARE(result, static_cast<int32_t>(71649197));
 }
 
+void TestVolume::testPagedVolumeConcurrentAccess()
+{
+	// A small memory limit means the threads are constantly evicting chunks which the others are using.
+	FilePager<int32_t> filePager(".");
+	PagedVolume<int32_t> volume(&filePager, 2 * 1024 * 1024, m_uChunkSideLength, true);
+
+	for (int z = m_regVolume.getLowerZ(); z <= m_regVolume.getUpperZ(); z++)
+	{
+		for (int y = m_regVolume.getLowerY(); y <= m_regVolume.getUpperY(); y++)
+		{
+			for (int x = m_regVolume.getLowerX(); x <= m_regVolume.getUpperX(); x++)
+			{
+				volume.setVoxel(x, y, z, x + y + z);
+			}
+		}
+	}
+
+	// Half the threads use samplers and the other half use direct access.
+	const uint32_t uNoOfThreads = 4;
+	int32_t results[uNoOfThreads];
+
+	QBENCHMARK
+	{
+		std::vector<std::thread> threads;
+		for (uint32_t ct = 0; ct < uNoOfThreads; ct++)
+		{
+			threads.push_back(std::thread([&, ct]
+			{
+				results[ct] = (ct % 2 == 0) ? testSamplersWithWrappingForwards(&volume, m_regInternal) :
+					testDirectAccessWithWrappingBackwards(&volume, m_regInternal);
+			}));
+		}
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+	}
+
+	for (uint32_t ct = 0; ct < uNoOfThreads; ct++)
+	{
+		QCOMPARE(results[ct], (ct % 2 == 0) ? static_cast<int32_t>(1004598054) : static_cast<int32_t>(-269366578));
+	}
+}
+
+void TestVolume::testPagedVolumeBackgroundPaging()
+{
+	// As above, but with background threads doing the prefetching and writing back the evicted chunks.
+	FilePager<int32_t> filePager(".");
+	PagedVolume<int32_t> volume(&filePager, 2 * 1024 * 1024, m_uChunkSideLength, true, 2);
+
+	for (int z = m_regVolume.getLowerZ(); z <= m_regVolume.getUpperZ(); z++)
+	{
+		for (int y = m_regVolume.getLowerY(); y <= m_regVolume.getUpperY(); y++)
+		{
+			for (int x = m_regVolume.getLowerX(); x <= m_regVolume.getUpperX(); x++)
+			{
+				volume.setVoxel(x, y, z, x + y + z);
+			}
+		}
+	}
+
+	// Make sure everything has been written, and that prefetching brings back the same data.
+	volume.flushAll();
+	std::future<void> prefetchComplete = volume.prefetch(Region(m_regInternal.getLowerCorner(), m_regInternal.getLowerCorner() + Vector3DInt32(63, 63, 63)));
+
+	const uint32_t uNoOfThreads = 4;
+	int32_t results[uNoOfThreads];
+
+	QBENCHMARK
+	{
+		std::vector<std::thread> threads;
+		for (uint32_t ct = 0; ct < uNoOfThreads; ct++)
+		{
+			threads.push_back(std::thread([&, ct]
+			{
+				results[ct] = (ct % 2 == 0) ? testSamplersWithWrappingForwards(&volume, m_regInternal) :
+					testDirectAccessWithWrappingBackwards(&volume, m_regInternal);
+			}));
+		}
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+	}
+
+	prefetchComplete.get();
+
+	for (uint32_t ct = 0; ct < uNoOfThreads; ct++)
+	{
+		QCOMPARE(results[ct], (ct % 2 == 0) ? static_cast<int32_t>(1004598054) : static_cast<int32_t>(-269366578));
+	}
+}
+
+void TestVolume::testPagedVolumeChunkPinning()
+{
+	// The smallest memory limit, so that walking through the volume evicts everything which is not pinned many times over.
+	FilePager<int32_t> filePager(".");
+	PagedVolume<int32_t> volume(&filePager, 1 * 1024 * 1024, m_uChunkSideLength);
+	const uint64_t uEmptySizeInBytes = volume.calculateSizeInBytes();
+
+	volume.setVoxel(0, 0, 0, 42);
+	volume.setVoxel(1000, 0, 0, 7);
+
+	{
+		PagedVolume<int32_t>::Sampler sampler(&volume);
+		sampler.setPosition(0, 0, 0);
+		PagedVolume<int32_t>::ChunkHandle handle = volume.pinChunk(Vector3DInt32(1000, 0, 0));
+		PagedVolume<int32_t>::Chunk* pChunk = handle.get();
+
+		for (int32_t ct = 1; ct <= 200; ct++)
+		{
+			volume.getVoxel(0, ct * m_uChunkSideLength, 0);
+		}
+
+		// The sampler and handle must still be pointing at the same (resident) data.
+		QCOMPARE(sampler.getVoxel(), 42);
+		QCOMPARE(handle.get(), pChunk);
+		QCOMPARE(handle->getVoxel(1000 % m_uChunkSideLength, 0, 0), 7);
+
+		// Pinned chunks survive a flush, and copies of the handle share the pin.
+		PagedVolume<int32_t>::ChunkHandle copyOfHandle = handle;
+		handle.reset();
+		volume.flushAll();
+		QVERIFY(volume.calculateSizeInBytes() > 0);
+		QCOMPARE(copyOfHandle.get(), pChunk);
+		QCOMPARE(copyOfHandle->getVoxel(1000 % m_uChunkSideLength, 0, 0), 7);
+	}
+
+	// Once nothing is pinned the flush removes everything but the versions of the two modified chunks, and the data comes back
+	// from the pager.
+	volume.flushAll();
+	QVERIFY(volume.calculateSizeInBytes() > uEmptySizeInBytes);
+	QVERIFY(volume.calculateSizeInBytes() <= uEmptySizeInBytes + 2 * 64);
+	QCOMPARE(volume.getVoxel(0, 0, 0), 42);
+	QCOMPARE(volume.getVoxel(1000, 0, 0), 7);
+}
+
+void TestVolume::testPagedVolumeCompressedChunks()
+{
+	// Room for 64 uncompressed chunks, but the region covers 1024 of them.
+	const uint16_t uChunkSideLength = 16;
+	const Region region(0, 0, 0, 255, 63, 255);
+	CountingTerrainPager pager;
+	PagedVolume<int32_t> volume(&pager, 2 * 1024 * 1024, uChunkSideLength);
+	const uint64_t uEmptySizeInBytes = volume.calculateSizeInBytes();
+
+	int32_t iSum = 0;
+	QBENCHMARK
+	{
+		iSum = 0;
+		for (int z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+		{
+			for (int y = region.getLowerY(); y <= region.getUpperY(); y++)
+			{
+				for (int x = region.getLowerX(); x <= region.getUpperX(); x++)
+				{
+					iSum += volume.getVoxel(x, y, z);
+				}
+			}
+		}
+	}
+
+	// Every chunk was paged in exactly once, as those which were not in use were compressed rather than paged out.
+	QCOMPARE(iSum, 256 * 20 * 256);
+	QCOMPARE(pager.m_uNoOfPageIns, static_cast<uint32_t>(1024));
+	QCOMPARE(pager.m_uNoOfPageOuts, static_cast<uint32_t>(0));
+	QVERIFY(volume.calculateSizeInBytes() <= 2 * 1024 * 1024);
+
+	// Modifications survive compression, and the modified chunk is the only one which gets paged out.
+	volume.setVoxel(0, 0, 0, 5);
+	for (int z = region.getLowerZ(); z <= region.getUpperZ(); z += uChunkSideLength)
+	{
+		for (int y = region.getLowerY(); y <= region.getUpperY(); y += uChunkSideLength)
+		{
+			for (int x = region.getLowerX(); x <= region.getUpperX(); x += uChunkSideLength)
+			{
+				volume.getVoxel(x, y, z);
+			}
+		}
+	}
+	QCOMPARE(volume.getVoxel(0, 0, 0), 5);
+	QCOMPARE(pager.m_uNoOfPageIns, static_cast<uint32_t>(1024));
+	volume.flushAll();
+	QCOMPARE(pager.m_uNoOfPageOuts, static_cast<uint32_t>(1));
+	QVERIFY(volume.calculateSizeInBytes() <= uEmptySizeInBytes + 64);
+}
+
+void TestVolume::testPagedVolumeHomogeneousChunks()
+{
+	const uint16_t uChunkSideLength = 16;
+	const Region region(0, 0, 0, 255, 63, 255);
+	CountingTerrainPager pager;
+	// Enough memory for 4096 uncompressed chunks, so chunks are never compressed or paged out.
+	PagedVolume<int32_t> volume(&pager, 64 * 1024 * 1024, uChunkSideLength);
+	const uint64_t uEmptySizeInBytes = volume.calculateSizeInBytes();
+
+	// The pager makes everything below y = 20 solid, so only the second layer of chunks has a mixture of values.
+	QVERIFY(volume.pinChunk(Vector3DInt32(0, 0, 0))->isHomogeneous());
+	QVERIFY(!volume.pinChunk(Vector3DInt32(0, 16, 0))->isHomogeneous());
+	QVERIFY(volume.pinChunk(Vector3DInt32(0, 32, 0))->isHomogeneous());
+	QVERIFY(volume.pinChunk(Vector3DInt32(0, 48, 0))->isHomogeneous());
+
+	int32_t iSum = 0;
+	for (int z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+	{
+		for (int y = region.getLowerY(); y <= region.getUpperY(); y++)
+		{
+			for (int x = region.getLowerX(); x <= region.getUpperX(); x++)
+			{
+				iSum += volume.getVoxel(x, y, z);
+			}
+		}
+	}
+	QCOMPARE(iSum, 256 * 20 * 256);
+
+	// Only the 256 mixed chunks need memory of their own (4Mb), while the other 768 chunks share two buffers.
+	QCOMPARE(pager.m_uNoOfPageIns, static_cast<uint32_t>(1024));
+	QVERIFY(volume.calculateSizeInBytes() < 5 * 1024 * 1024);
+
+	// Writing the value which is already there leaves the chunk homogeneous, while writing anything else gives it its own data.
+	volume.setVoxel(20, 5, 20, 1);
+	QVERIFY(volume.pinChunk(Vector3DInt32(20, 5, 20))->isHomogeneous());
+	volume.setVoxel(20, 5, 20, 7);
+	QVERIFY(!volume.pinChunk(Vector3DInt32(20, 5, 20))->isHomogeneous());
+	QCOMPARE(volume.getVoxel(20, 5, 20), 7);
+	QCOMPARE(volume.getVoxel(21, 5, 20), 1);
+
+	// The other chunks which shared the data are unaffected, including when read through a sampler.
+	QCOMPARE(volume.getVoxel(40, 5, 20), 1);
+	QCOMPARE(volume.getVoxel(4, 5, 20), 1);
+	{
+		PagedVolume<int32_t>::Sampler sampler(&volume);
+		sampler.setPosition(15, 5, 20);
+		QCOMPARE(sampler.getVoxel(), 1);
+		QCOMPARE(sampler.peekVoxel1px0py0pz(), 1);
+		sampler.movePositiveX();
+		QCOMPARE(sampler.getVoxel(), 1);
+		sampler.setPosition(21, 5, 20);
+		QCOMPARE(sampler.peekVoxel1nx0py0pz(), 7);
+	}
+
+	// Only the modified chunk is written back, and the shared data is released along with the chunks. Just the remembered version
+	// of the modified chunk is left.
+	volume.flushAll();
+	QCOMPARE(pager.m_uNoOfPageOuts, static_cast<uint32_t>(1));
+	QVERIFY(volume.calculateSizeInBytes() > uEmptySizeInBytes);
+	QVERIFY(volume.calculateSizeInBytes() <= uEmptySizeInBytes + 64);
+
+	// A sampler sees writes through the volume which give the chunk it is already in its own data.
+	{
+		PagedVolume<int32_t>::Sampler sampler(&volume);
+		sampler.setPosition(40, 5, 20);
+		QVERIFY(volume.pinChunk(Vector3DInt32(40, 5, 20))->isHomogeneous());
+		volume.setVoxel(41, 5, 20, 42);
+		volume.setVoxel(40, 6, 20, 43);
+		QCOMPARE(sampler.getVoxel(), 1);
+		QCOMPARE(sampler.peekVoxel0px1py0pz(), 43);
+		sampler.movePositiveX();
+		QCOMPARE(sampler.getVoxel(), 42);
+		QCOMPARE(sampler.peekVoxel1nx1py0pz(), 43);
+
+		// Writing through the sampler afterwards goes to the chunk's new data.
+		sampler.setVoxel(44);
+		QCOMPARE(volume.getVoxel(41, 5, 20), 44);
+
+		// Copies of a sampler, and samplers which have been assigned to, are kept up to date in the same way.
+		sampler.setPosition(72, 5, 20);
+		PagedVolume<int32_t>::Sampler samplerCopy(sampler);
+		PagedVolume<int32_t>::Sampler samplerAssigned(&volume);
+		samplerAssigned.setPosition(0, 40, 0);
+		samplerAssigned = sampler;
+		QVERIFY(volume.pinChunk(Vector3DInt32(72, 5, 20))->isHomogeneous());
+		volume.setVoxel(72, 5, 20, 45);
+		QCOMPARE(sampler.getVoxel(), 45);
+		QCOMPARE(samplerCopy.getVoxel(), 45);
+		QCOMPARE(samplerAssigned.getVoxel(), 45);
+	}
+}
+
+void TestVolume::testPagedVolumeChunkBufferPool()
+{
+	// Chunks of 32Kb, which is large enough for the buffers to be page aligned. Each pass covers more chunks than fit in memory.
+	const uint16_t uChunkSideLength = 32;
+	const Region region(0, 0, 0, 511, 31, 511);
+	CountingTerrainPager pager;
+	PagedVolume<int32_t> volume(&pager, 2 * 1024 * 1024, uChunkSideLength);
+	const uint64_t uEmptySizeInBytes = volume.calculateSizeInBytes();
+	volume.preallocateChunkBuffers();
+
+	// Mixed chunks (which are the only ones with their own data) are paged in and recycled repeatedly as the passes alternate.
+	for (int iPass = 0; iPass < 3; iPass++)
+	{
+		int32_t iSum = 0;
+		for (int z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+		{
+			for (int y = region.getLowerY(); y <= region.getUpperY(); y++)
+			{
+				for (int x = region.getLowerX(); x <= region.getUpperX(); x++)
+				{
+					iSum += volume.getVoxel(x, y, z);
+				}
+			}
+		}
+		QCOMPARE(iSum, 512 * 20 * 512);
+
+		auto chunk = volume.pinChunk(Vector3DInt32(iPass * uChunkSideLength, 0, 0));
+		QVERIFY(!chunk->isHomogeneous());
+		QCOMPARE(reinterpret_cast<uintptr_t>(chunk->getData()) % 4096, static_cast<uintptr_t>(0));
+	}
+
+	QCOMPARE(pager.m_uNoOfPageOuts, static_cast<uint32_t>(0));
+	volume.flushAll();
+	QCOMPARE(volume.calculateSizeInBytes(), uEmptySizeInBytes);
+}
+
+void TestVolume::testPagedVolumeManyChunks()
+{
+	// Small chunks and a large budget, so that all 49152 chunks covering the region can be resident at once. Only the 16384 chunks
+	// in the layer containing the surface have their own data, which takes 32Mb.
+	const uint16_t uChunkSideLength = 8;
+	const Region region(0, 0, 0, 1023, 23, 1023);
+	CountingTerrainPager pager;
+	PagedVolume<int32_t> volume(&pager, 256 * 1024 * 1024, uChunkSideLength);
+	const uint64_t uEmptySizeInBytes = volume.calculateSizeInBytes();
+
+	// Visit every chunk twice. None should be paged in again, and those far from the first are looked up in the same way.
+	for (int iPass = 0; iPass < 2; iPass++)
+	{
+		int32_t iSum = 0;
+		for (int z = region.getLowerZ(); z <= region.getUpperZ(); z += uChunkSideLength)
+		{
+			for (int y = region.getLowerY(); y <= region.getUpperY(); y += uChunkSideLength)
+			{
+				for (int x = region.getLowerX(); x <= region.getUpperX(); x += uChunkSideLength)
+				{
+					iSum += volume.getVoxel(x, y, z) + volume.getVoxel(-1 - x, y, -1 - z);
+				}
+			}
+		}
+		QCOMPARE(iSum, 2 * 128 * 3 * 128);
+	}
+	QCOMPARE(pager.m_uNoOfPageIns, static_cast<uint32_t>(2 * 128 * 3 * 128));
+	QCOMPARE(pager.m_uNoOfPageOuts, static_cast<uint32_t>(0));
+
+	// Modify every other chunk and check everything can still be found as the chunks are removed again.
+	for (int z = region.getLowerZ(); z <= region.getUpperZ(); z += uChunkSideLength * 2)
+	{
+		for (int x = region.getLowerX(); x <= region.getUpperX(); x += uChunkSideLength)
+		{
+			volume.setVoxel(x, 0, z, 2);
+		}
+	}
+	QCOMPARE(volume.getVoxel(Vector3DInt32(512, 0, 512)), 2);
+	QCOMPARE(volume.getVoxel(Vector3DInt32(512, 0, 520)), 1);
+	volume.flushAll();
+	QCOMPARE(pager.m_uNoOfPageOuts, static_cast<uint32_t>(64 * 128));
+	QVERIFY(volume.calculateSizeInBytes() <= uEmptySizeInBytes + 64 * 128 * 64);
+}
+
+void TestVolume::testPagedVolumeTargetMemoryUsage()
+{
+	const uint16_t uChunkSideLength = 16;
+	const Region region(0, 0, 0, 255, 63, 255);
+	CountingTerrainPager pager;
+
+	// Budgets above 4Gb can be expressed. Nothing is allocated up front, so this is fine even on small machines.
+	PagedVolume<int32_t> volume(&pager, static_cast<uint64_t>(8) * 1024 * 1024 * 1024, uChunkSideLength);
+	QVERIFY(volume.calculateSizeInBytes() < 1024 * 1024);
+
+	int32_t iSum = 0;
+	for (int z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+	{
+		for (int y = region.getLowerY(); y <= region.getUpperY(); y++)
+		{
+			for (int x = region.getLowerX(); x <= region.getUpperX(); x++)
+			{
+				iSum += volume.getVoxel(x, y, z);
+			}
+		}
+	}
+	QCOMPARE(iSum, 256 * 20 * 256);
+
+	// The 256 mixed chunks take 4Mb, and the chunk objects add to that.
+	const uint64_t uFullSizeInBytes = volume.calculateSizeInBytes();
+	QVERIFY(uFullSizeInBytes > 256 * (16 * 16 * 16 * sizeof(int32_t) + sizeof(PagedVolume<int32_t>::Chunk)));
+
+	// Shrinking the budget compresses (or evicts) chunks immediately. None were modified so none are written back.
+	volume.setTargetMemoryUsage(1 * 1024 * 1024);
+	QVERIFY(volume.calculateSizeInBytes() <= 1 * 1024 * 1024);
+	QCOMPARE(pager.m_uNoOfPageOuts, static_cast<uint32_t>(0));
+
+	// Growing it again allows everything to be uncompressed once more.
+	volume.setTargetMemoryUsage(64 * 1024 * 1024);
+	iSum = 0;
+	for (int z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+	{
+		for (int y = region.getLowerY(); y <= region.getUpperY(); y++)
+		{
+			for (int x = region.getLowerX(); x <= region.getUpperX(); x++)
+			{
+				iSum += volume.getVoxel(x, y, z);
+			}
+		}
+	}
+	QCOMPARE(iSum, 256 * 20 * 256);
+	QCOMPARE(volume.calculateSizeInBytes(), uFullSizeInBytes);
+}
+
+void TestVolume::testPagedVolumeCheckpoint()
+{
+	const uint16_t uChunkSideLength = 16;
+	const Region region(0, 0, 0, 255, 63, 255);
+	CountingTerrainPager pager;
+	PagedVolume<int32_t> volume(&pager, 2 * 1024 * 1024, uChunkSideLength);
+
+	// Modify three chunks, then read the whole region so that they are compressed (but not paged out) to make room for the others.
+	volume.setVoxel(0, 0, 0, 5);
+	volume.setVoxel(100, 20, 100, 6);
+	volume.setVoxel(200, 40, 200, 7);
+	int32_t iSum = 0;
+	for (int z = region.getLowerZ(); z <= region.getUpperZ(); z++)
+	{
+		for (int y = region.getLowerY(); y <= region.getUpperY(); y++)
+		{
+			for (int x = region.getLowerX(); x <= region.getUpperX(); x++)
+			{
+				iSum += volume.getVoxel(x, y, z);
+			}
+		}
+	}
+	QCOMPARE(iSum, 256 * 20 * 256 - 1 + 5 + 6 + 7);
+	QCOMPARE(pager.m_uNoOfPageIns, static_cast<uint32_t>(1024));
+	QCOMPARE(pager.m_uNoOfPageOuts, static_cast<uint32_t>(0));
+
+	// Only modified chunks in the region are written.
+	volume.getPagingStatistics(true);
+	volume.flushDirty(Region(90, 10, 90, 110, 30, 110));
+	QCOMPARE(pager.m_uNoOfPageOuts, static_cast<uint32_t>(1));
+
+	// A checkpoint writes the rest, and the chunks stay resident so nothing has to be paged in again. The compressed chunks are
+	// written without being decompressed, so the chunks which were in use are not compressed to make room for them.
+	QVERIFY(volume.checkpoint());
+	QCOMPARE(pager.m_uNoOfPageOuts, static_cast<uint32_t>(3));
+	QCOMPARE(volume.getPagingStatistics().m_uNoOfCompressions, static_cast<uint64_t>(0));
+	QVERIFY(volume.checkpoint());
+	QCOMPARE(pager.m_uNoOfPageOuts, static_cast<uint32_t>(3));
+	QCOMPARE(volume.getVoxel(0, 0, 0), 5);
+	QCOMPARE(volume.getVoxel(100, 20, 100), 6);
+	QCOMPARE(volume.getVoxel(200, 40, 200), 7);
+	QCOMPARE(pager.m_uNoOfPageIns, static_cast<uint32_t>(1024));
+
+	// With a time budget the work may be split over several calls, but every chunk is written exactly once.
+	for (int x = 0; x < 256; x += uChunkSideLength)
+	{
+		volume.setVoxel(x, 30, 0, 8);
+	}
+	uint32_t uNoOfCalls = 1;
+	while (!volume.checkpoint(1))
+	{
+		uNoOfCalls++;
+	}
+	QVERIFY(uNoOfCalls <= 16);
+	QCOMPARE(pager.m_uNoOfPageOuts, static_cast<uint32_t>(3 + 16));
+
+	// Everything has been written, so there is nothing left to page out when the chunks are removed.
+	volume.flushAll();
+	QCOMPARE(pager.m_uNoOfPageOuts, static_cast<uint32_t>(3 + 16));
+}
+
+void TestVolume::testVolumeVersions()
+{
+	std::vector<Region> vecChanged;
+	std::vector<Region> vecAffected;
+	auto funcChangeListener = [&](const Region& regChanged, const Region& regAffected)
+	{
+		vecChanged.push_back(regChanged);
+		vecAffected.push_back(regAffected);
+	};
+
+	CountingTerrainPager pager;
+	PagedVolume<int32_t> volume(&pager, 2 * 1024 * 1024, 16);
+	volume.setChangeListener(funcChangeListener);
+	const Region regChunkA(0, 0, 0, 15, 15, 15);
+	const Region regChunkB(16, 0, 0, 31, 15, 15);
+	QCOMPARE(volume.getMaxVersion(regChunkA), static_cast<uint64_t>(0));
+
+	// Each write to a chunk is reported, even without the version being queried in between, along with the neighbouring voxels
+	// which may need re-meshing.
+	volume.setVoxel(1, 1, 1, 5);
+	volume.setVoxel(2, 2, 2, 5);
+	QCOMPARE(vecChanged.size(), static_cast<size_t>(2));
+	QVERIFY(vecChanged[0] == regChunkA);
+	QVERIFY(vecChanged[1] == regChunkA);
+	QVERIFY(vecAffected[0] == Region(-1, -1, -1, 16, 16, 16));
+	const uint64_t uVersionA = volume.getMaxVersion(regChunkA);
+	QVERIFY(uVersionA > 0);
+	QCOMPARE(volume.getMaxVersion(regChunkB), static_cast<uint64_t>(0));
+
+	// Reading does not change the version, but a write after it has been queried gives a higher one.
+	QCOMPARE(volume.getVoxel(1, 1, 1), 5);
+	QCOMPARE(volume.getMaxVersion(regChunkA), uVersionA);
+	volume.setVoxel(3, 3, 3, 6);
+	QCOMPARE(vecChanged.size(), static_cast<size_t>(3));
+	const uint64_t uVersionA2 = volume.getMaxVersion(regChunkA);
+	QVERIFY(uVersionA2 > uVersionA);
+	volume.setVoxel(20, 0, 0, 7);
+	QVERIFY(vecChanged.back() == regChunkB);
+	const uint64_t uVersionB = volume.getMaxVersion(regChunkB);
+	QVERIFY(uVersionB > uVersionA2);
+	QCOMPARE(volume.getMaxVersion(Region(0, 0, 0, 31, 15, 15)), uVersionB);
+
+	// Versions are remembered while chunks are paged out, and when they are paged back in.
+	volume.flushAll();
+	QCOMPARE(volume.getMaxVersion(regChunkA), uVersionA2);
+	QCOMPARE(volume.getMaxVersion(regChunkB), uVersionB);
+	volume.getVoxel(20, 0, 0);
+	QCOMPARE(volume.getMaxVersion(regChunkB), uVersionB);
+	QCOMPARE(vecChanged.size(), static_cast<size_t>(4));
+
+	// Modifying many more chunks than fit in memory does not make the remembered versions grow without limit (they take less than
+	// 16 bytes per chunk here). Those which are forgotten are replaced by a higher version, so the regions are still seen to have changed.
+	PagedVolume<int32_t> largeVolume(&pager, 2 * 1024 * 1024, 8);
+	const uint64_t uEmptySizeInBytes = largeVolume.calculateSizeInBytes();
+	largeVolume.setVoxel(0, 0, 0, 9);
+	const uint64_t uFirstVersion = largeVolume.getMaxVersion(Region(0, 0, 0, 7, 7, 7));
+	const int32_t iNoOfChunks = 200000;
+	for (int32_t iChunk = 1; iChunk < iNoOfChunks; iChunk++)
+	{
+		largeVolume.setVoxel((iChunk % 500) * 8, 0, (iChunk / 500) * 8, 9);
+	}
+	largeVolume.flushAll();
+	QVERIFY(largeVolume.calculateSizeInBytes() < uEmptySizeInBytes + iNoOfChunks * 16);
+	QVERIFY(largeVolume.getMaxVersion(Region(0, 0, 0, 7, 7, 7)) >= uFirstVersion);
+	QVERIFY(largeVolume.getMaxVersion(Region(8, 0, 0, 15, 7, 7)) > uFirstVersion);
+
+	// The RawVolume tracks changes in the same way, using tiles of 16 voxels which are cropped to the volume.
+	vecChanged.clear();
+	vecAffected.clear();
+	RawVolume<int32_t> rawVolume(Region(0, 0, 0, 39, 39, 39));
+	rawVolume.setChangeListener(funcChangeListener);
+	rawVolume.setVoxel(39, 39, 39, 1);
+	QCOMPARE(vecChanged.size(), static_cast<size_t>(1));
+	QVERIFY(vecChanged[0] == Region(32, 32, 32, 39, 39, 39));
+	QVERIFY(vecAffected[0] == Region(31, 31, 31, 40, 40, 40));
+	const uint64_t uRawVersion = rawVolume.getMaxVersion(Region(30, 30, 30, 50, 50, 50));
+	QVERIFY(uRawVersion > 0);
+	QCOMPARE(rawVolume.getMaxVersion(Region(0, 0, 0, 31, 31, 31)), static_cast<uint64_t>(0));
+
+	RawVolume<int32_t>::Sampler sampler(&rawVolume);
+	sampler.setPosition(35, 35, 35);
+	sampler.setVoxel(2);
+	QCOMPARE(vecChanged.size(), static_cast<size_t>(2));
+	QVERIFY(rawVolume.getMaxVersion(Region(35, 35, 35, 35, 35, 35)) > uRawVersion);
+	rawVolume.setVoxel(36, 36, 36, 3);
+	sampler.setVoxel(4);
+	QCOMPARE(vecChanged.size(), static_cast<size_t>(4));
+	QVERIFY(vecChanged[3] == Region(32, 32, 32, 39, 39, 39));
+}
+
+void TestVolume::testVolumeBulkWrites()
+{
+	// The region covers whole chunks as well as parts of chunks, and has negative coordinates.
+	const Region regWrite(-5, 3, -20, 40, 35, 18);
+	auto funcGenerator = [](int32_t x, int32_t y, int32_t z) { return x * 3 + y * 5 + z * 7; };
+
+	CountingTerrainPager pager;
+	PagedVolume<int32_t> volume(&pager, 4 * 1024 * 1024, 16);
+	uint32_t uNoOfChunksChanged = 0;
+	volume.setChangeListener([&](const Region&, const Region&) { uNoOfChunksChanged++; });
+
+	volume.fill(regWrite, 7);
+	QCOMPARE(uNoOfChunksChanged, static_cast<uint32_t>(4 * 3 * 4));
+
+	// The four chunks which are entirely inside the region are not paged in.
+	QCOMPARE(pager.m_uNoOfPageIns, static_cast<uint32_t>(4 * 3 * 4 - 4));
+	const uint64_t uSizeAfterFill = volume.calculateSizeInBytes();
+	for (int32_t z = regWrite.getLowerZ() - 1; z <= regWrite.getUpperZ() + 1; z++)
+	{
+		for (int32_t y = regWrite.getLowerY() - 1; y <= regWrite.getUpperY() + 1; y++)
+		{
+			for (int32_t x = regWrite.getLowerX() - 1; x <= regWrite.getUpperX() + 1; x++)
+			{
+				const int32_t iExpected = regWrite.containsPoint(x, y, z) ? 7 : ((y < 20) ? 1 : 0);
+				QCOMPARE(volume.getVoxel(x, y, z), iExpected);
+			}
+		}
+	}
+
+	// Filling a chunk with the value it already contains does not modify it.
+	uNoOfChunksChanged = 0;
+	volume.fill(Region(0, 16, 0, 15, 31, 15), 7);
+	QCOMPARE(uNoOfChunksChanged, static_cast<uint32_t>(0));
+
+	volume.generate(regWrite, funcGenerator);
+	for (int32_t z = regWrite.getLowerZ(); z <= regWrite.getUpperZ(); z++)
+	{
+		for (int32_t y = regWrite.getLowerY(); y <= regWrite.getUpperY(); y++)
+		{
+			for (int32_t x = regWrite.getLowerX(); x <= regWrite.getUpperX(); x++)
+			{
+				QCOMPARE(volume.getVoxel(x, y, z), funcGenerator(x, y, z));
+			}
+		}
+	}
+	QVERIFY(volume.calculateSizeInBytes() > uSizeAfterFill);
+
+	std::vector<int32_t> vecSource;
+	for (int32_t z = regWrite.getLowerZ(); z <= regWrite.getUpperZ(); z++)
+	{
+		for (int32_t y = regWrite.getLowerY(); y <= regWrite.getUpperY(); y++)
+		{
+			for (int32_t x = regWrite.getLowerX(); x <= regWrite.getUpperX(); x++)
+			{
+				vecSource.push_back(funcGenerator(z, x, y));
+			}
+		}
+	}
+	volume.setVoxels(regWrite, vecSource.data());
+	QCOMPARE(volume.getVoxel(regWrite.getLowerCorner()), vecSource.front());
+	QCOMPARE(volume.getVoxel(regWrite.getUpperCorner()), vecSource.back());
+	QCOMPARE(volume.getVoxel(10, 20, 0), funcGenerator(0, 10, 20));
+
+	// All the chunks which were written to are paged out.
+	volume.flushAll();
+	QCOMPARE(pager.m_uNoOfPageOuts, static_cast<uint32_t>(4 * 3 * 4));
+
+	// The RawVolume offers the same functions, but the region must be inside the volume.
+	RawVolume<int32_t> rawVolume(Region(-10, -10, -30, 50, 50, 30));
+	rawVolume.fill(regWrite, 7);
+	QCOMPARE(rawVolume.getVoxel(regWrite.getLowerCorner()), 7);
+	QCOMPARE(rawVolume.getVoxel(regWrite.getUpperCorner()), 7);
+	QCOMPARE(rawVolume.getVoxel(regWrite.getLowerCorner() - Vector3DInt32(1, 0, 0)), 0);
+	QCOMPARE(rawVolume.getVoxel(regWrite.getUpperCorner() + Vector3DInt32(0, 0, 1)), 0);
+
+	rawVolume.generate(regWrite, funcGenerator);
+	QCOMPARE(rawVolume.getVoxel(10, 20, 0), funcGenerator(10, 20, 0));
+	rawVolume.setVoxels(regWrite, vecSource.data());
+	QCOMPARE(rawVolume.getVoxel(regWrite.getLowerCorner()), vecSource.front());
+	QCOMPARE(rawVolume.getVoxel(regWrite.getUpperCorner()), vecSource.back());
+	QCOMPARE(rawVolume.getVoxel(10, 20, 0), funcGenerator(0, 10, 20));
+
+	bool bExceptionThrown = false;
+	try
+	{
+		rawVolume.fill(Region(0, 0, 0, 60, 0, 0), 1);
+	}
+	catch (const std::out_of_range&)
+	{
+		bExceptionThrown = true;
+	}
+	QVERIFY(bExceptionThrown);
+}
+
+void TestVolume::testVolumeBulkReads()
+{
+	const Region regVolume(-20, -20, -20, 60, 60, 60);
+	auto funcGenerator = [](int32_t x, int32_t y, int32_t z) { return x * 3 + y * 5 + z * 7; };
+
+	// The pager does not store the data, so the budget must be large enough for it all to stay in memory.
+	CountingTerrainPager pager;
+	PagedVolume<int32_t> volume(&pager, 16 * 1024 * 1024, 16);
+	volume.generate(regVolume, funcGenerator);
+	RawVolume<int32_t> rawVolume(regVolume);
+	rawVolume.generate(regVolume, funcGenerator);
+
+	// The region spans several chunks, and is read into a larger buffer with a border around it.
+	const Region regRead(-7, 5, -18, 33, 21, 40);
+	const int32_t iRowStride = regRead.getWidthInVoxels() + 2;
+	const int32_t iSliceStride = iRowStride * (regRead.getHeightInVoxels() + 1);
+	std::vector<int32_t> vecPaged(iSliceStride * regRead.getDepthInVoxels(), -1);
+	std::vector<int32_t> vecRaw(vecPaged);
+	volume.readRegion(regRead, vecPaged.data(), iRowStride, iSliceStride);
+	rawVolume.readRegion(regRead, vecRaw.data(), iRowStride, iSliceStride);
+	for (int32_t z = regRead.getLowerZ(); z <= regRead.getUpperZ(); z++)
+	{
+		for (int32_t y = regRead.getLowerY(); y <= regRead.getUpperY(); y++)
+		{
+			for (int32_t x = regRead.getLowerX(); x <= regRead.getUpperX(); x++)
+			{
+				const int32_t iIndex = (x - regRead.getLowerX()) + (y - regRead.getLowerY()) * iRowStride + (z - regRead.getLowerZ()) * iSliceStride;
+				QCOMPARE(vecPaged[iIndex], funcGenerator(x, y, z));
+				QCOMPARE(vecRaw[iIndex], funcGenerator(x, y, z));
+			}
+		}
+	}
+	QCOMPARE(vecPaged[regRead.getWidthInVoxels()], -1);
+	QCOMPARE(vecRaw[regRead.getWidthInVoxels()], -1);
+
+	// Each chunk is visited once, and the spans cover the region exactly.
+	uint32_t uNoOfChunks = 0;
+	int32_t iNoOfVoxels = 0;
+	volume.forEachChunkSpan(regRead, [&](const Region& regChunk, const Region& regSpan, const int32_t* pChunkData)
+	{
+		QVERIFY(regChunk.containsRegion(regSpan));
+		QVERIFY(regRead.containsRegion(regSpan));
+		QCOMPARE(pChunkData[0], volume.getVoxel(regChunk.getLowerCorner()));
+		uNoOfChunks++;
+		iNoOfVoxels += regSpan.getWidthInVoxels() * regSpan.getHeightInVoxels() * regSpan.getDepthInVoxels();
+	});
+	QCOMPARE(uNoOfChunks, static_cast<uint32_t>(4 * 2 * 5));
+	QCOMPARE(iNoOfVoxels, regRead.getWidthInVoxels() * regRead.getHeightInVoxels() * regRead.getDepthInVoxels());
+
+	// Parts of the region outside a RawVolume are given the border value.
+	rawVolume.setBorderValue(-2);
+	std::vector<int32_t> vecBorder(4 * 4 * 4);
+	rawVolume.readRegion(Region(58, 58, 58, 61, 61, 61), vecBorder.data());
+	QCOMPARE(vecBorder[0], funcGenerator(58, 58, 58));
+	QCOMPARE(vecBorder[2 + 2 * 4 + 2 * 16], funcGenerator(60, 60, 60));
+	QCOMPARE(vecBorder[3 + 2 * 4 + 2 * 16], -2);
+	QCOMPARE(vecBorder[63], -2);
+}
+
+void TestVolume::testPagedVolumeSnapshots()
+{
+	auto funcInitial = [](int32_t x, int32_t y, int32_t z) { return x + y * 32 + z * 1024; };
+	auto funcExpected = [&](int32_t x, int32_t y, int32_t z)
+	{
+		// Chunks outside the generated region are homogeneous, as they come from the pager.
+		return Region(0, 0, 0, 31, 31, 31).containsPoint(x, y, z) ? funcInitial(x, y, z) : ((y < 20) ? 1 : 0);
+	};
+
+	// The pager does not store the data, so the budget must be large enough for it all to stay in memory.
+	CountingTerrainPager pager;
+	PagedVolume<int32_t> volume(&pager, 16 * 1024 * 1024, 16);
+	volume.generate(Region(0, 0, 0, 31, 31, 31), funcInitial);
+
+	QVERIFY(!PagedVolume<int32_t>::Snapshot());
+	const PagedVolume<int32_t>::Snapshot snapshot = volume.snapshot();
+	QVERIFY(snapshot);
+
+	// Each way of writing to the volume must leave the snapshot as it was. The last chunk was not paged in when the snapshot was taken.
+	volume.setVoxel(5, 5, 5, -1);
+	volume.setVoxel(40, 5, 5, -1);
+	volume.fill(Region(0, 16, 0, 15, 31, 15), -2);
+	volume.generate(Region(16, 0, 16, 40, 10, 40), [](int32_t, int32_t, int32_t) { return -3; });
+	volume.setVoxel(100, 100, 100, -4);
+
+	// A second snapshot sees these changes, but not the later ones.
+	const PagedVolume<int32_t>::Snapshot snapshot2 = volume.snapshot();
+	const Region regFill(8, 8, 8, 55, 55, 55);
+	volume.fill(regFill, -5);
+
+	QCOMPARE(snapshot.getVoxel(5, 5, 5), funcExpected(5, 5, 5));
+	QCOMPARE(snapshot.getVoxel(40, 5, 5), 1);
+	QCOMPARE(snapshot.getVoxel(Vector3DInt32(100, 100, 100)), 0);
+	QCOMPARE(snapshot2.getVoxel(5, 5, 5), -1);
+	QCOMPARE(snapshot2.getVoxel(40, 5, 5), -1);
+	QCOMPARE(snapshot2.getVoxel(Vector3DInt32(100, 100, 100)), -4);
+	QCOMPARE(volume.getVoxel(40, 5, 5), -1);
+	QCOMPARE(volume.getVoxel(20, 20, 20), -5);
+
+	const Region regRead(-8, -8, -8, 63, 63, 63);
+	std::vector<int32_t> vecSnapshot(regRead.getWidthInVoxels() * regRead.getHeightInVoxels() * regRead.getDepthInVoxels());
+	std::vector<int32_t> vecSnapshot2(vecSnapshot.size());
+	std::vector<int32_t> vecVolume(vecSnapshot.size());
+	snapshot.readRegion(regRead, vecSnapshot.data());
+	snapshot2.readRegion(regRead, vecSnapshot2.data());
+	volume.readRegion(regRead, vecVolume.data());
+	uint32_t uIndex = 0;
+	for (int32_t z = regRead.getLowerZ(); z <= regRead.getUpperZ(); z++)
+	{
+		for (int32_t y = regRead.getLowerY(); y <= regRead.getUpperY(); y++)
+		{
+			for (int32_t x = regRead.getLowerX(); x <= regRead.getUpperX(); x++)
+			{
+				int32_t iExpected = funcExpected(x, y, z);
+				QCOMPARE(vecSnapshot[uIndex], iExpected);
+
+				if ((x == 5 && y == 5 && z == 5) || (x == 40 && y == 5 && z == 5))
+				{
+					iExpected = -1;
+				}
+				if (Region(0, 16, 0, 15, 31, 15).containsPoint(x, y, z))
+				{
+					iExpected = -2;
+				}
+				if (Region(16, 0, 16, 40, 10, 40).containsPoint(x, y, z))
+				{
+					iExpected = -3;
+				}
+				QCOMPARE(vecSnapshot2[uIndex], iExpected);
+				QCOMPARE(vecVolume[uIndex], regFill.containsPoint(x, y, z) ? -5 : iExpected);
+				uIndex++;
+			}
+		}
+	}
+
+	// A sampler sees writes through the volume which give the chunk it is in to a snapshot, and carry on with a copy of the data.
+	{
+		volume.setVoxel(0, 64, 0, 9);
+		PagedVolume<int32_t>::Sampler sampler(&volume);
+		sampler.setPosition(0, 64, 0);
+		QCOMPARE(sampler.getVoxel(), 9);
+		const PagedVolume<int32_t>::Snapshot snapshot3 = volume.snapshot();
+		volume.setVoxel(1, 64, 0, 11);
+		QCOMPARE(sampler.peekVoxel1px0py0pz(), 11);
+		sampler.movePositiveX();
+		QCOMPARE(sampler.getVoxel(), 11);
+		QCOMPARE(snapshot3.getVoxel(1, 64, 0), 0);
+		QCOMPARE(snapshot3.getVoxel(0, 64, 0), 9);
+	}
+
+	// With concurrent access a snapshot stays the same while another thread writes to the volume.
+	PagedVolume<int32_t> concurrentVolume(&pager, 16 * 1024 * 1024, 16, true);
+	const Region regWrite(0, 0, 0, 47, 47, 47);
+	std::atomic<bool> bWriting(true);
+	std::thread writer([&]
+	{
+		for (int32_t iPass = 0; bWriting; iPass++)
+		{
+			concurrentVolume.generate(regWrite, [&](int32_t x, int32_t y, int32_t z) { return iPass + x + y + z; });
+			concurrentVolume.setVoxel(iPass % 48, 0, 0, -iPass);
+		}
+	});
+
+	std::vector<int32_t> vecFirstRead(regWrite.getWidthInVoxels() * regWrite.getHeightInVoxels() * regWrite.getDepthInVoxels());
+	std::vector<int32_t> vecSecondRead(vecFirstRead.size());
+	bool bSnapshotsUnchanged = true;
+	for (uint32_t ct = 0; ct < 20; ct++)
+	{
+		const PagedVolume<int32_t>::Snapshot concurrentSnapshot = concurrentVolume.snapshot();
+		concurrentSnapshot.readRegion(regWrite, vecFirstRead.data());
+		std::this_thread::yield();
+		concurrentSnapshot.readRegion(regWrite, vecSecondRead.data());
+		bSnapshotsUnchanged = bSnapshotsUnchanged && (vecFirstRead == vecSecondRead);
+	}
+	bWriting = false;
+	writer.join();
+	QVERIFY(bSnapshotsUnchanged);
+}
+
+void TestVolume::testPagedVolumeSamplerWrites()
+{
+	// The pager does not store the data, so the budget must be large enough for it all to stay in memory.
+	CountingTerrainPager pager;
+	PagedVolume<int32_t> volume(&pager, 16 * 1024 * 1024, 16);
+	const Region regChunk(0, 0, 0, 15, 15, 15);
+	QCOMPARE(volume.getMaxVersion(regChunk), static_cast<uint64_t>(0));
+
+	// The row crosses several chunks, all of which start off homogeneous.
+	PagedVolume<int32_t>::Sampler sampler(&volume);
+	sampler.setPosition(-5, 10, 3);
+	for (int32_t x = -5; x <= 40; x++)
+	{
+		QVERIFY(sampler.setVoxel(x * 10));
+		QCOMPARE(sampler.getVoxel(), x * 10);
+		sampler.movePositiveX();
+	}
+	for (int32_t x = -5; x <= 40; x++)
+	{
+		QCOMPARE(volume.getVoxel(x, 10, 3), x * 10);
+	}
+	QCOMPARE(volume.getVoxel(0, 11, 3), 1);
+	QVERIFY(volume.getMaxVersion(regChunk) > 0);
+
+	// A snapshot is not affected by later writes, even though the sampler had already made the chunk writable.
+	const PagedVolume<int32_t>::Snapshot snapshot = volume.snapshot();
+	sampler.setPosition(2, 10, 3);
+	sampler.setVoxel(-1);
+	QCOMPARE(sampler.getVoxel(), -1);
+	QCOMPARE(volume.getVoxel(2, 10, 3), -1);
+	QCOMPARE(snapshot.getVoxel(2, 10, 3), 20);
+
+	// A region writer visits the voxels in raster order.
+	auto funcValue = [](int32_t x, int32_t y, int32_t z) { return x + y * 100 + z * 10000; };
+	const Region regWrite(-20, 5, -3, 37, 21, 18);
+	{
+		PagedVolume<int32_t>::RegionWriter writer(&volume, regWrite);
+		for (int32_t z = regWrite.getLowerZ(); z <= regWrite.getUpperZ(); z++)
+		{
+			for (int32_t y = regWrite.getLowerY(); y <= regWrite.getUpperY(); y++)
+			{
+				for (int32_t x = regWrite.getLowerX(); x <= regWrite.getUpperX(); x++)
+				{
+					QVERIFY(!writer.isFinished());
+					QVERIFY(writer.getPosition() == Vector3DInt32(x, y, z));
+
+					// Taking a snapshot part of the way through means the chunks must be made writable again.
+					if (z == 0 && y == 5 && x == 0)
+					{
+						const PagedVolume<int32_t>::Snapshot snapshotDuringWrite = volume.snapshot();
+						writer.writeVoxel(funcValue(x, y, z));
+						QCOMPARE(snapshotDuringWrite.getVoxel(x, y, z), 1);
+						QCOMPARE(snapshotDuringWrite.getVoxel(x - 1, y, z), funcValue(x - 1, y, z));
+					}
+					else
+					{
+						writer.writeVoxel(funcValue(x, y, z));
+					}
+				}
+			}
+		}
+		QVERIFY(writer.isFinished());
+	}
+
+	std::vector<int32_t> vecRead(regWrite.getWidthInVoxels() * regWrite.getHeightInVoxels() * regWrite.getDepthInVoxels());
+	volume.readRegion(regWrite, vecRead.data());
+	uint32_t uIndex = 0;
+	for (int32_t z = regWrite.getLowerZ(); z <= regWrite.getUpperZ(); z++)
+	{
+		for (int32_t y = regWrite.getLowerY(); y <= regWrite.getUpperY(); y++)
+		{
+			for (int32_t x = regWrite.getLowerX(); x <= regWrite.getUpperX(); x++)
+			{
+				QCOMPARE(vecRead[uIndex++], funcValue(x, y, z));
+			}
+		}
+	}
+	QCOMPARE(snapshot.getVoxel(0, 10, 3), 0);
+
+	// A writer which stops part of the way along a row only marks the chunks which it actually wrote to as modified.
+	{
+		PagedVolume<int32_t>::RegionWriter writer(&volume, Region(0, 64, 0, 47, 64, 0));
+		for (int32_t x = 0; x < 20; x++)
+		{
+			writer.writeVoxel(x);
+		}
+	}
+	QVERIFY(volume.getMaxVersion(Region(0, 64, 0, 15, 79, 15)) > 0);
+	QVERIFY(volume.getMaxVersion(Region(16, 64, 0, 31, 79, 15)) > 0);
+	QCOMPARE(volume.getMaxVersion(Region(32, 64, 0, 47, 79, 15)), static_cast<uint64_t>(0));
+	QCOMPARE(volume.getVoxel(19, 64, 0), 19);
+}
+
+void TestVolume::testPagedVolumeSamplerNeighbours()
+{
+	CountingTerrainPager pager;
+	PagedVolume<int32_t> volume(&pager, 16 * 1024 * 1024, 8);
+	auto funcValue = [](int32_t x, int32_t y, int32_t z) { return x + y * 100 + z * 10000; };
+	const Region regData(-9, -9, -9, 17, 17, 17);
+	volume.generate(regData, funcValue);
+
+	typedef PagedVolume<int32_t>::Sampler Sampler;
+	int32_t(Sampler::*arrayPeeks[27])(void) const =
+	{
+		&Sampler::peekVoxel1nx1ny1nz, &Sampler::peekVoxel0px1ny1nz, &Sampler::peekVoxel1px1ny1nz,
+		&Sampler::peekVoxel1nx0py1nz, &Sampler::peekVoxel0px0py1nz, &Sampler::peekVoxel1px0py1nz,
+		&Sampler::peekVoxel1nx1py1nz, &Sampler::peekVoxel0px1py1nz, &Sampler::peekVoxel1px1py1nz,
+		&Sampler::peekVoxel1nx1ny0pz, &Sampler::peekVoxel0px1ny0pz, &Sampler::peekVoxel1px1ny0pz,
+		&Sampler::peekVoxel1nx0py0pz, &Sampler::peekVoxel0px0py0pz, &Sampler::peekVoxel1px0py0pz,
+		&Sampler::peekVoxel1nx1py0pz, &Sampler::peekVoxel0px1py0pz, &Sampler::peekVoxel1px1py0pz,
+		&Sampler::peekVoxel1nx1ny1pz, &Sampler::peekVoxel0px1ny1pz, &Sampler::peekVoxel1px1ny1pz,
+		&Sampler::peekVoxel1nx0py1pz, &Sampler::peekVoxel0px0py1pz, &Sampler::peekVoxel1px0py1pz,
+		&Sampler::peekVoxel1nx1py1pz, &Sampler::peekVoxel0px1py1pz, &Sampler::peekVoxel1px1py1pz,
+	};
+	auto funcCheckPeeks = [&](const Sampler& sampler) -> bool
+	{
+		const Vector3DInt32 v3dPos = sampler.getPosition();
+		for (int32_t ct = 0; ct < 27; ct++)
+		{
+			const int32_t x = v3dPos.getX() + ct % 3 - 1;
+			const int32_t y = v3dPos.getY() + (ct / 3) % 3 - 1;
+			const int32_t z = v3dPos.getZ() + ct / 9 - 1;
+			if ((sampler.*arrayPeeks[ct])() != volume.getVoxel(x, y, z))
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	// Walk along every axis through the corners and edges of the chunks, in both directions.
+	const Region regWalk(-8, -8, -8, 16, 16, 16);
+	Sampler sampler(&volume);
+	for (int32_t a = regWalk.getLowerX(); a <= regWalk.getUpperX(); a += 3)
+	{
+		for (int32_t b = regWalk.getLowerY(); b <= regWalk.getUpperY(); b += 4)
+		{
+			sampler.setPosition(regWalk.getLowerX(), a, b);
+			for (int32_t x = regWalk.getLowerX(); x <= regWalk.getUpperX(); x++)
+			{
+				QVERIFY(funcCheckPeeks(sampler));
+				sampler.movePositiveX();
+			}
+			sampler.setPosition(a, regWalk.getUpperY(), b);
+			for (int32_t y = regWalk.getUpperY(); y >= regWalk.getLowerY(); y--)
+			{
+				QVERIFY(funcCheckPeeks(sampler));
+				sampler.moveNegativeY();
+			}
+			sampler.setPosition(a, b, regWalk.getLowerZ());
+			for (int32_t z = regWalk.getLowerZ(); z <= regWalk.getUpperZ(); z++)
+			{
+				QVERIFY(funcCheckPeeks(sampler));
+				sampler.movePositiveZ();
+			}
+		}
+	}
+
+	// Writes through the volume are seen by the neighbours, including when they give a homogeneous chunk its own data.
+	sampler.setPosition(23, 7, 7);
+	QCOMPARE(sampler.peekVoxel1px1py1pz(), 1);
+	volume.setVoxel(24, 8, 8, -5);
+	volume.setVoxel(22, 6, 6, -6);
+	QCOMPARE(sampler.peekVoxel1px1py1pz(), -5);
+	QCOMPARE(sampler.peekVoxel1nx1ny1nz(), -6);
+	sampler.movePositiveX();
+	sampler.movePositiveY();
+	sampler.movePositiveZ();
+	QCOMPARE(sampler.getVoxel(), -5);
+	QCOMPARE(sampler.peekVoxel1nx1ny1nz(), 1);
+
+	// Copies hold on to the neighbours independently.
+	Sampler samplerCopy(sampler);
+	sampler.setPosition(100, 100, 100);
+	QCOMPARE(samplerCopy.getVoxel(), -5);
+	QVERIFY(funcCheckPeeks(samplerCopy));
+	sampler = samplerCopy;
+	samplerCopy.setPosition(0, 0, 0);
+	QVERIFY(funcCheckPeeks(sampler));
+	QVERIFY(funcCheckPeeks(samplerCopy));
+}
+
+void TestVolume::testPagedVolumeFocus()
+{
+	CountingTerrainPager pager;
+	PagedVolume<int32_t> volume(&pager, 4 * 1024 * 1024, 16);
+
+	// The squared distance from the nearest focus point to the nearest voxel of the chunk at the given position.
+	auto funcDistanceSquared = [](const Vector3DInt32& v3dChunkLower, const std::vector<Vector3DInt32>& vecFocusPoints)
+	{
+		int64_t iMinDistanceSquared = (std::numeric_limits<int64_t>::max)();
+		for (const Vector3DInt32& v3dFocusPoint : vecFocusPoints)
+		{
+			int64_t iDistanceSquared = 0;
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				const int64_t iDistance = (std::max)(0, (std::max)(v3dChunkLower.getElement(i) - v3dFocusPoint.getElement(i), v3dFocusPoint.getElement(i) - v3dChunkLower.getElement(i) - 15));
+				iDistanceSquared += iDistance * iDistance;
+			}
+			iMinDistanceSquared = (std::min)(iMinDistanceSquared, iDistanceSquared);
+		}
+		return iMinDistanceSquared;
+	};
+
+	// The chunks are paged in nearest first, and only those which are within the radius.
+	std::vector<Vector3DInt32> vecFocusPoints = { Vector3DInt32(8, 8, 8), Vector3DInt32(100, 8, 8) };
+	volume.setFocus(vecFocusPoints, 20).get();
+	QVERIFY(pager.m_uNoOfPageIns > 0);
+	QCOMPARE(pager.m_uNoOfPageIns, static_cast<uint32_t>(pager.m_vecPageInPositions.size()));
+	for (uint32_t ct = 0; ct < pager.m_vecPageInPositions.size(); ct++)
+	{
+		QVERIFY(funcDistanceSquared(pager.m_vecPageInPositions[ct], vecFocusPoints) <= 20 * 20);
+		if (ct > 0)
+		{
+			QVERIFY(funcDistanceSquared(pager.m_vecPageInPositions[ct], vecFocusPoints) >= funcDistanceSquared(pager.m_vecPageInPositions[ct - 1], vecFocusPoints));
+		}
+	}
+	QCOMPARE(pager.m_vecPageInPositions.front(), Vector3DInt32(0, 0, 0));
+
+	// They are all still resident, so accessing the region around a focus point does not page anything in.
+	const uint32_t uNoOfPageIns = pager.m_uNoOfPageIns;
+	QCOMPARE(volume.getVoxel(8, 8 + 19, 8), 0);
+	QCOMPARE(volume.getVoxel(100 - 19, 8, 8), 1);
+	QCOMPARE(pager.m_uNoOfPageIns, uNoOfPageIns);
+
+	// Chunks which are already resident are not paged in again when the focus moves, and with a small budget those furthest from
+	// the new focus point are evicted first.
+	volume.setTargetMemoryUsage(1 * 1024 * 1024);
+	pager.m_vecPageInPositions.clear();
+	vecFocusPoints = { Vector3DInt32(40, 8, 8) };
+	volume.setFocus(vecFocusPoints, 20).get();
+	for (const Vector3DInt32& v3dChunkLower : pager.m_vecPageInPositions)
+	{
+		QVERIFY(funcDistanceSquared(v3dChunkLower, vecFocusPoints) <= 20 * 20);
+	}
+	pager.m_vecPageInPositions.clear();
+	for (int32_t x = 40 - 20; x <= 40 + 20; x++)
+	{
+		volume.getVoxel(x, 8, 8);
+	}
+	QVERIFY(pager.m_vecPageInPositions.empty());
+
+	// With background paging threads a new focus cancels the chunks of the previous one which have not been paged in yet, but its
+	// future still becomes ready.
+	FilePager<int32_t> filePager(".");
+	PagedVolume<int32_t> concurrentVolume(&filePager, 4 * 1024 * 1024, 16, true, 2);
+	std::future<void> futureFirst = concurrentVolume.setFocus({ Vector3DInt32(0, 0, 0) }, 100);
+	std::future<void> futureSecond = concurrentVolume.setFocus({ Vector3DInt32(1000, 0, 0), Vector3DInt32(0, 1000, 0) }, 20);
+	futureFirst.get();
+	futureSecond.get();
+	concurrentVolume.setVoxel(1000, 0, 0, 5);
+	QCOMPARE(concurrentVolume.getVoxel(1000, 0, 0), 5);
+}
+
+void TestVolume::testPagedVolumePagingStatistics()
+{
+	CountingTerrainPager pager;
+	PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, 16);
+	auto funcSumLatencies = [](const uint64_t* pLatencyBuckets)
+	{
+		uint64_t uSum = 0;
+		for (uint32_t ct = 0; ct < PagingStatistics::uNoOfLatencyBuckets; ct++)
+		{
+			uSum += pLatencyBuckets[ct];
+		}
+		return uSum;
+	};
+
+	PagingStatistics statistics = volume.getPagingStatistics();
+	QCOMPARE(statistics.m_uNoOfPageIns, static_cast<uint64_t>(0));
+	QCOMPARE(statistics.m_uNoOfChunkTableLookups, static_cast<uint64_t>(0));
+	QCOMPARE(statistics.getLastChunkCacheHitRate(), 0.0f);
+
+	// Repeated accesses to one chunk only look it up once.
+	for (int32_t x = 0; x < 16; x++)
+	{
+		volume.setVoxel(x, 30, 0, x);
+	}
+	statistics = volume.getPagingStatistics();
+	QCOMPARE(statistics.m_uNoOfPageIns, static_cast<uint64_t>(1));
+#ifdef POLYVOX_LOOKUP_STATISTICS_ENABLED
+	QCOMPARE(statistics.m_uNoOfLastChunkCacheHits, static_cast<uint64_t>(15));
+	QVERIFY(statistics.getLastChunkCacheHitRate() > 0.5f);
+	QVERIFY(statistics.getAverageProbeLength() >= 1.0f);
+#else
+	// Lookups are not counted, so that they stay as cheap as possible.
+	QCOMPARE(statistics.m_uNoOfLastChunkCacheHits, static_cast<uint64_t>(0));
+	QCOMPARE(statistics.m_uNoOfChunkTableLookups, static_cast<uint64_t>(0));
+#endif
+	QCOMPARE(funcSumLatencies(statistics.m_arrayPageInLatency), static_cast<uint64_t>(1));
+
+	// Writing back the modified chunk keeps it resident.
+	volume.flushDirty(Region(0, 0, 0, 15, 31, 15));
+	statistics = volume.getPagingStatistics(true);
+	QCOMPARE(statistics.m_uNoOfDirtyWriteBacks, static_cast<uint64_t>(1));
+	QCOMPARE(statistics.m_uNoOfPageOuts, static_cast<uint64_t>(1));
+	QCOMPARE(funcSumLatencies(statistics.m_arrayPageOutLatency), static_cast<uint64_t>(1));
+
+	// The counters were reset, and walking through far more chunks than the budget allows causes compressions and evictions.
+	statistics = volume.getPagingStatistics();
+	QCOMPARE(statistics.m_uNoOfDirtyWriteBacks, static_cast<uint64_t>(0));
+	QCOMPARE(statistics.m_uNoOfLastChunkCacheHits, static_cast<uint64_t>(0));
+	QCOMPARE(statistics.m_uNoOfChunkTableLookups, static_cast<uint64_t>(0));
+	// The data does not compress, so the compressed chunks have to be evicted as well.
+	volume.generate(Region(0, 0, 0, 16 * 64 - 1, 15, 16 * 4 - 1), [](int32_t x, int32_t y, int32_t z) { return x * 7919 + y * 104729 + z * 31; });
+	volume.flushAll();
+	statistics = volume.getPagingStatistics();
+	QCOMPARE(statistics.m_uNoOfPageIns, static_cast<uint64_t>(pager.m_uNoOfPageIns - 1));
+	QCOMPARE(statistics.m_uNoOfPageOuts, static_cast<uint64_t>(pager.m_uNoOfPageOuts - 1));
+	QCOMPARE(statistics.m_uNoOfPageOuts, static_cast<uint64_t>(64 * 4));
+	QVERIFY(statistics.m_uNoOfCompressions > 0);
+	QVERIFY(statistics.m_uNoOfEvictions > 0);
+	QCOMPARE(funcSumLatencies(statistics.m_arrayPageInLatency), statistics.m_uNoOfPageIns);
+}
+
+void TestVolume::testMappedFilePager()
+{
+	const std::string strFilename = "testMappedFilePager.vol";
+	const Region regFile(-16, 0, 0, 47, 31, 15);
+
+	{
+		CountingTerrainPager pager;
+		PagedVolume<int32_t> volume(&pager, 4 * 1024 * 1024, 16);
+		volume.generate(regFile, [](int32_t x, int32_t y, int32_t z) { return x * 7919 + y * 104729 + z * 31; });
+		MappedFilePager<int32_t>::writeFile(strFilename, volume, regFile);
+	}
+
+	{
+		MappedFilePager<int32_t> pager(strFilename);
+		QVERIFY(pager.getEnclosingRegion() == regFile);
+
+		PagedVolume<int32_t> volume(&pager, 4 * 1024 * 1024, 16);
+		int32_t iErrors = 0;
+		for (int32_t z = regFile.getLowerZ(); z <= regFile.getUpperZ(); z++)
+		{
+			for (int32_t y = regFile.getLowerY(); y <= regFile.getUpperY(); y++)
+			{
+				for (int32_t x = regFile.getLowerX(); x <= regFile.getUpperX(); x++)
+				{
+					iErrors += (volume.getVoxel(x, y, z) != x * 7919 + y * 104729 + z * 31) ? 1 : 0;
+				}
+			}
+		}
+		QCOMPARE(iErrors, 0);
+
+		// The chunks point into the mapping rather than having their own copies of the data.
+		QVERIFY(volume.calculateSizeInBytes() < 8 * 16 * 16 * 16 * sizeof(int32_t));
+		QCOMPARE(volume.getVoxel(100, 0, 0), 0);
+
+		// Modifying a chunk gives it a copy, which the snapshot does not see and which the pager keeps when it is paged out.
+		auto snapshot = volume.snapshot();
+		volume.setVoxel(5, 6, 7, -1);
+		QCOMPARE(volume.getVoxel(5, 6, 7), -1);
+		QCOMPARE(volume.getVoxel(6, 6, 7), 6 * 7919 + 6 * 104729 + 7 * 31);
+		volume.flushAll();
+		QCOMPARE(volume.getVoxel(5, 6, 7), -1);
+		QCOMPARE(snapshot.getVoxel(5, 6, 7), 5 * 7919 + 6 * 104729 + 7 * 31);
+
+		// The memory used for the modified chunk is reported, and the change can be dropped to go back to the file.
+		QVERIFY(pager.getModifiedChunksSizeInBytes() >= 16 * 16 * 16 * sizeof(int32_t));
+		volume.flushAll();
+		pager.discardModifiedChunks();
+		QCOMPARE(pager.getModifiedChunksSizeInBytes(), static_cast<uint64_t>(0));
+		QCOMPARE(volume.getVoxel(5, 6, 7), 5 * 7919 + 6 * 104729 + 7 * 31);
+	}
+
+	// Modified chunks can instead be paged out to another pager, so that they do not use up memory.
+	{
+		FilePager<int32_t> modifiedChunkPager(".");
+		MappedFilePager<int32_t> pager(strFilename, &modifiedChunkPager);
+		PagedVolume<int32_t> volume(&pager, 4 * 1024 * 1024, 16);
+		volume.setVoxel(5, 6, 7, -1);
+		volume.flushAll();
+		QVERIFY(pager.getModifiedChunksSizeInBytes() < 16 * 16 * 16 * sizeof(int32_t));
+		QCOMPARE(volume.getVoxel(5, 6, 7), -1);
+		QCOMPARE(volume.getVoxel(6, 6, 7), 6 * 7919 + 6 * 104729 + 7 * 31);
+	}
+
+	// The file itself was not modified.
+	{
+		MappedFilePager<int32_t> pager(strFilename);
+		PagedVolume<int32_t> volume(&pager, 4 * 1024 * 1024, 16);
+		QCOMPARE(volume.getVoxel(5, 6, 7), 5 * 7919 + 6 * 104729 + 7 * 31);
+	}
+
+	QVERIFY(std::remove(strFilename.c_str()) == 0);
+}
+
+void TestVolume::testContainerFilePager()
+{
+	const std::string strFilename = "testContainerFilePager.pvc";
+	std::remove(strFilename.c_str());
+	auto funcValue = [](int32_t x, int32_t y, int32_t z) { return x * 7919 + y * 104729 + z * 31; };
+	const Region regVolume(-32, 0, 0, 63, 15, 31);
+
+	// The chunks are all written to the one container, which is kept when the pager is destroyed.
+	{
+		ContainerFilePager<int32_t> pager(strFilename);
+		PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, 16);
+		volume.generate(regVolume, funcValue);
+		volume.flushAll();
+		QCOMPARE(pager.getFreeSpaceInBytes(), static_cast<uint64_t>(0));
+	}
+
+	uint64_t uFileSizeInBytes = 0;
+	{
+		ContainerFilePager<int32_t> pager(strFilename);
+		PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, 16);
+		int32_t iErrors = 0;
+		for (int32_t z = regVolume.getLowerZ(); z <= regVolume.getUpperZ(); z++)
+		{
+			for (int32_t y = regVolume.getLowerY(); y <= regVolume.getUpperY(); y++)
+			{
+				for (int32_t x = regVolume.getLowerX(); x <= regVolume.getUpperX(); x++)
+				{
+					iErrors += (volume.getVoxel(x, y, z) != funcValue(x, y, z)) ? 1 : 0;
+				}
+			}
+		}
+		QCOMPARE(iErrors, 0);
+		QCOMPARE(volume.getVoxel(0, 100, 0), 0);
+
+		// Chunks which are paged out again are written to new records, and their old records are freed.
+		FILE* pFile = fopen(strFilename.c_str(), "rb");
+		fseek(pFile, 0, SEEK_END);
+		uFileSizeInBytes = ftell(pFile);
+		fclose(pFile);
+		volume.setVoxel(1, 2, 3, -1);
+		volume.setVoxel(-20, 2, 3, -2);
+		volume.flushAll();
+	}
+
+	{
+		ContainerFilePager<int32_t> pager(strFilename);
+		QVERIFY(pager.getFreeSpaceInBytes() > 0);
+		pager.compact();
+		QCOMPARE(pager.getFreeSpaceInBytes(), static_cast<uint64_t>(0));
+
+		PagedVolume<int32_t> volume(&pager, 1 * 1024 * 1024, 16);
+		QCOMPARE(volume.getVoxel(1, 2, 3), -1);
+		QCOMPARE(volume.getVoxel(-20, 2, 3), -2);
+		QCOMPARE(volume.getVoxel(63, 15, 31), funcValue(63, 15, 31));
+	}
+
+	FILE* pFile = fopen(strFilename.c_str(), "rb");
+	fseek(pFile, 0, SEEK_END);
+	QVERIFY(static_cast<uint64_t>(ftell(pFile)) <= uFileSizeInBytes);
+	fclose(pFile);
+
+	// Containers written by another version of the format, or whose index has been cut short, are rejected when they are opened.
+	pFile = fopen(strFilename.c_str(), "rb");
+	std::vector<char> vecContainer;
+	for (int iChar = fgetc(pFile); iChar != EOF; iChar = fgetc(pFile))
+	{
+		vecContainer.push_back(static_cast<char>(iChar));
+	}
+	fclose(pFile);
+	auto funcOpenModifiedContainer = [&](const std::vector<char>& vecModified)
+	{
+		FILE* pModifiedFile = fopen(strFilename.c_str(), "wb");
+		fwrite(vecModified.data(), 1, vecModified.size(), pModifiedFile);
+		fclose(pModifiedFile);
+		try
+		{
+			ContainerFilePager<int32_t> pager(strFilename);
+		}
+		catch (const std::runtime_error&)
+		{
+			return false;
+		}
+		return true;
+	};
+	QVERIFY(funcOpenModifiedContainer(vecContainer));
+	std::vector<char> vecModified(vecContainer);
+	const uint32_t uUnknownVersion = 2;
+	std::memcpy(vecModified.data() + 8, &uUnknownVersion, sizeof(uUnknownVersion));
+	QVERIFY(!funcOpenModifiedContainer(vecModified));
+	uint64_t uIndexOffset = 0;
+	std::memcpy(&uIndexOffset, vecContainer.data() + 16, sizeof(uIndexOffset));
+	QVERIFY(uIndexOffset > 0);
+	vecModified.assign(vecContainer.begin(), vecContainer.begin() + static_cast<size_t>(uIndexOffset) + 32 + 60);
+	QVERIFY(!funcOpenModifiedContainer(vecModified));
+	QVERIFY(funcOpenModifiedContainer(vecContainer));
+
+	// If compacting fails part way (here because the container has been emptied behind the pager's back) then the partly written
+	// copy is removed, and the pager can still be destroyed.
+	{
+		ContainerFilePager<int32_t> pager(strFilename);
+		fclose(fopen(strFilename.c_str(), "wb"));
+		bool bExceptionThrown = false;
+		try
+		{
+			pager.compact();
+		}
+		catch (const std::runtime_error&)
+		{
+			bExceptionThrown = true;
+		}
+		QVERIFY(bExceptionThrown);
+		pFile = fopen((strFilename + ".compact").c_str(), "rb");
+		QVERIFY(!pFile);
+	}
+
+	QVERIFY(std::remove(strFilename.c_str()) == 0);
+}
+
+void TestVolume::testPagedVolumeBatchPaging()
+{
+	BatchCountingPager pager;
+	PagedVolume<int32_t> volume(&pager, 4 * 1024 * 1024, 16);
+
+	// The 40 chunks are prefetched in batches of up to 16, and only those which are not resident are passed to the pager.
+	volume.getVoxel(0, 0, 0);
+	volume.prefetch(Region(0, 0, 0, 16 * 10 - 1, 15, 16 * 4 - 1)).get();
+	QCOMPARE(pager.m_uNoOfPageIns, static_cast<uint32_t>(40));
+	QCOMPARE(pager.m_vecPageInBatchSizes, std::vector<uint32_t>({ 15, 16, 8 }));
+	QCOMPARE(volume.getVoxel(100, 5, 40), 1);
+	QCOMPARE(volume.getPagingStatistics().m_uNoOfPageIns, static_cast<uint64_t>(40));
+
+	volume.prefetch(Region(0, 0, 0, 16 * 10 - 1, 15, 16 * 4 - 1)).get();
+	QCOMPARE(pager.m_uNoOfPageIns, static_cast<uint32_t>(40));
+	QCOMPARE(pager.m_vecPageInBatchSizes.size(), static_cast<size_t>(3));
+
+	// Modified chunks are written back in batches too.
+	for (int32_t x = 0; x < 10; x++)
+	{
+		for (int32_t z = 0; z < 2; z++)
+		{
+			volume.setVoxel(x * 16, 0, z * 16, 5);
+		}
+	}
+	volume.flushDirty(Region(0, 0, 0, 16 * 10 - 1, 15, 16 * 4 - 1));
+	QCOMPARE(pager.m_uNoOfPageOuts, static_cast<uint32_t>(20));
+	QCOMPARE(pager.m_vecPageOutBatchSizes, std::vector<uint32_t>({ 16, 4 }));
+	QCOMPARE(volume.getPagingStatistics().m_uNoOfDirtyWriteBacks, static_cast<uint64_t>(20));
+
+	// The container reads the chunks of a batch in the order they are stored, including those it does not have.
+	const std::string strFilename = "testPagedVolumeBatchPaging.pvc";
+	std::remove(strFilename.c_str());
+	auto funcValue = [](int32_t x, int32_t y, int32_t z) { return x * 7919 + y * 104729 + z * 31; };
+	const Region regVolume(-32, 0, 0, 63, 15, 31);
+	{
+		ContainerFilePager<int32_t> containerPager(strFilename);
+		PagedVolume<int32_t> containerVolume(&containerPager, 1 * 1024 * 1024, 16);
+		containerVolume.generate(regVolume, funcValue);
+		containerVolume.flushDirty(regVolume);
+	}
+	{
+		ContainerFilePager<int32_t> containerPager(strFilename);
+		PagedVolume<int32_t> containerVolume(&containerPager, 1 * 1024 * 1024, 16);
+		containerVolume.prefetch(Region(-32, 0, 0, 63, 31, 31)).get();
+		QCOMPARE(containerVolume.getPagingStatistics().m_uNoOfPageIns, static_cast<uint64_t>(24));
+
+		int32_t iErrors = 0;
+		for (int32_t z = regVolume.getLowerZ(); z <= regVolume.getUpperZ(); z++)
+		{
+			for (int32_t y = regVolume.getLowerY(); y <= regVolume.getUpperY(); y++)
+			{
+				for (int32_t x = regVolume.getLowerX(); x <= regVolume.getUpperX(); x++)
+				{
+					iErrors += (containerVolume.getVoxel(x, y, z) != funcValue(x, y, z)) ? 1 : 0;
+				}
+			}
+		}
+		QCOMPARE(iErrors, 0);
+		QCOMPARE(containerVolume.getVoxel(-20, 20, 10), 0);
+		QCOMPARE(containerVolume.getPagingStatistics().m_uNoOfPageIns, static_cast<uint64_t>(24));
+	}
+	QVERIFY(std::remove(strFilename.c_str()) == 0);
+}
+
+void TestVolume::testPagedVolumeValueRange()
+{
+	CountingTerrainPager pager;
+	PagedVolume<int32_t> volume(&pager, 4 * 1024 * 1024, 16);
+
+	// The terrain is solid below y = 20, so the chunks above it only contain zeros.
+	int32_t iMin = -1;
+	int32_t iMax = -1;
+	QVERIFY(volume.getValueRange(Region(0, 0, 0, 31, 15, 31), iMin, iMax));
+	QCOMPARE(iMin, 1);
+	QCOMPARE(iMax, 1);
+	QVERIFY(volume.getValueRange(Region(0, 10, 0, 31, 25, 31), iMin, iMax));
+	QCOMPARE(iMin, 0);
+	QCOMPARE(iMax, 1);
+	QVERIFY(volume.getValueRange(Region(0, 32, 0, 31, 47, 31), iMin, iMax));
+	QCOMPARE(iMin, 0);
+	QCOMPARE(iMax, 0);
+	QCOMPARE(pager.m_uNoOfPageIns, static_cast<uint32_t>(12));
+
+	// Writes change the range of the chunk they are in, but not that of the chunks around it.
+	volume.setVoxel(5, 40, 5, 7);
+	QVERIFY(volume.getValueRange(Region(0, 32, 0, 15, 47, 15), iMin, iMax));
+	QCOMPARE(iMax, 7);
+	QVERIFY(volume.getValueRange(Region(16, 32, 0, 31, 47, 15), iMin, iMax));
+	QCOMPARE(iMax, 0);
+
+	volume.generate(Region(20, 35, 3, 22, 36, 4), [](int32_t, int32_t, int32_t) { return -4; });
+	QVERIFY(volume.getValueRange(Region(16, 32, 0, 31, 47, 15), iMin, iMax));
+	QCOMPARE(iMin, -4);
+	QCOMPARE(iMax, 0);
+
+	{
+		PagedVolume<int32_t>::Sampler sampler(&volume);
+		sampler.setPosition(20, 40, 20);
+		sampler.setVoxel(12);
+	}
+	{
+		const Region regWrite(10, 33, 30, 20, 33, 30);
+		PagedVolume<int32_t>::RegionWriter writer(&volume, regWrite);
+		while (!writer.isFinished())
+		{
+			writer.writeVoxel(9);
+		}
+	}
+	QVERIFY(volume.getValueRange(Region(16, 32, 16, 31, 47, 31), iMin, iMax));
+	QCOMPARE(iMin, 0);
+	QCOMPARE(iMax, 12);
+	QVERIFY(volume.getValueRange(Region(0, 32, 16, 15, 47, 31), iMin, iMax));
+	QCOMPARE(iMax, 9);
+
+	// Filling a whole chunk gives it an exact range again.
+	volume.fill(Region(0, 32, 0, 15, 47, 15), 3);
+	QVERIFY(volume.getValueRange(Region(0, 32, 0, 15, 47, 15), iMin, iMax));
+	QCOMPARE(iMin, 3);
+	QCOMPARE(iMax, 3);
+
+	// The range is recalculated after writes, so overwritten values are forgotten.
+	volume.setVoxel(5, 40, 5, 0);
+	QVERIFY(volume.getValueRange(Region(0, 32, 0, 15, 47, 15), iMin, iMax));
+	QCOMPARE(iMin, 0);
+	QCOMPARE(iMax, 3);
+	volume.setVoxel(5, 40, 5, 3);
+	QVERIFY(volume.getValueRange(Region(0, 32, 0, 15, 47, 15), iMin, iMax));
+	QCOMPARE(iMin, 3);
+	QCOMPARE(iMax, 3);
+
+	// This pager regenerates the terrain when the chunk is paged in again.
+	volume.flushAll();
+	QVERIFY(volume.getValueRange(Region(0, 32, 0, 15, 47, 15), iMin, iMax));
+	QCOMPARE(iMin, 0);
+	QCOMPARE(iMax, 0);
+
+	// NaNs cannot be ordered, so the range of the chunk containing one is unknown.
+	FilePager<float> floatPager(".");
+	PagedVolume<float> floatVolume(&floatPager, 4 * 1024 * 1024, 16);
+	floatVolume.fill(Region(0, 0, 0, 31, 15, 15), 2.5f);
+	float fMin = 0.0f;
+	float fMax = 0.0f;
+	QVERIFY(floatVolume.getValueRange(Region(0, 0, 0, 31, 15, 15), fMin, fMax));
+	QCOMPARE(fMin, 2.5f);
+	QCOMPARE(fMax, 2.5f);
+	floatVolume.setVoxel(20, 1, 1, std::numeric_limits<float>::quiet_NaN());
+	QVERIFY(floatVolume.getValueRange(Region(0, 0, 0, 15, 15, 15), fMin, fMax));
+	QVERIFY(!floatVolume.getValueRange(Region(0, 0, 0, 31, 15, 15), fMin, fMax));
+}
+
+void TestVolume::testMortonConversion()
+{
+	for (uint32_t uSideLength = 1; uSideLength <= 64; uSideLength *= 2)
+	{
+		QVERIFY(checkMortonConversion<uint8_t>(uSideLength));
+		QVERIFY(checkMortonConversion<uint16_t>(uSideLength));
+		QVERIFY(checkMortonConversion<int32_t>(uSideLength));
+		QVERIFY(checkMortonConversion<double>(uSideLength));
+	}
+
+	// The chunk functions convert the data in a buffer from the volume's pool.
+	CountingTerrainPager pager;
+	PagedVolume<int32_t> volume(&pager, 4 * 1024 * 1024, 16);
+	volume.setVoxel(3, 5, 7, 100);
+	auto handle = volume.pinChunk(Vector3DInt32(0, 0, 0));
+	handle->changeMortonOrderingToLinear();
+	QCOMPARE(handle->getData()[3 + 5 * 16 + 7 * 16 * 16], 100);
+	handle->changeLinearOrderingToMorton();
+	QCOMPARE(handle->getVoxel(3, 5, 7), 100);
+	QCOMPARE(volume.getVoxel(3, 5, 7), 100);
+}
+
+void TestVolume::testMortonConversionReferenceSpeed()
+{
+	const uint32_t uSideLength = 32;
+	std::vector<uint8_t> vecLinear(uSideLength * uSideLength * uSideLength, 1);
+	std::vector<uint8_t> vecMorton(vecLinear.size());
+	std::vector<int32_t> vecLinearInt(vecLinear.size(), 1);
+	std::vector<int32_t> vecMortonInt(vecLinear.size());
+
+	QBENCHMARK
+	{
+		convertLinearOrderingToMortonReference(vecLinear.data(), vecMorton.data(), uSideLength);
+		convertLinearOrderingToMortonReference(vecLinearInt.data(), vecMortonInt.data(), uSideLength);
+	}
+}
+
+void TestVolume::testMortonConversionSpeed()
+{
+	const uint32_t uSideLength = 32;
+	std::vector<uint8_t> vecLinear(uSideLength * uSideLength * uSideLength, 1);
+	std::vector<uint8_t> vecMorton(vecLinear.size());
+	std::vector<int32_t> vecLinearInt(vecLinear.size(), 1);
+	std::vector<int32_t> vecMortonInt(vecLinear.size());
+
+	QBENCHMARK
+	{
+		convertLinearOrderingToMorton(vecLinear.data(), vecMorton.data(), uSideLength);
+		convertLinearOrderingToMorton(vecLinearInt.data(), vecMortonInt.data(), uSideLength);
+	}
+}
+
 QTEST_MAIN(TestVolume)
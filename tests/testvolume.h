@@ -59,11 +59,40 @@ private slots:
 	void testPagedVolumeDirectAccessWithExternalBackwards();
 	void testPagedVolumeSamplersWithExternalBackwards();
 
+	void testRawVolumeSamplerRowSweep();
+	void testPagedVolumeSamplerRowSweep();
+
 	void testRawVolumeDirectRandomAccess();
 	void testPagedVolumeDirectRandomAccess();
 
 	void testPagedVolumeChunkLocalAccess();
 	void testPagedVolumeChunkRandomAccess();
+	void testPagedVolumeChunkPinning();
+	void testPagedVolumeCompressedChunks();
+	void testPagedVolumeHomogeneousChunks();
+	void testPagedVolumeChunkBufferPool();
+	void testPagedVolumeManyChunks();
+	void testPagedVolumeTargetMemoryUsage();
+	void testPagedVolumeCheckpoint();
+	void testVolumeVersions();
+	void testVolumeBulkWrites();
+	void testVolumeBulkReads();
+	void testPagedVolumeSnapshots();
+	void testPagedVolumeSamplerWrites();
+	void testPagedVolumeSamplerNeighbours();
+	void testPagedVolumeFocus();
+	void testPagedVolumePagingStatistics();
+	void testMappedFilePager();
+	void testContainerFilePager();
+	void testPagedVolumeBatchPaging();
+	void testPagedVolumeValueRange();
+
+	void testMortonConversion();
+	void testMortonConversionReferenceSpeed();
+	void testMortonConversionSpeed();
+
+	void testPagedVolumeConcurrentAccess();
+	void testPagedVolumeBackgroundPaging();
 
 private:
 	int32_t testPagedVolumeChunkAccess(uint16_t localityMask);